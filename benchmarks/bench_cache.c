@@ -0,0 +1,527 @@
+#define _POSIX_C_SOURCE 200809L
+#include "cache.h"
+#include "common.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+
+#define BENCH_ITERATIONS 100000
+#define BENCH_CACHE_SIZE 10000
+
+// Trace-driven hit-ratio settings
+#define TRACE_LENGTH 500000
+#define TRACE_CACHE_SIZE 1000
+#define TRACE_KEY_SPACE 20000
+#define TRACE_ZIPF_SKEW 0.9
+#define TRACE_SCAN_LENGTH 3000
+#define TRACE_SCAN_INTERVAL 20000
+
+// Concurrent read-mostly settings
+#define CONCURRENT_OPS_PER_THREAD 200000
+#define CONCURRENT_KEYS 10000
+#define CONCURRENT_WRITE_PERCENT 5
+
+// Snapshot settings
+#define SNAPSHOT_ENTRIES 200000
+#define SNAPSHOT_VALUE_SIZE 256
+#define SNAPSHOT_PATH "/tmp/bench_cache_snapshot.bin"
+
+// Batch settings: a page render's worth of keys against a cache too large
+// for the CPU caches, so bucket and entry loads actually miss
+#define BATCH_KEYS 64
+#define BATCH_ROUNDS 20000
+#define BATCH_CACHE_ENTRIES 500000
+#define BATCH_POOL (BATCH_KEYS * 1024)
+
+// Index growth settings
+#define GROWTH_ENTRIES 1000000
+
+// Timing utilities
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void print_benchmark_result(const char* name, uint64_t total_ns, int iterations) {
+    double avg_ns = (double)total_ns / iterations;
+    double ops_per_sec = 1000000000.0 / avg_ns;
+    
+    printf("%-40s: %10.2f ns/op, %12.0f ops/sec\n",
+           name, avg_ns, ops_per_sec);
+}
+
+static const char* policy_name(eviction_policy_t policy) {
+    switch (policy) {
+        case EVICTION_LRU: return "LRU";
+        case EVICTION_LFU: return "LFU";
+        case EVICTION_TINYLFU: return "W-TinyLFU";
+        case EVICTION_SIEVE: return "SIEVE";
+    }
+    return "?";
+}
+
+static uint64_t rng_state = 0x2545F4914F6CDD1DULL;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// =============================================================================
+// Trace Generation
+// =============================================================================
+
+// Zipf sampler over [0, n) using an inverted CDF table
+typedef struct {
+    double* cdf;
+    size_t n;
+} zipf_t;
+
+static zipf_t zipf_create(size_t n, double skew) {
+    zipf_t zipf = { safe_malloc(n * sizeof(double)), n };
+    double sum = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        sum += 1.0 / pow((double)(i + 1), skew);
+        zipf.cdf[i] = sum;
+    }
+    for (size_t i = 0; i < n; i++) {
+        zipf.cdf[i] /= sum;
+    }
+    return zipf;
+}
+
+static size_t zipf_next(const zipf_t* zipf) {
+    double u = (double)(next_random() >> 11) / (double)(1ULL << 53);
+    size_t lo = 0;
+    size_t hi = zipf->n - 1;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (zipf->cdf[mid] < u) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Builds a trace of key ids. With scans enabled, every TRACE_SCAN_INTERVAL
+// accesses a crawler-style burst of never-repeated keys is injected.
+static uint64_t* build_trace(bool with_scans) {
+    uint64_t* trace = safe_malloc(TRACE_LENGTH * sizeof(uint64_t));
+    zipf_t zipf = zipf_create(TRACE_KEY_SPACE, TRACE_ZIPF_SKEW);
+    uint64_t scan_key = TRACE_KEY_SPACE;
+    
+    size_t i = 0;
+    while (i < TRACE_LENGTH) {
+        if (with_scans && i > 0 && i % TRACE_SCAN_INTERVAL == 0) {
+            for (int s = 0; s < TRACE_SCAN_LENGTH && i < TRACE_LENGTH; s++) {
+                trace[i++] = scan_key++;
+            }
+            continue;
+        }
+        trace[i++] = zipf_next(&zipf);
+    }
+    
+    safe_free((void**)&zipf.cdf);
+    return trace;
+}
+
+static double replay_trace(const uint64_t* trace, eviction_policy_t policy) {
+    cache_t* cache = cache_create(TRACE_CACHE_SIZE, policy);
+    char key[32];
+    
+    for (size_t i = 0; i < TRACE_LENGTH; i++) {
+        snprintf(key, sizeof(key), "k%lu", (unsigned long)trace[i]);
+        if (cache_get(cache, key, NULL, NULL) != SUCCESS) {
+            cache_put(cache, key, "v", 2);
+        }
+    }
+    
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    cache_destroy(cache);
+    
+    return (double)stats.hits / (double)(stats.hits + stats.misses);
+}
+
+// =============================================================================
+// Hit Ratio Benchmarks
+// =============================================================================
+
+void bench_hit_ratio(const char* name, bool with_scans) {
+    uint64_t* trace = build_trace(with_scans);
+    eviction_policy_t policies[] = { EVICTION_LRU, EVICTION_LFU, EVICTION_TINYLFU, EVICTION_SIEVE };
+    
+    printf("%s (%d accesses, cache %d, %d keys):\n",
+           name, TRACE_LENGTH, TRACE_CACHE_SIZE, TRACE_KEY_SPACE);
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+        double hit_ratio = replay_trace(trace, policies[p]);
+        printf("  %-38s: %9.2f%% hit ratio\n", policy_name(policies[p]), hit_ratio * 100.0);
+    }
+    
+    safe_free((void**)&trace);
+}
+
+// =============================================================================
+// Throughput Benchmarks
+// =============================================================================
+
+void bench_cache_put(eviction_policy_t policy) {
+    cache_t* cache = cache_create(BENCH_CACHE_SIZE, policy);
+    char key[32];
+    char name[64];
+    
+    uint64_t start = get_time_ns();
+    
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        snprintf(key, sizeof(key), "key%d", i % (BENCH_CACHE_SIZE * 2));
+        cache_put(cache, key, "value", 6);
+    }
+    
+    uint64_t elapsed = get_time_ns() - start;
+    snprintf(name, sizeof(name), "Cache Put (%s)", policy_name(policy));
+    print_benchmark_result(name, elapsed, BENCH_ITERATIONS);
+    
+    cache_destroy(cache);
+}
+
+void bench_cache_get(eviction_policy_t policy) {
+    cache_t* cache = cache_create(BENCH_CACHE_SIZE, policy);
+    char key[32];
+    char name[64];
+    
+    for (int i = 0; i < BENCH_CACHE_SIZE; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        cache_put(cache, key, "value", 6);
+    }
+    
+    uint64_t start = get_time_ns();
+    
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        snprintf(key, sizeof(key), "key%d", i % BENCH_CACHE_SIZE);
+        cache_get(cache, key, NULL, NULL);
+    }
+    
+    uint64_t elapsed = get_time_ns() - start;
+    snprintf(name, sizeof(name), "Cache Get (%s)", policy_name(policy));
+    print_benchmark_result(name, elapsed, BENCH_ITERATIONS);
+    
+    cache_destroy(cache);
+}
+
+// =============================================================================
+// Concurrent Read-Mostly Benchmarks
+// =============================================================================
+
+typedef struct {
+    cache_t* cache;
+    uint64_t seed;
+} concurrent_worker_t;
+
+static void* concurrent_worker(void* arg) {
+    concurrent_worker_t* worker = (concurrent_worker_t*)arg;
+    uint64_t state = worker->seed;
+    char key[32];
+    
+    for (int i = 0; i < CONCURRENT_OPS_PER_THREAD; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        snprintf(key, sizeof(key), "key%lu", (unsigned long)(state % CONCURRENT_KEYS));
+        
+        if (state % 100 < CONCURRENT_WRITE_PERCENT) {
+            cache_put(worker->cache, key, "value", 6);
+        } else {
+            cache_get(worker->cache, key, NULL, NULL);
+        }
+    }
+    
+    return NULL;
+}
+
+void bench_concurrent_read_mostly(eviction_policy_t policy, int threads) {
+    cache_t* cache = cache_create(CONCURRENT_KEYS, policy);
+    char key[32];
+    char name[64];
+    
+    for (int i = 0; i < CONCURRENT_KEYS; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        cache_put(cache, key, "value", 6);
+    }
+    
+    pthread_t tids[threads];
+    concurrent_worker_t workers[threads];
+    
+    uint64_t start = get_time_ns();
+    
+    for (int t = 0; t < threads; t++) {
+        workers[t].cache = cache;
+        workers[t].seed = 0x9E3779B97F4A7C15ULL * (uint64_t)(t + 1);
+        pthread_create(&tids[t], NULL, concurrent_worker, &workers[t]);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    
+    uint64_t elapsed = get_time_ns() - start;
+    snprintf(name, sizeof(name), "%s %d thread(s), %d%% writes",
+             policy_name(policy), threads, CONCURRENT_WRITE_PERCENT);
+    print_benchmark_result(name, elapsed, CONCURRENT_OPS_PER_THREAD * threads);
+    
+    cache_destroy(cache);
+}
+
+// =============================================================================
+// Snapshot Benchmarks
+// =============================================================================
+
+typedef struct {
+    cache_t* cache;
+    int stop;
+    uint64_t max_put_ns;
+} snapshot_writer_args_t;
+
+static void* snapshot_writer(void* arg) {
+    snapshot_writer_args_t* args = (snapshot_writer_args_t*)arg;
+    char key[32];
+    for (int i = 0; !__atomic_load_n(&args->stop, __ATOMIC_ACQUIRE); i++) {
+        snprintf(key, sizeof(key), "key%d", i % SNAPSHOT_ENTRIES);
+        uint64_t start = get_time_ns();
+        cache_put(args->cache, key, "w", 2);
+        uint64_t elapsed = get_time_ns() - start;
+        if (elapsed > args->max_put_ns) args->max_put_ns = elapsed;
+    }
+    return NULL;
+}
+
+void bench_snapshot(void) {
+    cache_t* cache = cache_create(SNAPSHOT_ENTRIES, EVICTION_LRU);
+    char key[32];
+    char value[SNAPSHOT_VALUE_SIZE];
+    memset(value, 'x', sizeof(value));
+    
+    for (int i = 0; i < SNAPSHOT_ENTRIES; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        cache_put_with_ttl(cache, key, value, sizeof(value), 3600000);
+    }
+    
+    double megabytes = (double)SNAPSHOT_ENTRIES * (SNAPSHOT_VALUE_SIZE + 48) / (1024.0 * 1024.0);
+    
+    uint64_t start = get_time_ns();
+    cache_snapshot_save(cache, SNAPSHOT_PATH);
+    uint64_t elapsed = get_time_ns() - start;
+    print_benchmark_result("Snapshot Save (per entry)", elapsed, SNAPSHOT_ENTRIES);
+    printf("  %-38s: %9.1f MB/s\n", "Save throughput", megabytes / (elapsed / 1e9));
+    
+    // Writers only wait for one chunk copy, not for the file I/O
+    snapshot_writer_args_t args = { .cache = cache, .stop = 0, .max_put_ns = 0 };
+    pthread_t writer;
+    pthread_create(&writer, NULL, snapshot_writer, &args);
+    cache_snapshot_save(cache, SNAPSHOT_PATH);
+    __atomic_store_n(&args.stop, 1, __ATOMIC_RELEASE);
+    pthread_join(writer, NULL);
+    printf("  %-38s: %9.2f ms\n", "Longest put during save", args.max_put_ns / 1e6);
+    cache_destroy(cache);
+    
+    cache_t* restored = cache_create(SNAPSHOT_ENTRIES, EVICTION_LRU);
+    start = get_time_ns();
+    cache_snapshot_load(restored, SNAPSHOT_PATH);
+    elapsed = get_time_ns() - start;
+    print_benchmark_result("Snapshot Load (per entry)", elapsed, SNAPSHOT_ENTRIES);
+    printf("  %-38s: %9.1f MB/s\n", "Load throughput", megabytes / (elapsed / 1e9));
+    cache_destroy(restored);
+    
+    remove(SNAPSHOT_PATH);
+}
+
+// =============================================================================
+// Batch Benchmarks
+// =============================================================================
+
+void bench_batch_get(eviction_policy_t policy) {
+    cache_t* cache = cache_create(BATCH_CACHE_ENTRIES, policy);
+    static char key_storage[BATCH_POOL][16];
+    const char* keys[BATCH_KEYS];
+    void* values[BATCH_KEYS];
+    size_t sizes[BATCH_KEYS];
+    char name[64];
+    
+    for (int i = 0; i < BATCH_CACHE_ENTRIES; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%d", i);
+        cache_put(cache, key, "value", 6);
+    }
+    
+    // Random batches drawn from the whole key space
+    size_t batches = BATCH_POOL / BATCH_KEYS;
+    for (size_t i = 0; i < BATCH_POOL; i++) {
+        snprintf(key_storage[i], sizeof(key_storage[i]), "key%d",
+                 (int)(next_random() % BATCH_CACHE_ENTRIES));
+    }
+    
+    uint64_t start = get_time_ns();
+    for (int r = 0; r < BATCH_ROUNDS; r++) {
+        size_t base = (r % batches) * BATCH_KEYS;
+        for (int i = 0; i < BATCH_KEYS; i++) {
+            cache_get(cache, key_storage[base + i], &values[i], &sizes[i]);
+        }
+        for (int i = 0; i < BATCH_KEYS; i++) {
+            free(values[i]);
+        }
+    }
+    uint64_t elapsed = get_time_ns() - start;
+    snprintf(name, sizeof(name), "Get x%d loop (%s, per key)", BATCH_KEYS, policy_name(policy));
+    print_benchmark_result(name, elapsed, BATCH_ROUNDS * BATCH_KEYS);
+    
+    start = get_time_ns();
+    for (int r = 0; r < BATCH_ROUNDS; r++) {
+        size_t base = (r % batches) * BATCH_KEYS;
+        for (int i = 0; i < BATCH_KEYS; i++) {
+            keys[i] = key_storage[base + i];
+        }
+        cache_mget(cache, keys, BATCH_KEYS, values, sizes);
+        for (int i = 0; i < BATCH_KEYS; i++) {
+            free(values[i]);
+        }
+    }
+    elapsed = get_time_ns() - start;
+    snprintf(name, sizeof(name), "Mget x%d (%s, per key)", BATCH_KEYS, policy_name(policy));
+    print_benchmark_result(name, elapsed, BATCH_ROUNDS * BATCH_KEYS);
+    
+    cache_destroy(cache);
+}
+
+void bench_batch_put(void) {
+    cache_t* cache = cache_create(BATCH_CACHE_ENTRIES, EVICTION_LRU);
+    static char key_storage[BATCH_POOL][16];
+    const char* keys[BATCH_KEYS];
+    const void* values[BATCH_KEYS];
+    size_t sizes[BATCH_KEYS];
+    char name[64];
+    
+    size_t batches = BATCH_POOL / BATCH_KEYS;
+    for (size_t i = 0; i < BATCH_POOL; i++) {
+        snprintf(key_storage[i], sizeof(key_storage[i]), "key%d",
+                 (int)(next_random() % BATCH_CACHE_ENTRIES));
+    }
+    for (int i = 0; i < BATCH_KEYS; i++) {
+        values[i] = "value";
+        sizes[i] = 6;
+    }
+    
+    uint64_t start = get_time_ns();
+    for (int r = 0; r < BATCH_ROUNDS; r++) {
+        size_t base = (r % batches) * BATCH_KEYS;
+        for (int i = 0; i < BATCH_KEYS; i++) {
+            cache_put(cache, key_storage[base + i], "value", 6);
+        }
+    }
+    uint64_t elapsed = get_time_ns() - start;
+    snprintf(name, sizeof(name), "Put x%d loop (LRU, per key)", BATCH_KEYS);
+    print_benchmark_result(name, elapsed, BATCH_ROUNDS * BATCH_KEYS);
+    
+    start = get_time_ns();
+    for (int r = 0; r < BATCH_ROUNDS; r++) {
+        size_t base = (r % batches) * BATCH_KEYS;
+        for (int i = 0; i < BATCH_KEYS; i++) {
+            keys[i] = key_storage[base + i];
+        }
+        cache_mput(cache, keys, BATCH_KEYS, values, sizes, 0);
+    }
+    elapsed = get_time_ns() - start;
+    snprintf(name, sizeof(name), "Mput x%d (LRU, per key)", BATCH_KEYS);
+    print_benchmark_result(name, elapsed, BATCH_ROUNDS * BATCH_KEYS);
+    
+    cache_destroy(cache);
+}
+
+// =============================================================================
+// Index Growth Benchmarks
+// =============================================================================
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Fill an empty cache so the index doubles ~16 times and report the tail of
+// single-put latency; with incremental rehashing no put pays for a whole table
+// copy. The worst case on a busy machine also includes scheduler preemption.
+void bench_index_growth(void) {
+    cache_t* cache = cache_create(GROWTH_ENTRIES, EVICTION_LRU);
+    uint64_t* latencies = malloc(GROWTH_ENTRIES * sizeof(uint64_t));
+    char key[32];
+    
+    uint64_t start = get_time_ns();
+    
+    for (int i = 0; i < GROWTH_ENTRIES; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        uint64_t op_start = get_time_ns();
+        cache_put(cache, key, "value", 6);
+        latencies[i] = get_time_ns() - op_start;
+    }
+    
+    uint64_t elapsed = get_time_ns() - start;
+    print_benchmark_result("Put with index growth (1M)", elapsed, GROWTH_ENTRIES);
+    
+    qsort(latencies, GROWTH_ENTRIES, sizeof(uint64_t), compare_u64);
+    printf("  %-38s: %9.1f us\n", "p99.99 single put",
+           latencies[GROWTH_ENTRIES - GROWTH_ENTRIES / 10000] / 1000.0);
+    printf("  %-38s: %9.1f us\n", "Worst single put", latencies[GROWTH_ENTRIES - 1] / 1000.0);
+    
+    free(latencies);
+    cache_destroy(cache);
+}
+
+// =============================================================================
+// Main Benchmark Runner
+// =============================================================================
+
+int main(void) {
+    printf("========================================\n");
+    printf("Cache System Benchmarks\n");
+    printf("========================================\n\n");
+    
+    printf("=== Throughput Benchmarks ===\n");
+    bench_cache_put(EVICTION_LRU);
+    bench_cache_put(EVICTION_TINYLFU);
+    bench_cache_get(EVICTION_LRU);
+    bench_cache_get(EVICTION_LFU);
+    bench_cache_get(EVICTION_TINYLFU);
+    bench_cache_get(EVICTION_SIEVE);
+    
+    printf("\n=== Concurrent Read-Mostly (LRU write lock vs SIEVE read lock) ===\n");
+    int thread_counts[] = { 1, 2, 4, 8 };
+    for (size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++) {
+        bench_concurrent_read_mostly(EVICTION_LRU, thread_counts[i]);
+        bench_concurrent_read_mostly(EVICTION_SIEVE, thread_counts[i]);
+    }
+    
+    printf("\n=== Warm-Restart Snapshots ===\n");
+    bench_snapshot();
+    
+    printf("\n=== Batch Get/Put vs Single-Key Loop ===\n");
+    bench_batch_get(EVICTION_LRU);
+    bench_batch_get(EVICTION_SIEVE);
+    bench_batch_put();
+    
+    printf("\n=== Incremental Index Resizing ===\n");
+    bench_index_growth();
+    
+    printf("\n=== Trace-Driven Hit Ratio ===\n");
+    bench_hit_ratio("Zipf trace", false);
+    bench_hit_ratio("Zipf trace with scans", true);
+    
+    printf("\n========================================\n");
+    printf("Benchmarks completed successfully!\n");
+    printf("========================================\n");
+    
+    return 0;
+}
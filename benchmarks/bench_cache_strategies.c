@@ -0,0 +1,955 @@
+#define _POSIX_C_SOURCE 200809L
+#include "cache_strategies.h"
+#include "common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define BENCH_ITERATIONS 200000
+#define BENCH_KEYS 10000
+
+// Stampede settings: callers released on a freshly expired hot key
+#define STAMPEDE_CALLERS 256
+#define STAMPEDE_EXPIRIES 5
+#define STAMPEDE_LOAD_MS 5
+
+// Refresh settings: readers polling a hot key with a short TTL
+#define REFRESH_READERS 8
+#define REFRESH_TTL_MS 100
+#define REFRESH_RUN_MS 1000
+#define REFRESH_STALL_NS 2000000ULL
+
+// Write-behind settings: counter updates over a small hot key set
+#define WB_WRITES 20000
+#define WB_HOT_KEYS 200
+#define WB_WRITE_US 50
+
+// Cache warming
+#define WARMUP_KEYS 4000
+#define WARMUP_LOAD_US 200
+
+// Near cache
+#define NEAR_THREADS 4
+#define NEAR_OPS 400000
+#define NEAR_HOT_KEYS 128
+#define NEAR_WRITE_EVERY 1000   // One shared-cache write per this many reads
+
+// Invalidation settings: a catalog of products spread over categories
+#define CATALOG_PRODUCTS 200000
+#define CATALOG_CATEGORIES 10
+
+// Compression settings: HTML fragments of about 4 KB
+#define DOC_COUNT 2000
+#define DOC_SIZE 4096
+#define DOC_READS 20000
+#define BYTES_PER_MB (1024.0 * 1024.0)
+
+// Redis backend settings: small values over loopback
+#define REDIS_OPS 20000
+#define REDIS_KEYS 1000
+#define REDIS_BATCH 100
+#define REDIS_THREADS 4
+
+// Cluster settings: nodes on loopback, keys written with full replication
+#define CLUSTER_NODES 3
+
+// Timing utilities
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void print_benchmark_result(const char* name, uint64_t total_ns, int iterations) {
+    double avg_ns = (double)total_ns / iterations;
+    double ops_per_sec = 1000000000.0 / avg_ns;
+    
+    printf("%-40s: %10.2f ns/op, %12.0f ops/sec\n",
+           name, avg_ns, ops_per_sec);
+}
+
+static cache_instance_t* create_memory_cache(size_t max_size) {
+    cache_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.type = CACHE_TYPE_MEMORY;
+    config.eviction_policy = CACHE_EVICTION_LRU;
+    config.max_size = max_size;
+    return cache_instance_create(&config);
+}
+
+// =============================================================================
+// Throughput Benchmarks
+// =============================================================================
+
+void bench_cache_set(void) {
+    cache_instance_t* cache = create_memory_cache(BENCH_KEYS);
+    char key[32];
+    
+    uint64_t start = get_time_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        snprintf(key, sizeof(key), "key%d", i % (BENCH_KEYS * 2));
+        cache_set(cache, key, "value", 6);
+    }
+    uint64_t elapsed = get_time_ns() - start;
+    print_benchmark_result("Cache Set (sharded memory store)", elapsed, BENCH_ITERATIONS);
+    
+    cache_instance_destroy(cache);
+}
+
+void bench_cache_get(void) {
+    cache_instance_t* cache = create_memory_cache(BENCH_KEYS);
+    char key[32];
+    
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        cache_set(cache, key, "value", 6);
+    }
+    
+    uint64_t start = get_time_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        snprintf(key, sizeof(key), "key%d", i % BENCH_KEYS);
+        cache_get(cache, key, NULL, NULL);
+    }
+    uint64_t elapsed = get_time_ns() - start;
+    print_benchmark_result("Cache Get (sharded memory store)", elapsed, BENCH_ITERATIONS);
+    
+    cache_instance_destroy(cache);
+}
+
+// =============================================================================
+// Compression Benchmarks
+// =============================================================================
+
+// A product listing rendered as HTML
+static size_t make_page(char* buffer, int seed) {
+    size_t length = 0;
+    for (int i = 0; length + 200 < DOC_SIZE; i++) {
+        length += (size_t)snprintf(buffer + length, DOC_SIZE - length,
+                                   "<li class=\"product\"><a href=\"/p/%d\">Item %d</a>"
+                                   "<span class=\"price\">$%d.99</span></li>\n",
+                                   seed * 100 + i, (seed * 7 + i) % 1000, (seed + i) % 90 + 10);
+    }
+    return length;
+}
+
+void bench_compression(bool enabled) {
+    cache_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.type = CACHE_TYPE_MEMORY;
+    config.eviction_policy = CACHE_EVICTION_LRU;
+    config.max_size = DOC_COUNT;
+    config.enable_compression = enabled;
+    cache_instance_t* cache = cache_instance_create(&config);
+    
+    static char pages[DOC_COUNT][DOC_SIZE];
+    size_t lengths[DOC_COUNT];
+    size_t raw_bytes = 0;
+    for (int i = 0; i < DOC_COUNT; i++) {
+        lengths[i] = make_page(pages[i], i);
+        raw_bytes += lengths[i];
+    }
+    char key[32];
+    
+    uint64_t start = get_time_ns();
+    for (int i = 0; i < DOC_COUNT; i++) {
+        snprintf(key, sizeof(key), "page%d", i);
+        cache_set(cache, key, pages[i], lengths[i]);
+    }
+    print_benchmark_result(enabled ? "Set 4 KB page (compressed)" : "Set 4 KB page (raw)",
+                           get_time_ns() - start, DOC_COUNT);
+    
+    start = get_time_ns();
+    for (int i = 0; i < DOC_READS; i++) {
+        snprintf(key, sizeof(key), "page%d", i % DOC_COUNT);
+        void* value;
+        size_t size;
+        cache_get(cache, key, &value, &size);
+        free(value);
+    }
+    print_benchmark_result(enabled ? "Get 4 KB page (compressed)" : "Get 4 KB page (raw)",
+                           get_time_ns() - start, DOC_READS);
+    
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    printf("  %-38s: %9.2f MB\n", "memory used", stats.memory_used_mb);
+    if (enabled) {
+        printf("  %-38s: %9.2fx\n", "compression ratio",
+               (double)raw_bytes / (raw_bytes - stats.compression_bytes_saved));
+        printf("  %-38s: %9.1f MB/s compress, %.1f MB/s decompress\n", "codec throughput",
+               raw_bytes / BYTES_PER_MB / (stats.compression_time_ns / 1e9),
+               (double)DOC_READS / DOC_COUNT * raw_bytes / BYTES_PER_MB / (stats.decompression_time_ns / 1e9));
+    }
+    
+    cache_instance_destroy(cache);
+}
+
+// =============================================================================
+// Stampede Benchmarks
+// =============================================================================
+
+typedef struct {
+    int calls;
+} backend_t;
+
+// Stand-in for a database query
+static void* backend_load(const char* key, void* ctx, size_t* size) {
+    backend_t* backend = (backend_t*)ctx;
+    __atomic_fetch_add(&backend->calls, 1, __ATOMIC_RELAXED);
+    
+    struct timespec delay = { 0, STAMPEDE_LOAD_MS * 1000000L };
+    nanosleep(&delay, NULL);
+    
+    char* value = safe_malloc(64);
+    *size = (size_t)snprintf(value, 64, "row:%s", key) + 1;
+    return value;
+}
+
+typedef struct {
+    cache_instance_t* cache;
+    backend_t* backend;
+    pthread_barrier_t* barrier;
+    bool single_flight;
+} stampede_caller_t;
+
+static void* stampede_caller(void* arg) {
+    stampede_caller_t* caller = (stampede_caller_t*)arg;
+    pthread_barrier_wait(caller->barrier);
+    
+    void* value = NULL;
+    size_t size = 0;
+    if (caller->single_flight) {
+        cache_get_with_lock(caller->cache, "hot", &value, &size, backend_load, caller->backend);
+    } else if (cache_get(caller->cache, "hot", &value, &size) != SUCCESS) {
+        // Plain cache-aside: every caller that misses goes to the backend
+        value = backend_load("hot", caller->backend, &size);
+        cache_set(caller->cache, "hot", value, size);
+    }
+    
+    free(value);
+    return NULL;
+}
+
+void bench_stampede(bool single_flight) {
+    cache_instance_t* cache = create_memory_cache(BENCH_KEYS);
+    backend_t backend = { 0 };
+    pthread_t threads[STAMPEDE_CALLERS];
+    stampede_caller_t callers[STAMPEDE_CALLERS];
+    uint64_t total_ns = 0;
+    
+    for (int round = 0; round < STAMPEDE_EXPIRIES; round++) {
+        // The hot key has just expired
+        cache_delete(cache, "hot");
+        
+        pthread_barrier_t barrier;
+        pthread_barrier_init(&barrier, NULL, STAMPEDE_CALLERS);
+        
+        uint64_t start = get_time_ns();
+        for (int i = 0; i < STAMPEDE_CALLERS; i++) {
+            callers[i] = (stampede_caller_t){ cache, &backend, &barrier, single_flight };
+            pthread_create(&threads[i], NULL, stampede_caller, &callers[i]);
+        }
+        for (int i = 0; i < STAMPEDE_CALLERS; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        total_ns += get_time_ns() - start;
+        
+        pthread_barrier_destroy(&barrier);
+    }
+    
+    const char* name = single_flight ? "cache_get_with_lock" : "cache_get + load on miss";
+    printf("%-40s: %10.1f backend calls/expiry, %8.2f ms/expiry\n", name,
+           (double)backend.calls / STAMPEDE_EXPIRIES, total_ns / 1e6 / STAMPEDE_EXPIRIES);
+    
+    cache_instance_destroy(cache);
+}
+
+typedef struct {
+    cache_instance_t* cache;
+    backend_t* backend;
+    uint64_t end_ns;
+    uint64_t reads;
+    uint64_t stalls;   // Reads that had to wait for the backend
+} refresh_reader_t;
+
+static void* refresh_reader(void* arg) {
+    refresh_reader_t* reader = (refresh_reader_t*)arg;
+    struct timespec pause = { 0, 1000000L };
+    
+    while (get_time_ns() < reader->end_ns) {
+        void* value = NULL;
+        uint64_t start = get_time_ns();
+        cache_get_with_lock(reader->cache, "hot", &value, NULL, backend_load, reader->backend);
+        if (get_time_ns() - start >= REFRESH_STALL_NS) {
+            reader->stalls++;
+        }
+        reader->reads++;
+        free(value);
+        nanosleep(&pause, NULL);
+    }
+    return NULL;
+}
+
+void bench_early_refresh(stampede_prevention_t method, const char* name) {
+    cache_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.type = CACHE_TYPE_MEMORY;
+    config.eviction_policy = CACHE_EVICTION_LRU;
+    config.max_size = BENCH_KEYS;
+    config.default_ttl_ms = REFRESH_TTL_MS;
+    cache_instance_t* cache = cache_instance_create(&config);
+    
+    stampede_config_t stampede = { method, 1000, 1.0, REFRESH_TTL_MS / 4 };
+    cache_with_stampede_prevention(cache, &stampede);
+    
+    backend_t backend = { 0 };
+    pthread_t threads[REFRESH_READERS];
+    refresh_reader_t readers[REFRESH_READERS];
+    uint64_t end_ns = get_time_ns() + REFRESH_RUN_MS * 1000000ULL;
+    
+    for (int i = 0; i < REFRESH_READERS; i++) {
+        readers[i] = (refresh_reader_t){ cache, &backend, end_ns, 0, 0 };
+        pthread_create(&threads[i], NULL, refresh_reader, &readers[i]);
+    }
+    
+    uint64_t reads = 0;
+    uint64_t stalls = 0;
+    for (int i = 0; i < REFRESH_READERS; i++) {
+        pthread_join(threads[i], NULL);
+        reads += readers[i].reads;
+        stalls += readers[i].stalls;
+    }
+    
+    printf("%-40s: %6d backend calls, %6llu/%llu reads stalled\n", name, backend.calls,
+           (unsigned long long)stalls, (unsigned long long)reads);
+    
+    cache_instance_destroy(cache);
+}
+
+// =============================================================================
+// Invalidation Benchmarks
+// =============================================================================
+
+static cache_instance_t* create_catalog(void) {
+    cache_instance_t* cache = create_memory_cache(CATALOG_PRODUCTS * 2);
+    char key[48];
+    char tag[32];
+    const char* tags[] = { tag, "catalog" };
+    for (int i = 0; i < CATALOG_PRODUCTS; i++) {
+        int category = i % CATALOG_CATEGORIES;
+        snprintf(key, sizeof(key), "catalog:%d:product:%d", category, i);
+        snprintf(tag, sizeof(tag), "category:%d", category);
+        cache_set_with_tags(cache, key, "item", 5, tags, 2);
+    }
+    return cache;
+}
+
+// What callers had to do before: list every key and delete the matches
+static int invalidate_by_scan(cache_instance_t* cache, const char* prefix) {
+    char** keys = NULL;
+    size_t count = 0;
+    int removed = 0;
+    size_t prefix_len = strlen(prefix);
+    
+    cache_get_all_keys(cache, &keys, &count);
+    for (size_t i = 0; i < count; i++) {
+        if (strncmp(keys[i], prefix, prefix_len) == 0 && cache_delete(cache, keys[i]) == SUCCESS) {
+            removed++;
+        }
+        free(keys[i]);
+    }
+    free(keys);
+    return removed;
+}
+
+void bench_invalidation(int method) {
+    static const char* names[] = {
+        "Full key scan + delete",
+        "cache_invalidate_tag",
+        "cache_invalidate_pattern (prefix)",
+        "cache_invalidate_pattern (glob)",
+    };
+    cache_instance_t* cache = create_catalog();
+    
+    // The key trie is built by the first pattern call; keep that out of the timing
+    if (method >= 2) {
+        uint64_t build_start = get_time_ns();
+        cache_invalidate_pattern(cache, "warmup:*");
+        if (method == 2) {
+            printf("%-40s: %10.2f ms\n", "Key trie build (first pattern call)",
+                   (get_time_ns() - build_start) / 1e6);
+        }
+    }
+    
+    uint64_t start = get_time_ns();
+    int removed = 0;
+    switch (method) {
+        case 0: removed = invalidate_by_scan(cache, "catalog:3:"); break;
+        case 1: removed = cache_invalidate_tag(cache, "category:3"); break;
+        case 2: removed = cache_invalidate_pattern(cache, "catalog:3:*"); break;
+        default: removed = cache_invalidate_pattern(cache, "*:3:product:*"); break;
+    }
+    uint64_t elapsed = get_time_ns() - start;
+    
+    printf("%-40s: %10.2f ms, %6d keys, %8.1f ns/key\n", names[method], elapsed / 1e6,
+           removed, removed > 0 ? (double)elapsed / removed : 0.0);
+    
+    cache_instance_destroy(cache);
+}
+
+// =============================================================================
+// Write-Behind Benchmarks
+// =============================================================================
+
+// Stand-in for a database write
+static int backend_store(const char* key, const void* value, size_t size, void* ctx) {
+    (void)key; (void)value; (void)size;
+    backend_t* backend = (backend_t*)ctx;
+    __atomic_fetch_add(&backend->calls, 1, __ATOMIC_RELAXED);
+    
+    struct timespec delay = { 0, WB_WRITE_US * 1000L };
+    nanosleep(&delay, NULL);
+    return SUCCESS;
+}
+
+void bench_write_through_sync(void) {
+    cache_instance_t* cache = create_memory_cache(BENCH_KEYS);
+    backend_t backend = { 0 };
+    char key[32];
+    
+    uint64_t start = get_time_ns();
+    for (int i = 0; i < WB_WRITES; i++) {
+        snprintf(key, sizeof(key), "counter%d", i % WB_HOT_KEYS);
+        cache_set(cache, key, &i, sizeof(i));
+        backend_store(key, &i, sizeof(i), &backend);
+    }
+    uint64_t elapsed = get_time_ns() - start;
+    print_benchmark_result("Set + synchronous backend write", elapsed, WB_WRITES);
+    printf("  %-38s: %9d\n", "backend writes", backend.calls);
+    
+    cache_instance_destroy(cache);
+}
+
+void bench_write_behind(void) {
+    cache_instance_t* cache = create_memory_cache(BENCH_KEYS);
+    backend_t backend = { 0 };
+    write_behind_config_t config = { 1024, 64, 50, 3, 10 };
+    write_behind_cache_t* wb = write_behind_cache_create_with_config(cache, backend_store, &backend, &config);
+    char key[32];
+    
+    uint64_t start = get_time_ns();
+    for (int i = 0; i < WB_WRITES; i++) {
+        snprintf(key, sizeof(key), "counter%d", i % WB_HOT_KEYS);
+        write_behind_set(wb, key, &i, sizeof(i));
+    }
+    uint64_t elapsed = get_time_ns() - start;
+    write_behind_flush(wb);
+    
+    write_behind_stats_t stats;
+    write_behind_get_stats(wb, &stats);
+    print_benchmark_result("write_behind_set", elapsed, WB_WRITES);
+    printf("  %-38s: %9d\n", "backend writes", backend.calls);
+    printf("  %-38s: %9.1f%%\n", "absorbed by coalescing", 100.0 * stats.coalesced / stats.writes);
+    printf("  %-38s: %9.1f ms avg, %llu ms max\n", "flush lag", stats.avg_lag_ms,
+           (unsigned long long)stats.max_lag_ms);
+    
+    write_behind_cache_destroy(wb);
+    cache_instance_destroy(cache);
+}
+
+// =============================================================================
+// Cache Warming Benchmarks
+// =============================================================================
+
+// Stand-in for a database read
+static void* warmup_load(const char* key, void* ctx, size_t* size) {
+    backend_t* backend = (backend_t*)ctx;
+    __atomic_fetch_add(&backend->calls, 1, __ATOMIC_RELAXED);
+    
+    struct timespec delay = { 0, WARMUP_LOAD_US * 1000L };
+    nanosleep(&delay, NULL);
+    
+    char* value = safe_malloc(64);
+    *size = (size_t)snprintf(value, 64, "row:%s", key) + 1;
+    return value;
+}
+
+void bench_warmup(const char* name, warmup_strategy_t strategy, double max_cpu_usage) {
+    cache_instance_t* cache = create_memory_cache(0);
+    backend_t backend = { 0 };
+    static char keys[WARMUP_KEYS][32];
+    static const char* key_ptrs[WARMUP_KEYS];
+    for (int i = 0; i < WARMUP_KEYS; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "row%d", i);
+        key_ptrs[i] = keys[i];
+    }
+    
+    warmup_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.strategy = strategy;
+    config.batch_size = 100;
+    config.max_cpu_usage = max_cpu_usage;
+    config.keys = key_ptrs;
+    config.key_count = WARMUP_KEYS;
+    
+    uint64_t start = get_time_ns();
+    warmup_result_t* result = cache_warmup(cache, warmup_load, &backend, &config);
+    print_benchmark_result(name, get_time_ns() - start, WARMUP_KEYS);
+    printf("  %-38s: %9.0f keys/s, %llu loaded, %llu failed\n", "throughput", result->keys_per_second,
+           (unsigned long long)result->keys_loaded, (unsigned long long)result->keys_failed);
+    
+    warmup_result_destroy(result);
+    cache_instance_destroy(cache);
+}
+
+// =============================================================================
+// Near Cache Benchmarks
+// =============================================================================
+
+typedef struct {
+    cache_instance_t* cache;
+    near_cache_t* near;       // NULL = read the shared cache directly
+    int offset;
+} near_reader_t;
+
+static void* near_reader(void* arg) {
+    near_reader_t* reader = (near_reader_t*)arg;
+    char key[32];
+    for (int i = 0; i < NEAR_OPS / NEAR_THREADS; i++) {
+        snprintf(key, sizeof(key), "hot%d", (reader->offset + i) % NEAR_HOT_KEYS);
+        if (i % NEAR_WRITE_EVERY == 0) {
+            cache_set(reader->cache, key, &i, sizeof(i));
+        }
+        void* value;
+        size_t size;
+        if (reader->near) {
+            near_cache_get(reader->near, key, &value, &size);
+        } else {
+            cache_get(reader->cache, key, &value, &size);
+        }
+        free(value);
+    }
+    return NULL;
+}
+
+void bench_near_cache(bool enabled) {
+    cache_instance_t* cache = create_memory_cache(0);
+    for (int i = 0; i < NEAR_HOT_KEYS; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "hot%d", i);
+        cache_set(cache, key, &i, sizeof(i));
+    }
+    near_cache_t* near = enabled ? near_cache_create(cache, NULL) : NULL;
+    pthread_t threads[NEAR_THREADS];
+    near_reader_t readers[NEAR_THREADS];
+    
+    uint64_t start = get_time_ns();
+    for (int i = 0; i < NEAR_THREADS; i++) {
+        readers[i] = (near_reader_t){ cache, near, i * 7 };
+        pthread_create(&threads[i], NULL, near_reader, &readers[i]);
+    }
+    for (int i = 0; i < NEAR_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    print_benchmark_result(enabled ? "near_cache_get (per-thread L1)" : "cache_get (shared shards)",
+                           get_time_ns() - start, NEAR_OPS);
+    
+    if (near) {
+        near_cache_stats_t stats;
+        near_cache_get_stats(near, &stats);
+        printf("  %-38s: %9.1f%%\n", "L1 hit rate", 100.0 * stats.l1_hit_rate);
+        printf("  %-38s: %9llu published, %llu dropped from L1\n", "invalidations",
+               (unsigned long long)stats.invalidations, (unsigned long long)stats.l1_invalidations);
+        printf("  %-38s: %9.1f us avg, %.1f us max (<= %llu ops)\n", "staleness", stats.avg_staleness_us,
+               stats.max_staleness_us, (unsigned long long)stats.max_stale_ops);
+        near_cache_destroy(near);
+    }
+    cache_instance_destroy(cache);
+}
+
+// =============================================================================
+// Operation Timing Benchmarks
+// =============================================================================
+
+#define TIMING_OPS 1000000
+#define TIMING_KEYS 1024
+
+void bench_operation_timing(bool enabled) {
+    cache_instance_t* cache = create_memory_cache(0);
+    char keys[TIMING_KEYS][32];
+    for (int i = 0; i < TIMING_KEYS; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "key%d", i);
+        cache_set(cache, keys[i], &i, sizeof(i));
+    }
+    cache_set_operation_timing(cache, enabled);
+    cache_reset_stats(cache);
+    
+    uint64_t start = get_time_ns();
+    for (int i = 0; i < TIMING_OPS; i++) {
+        cache_get(cache, keys[i % TIMING_KEYS], NULL, NULL);
+    }
+    print_benchmark_result(enabled ? "cache_get (operation timing on)" : "cache_get (operation timing off)",
+                           get_time_ns() - start, TIMING_OPS);
+    
+    cache_operation_stats_t* stats = NULL;
+    size_t count = 0;
+    cache_get_operation_stats(cache, &stats, &count);
+    for (size_t i = 0; i < count; i++) {
+        printf("  %-38s: %9.0f ns avg, p95 %.0f ns, p99 %.0f ns\n", stats[i].operation,
+               stats[i].avg_time_ms * 1e6, stats[i].p95_time_ms * 1e6, stats[i].p99_time_ms * 1e6);
+    }
+    free(stats);
+    cache_instance_destroy(cache);
+}
+
+// =============================================================================
+// Redis Backend Benchmarks
+// =============================================================================
+
+// Run against tools/resp_server on loopback (RESP_SERVER overrides the path)
+static pid_t start_resp_server(int* port) {
+    const char* path = getenv("RESP_SERVER");
+    if (!path) {
+        path = "./build/resp_server";
+    }
+    
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        execl(path, path, "-p", "0", (char*)NULL);
+        _exit(127);
+    }
+    close(fds[1]);
+    
+    FILE* out = fdopen(fds[0], "r");
+    *port = 0;
+    if (!out || pid < 0 || fscanf(out, "port %d", port) != 1) {
+        *port = 0;
+    }
+    if (out) {
+        fclose(out);
+    } else {
+        close(fds[0]);
+    }
+    if (*port == 0 && pid > 0) {
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+        return -1;
+    }
+    return pid;
+}
+
+static cache_instance_t* create_redis_cache(int port, uint64_t default_ttl_ms) {
+    cache_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.type = CACHE_TYPE_REDIS;
+    config.default_ttl_ms = default_ttl_ms;
+    snprintf(config.redis_host, sizeof(config.redis_host), "127.0.0.1");
+    config.redis_port = port;
+    cache_instance_t* cache = cache_instance_create(&config);
+    cache_instance_connect(cache);
+    return cache;
+}
+
+static void fill_redis_keys(char keys[][32], const char** key_ptrs) {
+    for (int i = 0; i < REDIS_KEYS; i++) {
+        snprintf(keys[i], 32, "user:%d", i);
+        key_ptrs[i] = keys[i];
+    }
+}
+
+void bench_redis_round_trips(int port) {
+    cache_instance_t* cache = create_redis_cache(port, 0);
+    static char keys[REDIS_KEYS][32];
+    const char* key_ptrs[REDIS_KEYS];
+    fill_redis_keys(keys, key_ptrs);
+    
+    uint64_t start = get_time_ns();
+    for (int i = 0; i < REDIS_OPS; i++) {
+        cache_set(cache, key_ptrs[i % REDIS_KEYS], &i, sizeof(i));
+    }
+    print_benchmark_result("SET (one round trip each)", get_time_ns() - start, REDIS_OPS);
+    
+    start = get_time_ns();
+    for (int i = 0; i < REDIS_OPS; i++) {
+        void* value;
+        size_t size;
+        cache_get(cache, key_ptrs[i % REDIS_KEYS], &value, &size);
+        safe_free(&value);
+    }
+    print_benchmark_result("GET (one round trip each)", get_time_ns() - start, REDIS_OPS);
+    
+    cache_instance_destroy(cache);
+}
+
+void bench_redis_batches(int port) {
+    cache_instance_t* cache = create_redis_cache(port, 60000);
+    static char keys[REDIS_KEYS][32];
+    const char* key_ptrs[REDIS_KEYS];
+    fill_redis_keys(keys, key_ptrs);
+    int numbers[REDIS_BATCH];
+    void* values[REDIS_BATCH];
+    size_t sizes[REDIS_BATCH];
+    for (int i = 0; i < REDIS_BATCH; i++) {
+        numbers[i] = i;
+        values[i] = &numbers[i];
+        sizes[i] = sizeof(int);
+    }
+    
+    // Per-key cost, with a default TTL so each key is its own SET ... PX
+    uint64_t start = get_time_ns();
+    for (int i = 0; i < REDIS_OPS; i += REDIS_BATCH) {
+        cache_mset(cache, &key_ptrs[i % REDIS_KEYS], values, sizes, REDIS_BATCH);
+    }
+    print_benchmark_result("cache_mset (pipelined, per key)", get_time_ns() - start, REDIS_OPS);
+    
+    start = get_time_ns();
+    for (int i = 0; i < REDIS_OPS; i += REDIS_BATCH) {
+        void** got;
+        size_t* got_sizes;
+        cache_mget(cache, &key_ptrs[i % REDIS_KEYS], REDIS_BATCH, &got, &got_sizes);
+        for (int j = 0; j < REDIS_BATCH; j++) {
+            safe_free(&got[j]);
+        }
+        safe_free((void**)&got);
+        safe_free((void**)&got_sizes);
+    }
+    print_benchmark_result("cache_mget (one MGET, per key)", get_time_ns() - start, REDIS_OPS);
+    
+    cache_instance_destroy(cache);
+}
+
+typedef struct {
+    cache_instance_t* cache;
+    int offset;
+} redis_reader_t;
+
+static void* redis_reader(void* arg) {
+    redis_reader_t* reader = (redis_reader_t*)arg;
+    char key[32];
+    for (int i = 0; i < REDIS_OPS / REDIS_THREADS; i++) {
+        snprintf(key, sizeof(key), "user:%d", (reader->offset + i) % REDIS_KEYS);
+        void* value;
+        size_t size;
+        cache_get(reader->cache, key, &value, &size);
+        safe_free(&value);
+    }
+    return NULL;
+}
+
+void bench_redis_pool(int port) {
+    cache_instance_t* cache = create_redis_cache(port, 0);
+    pthread_t threads[REDIS_THREADS];
+    redis_reader_t readers[REDIS_THREADS];
+    
+    uint64_t start = get_time_ns();
+    for (int i = 0; i < REDIS_THREADS; i++) {
+        readers[i] = (redis_reader_t){ cache, i * (REDIS_KEYS / REDIS_THREADS) };
+        pthread_create(&threads[i], NULL, redis_reader, &readers[i]);
+    }
+    for (int i = 0; i < REDIS_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    print_benchmark_result("GET from 4 threads sharing the pool", get_time_ns() - start, REDIS_OPS);
+    
+    cache_instance_destroy(cache);
+}
+
+// =============================================================================
+// Cluster Benchmarks
+// =============================================================================
+
+static cache_cluster_t* create_cluster(const int* ports, size_t replication_factor, bool read_from_replicas) {
+    replication_config_t config = { 0 };
+    config.replication_factor = replication_factor;
+    config.enable_read_from_replicas = read_from_replicas;
+    cache_cluster_t* cluster = cache_cluster_create(&config);
+    for (int i = 0; i < CLUSTER_NODES; i++) {
+        cache_cluster_add_node(cluster, "127.0.0.1", ports[i]);
+    }
+    return cluster;
+}
+
+void bench_cluster_writes(const int* ports, size_t replication_factor) {
+    cache_cluster_t* cluster = create_cluster(ports, replication_factor, false);
+    char key[32];
+    char name[64];
+    
+    uint64_t start = get_time_ns();
+    for (int i = 0; i < REDIS_OPS; i++) {
+        snprintf(key, sizeof(key), "user:%d", i % REDIS_KEYS);
+        cache_cluster_set(cluster, key, &i, sizeof(i));
+    }
+    snprintf(name, sizeof(name), "cache_cluster_set (replication %zu)", replication_factor);
+    print_benchmark_result(name, get_time_ns() - start, REDIS_OPS);
+    
+    cache_cluster_destroy(cluster);
+}
+
+// The same replicated write issued to each node in turn
+void bench_cluster_sequential_writes(const int* ports) {
+    cache_instance_t* nodes[CLUSTER_NODES];
+    for (int i = 0; i < CLUSTER_NODES; i++) {
+        nodes[i] = create_redis_cache(ports[i], 0);
+    }
+    char key[32];
+    char name[64];
+    
+    uint64_t start = get_time_ns();
+    for (int i = 0; i < REDIS_OPS; i++) {
+        snprintf(key, sizeof(key), "user:%d", i % REDIS_KEYS);
+        for (int j = 0; j < CLUSTER_NODES; j++) {
+            cache_set(nodes[j], key, &i, sizeof(i));
+        }
+    }
+    snprintf(name, sizeof(name), "%d sequential sets (no fan-out)", CLUSTER_NODES);
+    print_benchmark_result(name, get_time_ns() - start, REDIS_OPS);
+    
+    for (int i = 0; i < CLUSTER_NODES; i++) {
+        cache_instance_destroy(nodes[i]);
+    }
+}
+
+typedef struct {
+    cache_cluster_t* cluster;
+    int offset;
+} cluster_reader_t;
+
+static void* cluster_reader(void* arg) {
+    cluster_reader_t* reader = (cluster_reader_t*)arg;
+    char key[32];
+    for (int i = 0; i < REDIS_OPS / REDIS_THREADS; i++) {
+        snprintf(key, sizeof(key), "user:%d", (reader->offset + i * 7) % REDIS_KEYS);
+        void* value;
+        size_t size;
+        cache_cluster_get(reader->cluster, key, &value, &size);
+        safe_free(&value);
+    }
+    return NULL;
+}
+
+// Hot reads from several threads; replica reads spread them over all nodes
+void bench_cluster_reads(const int* ports, bool read_from_replicas) {
+    cache_cluster_t* cluster = create_cluster(ports, CLUSTER_NODES, read_from_replicas);
+    pthread_t threads[REDIS_THREADS];
+    cluster_reader_t readers[REDIS_THREADS];
+    
+    uint64_t start = get_time_ns();
+    for (int i = 0; i < REDIS_THREADS; i++) {
+        readers[i] = (cluster_reader_t){ cluster, i };
+        pthread_create(&threads[i], NULL, cluster_reader, &readers[i]);
+    }
+    for (int i = 0; i < REDIS_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    print_benchmark_result(read_from_replicas ? "cache_cluster_get (replica reads)" : "cache_cluster_get (primary only)",
+                           get_time_ns() - start, REDIS_OPS);
+    
+    cache_cluster_destroy(cluster);
+}
+
+// =============================================================================
+// Main Benchmark Runner
+// =============================================================================
+
+int main(void) {
+    printf("========================================\n");
+    printf("Cache Strategies Benchmarks\n");
+    printf("========================================\n\n");
+    
+    printf("=== Throughput Benchmarks ===\n");
+    bench_cache_set();
+    bench_cache_get();
+    
+    printf("\n=== Compression (%d HTML pages) ===\n", DOC_COUNT);
+    bench_compression(false);
+    bench_compression(true);
+    
+    printf("\n=== Hot Key Expiry (%d concurrent callers, %d ms load) ===\n",
+           STAMPEDE_CALLERS, STAMPEDE_LOAD_MS);
+    bench_stampede(false);
+    bench_stampede(true);
+    
+    printf("\n=== Hot Key Refresh (%d readers, %d ms TTL, %d ms load) ===\n",
+           REFRESH_READERS, REFRESH_TTL_MS, STAMPEDE_LOAD_MS);
+    bench_early_refresh(STAMPEDE_LOCK, "Reload on expiry (lock)");
+    bench_early_refresh(STAMPEDE_PROBABILISTIC, "Probabilistic early expiry (XFetch)");
+    bench_early_refresh(STAMPEDE_PRECOMPUTE, "Background refresh-ahead");
+    
+    printf("\n=== Invalidation (%d keys, one category of %d) ===\n",
+           CATALOG_PRODUCTS, CATALOG_PRODUCTS / CATALOG_CATEGORIES);
+    for (int method = 0; method < 4; method++) {
+        bench_invalidation(method);
+    }
+    
+    printf("\n=== Write-Behind (%d hot keys, %d us backend write) ===\n", WB_HOT_KEYS, WB_WRITE_US);
+    bench_write_through_sync();
+    bench_write_behind();
+    
+    printf("\n=== Cache Warming (%d keys, %d us backend read) ===\n", WARMUP_KEYS, WARMUP_LOAD_US);
+    bench_warmup("Warmup, one loader thread", WARMUP_INCREMENTAL, 0.0);
+    bench_warmup("Warmup, max_cpu_usage 0.25", WARMUP_ALL, 0.25);
+    bench_warmup("Warmup, unthrottled", WARMUP_ALL, 0.0);
+    
+    printf("\n=== Near Cache (%d threads, %d hot keys, 1 write per %d reads) ===\n",
+           NEAR_THREADS, NEAR_HOT_KEYS, NEAR_WRITE_EVERY);
+    bench_near_cache(false);
+    bench_near_cache(true);
+    
+    printf("\n=== Operation Timing (%d gets) ===\n", TIMING_OPS);
+    bench_operation_timing(false);
+    bench_operation_timing(true);
+    
+    printf("\n=== Redis Backend (loopback resp_server, %d keys) ===\n", REDIS_KEYS);
+    int port;
+    pid_t server = start_resp_server(&port);
+    if (server > 0) {
+        bench_redis_round_trips(port);
+        bench_redis_batches(port);
+        bench_redis_pool(port);
+        kill(server, SIGTERM);
+        waitpid(server, NULL, 0);
+    } else {
+        printf("resp_server not available, skipped\n");
+    }
+    
+    printf("\n=== Cluster (%d loopback nodes) ===\n", CLUSTER_NODES);
+    pid_t nodes[CLUSTER_NODES];
+    int ports[CLUSTER_NODES];
+    bool started = true;
+    for (int i = 0; i < CLUSTER_NODES; i++) {
+        nodes[i] = start_resp_server(&ports[i]);
+        started = started && nodes[i] > 0;
+    }
+    if (started) {
+        bench_cluster_writes(ports, 1);
+        bench_cluster_writes(ports, CLUSTER_NODES);
+        bench_cluster_sequential_writes(ports);
+        bench_cluster_reads(ports, false);
+        bench_cluster_reads(ports, true);
+    } else {
+        printf("resp_server not available, skipped\n");
+    }
+    for (int i = 0; i < CLUSTER_NODES; i++) {
+        if (nodes[i] > 0) {
+            kill(nodes[i], SIGTERM);
+            waitpid(nodes[i], NULL, 0);
+        }
+    }
+    
+    printf("\n========================================\n");
+    printf("Benchmarks completed successfully!\n");
+    printf("========================================\n");
+    
+    return 0;
+}
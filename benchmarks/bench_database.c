@@ -0,0 +1,777 @@
+#define _POSIX_C_SOURCE 200809L
+#include "database.h"
+#include "common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Group commit settings: small puts from a growing number of writers
+#define COMMIT_WRITES 8000
+#define COMMIT_MAX_THREADS 64
+#define COMMIT_VALUE_SIZE 100
+
+// Recovery settings: a multi-GB WAL of large overwrites to a small key set
+#define RECOVERY_WAL_MB 2048
+#define RECOVERY_VALUE_SIZE (64 * 1024)
+#define RECOVERY_KEYS 1024
+#define RECOVERY_WRITERS 16
+#define BYTES_PER_MB (1024.0 * 1024.0)
+
+// Startup settings: many overwrites of a modest key set
+#define STARTUP_KEYS 10000
+#define STARTUP_WRITES 100000
+#define STARTUP_WRITERS 64
+
+// Engine settings: distinct keys from many writers, then random reads
+#define ENGINE_KEYS 200000
+#define ENGINE_WRITERS 64
+#define ENGINE_READS 100000
+#define ENGINE_HOT_KEYS 2000
+
+// Bulk loads: single puts against write batches
+#define BULK_PUT_KEYS 10000
+#define BULK_KEYS 1000000
+#define BULK_BATCH_KEYS 10000
+
+// Transactions: snapshot reads over overwritten keys, then contended
+// read-modify-write transactions on a small key space
+#define TXN_KEYS 100000
+#define TXN_THREADS 8
+#define TXN_PER_THREAD 5000
+#define TXN_HOT_KEYS 16
+#define TXN_WRITER_BATCH 20000     // Puts per batch committed beside the readers
+
+// Range scans
+#define SCAN_KEYS 1000000
+#define SCAN_RANGES 10000
+
+// Timing utilities
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void print_benchmark_result(const char* name, uint64_t total_ns, int iterations) {
+    double avg_ns = (double)total_ns / iterations;
+    double ops_per_sec = 1000000000.0 / avg_ns;
+    
+    printf("%-40s: %10.2f ns/op, %12.0f ops/sec\n",
+           name, avg_ns, ops_per_sec);
+}
+
+static char* make_data_dir(void) {
+    char* dir = safe_strdup("/tmp/bench_database_XXXXXX");
+    if (!mkdtemp(dir)) {
+        fprintf(stderr, "mkdtemp failed\n");
+        exit(1);
+    }
+    return dir;
+}
+
+static void remove_data_dir(char* dir) {
+    DIR* handle = opendir(dir);
+    if (handle) {
+        struct dirent* entry;
+        while ((entry = readdir(handle)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+                continue;
+            }
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+        closedir(handle);
+    }
+    rmdir(dir);
+    free(dir);
+}
+
+static database_t* open_database(const char* dir, const database_config_t* config) {
+    database_t* db = database_create_with_config(dir, config);
+    if (!db || database_open(db) != SUCCESS) {
+        fprintf(stderr, "database_open failed for %s\n", dir);
+        exit(1);
+    }
+    return db;
+}
+
+// =============================================================================
+// Group Commit Benchmarks
+// =============================================================================
+
+typedef struct {
+    database_t* db;
+    int id;
+    int writes;
+} commit_writer_t;
+
+static void* commit_writer(void* arg) {
+    commit_writer_t* writer = (commit_writer_t*)arg;
+    char value[COMMIT_VALUE_SIZE];
+    memset(value, 'v', sizeof(value));
+    for (int i = 0; i < writer->writes; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "t%d:%d", writer->id, i);
+        database_put(writer->db, key, value, sizeof(value));
+    }
+    return NULL;
+}
+
+void bench_group_commit(int thread_count, uint64_t delay_us) {
+    char* dir = make_data_dir();
+    database_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.wal_batch_delay_us = delay_us;
+    database_t* db = open_database(dir, &config);
+    
+    pthread_t threads[COMMIT_MAX_THREADS];
+    commit_writer_t writers[COMMIT_MAX_THREADS];
+    int writes = COMMIT_WRITES / thread_count;
+    
+    uint64_t start = get_time_ns();
+    for (int i = 0; i < thread_count; i++) {
+        writers[i] = (commit_writer_t){ db, i, writes };
+        pthread_create(&threads[i], NULL, commit_writer, &writers[i]);
+    }
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    uint64_t elapsed = get_time_ns() - start;
+    
+    char name[96];
+    if (delay_us > 0) {
+        snprintf(name, sizeof(name), "database_put, %d writer%s, %llu us delay", thread_count,
+                 thread_count == 1 ? "" : "s", (unsigned long long)delay_us);
+    } else {
+        snprintf(name, sizeof(name), "database_put, %d writer%s", thread_count, thread_count == 1 ? "" : "s");
+    }
+    print_benchmark_result(name, elapsed, writes * thread_count);
+    
+    database_stats_t stats;
+    database_get_stats(db, &stats);
+    printf("  %-38s: %9.1f records per fdatasync\n", "group commit size",
+           stats.wal_syncs ? (double)stats.wal_records / stats.wal_syncs : 0.0);
+    
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+// =============================================================================
+// Recovery Benchmarks
+// =============================================================================
+
+typedef struct {
+    database_t* db;
+    int id;
+    int writes;
+} recovery_writer_t;
+
+static void* recovery_writer(void* arg) {
+    recovery_writer_t* writer = (recovery_writer_t*)arg;
+    char* value = safe_malloc(RECOVERY_VALUE_SIZE);
+    memset(value, 'r', RECOVERY_VALUE_SIZE);
+    for (int i = 0; i < writer->writes; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%d", (writer->id * writer->writes + i) % RECOVERY_KEYS);
+        database_put(writer->db, key, value, RECOVERY_VALUE_SIZE);
+    }
+    safe_free((void**)&value);
+    return NULL;
+}
+
+// Drop the WAL from the page cache so replay reads it from disk
+static void evict_wal(const char* dir) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/wal-000001.log", dir);  // Only segment before any snapshot
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+// Returns the recovered handle; closing it would checkpoint the WAL away
+static database_t* time_recovery(const char* name, const char* dir, double wal_mb) {
+    uint64_t start = get_time_ns();
+    database_t* db = open_database(dir, NULL);
+    uint64_t elapsed = get_time_ns() - start;
+    
+    database_stats_t stats;
+    database_get_stats(db, &stats);
+    printf("%-40s: %10.1f ms, %9.1f MB/s, %zu keys\n", name, elapsed / 1e6,
+           wal_mb / (elapsed / 1e9), stats.num_keys);
+    return db;
+}
+
+void bench_recovery(void) {
+    char* dir = make_data_dir();
+    database_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.snapshot_wal_bytes = (size_t)(2 * RECOVERY_WAL_MB * BYTES_PER_MB);  // Keep the whole WAL
+    database_t* db = open_database(dir, &config);
+    
+    int writes = (int)((RECOVERY_WAL_MB * BYTES_PER_MB) / RECOVERY_VALUE_SIZE / RECOVERY_WRITERS);
+    pthread_t threads[RECOVERY_WRITERS];
+    recovery_writer_t writers[RECOVERY_WRITERS];
+    uint64_t start = get_time_ns();
+    for (int i = 0; i < RECOVERY_WRITERS; i++) {
+        writers[i] = (recovery_writer_t){ db, i, writes };
+        pthread_create(&threads[i], NULL, recovery_writer, &writers[i]);
+    }
+    for (int i = 0; i < RECOVERY_WRITERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    uint64_t elapsed = get_time_ns() - start;
+    
+    database_stats_t stats;
+    database_get_stats(db, &stats);
+    double wal_mb = stats.wal_size / BYTES_PER_MB;
+    printf("%-40s: %10.1f ms, %9.1f MB/s\n", "Write WAL (group commit)", elapsed / 1e6,
+           wal_mb / (elapsed / 1e9));
+    
+    evict_wal(dir);
+    database_t* cold = time_recovery("Replay WAL (cold page cache)", dir, wal_mb);
+    database_t* warm = time_recovery("Replay WAL (warm page cache)", dir, wal_mb);
+    
+    database_destroy(warm);
+    database_destroy(cold);
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+// =============================================================================
+// Startup Benchmarks
+// =============================================================================
+
+typedef struct {
+    database_t* db;
+    int id;
+} startup_writer_t;
+
+static void* startup_writer(void* arg) {
+    startup_writer_t* writer = (startup_writer_t*)arg;
+    char value[COMMIT_VALUE_SIZE];
+    memset(value, 's', sizeof(value));
+    for (int i = writer->id; i < STARTUP_WRITES; i += STARTUP_WRITERS) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%d", i % STARTUP_KEYS);
+        database_put(writer->db, key, value, sizeof(value));
+    }
+    return NULL;
+}
+
+static database_t* time_startup(const char* name, const char* dir) {
+    uint64_t start = get_time_ns();
+    database_t* db = open_database(dir, NULL);
+    uint64_t elapsed = get_time_ns() - start;
+    
+    database_stats_t stats;
+    database_get_stats(db, &stats);
+    printf("%-40s: %10.2f ms, %zu keys\n", name, elapsed / 1e6, stats.num_keys);
+    return db;
+}
+
+void bench_startup(void) {
+    char* dir = make_data_dir();
+    database_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.snapshot_wal_bytes = (size_t)1 << 40;  // Snapshot only on request
+    database_t* db = open_database(dir, &config);
+    
+    pthread_t threads[STARTUP_WRITERS];
+    startup_writer_t writers[STARTUP_WRITERS];
+    for (int i = 0; i < STARTUP_WRITERS; i++) {
+        writers[i] = (startup_writer_t){ db, i };
+        pthread_create(&threads[i], NULL, startup_writer, &writers[i]);
+    }
+    for (int i = 0; i < STARTUP_WRITERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    
+    // Open second handles on the same directory, as a restart after a crash
+    database_t* replayed = time_startup("Startup replaying the full WAL", dir);
+    
+    uint64_t start = get_time_ns();
+    database_checkpoint(db);
+    printf("%-40s: %10.2f ms\n", "database_checkpoint (snapshot)", (get_time_ns() - start) / 1e6);
+    database_t* snapshotted = time_startup("Startup from snapshot", dir);
+    
+    database_destroy(snapshotted);
+    database_destroy(replayed);
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+// =============================================================================
+// Storage Engine Benchmarks
+// =============================================================================
+
+static void* engine_writer(void* arg) {
+    startup_writer_t* writer = (startup_writer_t*)arg;
+    char value[COMMIT_VALUE_SIZE];
+    memset(value, 'e', sizeof(value));
+    for (int i = writer->id; i < ENGINE_KEYS; i += ENGINE_WRITERS) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%08d", i);
+        database_put(writer->db, key, value, sizeof(value));
+    }
+    return NULL;
+}
+
+static void load_engine_keys(database_t* db) {
+    pthread_t threads[ENGINE_WRITERS];
+    startup_writer_t writers[ENGINE_WRITERS];
+    for (int i = 0; i < ENGINE_WRITERS; i++) {
+        writers[i] = (startup_writer_t){ db, i };
+        pthread_create(&threads[i], NULL, engine_writer, &writers[i]);
+    }
+    for (int i = 0; i < ENGINE_WRITERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+void bench_engine(database_engine_t engine) {
+    const char* label = engine == DATABASE_ENGINE_LSM ? "lsm" : "hash";
+    char* dir = make_data_dir();
+    database_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.engine = engine;
+    config.snapshot_wal_bytes = (size_t)1 << 40;  // Snapshot only on request
+    database_t* db = open_database(dir, &config);
+    
+    uint64_t start = get_time_ns();
+    load_engine_keys(db);
+    char name[96];
+    snprintf(name, sizeof(name), "database_put (%s, %d writers)", label, ENGINE_WRITERS);
+    print_benchmark_result(name, get_time_ns() - start, ENGINE_KEYS);
+    
+    // Everything in tables, so LSM reads go to disk blocks
+    database_checkpoint(db);
+    
+    srand(42);
+    int found = 0;
+    start = get_time_ns();
+    for (int i = 0; i < ENGINE_READS; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%08d", rand() % ENGINE_KEYS);
+        void* value = NULL;
+        if (database_get(db, key, &value, NULL) == SUCCESS) {
+            found++;
+        }
+        free(value);
+    }
+    snprintf(name, sizeof(name), "database_get (%s, random)", label);
+    print_benchmark_result(name, get_time_ns() - start, ENGINE_READS);
+    if (found != ENGINE_READS) {
+        printf("  %-38s: %d\n", "missing keys", ENGINE_READS - found);
+    }
+    
+    if (engine == DATABASE_ENGINE_LSM) {
+        database_stats_t stats;
+        database_get_stats(db, &stats);
+        printf("  %-38s: %zu tables, %.1f MB, %llu flushes, %llu compactions\n", "tables",
+               stats.sstable_count, stats.sstable_bytes / BYTES_PER_MB,
+               (unsigned long long)stats.memtable_flushes, (unsigned long long)stats.compactions);
+        
+        start = get_time_ns();
+        database_compact(db);
+        printf("%-40s: %10.2f ms\n", "database_compact (lsm)", (get_time_ns() - start) / 1e6);
+    }
+    
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+// Point lookups against tables: absent keys that fall inside table ranges,
+// then a small hot set read over and over
+void bench_lsm_reads(int bits_per_key) {
+    char* dir = make_data_dir();
+    database_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.engine = DATABASE_ENGINE_LSM;
+    config.bloom_bits_per_key = bits_per_key;
+    database_t* db = open_database(dir, &config);
+    load_engine_keys(db);
+    database_compact(db);
+    
+    char label[32];
+    if (bits_per_key > 0) {
+        snprintf(label, sizeof(label), "%d bits/key", bits_per_key);
+    } else {
+        snprintf(label, sizeof(label), "no filter");
+    }
+    
+    srand(42);
+    char name[96];
+    uint64_t start = get_time_ns();
+    for (int i = 0; i < ENGINE_READS; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%08dx", rand() % ENGINE_KEYS);
+        database_exists(db, key);
+    }
+    snprintf(name, sizeof(name), "database_get absent (%s)", label);
+    print_benchmark_result(name, get_time_ns() - start, ENGINE_READS);
+    
+    database_stats_t stats;
+    database_get_stats(db, &stats);
+    if (bits_per_key > 0) {
+        printf("  %-38s: %9.2f%%\n", "bloom false positive rate", stats.bloom_false_positive_rate * 100.0);
+    }
+    uint64_t hits = stats.block_cache_hits;
+    uint64_t misses = stats.block_cache_misses;
+    
+    start = get_time_ns();
+    for (int i = 0; i < ENGINE_READS; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%08d", (rand() % ENGINE_HOT_KEYS) * (ENGINE_KEYS / ENGINE_HOT_KEYS));
+        void* value = NULL;
+        database_get(db, key, &value, NULL);
+        free(value);
+    }
+    snprintf(name, sizeof(name), "database_get hot set (%s)", label);
+    print_benchmark_result(name, get_time_ns() - start, ENGINE_READS);
+    
+    database_get_stats(db, &stats);
+    hits = stats.block_cache_hits - hits;
+    misses = stats.block_cache_misses - misses;
+    printf("  %-38s: %9.2f%% of %llu block reads, %.1f MB cached\n", "block cache hit rate",
+           hits + misses ? 100.0 * hits / (hits + misses) : 0.0, (unsigned long long)(hits + misses),
+           stats.block_cache_usage / BYTES_PER_MB);
+    
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+// =============================================================================
+// Bulk Load Benchmarks
+// =============================================================================
+
+void bench_bulk_load(void) {
+    char* dir = make_data_dir();
+    database_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.snapshot_wal_bytes = (size_t)1 << 40;
+    database_t* db = open_database(dir, &config);
+    char value[COMMIT_VALUE_SIZE];
+    memset(value, 'b', sizeof(value));
+    
+    database_stats_t stats;
+    uint64_t start = get_time_ns();
+    for (int i = 0; i < BULK_PUT_KEYS; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "put%08d", i);
+        database_put(db, key, value, sizeof(value));
+    }
+    print_benchmark_result("database_put (one key per sync)", get_time_ns() - start, BULK_PUT_KEYS);
+    database_get_stats(db, &stats);
+    uint64_t syncs = stats.wal_syncs;
+    
+    database_write_batch_t* batch = database_write_batch_create();
+    start = get_time_ns();
+    for (int i = 0; i < BULK_KEYS; i += BULK_BATCH_KEYS) {
+        database_write_batch_clear(batch);
+        for (int n = i; n < i + BULK_BATCH_KEYS; n++) {
+            char key[32];
+            snprintf(key, sizeof(key), "key%08d", n);
+            database_write_batch_put(batch, key, value, sizeof(value));
+        }
+        database_write_batch(db, batch);
+    }
+    char name[96];
+    snprintf(name, sizeof(name), "database_write_batch (%d keys each)", BULK_BATCH_KEYS);
+    print_benchmark_result(name, get_time_ns() - start, BULK_KEYS);
+    database_get_stats(db, &stats);
+    printf("  %-38s: %llu for %d keys\n", "WAL syncs", (unsigned long long)(stats.wal_syncs - syncs), BULK_KEYS);
+    
+    database_write_batch_destroy(batch);
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+// =============================================================================
+// Transaction Benchmarks
+// =============================================================================
+
+typedef struct {
+    database_t* db;
+    int id;
+    int commits;
+} txn_worker_t;
+
+// Increment random counters, retrying on conflict
+static void* txn_worker(void* arg) {
+    txn_worker_t* worker = (txn_worker_t*)arg;
+    unsigned int seed = (unsigned int)worker->id;
+    for (int i = 0; i < TXN_PER_THREAD; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%08d", rand_r(&seed) % TXN_HOT_KEYS);
+        int status;
+        do {
+            transaction_t* txn = database_begin_transaction(worker->db, ISOLATION_REPEATABLE_READ);
+            uint64_t* value = NULL;
+            uint64_t next = 1;
+            if (transaction_get(txn, key, (void**)&value, NULL) == SUCCESS) {
+                next = *value + 1;
+            }
+            free(value);
+            transaction_put(txn, key, &next, sizeof(next));
+            status = transaction_commit(txn);
+            worker->commits++;
+        } while (status == ERROR_CONFLICT);
+    }
+    return NULL;
+}
+
+typedef struct {
+    database_t* db;
+    int stop;
+} batch_writer_t;
+
+// Commit large batches over the key space until told to stop
+static void* batch_writer(void* arg) {
+    batch_writer_t* writer = (batch_writer_t*)arg;
+    database_write_batch_t* batch = database_write_batch_create();
+    char value[COMMIT_VALUE_SIZE];
+    memset(value, 'w', sizeof(value));
+    for (int round = 0; !__atomic_load_n(&writer->stop, __ATOMIC_ACQUIRE); round++) {
+        database_write_batch_clear(batch);
+        for (int i = 0; i < TXN_WRITER_BATCH; i++) {
+            char key[32];
+            snprintf(key, sizeof(key), "key%08d", (round * TXN_WRITER_BATCH + i) % TXN_KEYS);
+            database_write_batch_put(batch, key, value, sizeof(value));
+        }
+        database_write_batch(writer->db, batch);
+    }
+    database_write_batch_destroy(batch);
+    return NULL;
+}
+
+// Longest of a run of random reads, through snapshot or, without one, database_get
+static uint64_t longest_read(database_t* db, transaction_t* snapshot) {
+    uint64_t longest = 0;
+    for (int i = 0; i < ENGINE_READS / 10; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%08d", rand() % TXN_KEYS);
+        void* read = NULL;
+        uint64_t start = get_time_ns();
+        if (snapshot) {
+            transaction_get(snapshot, key, &read, NULL);
+        } else {
+            database_get(db, key, &read, NULL);
+        }
+        uint64_t elapsed = get_time_ns() - start;
+        free(read);
+        if (elapsed > longest) {
+            longest = elapsed;
+        }
+    }
+    return longest;
+}
+
+void bench_transactions(void) {
+    char* dir = make_data_dir();
+    database_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.snapshot_wal_bytes = (size_t)1 << 40;
+    database_t* db = open_database(dir, &config);
+    
+    char value[COMMIT_VALUE_SIZE];
+    memset(value, 'm', sizeof(value));
+    transaction_t* txn = database_begin_transaction(db, ISOLATION_READ_COMMITTED);
+    for (int i = 0; i < TXN_KEYS; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%08d", i);
+        transaction_put(txn, key, value, sizeof(value));
+    }
+    transaction_commit(txn);
+    
+    // Every key overwritten behind an open snapshot, so its reads walk chains
+    transaction_t* snapshot = database_begin_transaction(db, ISOLATION_REPEATABLE_READ);
+    txn = database_begin_transaction(db, ISOLATION_READ_COMMITTED);
+    memset(value, 'n', sizeof(value));
+    for (int i = 0; i < TXN_KEYS; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%08d", i);
+        transaction_put(txn, key, value, sizeof(value));
+    }
+    transaction_commit(txn);
+    
+    srand(42);
+    uint64_t start = get_time_ns();
+    for (int i = 0; i < ENGINE_READS; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%08d", rand() % TXN_KEYS);
+        void* read = NULL;
+        database_get(db, key, &read, NULL);
+        free(read);
+    }
+    print_benchmark_result("database_get (newest)", get_time_ns() - start, ENGINE_READS);
+    
+    start = get_time_ns();
+    for (int i = 0; i < ENGINE_READS; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%08d", rand() % TXN_KEYS);
+        void* read = NULL;
+        transaction_get(snapshot, key, &read, NULL);
+        free(read);
+    }
+    print_benchmark_result("transaction_get (snapshot)", get_time_ns() - start, ENGINE_READS);
+    
+    // Beside a writer committing large batches: newest-value reads wait out
+    // each batch's apply under the write lock, snapshot reads take no lock
+    batch_writer_t writer = { db, 0 };
+    pthread_t writer_thread;
+    pthread_create(&writer_thread, NULL, batch_writer, &writer);
+    uint64_t longest_latest = longest_read(db, NULL);
+    uint64_t longest_snapshot = longest_read(db, snapshot);
+    __atomic_store_n(&writer.stop, 1, __ATOMIC_RELEASE);
+    pthread_join(writer_thread, NULL);
+    printf("%-40s: %10.2f us\n", "Longest database_get beside batches", longest_latest / 1e3);
+    printf("%-40s: %10.2f us\n", "Longest snapshot read beside batches", longest_snapshot / 1e3);
+    
+    database_stats_t stats;
+    database_get_stats(db, &stats);
+    size_t retained = stats.mvcc_versions;
+    start = get_time_ns();
+    transaction_rollback(snapshot);
+    while (stats.mvcc_versions > 0) {
+        database_get_stats(db, &stats);
+    }
+    printf("%-40s: %10.2f ms for %zu versions\n", "version garbage collection", (get_time_ns() - start) / 1e6,
+           retained);
+    
+    // Contended read-modify-write transactions
+    pthread_t threads[TXN_THREADS];
+    txn_worker_t workers[TXN_THREADS];
+    start = get_time_ns();
+    for (int i = 0; i < TXN_THREADS; i++) {
+        workers[i] = (txn_worker_t){ db, i + 1, 0 };
+        pthread_create(&threads[i], NULL, txn_worker, &workers[i]);
+    }
+    int attempts = 0;
+    for (int i = 0; i < TXN_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        attempts += workers[i].commits;
+    }
+    char name[96];
+    snprintf(name, sizeof(name), "transaction_commit (%d threads)", TXN_THREADS);
+    print_benchmark_result(name, get_time_ns() - start, TXN_THREADS * TXN_PER_THREAD);
+    database_get_stats(db, &stats);
+    printf("  %-38s: %9.2f%% of %d attempts\n", "conflicts", 100.0 * stats.txn_conflicts / attempts, attempts);
+    
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+// =============================================================================
+// Range Scan Benchmarks
+// =============================================================================
+
+// Scan the whole table and return the number of keys seen
+static int scan_all(database_t* db) {
+    int count = 0;
+    database_iterator_t* it = database_scan(db, NULL, NULL);
+    while (database_iterator_next(it)) {
+        count++;
+    }
+    database_iterator_close(it);
+    return count;
+}
+
+void bench_scan(void) {
+    char* dir = make_data_dir();
+    database_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.snapshot_wal_bytes = (size_t)1 << 40;
+    database_t* db = open_database(dir, &config);
+    
+    // One transaction keeps the load from waiting on a sync per key
+    char value[COMMIT_VALUE_SIZE];
+    memset(value, 's', sizeof(value));
+    transaction_t* txn = database_begin_transaction(db, ISOLATION_READ_COMMITTED);
+    for (int i = 0; i < SCAN_KEYS; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%08d", (int)(((uint64_t)i * 7919) % SCAN_KEYS));
+        transaction_put(txn, key, value, sizeof(value));
+    }
+    transaction_commit(txn);
+    
+    uint64_t start = get_time_ns();
+    int count = scan_all(db);
+    print_benchmark_result("database_scan (hash walk + sort)", get_time_ns() - start, count);
+    
+    start = get_time_ns();
+    database_create_index(db, "primary", INDEX_BTREE);
+    printf("%-40s: %10.2f ms\n", "database_create_index (bulk load)", (get_time_ns() - start) / 1e6);
+    
+    start = get_time_ns();
+    count = scan_all(db);
+    print_benchmark_result("database_scan (B-tree)", get_time_ns() - start, count);
+    
+    start = get_time_ns();
+    count = 0;
+    for (int i = 0; i < SCAN_RANGES; i++) {
+        char first[32];
+        snprintf(first, sizeof(first), "key%08d", rand() % SCAN_KEYS);
+        database_iterator_t* it = database_scan(db, first, NULL);
+        for (int n = 0; n < 100 && database_iterator_next(it); n++) {
+            count++;
+        }
+        database_iterator_close(it);
+    }
+    print_benchmark_result("database_scan (B-tree, 100-key ranges)", get_time_ns() - start, count);
+    
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+// =============================================================================
+// Main Benchmark Runner
+// =============================================================================
+
+int main(void) {
+    printf("========================================\n");
+    printf("Database Benchmarks\n");
+    printf("========================================\n\n");
+    
+    printf("=== Group Commit WAL (%d puts of %d bytes) ===\n", COMMIT_WRITES, COMMIT_VALUE_SIZE);
+    for (int threads = 1; threads <= COMMIT_MAX_THREADS; threads *= 2) {
+        bench_group_commit(threads, 0);
+    }
+    bench_group_commit(1, 200);
+    bench_group_commit(COMMIT_MAX_THREADS, 200);
+    
+    printf("\n=== Storage Engines (%d keys of %d bytes) ===\n", ENGINE_KEYS, COMMIT_VALUE_SIZE);
+    bench_engine(DATABASE_ENGINE_HASH);
+    bench_engine(DATABASE_ENGINE_LSM);
+    bench_lsm_reads(10);
+    bench_lsm_reads(-1);
+    
+    printf("\n=== Bulk Load (%d keys of %d bytes) ===\n", BULK_KEYS, COMMIT_VALUE_SIZE);
+    bench_bulk_load();
+    
+    printf("\n=== Transactions (%d keys) ===\n", TXN_KEYS);
+    bench_transactions();
+    
+    printf("\n=== Range Scans (%d keys) ===\n", SCAN_KEYS);
+    bench_scan();
+    
+    printf("\n=== Startup (%d puts over %d keys) ===\n", STARTUP_WRITES, STARTUP_KEYS);
+    bench_startup();
+    
+    printf("\n=== WAL Recovery (%d MB of %d KB puts) ===\n", RECOVERY_WAL_MB, RECOVERY_VALUE_SIZE / 1024);
+    bench_recovery();
+    
+    printf("\n========================================\n");
+    printf("Benchmarks completed successfully!\n");
+    printf("========================================\n");
+    
+    return 0;
+}
@@ -5,8 +5,10 @@
 
 // Cache eviction policies
 typedef enum {
-    EVICTION_LRU,   // Least Recently Used
-    EVICTION_LFU    // Least Frequently Used
+    EVICTION_LRU,       // Least Recently Used
+    EVICTION_LFU,       // Least Frequently Used
+    EVICTION_TINYLFU,   // W-TinyLFU: LRU window + frequency-gated segmented LRU
+    EVICTION_SIEVE      // SIEVE: FIFO + visited bit; hits only take a read lock
 } eviction_policy_t;
 
 typedef struct cache cache_t;
@@ -16,13 +18,33 @@ cache_t* cache_create(size_t max_size, eviction_policy_t policy);
 void cache_destroy(cache_t* cache);
 
 int cache_put(cache_t* cache, const char* key, const void* value, size_t value_size);
-int cache_put_with_ttl(cache_t* cache, const char* key, const void* value, 
+int cache_put_with_ttl(cache_t* cache, const char* key, const void* value,
                        size_t value_size, uint64_t ttl_ms);
 int cache_get(cache_t* cache, const char* key, void** value, size_t* value_size);
+
+// Trace replay for simulators: a get that, on a miss, inserts key with a
+// one-byte empty value, with the same statistics as cache_get + cache_put.
+// The entry it evicts is recycled for the next insert instead of freed, so
+// a warm replay makes no allocations. Returns true on a hit.
+bool cache_replay_access(cache_t* cache, const char* key);
 int cache_delete(cache_t* cache, const char* key);
 int cache_exists(cache_t* cache, const char* key);
 void cache_clear(cache_t* cache);
 
+// Batch operations: one lock acquisition per call. cache_mget fills
+// values[i]/value_sizes[i] like cache_get (either array may be NULL), setting
+// NULL/0 for misses. cache_mput stores every pair with the same TTL
+// (0 = none). A NULL key, value or zero size rejects the whole batch.
+int cache_mget(cache_t* cache, const char* const* keys, size_t count,
+               void** values, size_t* value_sizes);
+int cache_mput(cache_t* cache, const char* const* keys, size_t count,
+               const void* const* values, const size_t* value_sizes, uint64_t ttl_ms);
+
+// Change the capacity at runtime, evicting overflow when shrinking. The hash
+// index is sized by the entry count and resizes incrementally, so neither this
+// nor growth through puts stalls concurrent requests on a rehash.
+int cache_set_max_size(cache_t* cache, size_t max_size);
+
 // Statistics
 typedef struct {
     size_t size;
@@ -30,8 +52,26 @@ typedef struct {
     size_t hits;
     size_t misses;
     size_t evictions;
+    size_t expirations;
 } cache_stats_t;
 
 int cache_get_stats(cache_t* cache, cache_stats_t* stats);
 
+// Expiration: frees expired entries from the timing wheel, examining at most
+// max_entries entries (0 = no limit). Returns the number of entries freed.
+size_t cache_expire(cache_t* cache, size_t max_entries);
+
+// Background reaper: every interval_ms, expire due entries in slices of
+// slice_entries (0 = default), releasing the lock between slices
+int cache_start_reaper(cache_t* cache, uint64_t interval_ms, size_t slice_entries);
+int cache_stop_reaper(cache_t* cache);
+
+// Snapshots for warm restarts. Entries are written with their absolute TTL
+// deadlines in recency order; loading mmaps the file, rebuilds entries in
+// parallel and skips anything that expired while the process was down.
+// Saving copies entries a chunk per read lock and writes with the lock
+// released, so the file is a fuzzy image of a cache that is taking writes.
+int cache_snapshot_save(cache_t* cache, const char* path);
+int cache_snapshot_load(cache_t* cache, const char* path);
+
 #endif // CACHE_H
@@ -22,6 +22,12 @@ typedef struct cache_instance cache_instance_t;
 typedef struct cache_entry cache_entry_t;
 typedef struct cache_cluster cache_cluster_t;
 
+// Callback function types. A loader returns a malloc'd value (setting *size)
+// or NULL on failure; the cache takes ownership of the returned buffer.
+typedef void* (*cache_loader_fn)(const char* key, void* ctx, size_t* size);
+typedef int (*cache_writer_fn)(const char* key, const void* value, 
+                                size_t size, void* ctx);
+
 // =============================================================================
 // CACHE TYPES & STRATEGIES
 // =============================================================================
@@ -60,15 +66,21 @@ typedef struct {
     size_t max_size;         // Maximum number of entries
     size_t max_memory_mb;    // Maximum memory in MB
     uint64_t default_ttl_ms; // Default TTL in milliseconds
-    bool enable_compression;
+    bool enable_compression; // LZ-compress large values in memory
     bool enable_encryption;
     char redis_host[256];
     int redis_port;
     char redis_password[256];
     int redis_db;
+    size_t compression_threshold; // Smallest value compressed; 0 = 1 KB
 } cache_config_t;
 
-// Cache instance management
+// Cache instance management. Connecting a CACHE_TYPE_REDIS instance opens a
+// small connection pool to redis_host:redis_port (AUTH and SELECT as
+// configured); it fails with ERROR_IO if the server is unreachable. Remote
+// instances forward the basic, atomic, batch and TTL operations below (except
+// cache_touch), cache_invalidate_all and cache_get_size; those return ERROR_IO
+// while disconnected. Everything else acts on the local in-memory store.
 cache_instance_t* cache_instance_create(cache_config_t* config);
 void cache_instance_destroy(cache_instance_t* cache);
 int cache_instance_connect(cache_instance_t* cache);
@@ -144,13 +156,18 @@ typedef struct invalidation_config {
     bool propagate_to_cluster;
 } invalidation_config_t;
 
-// Invalidation API
+// Invalidation API. Pattern and tag invalidation return the number of keys
+// removed. Patterns use fnmatch syntax; "prefix*" is served from a key trie
+// in time proportional to the matches, other globs scan shards in parallel.
+// Both release shard locks between batches rather than holding them
+// throughout; a glob scan resumes after the last key it visited.
 int cache_invalidate_key(cache_instance_t* cache, const char* key);
 int cache_invalidate_pattern(cache_instance_t* cache, const char* pattern);
 int cache_invalidate_tag(cache_instance_t* cache, const char* tag);
 int cache_invalidate_all(cache_instance_t* cache);
 
-// Tag-based invalidation
+// Tag-based invalidation. cache_set_with_tags replaces the key's tags; plain
+// sets keep them. Evicted and expired keys leave their tags automatically.
 int cache_set_with_tags(cache_instance_t* cache, const char* key, 
                         const void* value, size_t value_size,
                         const char** tags, size_t tag_count);
@@ -180,17 +197,19 @@ typedef enum {
 typedef struct {
     stampede_prevention_t method;
     uint64_t lock_timeout_ms;
-    double early_expiration_factor; // For probabilistic (0.0-1.0)
-    uint64_t refresh_threshold_ms;  // For precompute
+    double early_expiration_factor; // For probabilistic: XFetch beta (0 = 1.0)
+    uint64_t refresh_threshold_ms;  // For precompute: reload when TTL left <= this
 } stampede_config_t;
 
 // Stampede prevention
 cache_instance_t* cache_with_stampede_prevention(cache_instance_t* cache,
                                                   stampede_config_t* config);
+// Single-flight load: concurrent misses on one key share a single loader call
+// and wait up to lock_timeout_ms for it (ERROR_TIMEOUT otherwise). A failed
+// load returns ERROR_NOT_FOUND to every caller that waited on it.
 int cache_get_with_lock(cache_instance_t* cache, const char* key,
                         void** value, size_t* value_size,
-                        void* (*loader_fn)(const char* key, void* ctx),
-                        void* ctx);
+                        cache_loader_fn loader, void* ctx);
 
 // Lock primitives for stampede prevention
 typedef struct cache_lock cache_lock_t;
@@ -205,11 +224,6 @@ bool cache_lock_try_acquire(cache_instance_t* cache, const char* key,
 // READ-THROUGH & WRITE-THROUGH CACHING
 // =============================================================================
 
-// Callback function types
-typedef void* (*cache_loader_fn)(const char* key, void* ctx, size_t* size);
-typedef int (*cache_writer_fn)(const char* key, const void* value, 
-                                size_t size, void* ctx);
-
 typedef struct {
     cache_loader_fn loader;
     cache_writer_fn writer;
@@ -240,17 +254,86 @@ int write_through_set(write_through_cache_t* wt_cache, const char* key,
                       const void* value, size_t value_size);
 int write_through_delete(write_through_cache_t* wt_cache, const char* key);
 
-// Write-behind cache (async writes)
+// Write-behind cache (async writes). Writes land in the cache immediately and
+// are queued for a flusher thread; repeated writes to a queued key coalesce
+// into one backend write. Writers block once queue_size keys are pending.
 typedef struct write_behind_cache write_behind_cache_t;
 
+typedef struct {
+    size_t queue_size;           // Max distinct keys pending
+    size_t batch_size;           // Flush once this many keys are pending (0 = 64)
+    uint64_t flush_interval_ms;  // ...or once the oldest write is this old (0 = 100)
+    uint32_t max_retries;        // Extra attempts per key when the writer fails
+    uint64_t retry_backoff_ms;   // Delay before the first retry, doubled after each
+} write_behind_config_t;
+
+typedef struct {
+    uint64_t writes;             // write_behind_set calls
+    uint64_t coalesced;          // Writes absorbed by an already queued key
+    uint64_t flushed;            // Keys written to the backend
+    uint64_t batches;
+    uint64_t retries;
+    uint64_t failed;             // Keys dropped after exhausting retries
+    size_t pending;
+    uint64_t oldest_pending_ms;  // Age of the oldest unflushed write
+    uint64_t max_lag_ms;         // Worst write-to-backend delay
+    double avg_lag_ms;
+} write_behind_stats_t;
+
 write_behind_cache_t* write_behind_cache_create(cache_instance_t* cache,
                                                  cache_writer_fn writer,
                                                  void* writer_ctx,
                                                  size_t queue_size);
+write_behind_cache_t* write_behind_cache_create_with_config(cache_instance_t* cache,
+                                                             cache_writer_fn writer,
+                                                             void* writer_ctx,
+                                                             const write_behind_config_t* config);
 void write_behind_cache_destroy(write_behind_cache_t* wb_cache);
 int write_behind_set(write_behind_cache_t* wb_cache, const char* key,
                      const void* value, size_t value_size);
 int write_behind_flush(write_behind_cache_t* wb_cache);
+int write_behind_get_stats(write_behind_cache_t* wb_cache, write_behind_stats_t* stats);
+
+// =============================================================================
+// NEAR CACHE
+// =============================================================================
+
+// A small per-thread L1 in front of a shared cache instance. L1 hits take no
+// locks and touch no shared memory. Changes to the instance's keys (from any
+// thread, through the near cache or not) are published to an invalidation
+// log that each thread applies every max_stale_ops of its own near cache
+// operations, so another thread's write may be missed for at most that many
+// operations. A thread always sees its own near_cache_set/delete. L1 entries
+// also honour the shared entry's TTL. For CACHE_TYPE_REDIS instances changes
+// made by other clients are not seen; bound them with l1_ttl_ms.
+typedef struct near_cache near_cache_t;
+
+typedef struct {
+    size_t l1_entries;           // Per thread, rounded up to a power of two (0 = 256)
+    size_t max_value_size;       // Larger values bypass L1 (0 = 4 KB)
+    uint64_t max_stale_ops;      // Operations between log checks (0 = 16)
+    uint64_t l1_ttl_ms;          // Cap on an L1 entry's life (0 = none)
+} near_cache_config_t;
+
+typedef struct {
+    uint64_t l1_hits;
+    uint64_t l1_misses;
+    double l1_hit_rate;
+    uint64_t invalidations;      // Changes published since the near cache was created
+    uint64_t l1_invalidations;   // L1 entries they dropped
+    uint64_t l1_flushes;         // L1s dropped whole after falling behind the log
+    double avg_staleness_us;     // Change published to L1 entry dropped
+    double max_staleness_us;
+    uint64_t max_stale_ops;
+    size_t threads;              // Threads with an L1
+} near_cache_stats_t;
+
+near_cache_t* near_cache_create(cache_instance_t* cache, const near_cache_config_t* config);
+void near_cache_destroy(near_cache_t* near);
+int near_cache_get(near_cache_t* near, const char* key, void** value, size_t* value_size);
+int near_cache_set(near_cache_t* near, const char* key, const void* value, size_t value_size);
+int near_cache_delete(near_cache_t* near, const char* key);
+int near_cache_get_stats(near_cache_t* near, near_cache_stats_t* stats);
 
 // =============================================================================
 // CACHE WARMING & PRELOADING
@@ -266,23 +349,32 @@ typedef enum {
 typedef struct {
     warmup_strategy_t strategy;
     size_t batch_size;
-    uint64_t delay_between_batches_ms;
-    double max_cpu_usage;
-    double max_memory_usage;
+    uint64_t delay_between_batches_ms; // Minimum gap between batch starts
+    double max_cpu_usage;    // Fraction of all CPUs, 0 = unthrottled
+    double max_memory_usage; // Stop at this fraction of max_memory_mb
+    const char** keys;       // Keys to load; NULL = the profile's keys
+    size_t key_count;
+    const char* profile_path; // WARMUP_POPULAR: from cache_save_access_profile
+    size_t max_keys;         // 0 = no limit
 } warmup_config_t;
 
 typedef struct {
     uint64_t keys_loaded;
     uint64_t keys_failed;
+    uint64_t keys_skipped;   // Already cached, or cut off by the memory limit
     uint64_t total_time_ms;
     double memory_used_mb;
+    double keys_per_second;
 } warmup_result_t;
 
-// Cache warming
+// Cache warming. Batches of keys are loaded on worker threads; loader must
+// be thread-safe. WARMUP_POPULAR loads the most accessed keys of the
+// profiled run first.
 warmup_result_t* cache_warmup(cache_instance_t* cache, 
                               cache_loader_fn loader,
                               void* loader_ctx,
                               warmup_config_t* config);
+int cache_save_access_profile(cache_instance_t* cache, const char* path);
 int cache_preload_keys(cache_instance_t* cache, const char** keys, 
                        size_t key_count,
                        cache_loader_fn loader, void* loader_ctx);
@@ -299,6 +391,12 @@ typedef struct {
     uint64_t deletes;
     uint64_t evictions;
     uint64_t expirations;
+    uint64_t early_refreshes;  // Reloads started before expiry (XFetch/precompute)
+    uint64_t compressed_values;       // Live entries stored compressed
+    uint64_t compression_bytes_saved; // Their raw minus compressed size
+    uint64_t compression_skipped;     // Values over the threshold that didn't shrink 1/8
+    uint64_t compression_time_ns;     // Time spent compressing
+    uint64_t decompression_time_ns;   // Time spent decompressing
     double hit_rate;
     double miss_rate;
     size_t current_size;
@@ -339,9 +437,13 @@ typedef struct {
     double p99_time_ms;
 } cache_operation_stats_t;
 
+// Latency of get, set, delete, mget, mset, mdelete and loader calls ("load"),
+// recorded per thread and merged on read. *stats is malloc'd for the caller.
+// Timing costs two clock reads per operation and can be switched off.
 int cache_get_operation_stats(cache_instance_t* cache,
                               cache_operation_stats_t** stats,
                               size_t* count);
+int cache_set_operation_timing(cache_instance_t* cache, bool enabled);
 
 // =============================================================================
 // DISTRIBUTED CACHE & REPLICATION
@@ -370,7 +472,12 @@ typedef struct {
     bool enable_read_from_replicas;
 } replication_config_t;
 
-// Distributed cache cluster
+// Distributed cache cluster: client-side consistent hashing over Redis/RESP
+// nodes (see CACHE_TYPE_REDIS). Each key lives on replication_factor nodes
+// (at most 8); writes go to all of them in parallel, reads go to the primary
+// or, with enable_read_from_replicas, round-robin over the replicas, skipping
+// unreachable nodes. Node ids are "host:port". Membership changes move only
+// the keys whose owners change; those miss until they are written again.
 cache_cluster_t* cache_cluster_create(replication_config_t* config);
 void cache_cluster_destroy(cache_cluster_t* cluster);
 int cache_cluster_add_node(cache_cluster_t* cluster, const char* host, int port);
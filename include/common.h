@@ -19,7 +19,8 @@ typedef enum {
     ERROR_IO = -5,
     ERROR_FULL = -6,
     ERROR_EMPTY = -7,
-    ERROR_TIMEOUT = -8
+    ERROR_TIMEOUT = -8,
+    ERROR_CONFLICT = -9            // Lost a race with a concurrent update; retry
 } error_code_t;
 
 // Memory allocation helpers
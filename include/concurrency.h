@@ -100,6 +100,8 @@ task_t* thread_pool_submit_with_priority(thread_pool_t* pool, task_fn function,
 int thread_pool_cancel_task(thread_pool_t* pool, task_t* task);
 int thread_pool_wait_for_task(task_t* task);
 int thread_pool_wait_all(thread_pool_t* pool);
+// Submitted tasks stay valid for waiting and inspection until released
+void thread_pool_task_release(task_t* task);
 
 // Thread pool statistics
 int thread_pool_get_stats(thread_pool_t* pool, thread_pool_stats_t* stats);
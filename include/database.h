@@ -7,6 +7,8 @@
 // Database types
 typedef struct database database_t;
 typedef struct transaction transaction_t;
+typedef struct database_iterator database_iterator_t;
+typedef struct database_write_batch database_write_batch_t;
 
 // Index types
 typedef enum {
@@ -22,19 +24,72 @@ typedef enum {
     ISOLATION_SERIALIZABLE
 } isolation_level_t;
 
+// Storage engines
+typedef enum {
+    DATABASE_ENGINE_HASH,          // In-memory hash table, persisted by snapshots
+    DATABASE_ENGINE_LSM            // Memtable plus leveled sorted table files on disk
+} database_engine_t;
+
+// Database configuration
+typedef struct {
+    database_engine_t engine;
+    uint64_t wal_batch_delay_us;   // Longest a commit waits for more writers to join its batch
+    size_t wal_batch_max_bytes;    // A batch this large is synced without waiting out the delay
+    size_t snapshot_wal_bytes;     // A WAL segment this large starts a background snapshot
+    
+    // LSM engine
+    size_t memtable_bytes;         // A memtable this large is flushed to a level-0 table
+    size_t sstable_block_size;     // Data block size in table files
+    size_t level0_compaction_trigger;  // Level-0 tables that start a compaction
+    size_t level1_max_bytes;       // Level 1 size; each deeper level is 10x larger
+    int bloom_bits_per_key;        // Filter size per table key; negative for no filters
+    size_t block_cache_bytes;      // Memory budget for cached data blocks
+} database_config_t;
+
 // Database functions
 database_t* database_create(const char* data_dir);
+database_t* database_create_with_config(const char* data_dir, const database_config_t* config);
 void database_destroy(database_t* db);
 int database_open(database_t* db);
 int database_close(database_t* db);
 
 // Key-value operations
+// Puts and deletes return once their WAL record is on disk; concurrent writers
+// share a single write and fdatasync per batch. A write is visible to readers
+// as soon as it is applied, before its batch is synced. If that sync fails,
+// the writers in the batch get ERROR_IO while their changes stay visible in
+// memory, though no snapshot will include them. Every later write is then
+// refused with ERROR_IO before it is logged or applied.
 int database_put(database_t* db, const char* key, const void* value, size_t value_size);
 int database_get(database_t* db, const char* key, void** value, size_t* value_size);
 int database_delete(database_t* db, const char* key);
 int database_exists(database_t* db, const char* key);
 
+// Write batches
+// A batch of puts and deletes is logged as one WAL record under one checksum
+// and one sync, and applied in order at once: readers and snapshots see all
+// of it or none, and recovery replays all of it or none. Deleting a missing
+// key is not an error inside a batch. The batch is left intact, so it can be
+// cleared and reused.
+database_write_batch_t* database_write_batch_create(void);
+int database_write_batch_put(database_write_batch_t* batch, const char* key, const void* value, size_t value_size);
+int database_write_batch_delete(database_write_batch_t* batch, const char* key);
+size_t database_write_batch_count(const database_write_batch_t* batch);
+void database_write_batch_clear(database_write_batch_t* batch);
+void database_write_batch_destroy(database_write_batch_t* batch);
+int database_write_batch(database_t* db, const database_write_batch_t* batch);
+
 // Transaction support
+// Writes are buffered and committed as one write batch.
+// Read-committed (and read-uncommitted) transactions read the newest data.
+// Repeatable-read and serializable ones read a snapshot taken when they
+// begin, and their commit fails with ERROR_CONFLICT, rolling them back, if
+// another commit wrote one of their keys after the snapshot. Serializable
+// transactions also fail if a key they read has changed. Snapshot reads take
+// no lock, and commits are checked for conflicts before the write lock is
+// taken; applying a commit still holds it, so newest-data reads and scans
+// never see part of one. Versions kept for snapshots are collected in the
+// background once the oldest one ends.
 transaction_t* database_begin_transaction(database_t* db, isolation_level_t level);
 int transaction_commit(transaction_t* txn);
 int transaction_rollback(transaction_t* txn);
@@ -43,10 +98,29 @@ int transaction_get(transaction_t* txn, const char* key, void** value, size_t* v
 int transaction_delete(transaction_t* txn, const char* key);
 
 // Index operations
+// A B-tree index keeps the hash engine's keys in order for database_scan; it
+// is bulk-loaded when created, maintained by every write and kept in memory
+// for the life of the handle. The LSM engine and INDEX_HASH need no extra
+// structure, so those indexes are only registered.
 int database_create_index(database_t* db, const char* index_name, index_type_t type);
 int database_drop_index(database_t* db, const char* index_name);
 
+// Range scans
+// Keys in [start, end) in order; NULL leaves a bound open. Keys are read in
+// batches under short locks, so writes are not blocked and a scan sees each
+// key that exists throughout it. Values are copied only when asked for. The
+// hash engine walks and sorts its whole table unless a B-tree index exists.
+database_iterator_t* database_scan(database_t* db, const char* start, const char* end);
+bool database_iterator_next(database_iterator_t* it);        // False at the end or on error
+const char* database_iterator_key(const database_iterator_t* it);
+int database_iterator_value(database_iterator_t* it, void** value, size_t* value_size);
+int database_iterator_status(const database_iterator_t* it);  // ERROR_IO if a read failed
+void database_iterator_close(database_iterator_t* it);
+
 // WAL operations
+// Checkpoint writes a sorted snapshot of the table and drops the WAL segments
+// it covers; snapshots also run in the background as the WAL grows. Recover
+// loads the snapshot and replays the WAL after it (done by database_open).
 int database_checkpoint(database_t* db);
 int database_recover(database_t* db);
 
@@ -55,10 +129,27 @@ int database_compact(database_t* db);
 
 // Statistics
 typedef struct {
-    size_t num_keys;
+    size_t num_keys;               // LSM: upper bound, counting versions not yet compacted
     size_t total_size;
     size_t wal_size;
     size_t num_transactions;
+    uint64_t txn_conflicts;        // Snapshot commits rolled back for a conflict
+    size_t mvcc_versions;          // Old key versions kept for active snapshots
+    uint64_t wal_records;          // Records synced to the WAL
+    uint64_t wal_syncs;            // fdatasync calls; records / syncs is the group commit size
+    uint64_t wal_truncated_bytes;  // Torn or corrupt WAL tail dropped at the last recovery
+    uint64_t snapshots;            // Snapshots written since open
+    size_t sstable_count;          // LSM: table files in all levels
+    uint64_t sstable_bytes;
+    uint64_t memtable_flushes;
+    uint64_t compactions;
+    uint64_t bloom_negatives;      // LSM: table lookups a Bloom filter ruled out
+    uint64_t bloom_false_positives;  // Lookups a filter let through for a key the table lacks
+    double bloom_false_positive_rate;
+    uint64_t block_cache_hits;
+    uint64_t block_cache_misses;
+    size_t block_cache_usage;      // Bytes
+    double block_cache_hit_rate;
 } database_stats_t;
 
 int database_get_stats(database_t* db, database_stats_t* stats);
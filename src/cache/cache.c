@@ -1,34 +1,172 @@
 #define _POSIX_C_SOURCE 200809L
 #include "cache.h"
 #include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// W-TinyLFU sizing: the admission window holds ~1% of the capacity and the
+// protected segment holds 80% of the main (segmented LRU) region
+#define TINYLFU_WINDOW_PERCENT 1
+#define TINYLFU_PROTECTED_PERCENT 80
+
+// Count-min sketch: 4 rows of 4-bit counters, 16 counters per 64-bit word.
+// Counters are halved after SKETCH_SAMPLE_FACTOR * max_size recorded accesses
+// so that old popularity ages out.
+#define SKETCH_DEPTH 4
+#define SKETCH_COUNTER_MAX 15
+#define SKETCH_SAMPLE_FACTOR 10
+#define SKETCH_RESET_MASK 0x7777777777777777ULL
+
+// Doorkeeper Bloom filter: bits per cache slot and probes per key
+#define DOORKEEPER_BITS_PER_SLOT 8
+#define DOORKEEPER_PROBES 2
+
+// Expiration timing wheel: WHEEL_SLOTS buckets of WHEEL_TICK_MS each. Deadlines
+// further out than one revolution stay in their slot until their round comes.
+#define WHEEL_SLOTS 1024
+#define WHEEL_TICK_MS 10
+#define REAPER_DEFAULT_SLICE 256
+
+// Snapshot file format
+#define SNAPSHOT_MAGIC 0x504E5343  // "CSNP"
+#define SNAPSHOT_VERSION 3
+#define SNAPSHOT_MIN_SLICE 4096     // Records per loader thread before splitting
+#define SNAPSHOT_MAX_THREADS 16
+#define SNAPSHOT_CHUNK_RECORDS 1024 // Records copied per read lock when saving
+#define SNAPSHOT_CHUNK_BYTES (1 << 20)
+
+// Hash index: grows at load factor 1 and shrinks below 1/8. Resizes are
+// incremental; each write-locked operation migrates INDEX_REHASH_STEP buckets
+// and skips at most INDEX_EMPTY_VISITS empty ones per migrated bucket.
+#define INDEX_MIN_BUCKETS 16
+#define INDEX_SHRINK_RATIO 8
+#define INDEX_REHASH_STEP 4
+#define INDEX_EMPTY_VISITS 10
+
+// Batch operations: keys hashed on the stack before this many are spilled to
+// the heap, and how far ahead of the probe bucket slots and chain heads are
+// prefetched
+#define BATCH_STACK_KEYS 128
+#define BATCH_PREFETCH_BUCKET 16
+#define BATCH_PREFETCH_ENTRY 8
+
+// List an entry currently lives on. LRU and LFU only use SEGMENT_MAIN, which
+// doubles as the W-TinyLFU probation segment.
+typedef enum {
+    SEGMENT_MAIN,
+    SEGMENT_WINDOW,
+    SEGMENT_PROTECTED
+} cache_segment_t;
+
+struct lfu_bucket;
 
 // Cache entry
 typedef struct cache_entry {
     char* key;
     void* value;
     size_t value_size;
+    uint32_t hash;
+    uint8_t segment;
+    uint8_t visited;      // SIEVE hit bit, set atomically under the read lock
+    uint16_t wheel_slot;
     uint64_t timestamp;
-    uint64_t ttl_ms;
+    uint64_t expires_at;  // 0 = no TTL
     uint64_t access_count;
+    struct lfu_bucket* bucket;  // LFU only
     struct cache_entry* prev;
     struct cache_entry* next;
     struct cache_entry* hash_next;
+    struct cache_entry* wheel_prev;
+    struct cache_entry* wheel_next;
 } cache_entry_t;
 
+// Recency-ordered doubly linked list
+typedef struct {
+    cache_entry_t* head;    // Most recently used
+    cache_entry_t* tail;    // Least recently used
+    size_t size;
+    cache_entry_t* cursor;  // Next entry a snapshot save will copy
+} cache_list_t;
+
+// LFU frequency bucket. The entries sharing an access count form one run of
+// the main list, runs are ordered by count from the tail up and buckets link
+// to their neighbours, so a hit moves an entry to the next run and the victim
+// is always the main list tail.
+typedef struct lfu_bucket {
+    uint64_t count;
+    size_t size;
+    cache_entry_t* first;      // Entry of the run nearest the list head
+    struct lfu_bucket* lower;
+    struct lfu_bucket* higher;
+} lfu_bucket_t;
+
+// Frequency estimator used by W-TinyLFU admission
+typedef struct {
+    uint64_t* counters;       // SKETCH_DEPTH rows of 4-bit counters
+    size_t width;             // Counters per row (power of two)
+    uint64_t* doorkeeper;     // Bloom filter absorbing one-hit wonders
+    size_t doorkeeper_bits;   // Power of two
+    size_t additions;
+    size_t sample_size;
+} frequency_sketch_t;
+
+// Chained hash table (power-of-two bucket count)
+typedef struct {
+    cache_entry_t** buckets;
+    size_t size;
+    size_t mask;
+    size_t used;
+} cache_index_t;
+
 struct cache {
-    cache_entry_t** hash_table;
-    size_t hash_size;
-    cache_entry_t* head;  // Most recently used
-    cache_entry_t* tail;  // Least recently used
+    // index[1] is only allocated while a resize is migrating buckets out of
+    // index[0]; rehash_index is the next bucket to move (-1 when idle)
+    cache_index_t index[2];
+    long rehash_index;
+    cache_list_t main;           // LRU/LFU order; W-TinyLFU probation segment
+    cache_list_t window;         // W-TinyLFU admission window
+    cache_list_t protected_seg;  // W-TinyLFU protected segment
     size_t size;
     size_t max_size;
     eviction_policy_t policy;
     pthread_rwlock_t lock;
     
+    // W-TinyLFU state
+    frequency_sketch_t sketch;
+    size_t window_max;
+    size_t protected_max;
+    
+    // SIEVE hand: next eviction candidate, moving from tail towards head
+    cache_entry_t* sieve_hand;
+    
+    // Trace replay: while recycle is set (inside cache_replay_access only),
+    // a removed entry is parked in `spare` and reused by the next insert
+    // instead of going back to the allocator
+    bool recycle;
+    cache_entry_t* spare;
+    
+    // Expiration index
+    cache_entry_t* wheel[WHEEL_SLOTS];
+    uint64_t wheel_next_tick;    // Next tick the reaper has to visit
+    cache_entry_t* wheel_resume; // Where a budget-limited pass stopped
+    bool wheel_partial;          // wheel_resume is valid for wheel_next_tick
+    
+    // Background reaper
+    pthread_t reaper_thread;
+    pthread_mutex_t reaper_lock;
+    pthread_mutex_t snapshot_lock;  // One save at a time owns the list cursors
+    pthread_cond_t reaper_cond;
+    int reaper_running;
+    uint64_t reaper_interval_ms;
+    size_t reaper_slice;
+    
     // Statistics
     size_t hits;
     size_t misses;
     size_t evictions;
+    size_t expirations;
 };
 
 static uint32_t hash_key(const char* key) {
@@ -40,265 +178,1315 @@ static uint32_t hash_key(const char* key) {
     return hash;
 }
 
-static void remove_from_list(cache_t* cache, cache_entry_t* entry) {
+// Derive an independent-looking index for row/probe `seed` from a key hash
+static uint32_t rehash(uint32_t hash, uint32_t seed) {
+    uint64_t x = ((uint64_t)hash + seed) * 0x9E3779B97F4A7C15ULL;
+    return (uint32_t)(x >> 32) ^ (uint32_t)x;
+}
+
+static size_t next_power_of_two(size_t n) {
+    size_t p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+// =============================================================================
+// Frequency sketch
+// =============================================================================
+
+static void sketch_init(frequency_sketch_t* sketch, size_t max_size) {
+    sketch->width = next_power_of_two(max_size < 16 ? 16 : max_size);
+    sketch->counters = safe_calloc(SKETCH_DEPTH * sketch->width / 16, sizeof(uint64_t));
+    sketch->doorkeeper_bits = sketch->width * DOORKEEPER_BITS_PER_SLOT;
+    sketch->doorkeeper = safe_calloc(sketch->doorkeeper_bits / 64, sizeof(uint64_t));
+    sketch->additions = 0;
+    sketch->sample_size = SKETCH_SAMPLE_FACTOR * (max_size > 0 ? max_size : 1);
+}
+
+static void sketch_destroy(frequency_sketch_t* sketch) {
+    safe_free((void**)&sketch->counters);
+    safe_free((void**)&sketch->doorkeeper);
+}
+
+static size_t sketch_index(const frequency_sketch_t* sketch, uint32_t hash, uint32_t row) {
+    return row * sketch->width + (rehash(hash, row) & (sketch->width - 1));
+}
+
+static uint32_t sketch_counter(const frequency_sketch_t* sketch, size_t index) {
+    return (sketch->counters[index / 16] >> ((index % 16) * 4)) & 0xF;
+}
+
+static bool doorkeeper_contains(const frequency_sketch_t* sketch, uint32_t hash) {
+    for (uint32_t i = 0; i < DOORKEEPER_PROBES; i++) {
+        size_t bit = rehash(hash, SKETCH_DEPTH + i) & (sketch->doorkeeper_bits - 1);
+        if (!(sketch->doorkeeper[bit / 64] & (1ULL << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void doorkeeper_add(frequency_sketch_t* sketch, uint32_t hash) {
+    for (uint32_t i = 0; i < DOORKEEPER_PROBES; i++) {
+        size_t bit = rehash(hash, SKETCH_DEPTH + i) & (sketch->doorkeeper_bits - 1);
+        sketch->doorkeeper[bit / 64] |= 1ULL << (bit % 64);
+    }
+}
+
+// Halve every counter and clear the doorkeeper so the sketch tracks recent
+// popularity rather than all-time popularity
+static void sketch_reset(frequency_sketch_t* sketch) {
+    size_t words = SKETCH_DEPTH * sketch->width / 16;
+    for (size_t i = 0; i < words; i++) {
+        sketch->counters[i] = (sketch->counters[i] >> 1) & SKETCH_RESET_MASK;
+    }
+    memset(sketch->doorkeeper, 0, sketch->doorkeeper_bits / 8);
+    sketch->additions /= 2;
+}
+
+static void sketch_record(frequency_sketch_t* sketch, uint32_t hash) {
+    // First sighting only sets the doorkeeper; repeat accesses reach the sketch
+    if (!doorkeeper_contains(sketch, hash)) {
+        doorkeeper_add(sketch, hash);
+    } else {
+        for (uint32_t row = 0; row < SKETCH_DEPTH; row++) {
+            size_t index = sketch_index(sketch, hash, row);
+            if (sketch_counter(sketch, index) < SKETCH_COUNTER_MAX) {
+                sketch->counters[index / 16] += 1ULL << ((index % 16) * 4);
+            }
+        }
+    }
+    
+    if (++sketch->additions >= sketch->sample_size) {
+        sketch_reset(sketch);
+    }
+}
+
+static uint32_t sketch_frequency(const frequency_sketch_t* sketch, uint32_t hash) {
+    uint32_t frequency = SKETCH_COUNTER_MAX;
+    for (uint32_t row = 0; row < SKETCH_DEPTH; row++) {
+        uint32_t count = sketch_counter(sketch, sketch_index(sketch, hash, row));
+        if (count < frequency) {
+            frequency = count;
+        }
+    }
+    return frequency + (doorkeeper_contains(sketch, hash) ? 1 : 0);
+}
+
+// =============================================================================
+// Lists
+// =============================================================================
+
+static cache_list_t* segment_list(cache_t* cache, uint8_t segment) {
+    switch (segment) {
+        case SEGMENT_WINDOW: return &cache->window;
+        case SEGMENT_PROTECTED: return &cache->protected_seg;
+        default: return &cache->main;
+    }
+}
+
+static void remove_from_list(cache_list_t* list, cache_entry_t* entry) {
+    if (list->cursor == entry) {
+        list->cursor = entry->prev;
+    }
+    
     if (entry->prev) {
         entry->prev->next = entry->next;
     } else {
-        cache->head = entry->next;
+        list->head = entry->next;
     }
     
     if (entry->next) {
         entry->next->prev = entry->prev;
     } else {
-        cache->tail = entry->prev;
+        list->tail = entry->prev;
     }
+    
+    list->size--;
 }
 
-static void add_to_head(cache_t* cache, cache_entry_t* entry) {
+static void add_to_head(cache_list_t* list, cache_entry_t* entry) {
     entry->prev = NULL;
-    entry->next = cache->head;
+    entry->next = list->head;
     
-    if (cache->head) {
-        cache->head->prev = entry;
+    if (list->head) {
+        list->head->prev = entry;
     }
-    cache->head = entry;
+    list->head = entry;
     
-    if (!cache->tail) {
-        cache->tail = entry;
+    if (!list->tail) {
+        list->tail = entry;
     }
+    
+    list->size++;
 }
 
-static void move_to_head(cache_t* cache, cache_entry_t* entry) {
-    if (cache->head == entry) return;
+static void move_to_head(cache_list_t* list, cache_entry_t* entry) {
+    if (list->head == entry) return;
     
-    remove_from_list(cache, entry);
-    add_to_head(cache, entry);
+    remove_from_list(list, entry);
+    add_to_head(list, entry);
 }
 
-static cache_entry_t* find_entry(cache_t* cache, const char* key) {
-    uint32_t hash = hash_key(key);
-    size_t bucket = hash % cache->hash_size;
-    
-    cache_entry_t* entry = cache->hash_table[bucket];
-    while (entry) {
-        if (strcmp(entry->key, key) == 0) {
-            // Check TTL
-            if (entry->ttl_ms > 0) {
-                uint64_t now = get_timestamp_ms();
-                if (now - entry->timestamp > entry->ttl_ms) {
-                    return NULL;  // Expired
-                }
-            }
-            return entry;
-        }
-        entry = entry->hash_next;
+// Link entry on the head side of pos, or at the tail when pos is NULL
+static void add_before(cache_list_t* list, cache_entry_t* pos, cache_entry_t* entry) {
+    entry->next = pos;
+    entry->prev = pos ? pos->prev : list->tail;
+    
+    if (entry->prev) {
+        entry->prev->next = entry;
+    } else {
+        list->head = entry;
     }
     
-    return NULL;
+    if (pos) {
+        pos->prev = entry;
+    } else {
+        list->tail = entry;
+    }
+    
+    list->size++;
 }
 
-static void remove_entry(cache_t* cache, cache_entry_t* entry) {
-    // Remove from hash table
-    uint32_t hash = hash_key(entry->key);
-    size_t bucket = hash % cache->hash_size;
+static void move_to_segment(cache_t* cache, cache_entry_t* entry, uint8_t segment) {
+    remove_from_list(segment_list(cache, entry->segment), entry);
+    entry->segment = segment;
+    add_to_head(segment_list(cache, segment), entry);
+}
+
+static void free_list(cache_list_t* list) {
+    cache_entry_t* current = list->head;
+    while (current) {
+        cache_entry_t* next = current->next;
+        safe_free((void**)&current->key);
+        safe_free((void**)&current->value);
+        safe_free((void**)&current);
+        current = next;
+    }
     
-    cache_entry_t* current = cache->hash_table[bucket];
-    cache_entry_t* prev = NULL;
+    list->head = NULL;
+    list->tail = NULL;
+    list->size = 0;
+    list->cursor = NULL;
+}
+
+// =============================================================================
+// LFU buckets
+// =============================================================================
+
+// Add entry, which is on no list, to the run for entry->access_count. `below`
+// is the highest bucket with a smaller count (NULL if there is none).
+static void lfu_link(cache_t* cache, cache_entry_t* entry, lfu_bucket_t* below) {
+    lfu_bucket_t* above = below ? below->higher :
+                          cache->main.tail ? cache->main.tail->bucket : NULL;
     
-    while (current) {
-        if (current == entry) {
-            if (prev) {
-                prev->hash_next = current->hash_next;
-            } else {
-                cache->hash_table[bucket] = current->hash_next;
-            }
-            break;
-        }
-        prev = current;
-        current = current->hash_next;
+    lfu_bucket_t* bucket = above;
+    if (!bucket || bucket->count != entry->access_count) {
+        bucket = safe_calloc(1, sizeof(lfu_bucket_t));
+        bucket->count = entry->access_count;
+        bucket->lower = below;
+        bucket->higher = above;
+        if (below) below->higher = bucket;
+        if (above) above->lower = bucket;
     }
     
-    // Remove from list
-    remove_from_list(cache, entry);
+    // Newest first within a run; a new run goes just above the one below it
+    cache_entry_t* pos = bucket->first ? bucket->first : below ? below->first : NULL;
+    add_before(&cache->main, pos, entry);
+    bucket->first = entry;
+    bucket->size++;
+    entry->bucket = bucket;
+}
+
+// Take entry out of its run and the main list, freeing an emptied bucket
+static void lfu_unlink(cache_t* cache, cache_entry_t* entry) {
+    lfu_bucket_t* bucket = entry->bucket;
     
-    // Free memory
-    safe_free((void**)&entry->key);
-    safe_free((void**)&entry->value);
-    safe_free((void**)&entry);
+    if (--bucket->size == 0) {
+        if (bucket->lower) bucket->lower->higher = bucket->higher;
+        if (bucket->higher) bucket->higher->lower = bucket->lower;
+        safe_free((void**)&bucket);
+    } else if (bucket->first == entry) {
+        bucket->first = entry->next;
+    }
     
-    cache->size--;
+    remove_from_list(&cache->main, entry);
+    entry->bucket = NULL;
 }
 
-static cache_entry_t* find_victim(cache_t* cache) {
-    if (cache->policy == EVICTION_LRU) {
-        return cache->tail;  // Least recently used
-    } else {  // EVICTION_LFU
-        // Find least frequently used
-        cache_entry_t* victim = cache->head;
-        cache_entry_t* current = cache->head;
-        
-        while (current) {
-            if (current->access_count < victim->access_count) {
-                victim = current;
-            }
-            current = current->next;
-        }
-        
-        return victim;
+// Move an entry whose access count has grown to the matching run
+static void lfu_touch(cache_t* cache, cache_entry_t* entry) {
+    lfu_bucket_t* bucket = entry->bucket;
+    if (bucket->count == entry->access_count) return;
+    
+    // The only entry of its run can take the bucket along unless that would
+    // overtake the next run
+    if (bucket->size == 1 &&
+        (!bucket->higher || bucket->higher->count > entry->access_count)) {
+        bucket->count = entry->access_count;
+        return;
     }
+    
+    lfu_bucket_t* below = bucket->size > 1 ? bucket : bucket->lower;
+    lfu_unlink(cache, entry);
+    lfu_link(cache, entry, below);
 }
 
-static void evict_if_needed(cache_t* cache) {
-    while (cache->size >= cache->max_size) {
-        cache_entry_t* victim = find_victim(cache);
-        if (victim) {
-            remove_entry(cache, victim);
-            cache->evictions++;
-        } else {
-            break;
-        }
+static void lfu_free_buckets(cache_t* cache) {
+    lfu_bucket_t* bucket = cache->main.tail ? cache->main.tail->bucket : NULL;
+    while (bucket) {
+        lfu_bucket_t* higher = bucket->higher;
+        safe_free((void**)&bucket);
+        bucket = higher;
     }
 }
 
-cache_t* cache_create(size_t max_size, eviction_policy_t policy) {
-    cache_t* cache = safe_calloc(1, sizeof(cache_t));
-    cache->max_size = max_size;
-    cache->policy = policy;
-    cache->hash_size = max_size * 2;  // 2x for better distribution
-    cache->hash_table = safe_calloc(cache->hash_size, sizeof(cache_entry_t*));
-    pthread_rwlock_init(&cache->lock, NULL);
-    return cache;
+// =============================================================================
+// Expiration wheel
+// =============================================================================
+
+static void wheel_insert(cache_t* cache, cache_entry_t* entry) {
+    uint64_t tick = entry->expires_at / WHEEL_TICK_MS;
+    if (tick <= cache->wheel_next_tick) {
+        // Already due (or due in a slot a pass may be part-way through):
+        // reap on the next tick
+        tick = cache->wheel_next_tick + 1;
+    }
+    
+    entry->wheel_slot = tick % WHEEL_SLOTS;
+    cache_entry_t** slot = &cache->wheel[entry->wheel_slot];
+    entry->wheel_prev = NULL;
+    entry->wheel_next = *slot;
+    if (*slot) {
+        (*slot)->wheel_prev = entry;
+    }
+    *slot = entry;
 }
 
-void cache_destroy(cache_t* cache) {
-    if (!cache) return;
+static void wheel_remove(cache_t* cache, cache_entry_t* entry) {
+    if (cache->wheel_resume == entry) {
+        cache->wheel_resume = entry->wheel_next;
+    }
     
-    cache_clear(cache);
+    if (entry->wheel_prev) {
+        entry->wheel_prev->wheel_next = entry->wheel_next;
+    } else {
+        cache->wheel[entry->wheel_slot] = entry->wheel_next;
+    }
     
-    safe_free((void**)&cache->hash_table);
-    pthread_rwlock_destroy(&cache->lock);
-    safe_free((void**)&cache);
+    if (entry->wheel_next) {
+        entry->wheel_next->wheel_prev = entry->wheel_prev;
+    }
+    
+    entry->wheel_prev = NULL;
+    entry->wheel_next = NULL;
 }
 
-int cache_put(cache_t* cache, const char* key, const void* value, size_t value_size) {
-    return cache_put_with_ttl(cache, key, value, value_size, 0);
+// =============================================================================
+// Hash index
+// =============================================================================
+
+static void index_init(cache_index_t* index, size_t size) {
+    index->buckets = safe_calloc(size, sizeof(cache_entry_t*));
+    index->size = size;
+    index->mask = size - 1;
+    index->used = 0;
 }
 
-int cache_put_with_ttl(cache_t* cache, const char* key, const void* value, 
-                       size_t value_size, uint64_t ttl_ms) {
-    if (!cache || !key || !value || value_size == 0) {
-        return ERROR_INVALID_PARAM;
-    }
+static void index_reset(cache_index_t* index) {
+    safe_free((void**)&index->buckets);
+    index->size = 0;
+    index->mask = 0;
+    index->used = 0;
+}
+
+static bool index_rehashing(const cache_t* cache) {
+    return cache->rehash_index >= 0;
+}
+
+// Move up to `buckets` non-empty buckets from index[0] to index[1]. Returns
+// true once the migration has finished and index[1] has become index[0].
+static bool index_rehash_step(cache_t* cache, size_t buckets) {
+    if (!index_rehashing(cache)) return true;
     
-    pthread_rwlock_wrlock(&cache->lock);
+    cache_index_t* from = &cache->index[0];
+    cache_index_t* to = &cache->index[1];
+    size_t empty_visits = buckets * INDEX_EMPTY_VISITS;
     
-    // Check if key exists
-    cache_entry_t* existing = find_entry(cache, key);
-    if (existing) {
-        // Update existing entry
-        safe_free((void**)&existing->value);
-        existing->value = safe_malloc(value_size);
-        memcpy(existing->value, value, value_size);
-        existing->value_size = value_size;
-        existing->timestamp = get_timestamp_ms();
-        existing->ttl_ms = ttl_ms;
-        
-        if (cache->policy == EVICTION_LRU) {
-            move_to_head(cache, existing);
+    while (buckets > 0 && from->used > 0) {
+        while (from->buckets[cache->rehash_index] == NULL) {
+            cache->rehash_index++;
+            if (--empty_visits == 0) return false;
         }
         
-        pthread_rwlock_unlock(&cache->lock);
-        return SUCCESS;
+        cache_entry_t* entry = from->buckets[cache->rehash_index];
+        while (entry) {
+            cache_entry_t* next = entry->hash_next;
+            size_t bucket = entry->hash & to->mask;
+            entry->hash_next = to->buckets[bucket];
+            to->buckets[bucket] = entry;
+            from->used--;
+            to->used++;
+            entry = next;
+        }
+        from->buckets[cache->rehash_index] = NULL;
+        cache->rehash_index++;
+        buckets--;
     }
     
-    // Evict if needed
-    evict_if_needed(cache);
+    if (from->used > 0) return false;
     
-    // Create new entry
-    cache_entry_t* entry = safe_calloc(1, sizeof(cache_entry_t));
-    entry->key = safe_strdup(key);
-    entry->value = safe_malloc(value_size);
-    memcpy(entry->value, value, value_size);
-    entry->value_size = value_size;
-    entry->timestamp = get_timestamp_ms();
-    entry->ttl_ms = ttl_ms;
-    entry->access_count = 0;
+    safe_free((void**)&from->buckets);
+    *from = *to;
+    to->buckets = NULL;
+    index_reset(to);
+    cache->rehash_index = -1;
+    return true;
+}
+
+// Start a grow or shrink when the load factor leaves [1/8, 1]. Only the new
+// table is allocated here; entries move over in later rehash steps.
+static void index_check_resize(cache_t* cache) {
+    if (index_rehashing(cache)) return;
     
-    // Add to hash table
-    uint32_t hash = hash_key(key);
-    size_t bucket = hash % cache->hash_size;
-    entry->hash_next = cache->hash_table[bucket];
-    cache->hash_table[bucket] = entry;
+    cache_index_t* index = &cache->index[0];
+    size_t target = 0;
+    if (index->used >= index->size) {
+        target = index->size * 2;
+    } else if (index->size > INDEX_MIN_BUCKETS &&
+               index->used < index->size / INDEX_SHRINK_RATIO) {
+        target = next_power_of_two(index->used * 2);
+        if (target < INDEX_MIN_BUCKETS) target = INDEX_MIN_BUCKETS;
+    }
+    if (target == 0 || target == index->size) return;
     
-    // Add to list
-    add_to_head(cache, entry);
+    index_init(&cache->index[1], target);
+    cache->rehash_index = 0;
+}
+
+static void index_insert(cache_t* cache, cache_entry_t* entry) {
+    index_rehash_step(cache, INDEX_REHASH_STEP);
     
-    cache->size++;
+    // New entries go straight to the table being migrated into
+    cache_index_t* index = &cache->index[index_rehashing(cache) ? 1 : 0];
+    size_t bucket = entry->hash & index->mask;
+    entry->hash_next = index->buckets[bucket];
+    index->buckets[bucket] = entry;
+    index->used++;
     
-    pthread_rwlock_unlock(&cache->lock);
-    return SUCCESS;
+    index_check_resize(cache);
 }
 
-int cache_get(cache_t* cache, const char* key, void** value, size_t* value_size) {
-    if (!cache || !key) {
-        return ERROR_INVALID_PARAM;
+static void index_remove(cache_t* cache, cache_entry_t* entry) {
+    for (int t = 0; t < 2; t++) {
+        cache_index_t* index = &cache->index[t];
+        if (index->size == 0) break;
+        
+        cache_entry_t** link = &index->buckets[entry->hash & index->mask];
+        while (*link) {
+            if (*link == entry) {
+                *link = entry->hash_next;
+                entry->hash_next = NULL;
+                index->used--;
+                index_rehash_step(cache, INDEX_REHASH_STEP);
+                index_check_resize(cache);
+                return;
+            }
+            link = &(*link)->hash_next;
+        }
+    }
+}
+
+// =============================================================================
+// Entries
+// =============================================================================
+
+static bool entry_expired(const cache_entry_t* entry, uint64_t now) {
+    return entry->expires_at > 0 && now > entry->expires_at;
+}
+
+// Returns the entry for key whether or not it has expired. Does not advance a
+// resize, so it is safe under the read lock; both tables are consulted while
+// a migration is in progress.
+static cache_entry_t* find_entry(cache_t* cache, const char* key, uint32_t hash) {
+    for (int t = 0; t < 2; t++) {
+        const cache_index_t* index = &cache->index[t];
+        if (index->size == 0) break;
+        
+        cache_entry_t* entry = index->buckets[hash & index->mask];
+        while (entry) {
+            if (entry->hash == hash && strcmp(entry->key, key) == 0) {
+                return entry;
+            }
+            entry = entry->hash_next;
+        }
     }
     
-    pthread_rwlock_wrlock(&cache->lock);
-    
-    cache_entry_t* entry = find_entry(cache, key);
+    return NULL;
+}
+
+static cache_entry_t* find_live_entry(cache_t* cache, const char* key, uint32_t hash) {
+    cache_entry_t* entry = find_entry(cache, key, hash);
+    if (entry && entry_expired(entry, get_timestamp_ms())) {
+        return NULL;
+    }
+    return entry;
+}
+
+static void free_entry(cache_entry_t* entry) {
+    safe_free((void**)&entry->key);
+    safe_free((void**)&entry->value);
+    safe_free((void**)&entry);
+}
+
+// Allocate an entry holding copies of key and value, reusing the spare one
+// when recycling. All other fields are zeroed.
+static cache_entry_t* alloc_entry(cache_t* cache, const char* key,
+                                  const void* value, size_t value_size) {
+    cache_entry_t* entry = cache->spare;
     if (!entry) {
-        cache->misses++;
-        pthread_rwlock_unlock(&cache->lock);
-        return ERROR_NOT_FOUND;
+        entry = safe_calloc(1, sizeof(cache_entry_t));
+        entry->key = safe_strdup(key);
+        entry->value = safe_malloc(value_size);
+    } else {
+        cache->spare = NULL;
+        char* old_key = entry->key;
+        void* old_value = entry->value;
+        size_t old_value_size = entry->value_size;
+        size_t key_size = strlen(key) + 1;
+        memset(entry, 0, sizeof(*entry));
+        
+        entry->key = strlen(old_key) + 1 >= key_size ? old_key :
+                     safe_realloc(old_key, key_size);
+        memcpy(entry->key, key, key_size);
+        entry->value = old_value_size >= value_size ? old_value :
+                       safe_realloc(old_value, value_size);
     }
     
-    cache->hits++;
-    entry->access_count++;
+    memcpy(entry->value, value, value_size);
+    entry->value_size = value_size;
+    return entry;
+}
+
+static void remove_entry(cache_t* cache, cache_entry_t* entry) {
+    // Remove from hash table
+    index_remove(cache, entry);
     
-    if (cache->policy == EVICTION_LRU) {
-        move_to_head(cache, entry);
+    // Remove from list and expiration index
+    if (cache->sieve_hand == entry) {
+        cache->sieve_hand = entry->prev;
     }
-    
-    if (value) {
-        *value = safe_malloc(entry->value_size);
-        memcpy(*value, entry->value, entry->value_size);
+    if (entry->bucket) {
+        lfu_unlink(cache, entry);
+    } else {
+        remove_from_list(segment_list(cache, entry->segment), entry);
+    }
+    if (entry->expires_at > 0) {
+        wheel_remove(cache, entry);
     }
     
-    if (value_size) {
-        *value_size = entry->value_size;
+    // Free memory
+    if (cache->recycle && !cache->spare) {
+        cache->spare = entry;
+    } else {
+        free_entry(entry);
     }
     
-    pthread_rwlock_unlock(&cache->lock);
-    return SUCCESS;
+    cache->size--;
 }
 
-int cache_delete(cache_t* cache, const char* key) {
-    if (!cache || !key) {
-        return ERROR_INVALID_PARAM;
+// Update recency/frequency bookkeeping for a hit or an overwrite
+static void touch_entry(cache_t* cache, cache_entry_t* entry) {
+    switch (cache->policy) {
+        case EVICTION_LRU:
+            move_to_head(&cache->main, entry);
+            break;
+        case EVICTION_TINYLFU:
+            sketch_record(&cache->sketch, entry->hash);
+            if (entry->segment == SEGMENT_MAIN) {
+                // Probation hit: promote, demoting protected overflow back
+                move_to_segment(cache, entry, SEGMENT_PROTECTED);
+                while (cache->protected_seg.size > cache->protected_max) {
+                    move_to_segment(cache, cache->protected_seg.tail, SEGMENT_MAIN);
+                }
+            } else {
+                move_to_head(segment_list(cache, entry->segment), entry);
+            }
+            break;
+        case EVICTION_LFU:
+            lfu_touch(cache, entry);
+            break;
+        case EVICTION_SIEVE:
+            // Hits never reorder the list, so this is safe under a read lock
+            __atomic_store_n(&entry->visited, 1, __ATOMIC_RELAXED);
+            break;
+        default:
+            break;
     }
+}
+
+// SIEVE: sweep the hand from the tail towards the head, clearing visited bits,
+// and evict the first entry that has not been hit since the hand last passed
+static cache_entry_t* sieve_find_victim(cache_t* cache) {
+    cache_entry_t* hand = cache->sieve_hand ? cache->sieve_hand : cache->main.tail;
     
-    pthread_rwlock_wrlock(&cache->lock);
-    
-    cache_entry_t* entry = find_entry(cache, key);
-    if (!entry) {
-        pthread_rwlock_unlock(&cache->lock);
-        return ERROR_NOT_FOUND;
+    while (hand && __atomic_load_n(&hand->visited, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&hand->visited, 0, __ATOMIC_RELAXED);
+        hand = hand->prev ? hand->prev : cache->main.tail;
     }
     
-    remove_entry(cache, entry);
-    
-    pthread_rwlock_unlock(&cache->lock);
-    return SUCCESS;
+    cache->sieve_hand = hand;
+    return hand;
 }
 
-int cache_exists(cache_t* cache, const char* key) {
-    if (!cache || !key) {
-        return 0;
+static cache_entry_t* find_victim(cache_t* cache) {
+    if (cache->policy == EVICTION_LRU) {
+        return cache->main.tail;  // Least recently used
+    } else if (cache->policy == EVICTION_SIEVE) {
+        return sieve_find_victim(cache);
+    } else {  // EVICTION_LFU
+        // Least recently used entry of the lowest-count run
+        return cache->main.tail;
+    }
+}
+
+static void evict_if_needed(cache_t* cache) {
+    while (cache->size >= cache->max_size) {
+        cache_entry_t* victim = find_victim(cache);
+        if (victim) {
+            remove_entry(cache, victim);
+            cache->evictions++;
+        } else {
+            break;
+        }
+    }
+}
+
+// W-TinyLFU admission: entries overflowing the window compete with the
+// probation LRU victim, and only the more frequently used of the two stays
+static void tinylfu_admit(cache_t* cache) {
+    while (cache->window.size > cache->window_max) {
+        cache_entry_t* candidate = cache->window.tail;
+        move_to_segment(cache, candidate, SEGMENT_MAIN);
+        
+        if (cache->size <= cache->max_size) {
+            continue;
+        }
+        
+        cache_entry_t* victim = cache->main.tail;
+        if (victim == candidate) {
+            victim = cache->protected_seg.tail;
+        }
+        if (!victim || sketch_frequency(&cache->sketch, candidate->hash) <=
+                       sketch_frequency(&cache->sketch, victim->hash)) {
+            victim = candidate;
+        }
+        
+        remove_entry(cache, victim);
+        cache->evictions++;
+    }
+    
+    // Only reachable when the window alone exceeds a tiny capacity
+    while (cache->size > cache->max_size && cache->window.tail) {
+        remove_entry(cache, cache->window.tail);
+        cache->evictions++;
+    }
+}
+
+static void set_expiry(cache_t* cache, cache_entry_t* entry, uint64_t now, uint64_t ttl_ms) {
+    if (entry->expires_at > 0) {
+        wheel_remove(cache, entry);
+    }
+    
+    entry->expires_at = ttl_ms > 0 ? now + ttl_ms : 0;
+    if (entry->expires_at > 0) {
+        wheel_insert(cache, entry);
+    }
+}
+
+// Walk the slots of fully elapsed ticks and free expired entries, examining at
+// most `budget` entries so the write lock is only held for a bounded slice.
+// *caught_up is set once every elapsed tick has been visited.
+static size_t expire_slice(cache_t* cache, size_t budget, bool* caught_up) {
+    uint64_t now = get_timestamp_ms();
+    uint64_t now_tick = now / WHEEL_TICK_MS;
+    size_t expired = 0;
+    
+    // After a long idle period a single revolution covers every slot
+    if (now_tick > cache->wheel_next_tick + WHEEL_SLOTS) {
+        cache->wheel_next_tick = now_tick - WHEEL_SLOTS;
+        cache->wheel_partial = false;
+    }
+    
+    while (cache->wheel_next_tick < now_tick) {
+        cache_entry_t* entry = cache->wheel_partial ?
+            cache->wheel_resume : cache->wheel[cache->wheel_next_tick % WHEEL_SLOTS];
+        
+        while (entry) {
+            if (budget == 0) {
+                cache->wheel_resume = entry;
+                cache->wheel_partial = true;
+                *caught_up = false;
+                return expired;
+            }
+            budget--;
+            
+            cache_entry_t* next = entry->wheel_next;
+            if (entry_expired(entry, now)) {
+                remove_entry(cache, entry);
+                cache->expirations++;
+                expired++;
+            }
+            entry = next;
+        }
+        
+        cache->wheel_partial = false;
+        cache->wheel_resume = NULL;
+        cache->wheel_next_tick++;
+    }
+    
+    *caught_up = true;
+    return expired;
+}
+
+static void* reaper_main(void* arg) {
+    cache_t* cache = (cache_t*)arg;
+    
+    pthread_mutex_lock(&cache->reaper_lock);
+    while (cache->reaper_running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += cache->reaper_interval_ms / 1000;
+        deadline.tv_nsec += (cache->reaper_interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        
+        pthread_cond_timedwait(&cache->reaper_cond, &cache->reaper_lock, &deadline);
+        if (!cache->reaper_running) break;
+        pthread_mutex_unlock(&cache->reaper_lock);
+        
+        // Release the cache lock between slices so requests interleave
+        bool caught_up = false;
+        while (!caught_up) {
+            pthread_rwlock_wrlock(&cache->lock);
+            expire_slice(cache, cache->reaper_slice, &caught_up);
+            pthread_rwlock_unlock(&cache->lock);
+        }
+        
+        pthread_mutex_lock(&cache->reaper_lock);
+    }
+    pthread_mutex_unlock(&cache->reaper_lock);
+    
+    return NULL;
+}
+
+// =============================================================================
+// Snapshots
+// =============================================================================
+//
+// Layout (native byte order):
+//   snapshot_header_t
+//   records, 8-byte aligned: snapshot_record_t, key bytes, value bytes
+//   uint64_t offsets[entry_count]   file offset of each record
+//
+// Records are written per segment from least to most recently used, so
+// re-inserting them at the head of their segment in file order restores the
+// recency order. The offset table lets the loader split records across
+// threads without a sequential parse.
+//
+// Saving copies records a chunk per read lock and writes them with the lock
+// released. The result is fuzzy: an entry touched mid-save may appear twice
+// (the later copy wins on load), and one W-TinyLFU moves into a segment that
+// has already been copied is left out.
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t entry_count;
+    uint64_t file_size;
+} snapshot_header_t;
+
+typedef struct {
+    uint64_t expires_at;
+    uint64_t access_count;
+    uint64_t value_size;
+    uint32_t key_size;        // 0 for the empty key
+    uint8_t segment;
+    uint8_t visited;
+    uint8_t reserved[2];
+} snapshot_record_t;
+
+typedef struct {
+    const uint8_t* base;
+    size_t length;
+    const uint64_t* offsets;
+    size_t begin;
+    size_t end;
+    uint64_t now;
+    cache_entry_t** entries;  // NULL slots: expired or malformed records
+    int status;
+} snapshot_loader_t;
+
+// Records of the chunk being copied plus the offsets of every record so far
+typedef struct {
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+    uint64_t* offsets;
+    size_t count;
+    size_t offsets_capacity;
+    uint64_t position;  // File offset of data[0]
+} snapshot_writer_t;
+
+static void snapshot_copy_record(snapshot_writer_t* writer, const cache_entry_t* entry) {
+    size_t key_size = strlen(entry->key);
+    size_t size = (sizeof(snapshot_record_t) + key_size + entry->value_size + 7) & ~(size_t)7;
+    
+    if (writer->length + size > writer->capacity) {
+        writer->capacity = (writer->length + size) * 2;
+        writer->data = safe_realloc(writer->data, writer->capacity);
+    }
+    if (writer->count == writer->offsets_capacity) {
+        writer->offsets_capacity = writer->offsets_capacity ? writer->offsets_capacity * 2 : 1024;
+        writer->offsets = safe_realloc(writer->offsets,
+                                       writer->offsets_capacity * sizeof(uint64_t));
+    }
+    writer->offsets[writer->count++] = writer->position + writer->length;
+    
+    snapshot_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.expires_at = entry->expires_at;
+    record.access_count = entry->access_count;
+    record.key_size = (uint32_t)key_size;
+    record.value_size = entry->value_size;
+    record.segment = entry->segment;
+    record.visited = __atomic_load_n(&entry->visited, __ATOMIC_RELAXED);
+    
+    uint8_t* out = writer->data + writer->length;
+    memset(out, 0, size);
+    memcpy(out, &record, sizeof(record));
+    memcpy(out + sizeof(record), entry->key, key_size);
+    memcpy(out + sizeof(record) + key_size, entry->value, entry->value_size);
+    writer->length += size;
+}
+
+// Copy records from list->cursor towards the head until the chunk is full.
+// Runs under the read lock; writers that unlink the cursor entry move the
+// cursor on. Returns true once the list has been walked to its head.
+static bool snapshot_copy_chunk(cache_list_t* list, uint64_t now, snapshot_writer_t* writer) {
+    size_t records = 0;
+    
+    while (list->cursor && records < SNAPSHOT_CHUNK_RECORDS &&
+           writer->length < SNAPSHOT_CHUNK_BYTES) {
+        cache_entry_t* entry = list->cursor;
+        list->cursor = entry->prev;
+        if (entry_expired(entry, now)) continue;
+        
+        snapshot_copy_record(writer, entry);
+        records++;
+    }
+    
+    return list->cursor == NULL;
+}
+
+// Materialise one slice of records: allocation, copies and hashing all happen
+// here, off the cache lock and in parallel with the other slices
+static void* snapshot_load_slice(void* arg) {
+    snapshot_loader_t* loader = (snapshot_loader_t*)arg;
+    
+    for (size_t i = loader->begin; i < loader->end; i++) {
+        uint64_t offset = loader->offsets[i];
+        if (offset > loader->length || loader->length - offset < sizeof(snapshot_record_t)) {
+            loader->status = ERROR_IO;
+            return NULL;
+        }
+        
+        snapshot_record_t record;
+        memcpy(&record, loader->base + offset, sizeof(record));
+        uint64_t room = loader->length - offset - sizeof(record);
+        if (record.value_size == 0 || record.value_size > room || record.key_size > room - record.value_size) {
+            loader->status = ERROR_IO;
+            return NULL;
+        }
+        
+        if (record.expires_at > 0 && loader->now > record.expires_at) {
+            continue;
+        }
+        
+        const uint8_t* data = loader->base + offset + sizeof(record);
+        cache_entry_t* entry = safe_calloc(1, sizeof(cache_entry_t));
+        entry->key = safe_malloc(record.key_size + 1);
+        memcpy(entry->key, data, record.key_size);
+        entry->key[record.key_size] = '\0';
+        entry->value = safe_malloc(record.value_size);
+        memcpy(entry->value, data + record.key_size, record.value_size);
+        entry->value_size = record.value_size;
+        entry->hash = hash_key(entry->key);
+        entry->segment = record.segment;
+        entry->visited = record.visited;
+        entry->timestamp = loader->now;
+        entry->expires_at = record.expires_at;
+        entry->access_count = record.access_count;
+        
+        loader->entries[i] = entry;
+    }
+    
+    return NULL;
+}
+
+// Link a fully built entry into the index, its segment and the wheel
+static void link_entry(cache_t* cache, cache_entry_t* entry) {
+    index_insert(cache, entry);
+    
+    if (cache->policy == EVICTION_LFU) {
+        // Records arrive in ascending count order, so the search is short
+        lfu_bucket_t* below = cache->main.head ? cache->main.head->bucket : NULL;
+        while (below && below->count >= entry->access_count) {
+            below = below->lower;
+        }
+        lfu_link(cache, entry, below);
+    } else {
+        add_to_head(segment_list(cache, entry->segment), entry);
+    }
+    if (entry->expires_at > 0) {
+        wheel_insert(cache, entry);
+    }
+    
+    cache->size++;
+}
+
+static void tinylfu_set_capacity(cache_t* cache, size_t max_size) {
+    cache->window_max = max_size * TINYLFU_WINDOW_PERCENT / 100;
+    if (cache->window_max == 0) {
+        cache->window_max = 1;
+    }
+    size_t main_max = max_size > cache->window_max ? max_size - cache->window_max : 0;
+    cache->protected_max = main_max * TINYLFU_PROTECTED_PERCENT / 100;
+}
+
+// Bring segment sizes and the entry count back within limits after a bulk load
+// or a capacity change
+static void rebalance_after_load(cache_t* cache) {
+    if (cache->policy == EVICTION_TINYLFU) {
+        while (cache->window.size > cache->window_max) {
+            move_to_segment(cache, cache->window.tail, SEGMENT_MAIN);
+        }
+        while (cache->protected_seg.size > cache->protected_max) {
+            move_to_segment(cache, cache->protected_seg.tail, SEGMENT_MAIN);
+        }
+        while (cache->size > cache->max_size && cache->main.tail) {
+            remove_entry(cache, cache->main.tail);
+            cache->evictions++;
+        }
+        return;
+    }
+    
+    while (cache->size > cache->max_size) {
+        cache_entry_t* victim = find_victim(cache);
+        if (!victim) break;
+        remove_entry(cache, victim);
+        cache->evictions++;
+    }
+}
+
+cache_t* cache_create(size_t max_size, eviction_policy_t policy) {
+    cache_t* cache = safe_calloc(1, sizeof(cache_t));
+    cache->max_size = max_size;
+    cache->policy = policy;
+    index_init(&cache->index[0], INDEX_MIN_BUCKETS);
+    cache->rehash_index = -1;
+    
+    if (policy == EVICTION_TINYLFU) {
+        tinylfu_set_capacity(cache, max_size);
+        sketch_init(&cache->sketch, max_size);
+    }
+    
+    cache->wheel_next_tick = get_timestamp_ms() / WHEEL_TICK_MS;
+    
+    pthread_rwlock_init(&cache->lock, NULL);
+    pthread_mutex_init(&cache->reaper_lock, NULL);
+    pthread_mutex_init(&cache->snapshot_lock, NULL);
+    pthread_cond_init(&cache->reaper_cond, NULL);
+    return cache;
+}
+
+void cache_destroy(cache_t* cache) {
+    if (!cache) return;
+    
+    if (cache->reaper_running) {
+        cache_stop_reaper(cache);
+    }
+    
+    cache_clear(cache);
+    
+    sketch_destroy(&cache->sketch);
+    index_reset(&cache->index[0]);
+    index_reset(&cache->index[1]);
+    pthread_rwlock_destroy(&cache->lock);
+    pthread_mutex_destroy(&cache->reaper_lock);
+    pthread_mutex_destroy(&cache->snapshot_lock);
+    pthread_cond_destroy(&cache->reaper_cond);
+    safe_free((void**)&cache);
+}
+
+int cache_put(cache_t* cache, const char* key, const void* value, size_t value_size) {
+    return cache_put_with_ttl(cache, key, value, value_size, 0);
+}
+
+// Insert a key known to be absent under the write lock
+static void insert_locked(cache_t* cache, const char* key, uint32_t hash, const void* value,
+                          size_t value_size, uint64_t ttl_ms, uint64_t now) {
+    // Evict if needed (W-TinyLFU decides after the new entry joins the window)
+    if (cache->policy != EVICTION_TINYLFU) {
+        evict_if_needed(cache);
+    }
+    
+    // Create new entry
+    cache_entry_t* entry = alloc_entry(cache, key, value, value_size);
+    entry->hash = hash;
+    entry->timestamp = now;
+    entry->access_count = 0;
+    set_expiry(cache, entry, now, ttl_ms);
+    
+    // Add to hash table
+    index_insert(cache, entry);
+    
+    cache->size++;
+    
+    // Add to list
+    if (cache->policy == EVICTION_TINYLFU) {
+        sketch_record(&cache->sketch, hash);
+        entry->segment = SEGMENT_WINDOW;
+        add_to_head(&cache->window, entry);
+        tinylfu_admit(cache);
+    } else if (cache->policy == EVICTION_LFU) {
+        entry->segment = SEGMENT_MAIN;
+        lfu_link(cache, entry, NULL);
+    } else {
+        entry->segment = SEGMENT_MAIN;
+        add_to_head(&cache->main, entry);
+    }
+}
+
+// Insert or overwrite under the write lock
+static void put_locked(cache_t* cache, const char* key, uint32_t hash, const void* value,
+                       size_t value_size, uint64_t ttl_ms, uint64_t now) {
+    // Check if key exists (an expired entry is reused rather than duplicated)
+    cache_entry_t* existing = find_entry(cache, key, hash);
+    if (existing) {
+        // Update existing entry
+        safe_free((void**)&existing->value);
+        existing->value = safe_malloc(value_size);
+        memcpy(existing->value, value, value_size);
+        existing->value_size = value_size;
+        existing->timestamp = now;
+        set_expiry(cache, existing, now, ttl_ms);
+        
+        touch_entry(cache, existing);
+        return;
+    }
+    
+    insert_locked(cache, key, hash, value, value_size, ttl_ms, now);
+}
+
+int cache_put_with_ttl(cache_t* cache, const char* key, const void* value,
+                       size_t value_size, uint64_t ttl_ms) {
+    if (!cache || !key || !value || value_size == 0) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    uint32_t hash = hash_key(key);
+    
+    pthread_rwlock_wrlock(&cache->lock);
+    put_locked(cache, key, hash, value, value_size, ttl_ms, get_timestamp_ms());
+    pthread_rwlock_unlock(&cache->lock);
+    
+    return SUCCESS;
+}
+
+// Read path for policies whose hits do not mutate shared structure: runs under
+// the read lock so concurrent readers proceed in parallel. Expired entries are
+// reported as misses and left for the reaper or the next writer.
+static int get_shared_locked(cache_t* cache, const char* key, uint32_t hash,
+                             void** value, size_t* value_size) {
+    cache_entry_t* entry = find_live_entry(cache, key, hash);
+    if (!entry) {
+        __atomic_fetch_add(&cache->misses, 1, __ATOMIC_RELAXED);
+        return ERROR_NOT_FOUND;
+    }
+    
+    __atomic_fetch_add(&cache->hits, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&entry->access_count, 1, __ATOMIC_RELAXED);
+    
+    touch_entry(cache, entry);
+    
+    if (value) {
+        *value = safe_malloc(entry->value_size);
+        memcpy(*value, entry->value, entry->value_size);
+    }
+    
+    if (value_size) {
+        *value_size = entry->value_size;
     }
     
+    return SUCCESS;
+}
+
+// Read path for every other policy: hits reorder lists, so it runs under the
+// write lock and also frees an expired entry it runs into
+static int get_exclusive_locked(cache_t* cache, const char* key, uint32_t hash,
+                                void** value, size_t* value_size) {
+    index_rehash_step(cache, INDEX_REHASH_STEP);
+    
+    cache_entry_t* entry = find_entry(cache, key, hash);
+    if (entry && entry_expired(entry, get_timestamp_ms())) {
+        remove_entry(cache, entry);
+        cache->expirations++;
+        entry = NULL;
+    }
+    
+    if (!entry) {
+        __atomic_fetch_add(&cache->misses, 1, __ATOMIC_RELAXED);
+        if (cache->policy == EVICTION_TINYLFU) {
+            // Misses count towards popularity so a returning key can be admitted
+            sketch_record(&cache->sketch, hash);
+        }
+        return ERROR_NOT_FOUND;
+    }
+    
+    __atomic_fetch_add(&cache->hits, 1, __ATOMIC_RELAXED);
+    entry->access_count++;
+    
+    touch_entry(cache, entry);
+    
+    if (value) {
+        *value = safe_malloc(entry->value_size);
+        memcpy(*value, entry->value, entry->value_size);
+    }
+    
+    if (value_size) {
+        *value_size = entry->value_size;
+    }
+    
+    return SUCCESS;
+}
+
+// SIEVE hits never reorder lists, so reads share the lock
+static bool reads_are_shared(const cache_t* cache) {
+    return cache->policy == EVICTION_SIEVE;
+}
+
+int cache_get(cache_t* cache, const char* key, void** value, size_t* value_size) {
+    if (!cache || !key) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    uint32_t hash = hash_key(key);
+    int result;
+    
+    if (reads_are_shared(cache)) {
+        pthread_rwlock_rdlock(&cache->lock);
+        result = get_shared_locked(cache, key, hash, value, value_size);
+    } else {
+        pthread_rwlock_wrlock(&cache->lock);
+        result = get_exclusive_locked(cache, key, hash, value, value_size);
+    }
+    pthread_rwlock_unlock(&cache->lock);
+    
+    return result;
+}
+
+bool cache_replay_access(cache_t* cache, const char* key) {
+    uint32_t hash = hash_key(key);
+    
+    pthread_rwlock_wrlock(&cache->lock);
+    cache->recycle = true;
+    index_rehash_step(cache, INDEX_REHASH_STEP);
+    
+    cache_entry_t* entry = find_entry(cache, key, hash);
+    if (entry && entry->expires_at > 0 && entry_expired(entry, get_timestamp_ms())) {
+        remove_entry(cache, entry);
+        cache->expirations++;
+        entry = NULL;
+    }
+    
+    bool hit = entry != NULL;
+    if (hit) {
+        cache->hits++;
+        entry->access_count++;
+        touch_entry(cache, entry);
+    } else {
+        // Same bookkeeping as a cache_get miss followed by a cache_put
+        cache->misses++;
+        if (cache->policy == EVICTION_TINYLFU) {
+            sketch_record(&cache->sketch, hash);
+        }
+        insert_locked(cache, key, hash, "", 1, 0, 0);
+    }
+    
+    cache->recycle = false;
+    pthread_rwlock_unlock(&cache->lock);
+    return hit;
+}
+
+// =============================================================================
+// Batch operations
+// =============================================================================
+
+// Software pipeline for a batch probe: while key i is being probed, the bucket
+// slot of key i + BATCH_PREFETCH_BUCKET and the chain head of key
+// i + BATCH_PREFETCH_ENTRY are already on their way into the CPU cache.
+// Only a hint; a resize started mid-batch merely makes some prefetches useless.
+static void batch_prefetch(const cache_t* cache, const uint32_t* hashes, size_t count, size_t i) {
+    for (int t = 0; t < 2; t++) {
+        const cache_index_t* index = &cache->index[t];
+        if (index->size == 0) break;
+        
+        if (i + BATCH_PREFETCH_BUCKET < count) {
+            __builtin_prefetch(&index->buckets[hashes[i + BATCH_PREFETCH_BUCKET] & index->mask]);
+        }
+        if (i + BATCH_PREFETCH_ENTRY < count) {
+            const cache_entry_t* head = index->buckets[hashes[i + BATCH_PREFETCH_ENTRY] & index->mask];
+            if (head) __builtin_prefetch(head);
+        }
+    }
+}
+
+// Prime the pipeline: the first keys get both prefetches before any probe
+static void batch_prefetch_start(const cache_t* cache, const uint32_t* hashes, size_t count) {
+    for (int t = 0; t < 2; t++) {
+        const cache_index_t* index = &cache->index[t];
+        if (index->size == 0) break;
+        
+        for (size_t i = 0; i < count && i < BATCH_PREFETCH_BUCKET; i++) {
+            __builtin_prefetch(&index->buckets[hashes[i] & index->mask]);
+        }
+        for (size_t i = 0; i < count && i < BATCH_PREFETCH_ENTRY; i++) {
+            const cache_entry_t* head = index->buckets[hashes[i] & index->mask];
+            if (head) __builtin_prefetch(head);
+        }
+    }
+}
+
+static uint32_t* batch_hash(const char* const* keys, size_t count, uint32_t* stack_hashes) {
+    uint32_t* hashes = count <= BATCH_STACK_KEYS ? stack_hashes
+                                                 : safe_malloc(count * sizeof(uint32_t));
+    for (size_t i = 0; i < count; i++) {
+        hashes[i] = hash_key(keys[i]);
+    }
+    return hashes;
+}
+
+int cache_mget(cache_t* cache, const char* const* keys, size_t count,
+               void** values, size_t* value_sizes) {
+    if (!cache || (!keys && count > 0)) {
+        return ERROR_INVALID_PARAM;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!keys[i]) return ERROR_INVALID_PARAM;
+    }
+    
+    // Hash outside the lock
+    uint32_t stack_hashes[BATCH_STACK_KEYS];
+    uint32_t* hashes = batch_hash(keys, count, stack_hashes);
+    bool shared = reads_are_shared(cache);
+    
+    if (shared) {
+        pthread_rwlock_rdlock(&cache->lock);
+    } else {
+        pthread_rwlock_wrlock(&cache->lock);
+    }
+    
+    batch_prefetch_start(cache, hashes, count);
+    for (size_t i = 0; i < count; i++) {
+        batch_prefetch(cache, hashes, count, i);
+        
+        void** value = values ? &values[i] : NULL;
+        size_t* value_size = value_sizes ? &value_sizes[i] : NULL;
+        int result = shared ? get_shared_locked(cache, keys[i], hashes[i], value, value_size)
+                            : get_exclusive_locked(cache, keys[i], hashes[i], value, value_size);
+        if (result != SUCCESS) {
+            if (value) *value = NULL;
+            if (value_size) *value_size = 0;
+        }
+    }
+    
+    pthread_rwlock_unlock(&cache->lock);
+    
+    if (hashes != stack_hashes) {
+        safe_free((void**)&hashes);
+    }
+    return SUCCESS;
+}
+
+int cache_mput(cache_t* cache, const char* const* keys, size_t count,
+               const void* const* values, const size_t* value_sizes, uint64_t ttl_ms) {
+    if (!cache || (count > 0 && (!keys || !values || !value_sizes))) {
+        return ERROR_INVALID_PARAM;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!keys[i] || !values[i] || value_sizes[i] == 0) return ERROR_INVALID_PARAM;
+    }
+    
+    uint32_t stack_hashes[BATCH_STACK_KEYS];
+    uint32_t* hashes = batch_hash(keys, count, stack_hashes);
+    
+    pthread_rwlock_wrlock(&cache->lock);
+    
+    uint64_t now = get_timestamp_ms();
+    batch_prefetch_start(cache, hashes, count);
+    for (size_t i = 0; i < count; i++) {
+        batch_prefetch(cache, hashes, count, i);
+        put_locked(cache, keys[i], hashes[i], values[i], value_sizes[i], ttl_ms, now);
+    }
+    
+    pthread_rwlock_unlock(&cache->lock);
+    
+    if (hashes != stack_hashes) {
+        safe_free((void**)&hashes);
+    }
+    return SUCCESS;
+}
+
+int cache_delete(cache_t* cache, const char* key) {
+    if (!cache || !key) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    uint32_t hash = hash_key(key);
+    
+    pthread_rwlock_wrlock(&cache->lock);
+    
+    cache_entry_t* entry = find_entry(cache, key, hash);
+    if (!entry) {
+        pthread_rwlock_unlock(&cache->lock);
+        return ERROR_NOT_FOUND;
+    }
+    
+    int result = SUCCESS;
+    if (entry_expired(entry, get_timestamp_ms())) {
+        cache->expirations++;
+        result = ERROR_NOT_FOUND;
+    }
+    remove_entry(cache, entry);
+    
+    pthread_rwlock_unlock(&cache->lock);
+    return result;
+}
+
+int cache_exists(cache_t* cache, const char* key) {
+    if (!cache || !key) {
+        return 0;
+    }
+    
+    uint32_t hash = hash_key(key);
+    
     pthread_rwlock_rdlock(&cache->lock);
-    cache_entry_t* entry = find_entry(cache, key);
+    cache_entry_t* entry = find_live_entry(cache, key, hash);
     pthread_rwlock_unlock(&cache->lock);
     
     return entry != NULL;
@@ -309,23 +1497,55 @@ void cache_clear(cache_t* cache) {
     
     pthread_rwlock_wrlock(&cache->lock);
     
-    cache_entry_t* current = cache->head;
-    while (current) {
-        cache_entry_t* next = current->next;
-        safe_free((void**)&current->key);
-        safe_free((void**)&current->value);
-        safe_free((void**)&current);
-        current = next;
+    if (cache->policy == EVICTION_LFU) {
+        lfu_free_buckets(cache);
     }
+    free_list(&cache->main);
+    free_list(&cache->window);
+    free_list(&cache->protected_seg);
     
-    memset(cache->hash_table, 0, cache->hash_size * sizeof(cache_entry_t*));
-    cache->head = NULL;
-    cache->tail = NULL;
+    index_reset(&cache->index[0]);
+    index_reset(&cache->index[1]);
+    index_init(&cache->index[0], INDEX_MIN_BUCKETS);
+    cache->rehash_index = -1;
+    memset(cache->wheel, 0, sizeof(cache->wheel));
+    cache->wheel_resume = NULL;
+    cache->wheel_partial = false;
+    cache->sieve_hand = NULL;
+    if (cache->spare) {
+        free_entry(cache->spare);
+        cache->spare = NULL;
+    }
     cache->size = 0;
     
     pthread_rwlock_unlock(&cache->lock);
 }
 
+int cache_set_max_size(cache_t* cache, size_t max_size) {
+    if (!cache || max_size == 0) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    pthread_rwlock_wrlock(&cache->lock);
+    
+    cache->max_size = max_size;
+    if (cache->policy == EVICTION_TINYLFU) {
+        tinylfu_set_capacity(cache, max_size);
+        // A wider sketch is needed to keep the error rate down when growing;
+        // shrinking keeps the existing one and its frequency history
+        if (next_power_of_two(max_size < 16 ? 16 : max_size) > cache->sketch.width) {
+            sketch_destroy(&cache->sketch);
+            sketch_init(&cache->sketch, max_size);
+        }
+    }
+    
+    // The index follows the entry count on its own; only overflow needs evicting
+    rebalance_after_load(cache);
+    
+    pthread_rwlock_unlock(&cache->lock);
+    return SUCCESS;
+}
+
 int cache_get_stats(cache_t* cache, cache_stats_t* stats) {
     if (!cache || !stats) {
         return ERROR_INVALID_PARAM;
@@ -335,11 +1555,258 @@ int cache_get_stats(cache_t* cache, cache_stats_t* stats) {
     
     stats->size = cache->size;
     stats->max_size = cache->max_size;
-    stats->hits = cache->hits;
-    stats->misses = cache->misses;
+    stats->hits = __atomic_load_n(&cache->hits, __ATOMIC_RELAXED);
+    stats->misses = __atomic_load_n(&cache->misses, __ATOMIC_RELAXED);
     stats->evictions = cache->evictions;
+    stats->expirations = cache->expirations;
+    
+    pthread_rwlock_unlock(&cache->lock);
+    
+    return SUCCESS;
+}
+
+size_t cache_expire(cache_t* cache, size_t max_entries) {
+    if (!cache) return 0;
+    
+    bool caught_up;
+    pthread_rwlock_wrlock(&cache->lock);
+    size_t expired = expire_slice(cache, max_entries > 0 ? max_entries : SIZE_MAX, &caught_up);
+    pthread_rwlock_unlock(&cache->lock);
+    
+    return expired;
+}
+
+int cache_start_reaper(cache_t* cache, uint64_t interval_ms, size_t slice_entries) {
+    if (!cache || interval_ms == 0) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    pthread_mutex_lock(&cache->reaper_lock);
+    if (cache->reaper_running) {
+        pthread_mutex_unlock(&cache->reaper_lock);
+        return ERROR_ALREADY_EXISTS;
+    }
+    
+    cache->reaper_interval_ms = interval_ms;
+    cache->reaper_slice = slice_entries > 0 ? slice_entries : REAPER_DEFAULT_SLICE;
+    cache->reaper_running = 1;
+    
+    if (pthread_create(&cache->reaper_thread, NULL, reaper_main, cache) != 0) {
+        cache->reaper_running = 0;
+        pthread_mutex_unlock(&cache->reaper_lock);
+        return ERROR_MEMORY;
+    }
+    
+    pthread_mutex_unlock(&cache->reaper_lock);
+    return SUCCESS;
+}
+
+int cache_stop_reaper(cache_t* cache) {
+    if (!cache) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    pthread_mutex_lock(&cache->reaper_lock);
+    if (!cache->reaper_running) {
+        pthread_mutex_unlock(&cache->reaper_lock);
+        return ERROR_INVALID_PARAM;
+    }
+    cache->reaper_running = 0;
+    pthread_cond_signal(&cache->reaper_cond);
+    pthread_mutex_unlock(&cache->reaper_lock);
+    
+    pthread_join(cache->reaper_thread, NULL);
+    return SUCCESS;
+}
+
+int cache_snapshot_save(cache_t* cache, const char* path) {
+    if (!cache || !path) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    
+    FILE* file = fopen(tmp_path, "wb");
+    if (!file) {
+        return ERROR_IO;
+    }
+    setvbuf(file, NULL, _IOFBF, 1 << 20);
+    
+    // The header is rewritten with the final count once the records are out
+    snapshot_header_t header = {
+        .magic = SNAPSHOT_MAGIC,
+        .version = SNAPSHOT_VERSION
+    };
+    int result = fwrite(&header, sizeof(header), 1, file) == 1 ? SUCCESS : ERROR_IO;
+    
+    uint64_t now = get_timestamp_ms();
+    cache_list_t* lists[3] = { &cache->main, &cache->window, &cache->protected_seg };
+    snapshot_writer_t writer = { .position = sizeof(header) };
+    
+    pthread_mutex_lock(&cache->snapshot_lock);
+    for (int i = 0; i < 3 && result == SUCCESS; i++) {
+        bool started = false;
+        bool done = false;
+        while (!done && result == SUCCESS) {
+            pthread_rwlock_rdlock(&cache->lock);
+            if (!started) {
+                lists[i]->cursor = lists[i]->tail;
+                started = true;
+            }
+            done = snapshot_copy_chunk(lists[i], now, &writer);
+            pthread_rwlock_unlock(&cache->lock);
+            
+            if (writer.length > 0 &&
+                fwrite(writer.data, 1, writer.length, file) != writer.length) {
+                result = ERROR_IO;
+            }
+            writer.position += writer.length;
+            writer.length = 0;
+        }
+    }
+    
+    // A failed write can stop part-way through a list
+    pthread_rwlock_rdlock(&cache->lock);
+    for (int i = 0; i < 3; i++) {
+        lists[i]->cursor = NULL;
+    }
+    pthread_rwlock_unlock(&cache->lock);
+    pthread_mutex_unlock(&cache->snapshot_lock);
+    
+    header.entry_count = writer.count;
+    header.file_size = writer.position + writer.count * sizeof(uint64_t);
+    if (result == SUCCESS &&
+        ((writer.count > 0 &&
+          fwrite(writer.offsets, sizeof(uint64_t), writer.count, file) != writer.count) ||
+         fseek(file, 0, SEEK_SET) != 0 ||
+         fwrite(&header, sizeof(header), 1, file) != 1)) {
+        result = ERROR_IO;
+    }
+    safe_free((void**)&writer.data);
+    safe_free((void**)&writer.offsets);
+    
+    if (fflush(file) != 0 || fsync(fileno(file)) != 0) {
+        result = ERROR_IO;
+    }
+    fclose(file);
+    
+    if (result != SUCCESS || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return ERROR_IO;
+    }
+    
+    return SUCCESS;
+}
+
+int cache_snapshot_load(cache_t* cache, const char* path) {
+    if (!cache || !path) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return ERROR_NOT_FOUND;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(snapshot_header_t)) {
+        close(fd);
+        return ERROR_IO;
+    }
+    
+    size_t length = (size_t)st.st_size;
+    uint8_t* base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return ERROR_IO;
+    }
+    posix_madvise(base, length, POSIX_MADV_WILLNEED);
+    
+    snapshot_header_t header;
+    memcpy(&header, base, sizeof(header));
+    if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION ||
+        header.file_size != length ||
+        header.entry_count > (length - sizeof(header)) / sizeof(uint64_t)) {
+        munmap(base, length);
+        return ERROR_IO;
+    }
+    
+    size_t count = header.entry_count;
+    size_t records_end = length - count * sizeof(uint64_t);
+    cache_entry_t** entries = safe_calloc(count > 0 ? count : 1, sizeof(cache_entry_t*));
+    
+    // Parallel phase: materialise entries in contiguous slices
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t threads = count / SNAPSHOT_MIN_SLICE;
+    if (threads > (size_t)(cpus > 0 ? cpus : 1)) threads = (size_t)(cpus > 0 ? cpus : 1);
+    if (threads > SNAPSHOT_MAX_THREADS) threads = SNAPSHOT_MAX_THREADS;
+    if (threads == 0) threads = 1;
+    
+    snapshot_loader_t loaders[SNAPSHOT_MAX_THREADS];
+    pthread_t tids[SNAPSHOT_MAX_THREADS];
+    bool spawned[SNAPSHOT_MAX_THREADS] = { false };
+    uint64_t now = get_timestamp_ms();
+    size_t chunk = (count + threads - 1) / threads;
+    
+    for (size_t t = 0; t < threads; t++) {
+        loaders[t] = (snapshot_loader_t){
+            .base = base,
+            .length = records_end,
+            .offsets = (const uint64_t*)(base + records_end),
+            .begin = t * chunk < count ? t * chunk : count,
+            .end = (t + 1) * chunk < count ? (t + 1) * chunk : count,
+            .now = now,
+            .entries = entries,
+            .status = SUCCESS
+        };
+        // Slice 0 (and any slice whose thread fails to start) runs inline
+        spawned[t] = t > 0 &&
+                     pthread_create(&tids[t], NULL, snapshot_load_slice, &loaders[t]) == 0;
+    }
+    for (size_t t = 0; t < threads; t++) {
+        if (!spawned[t]) snapshot_load_slice(&loaders[t]);
+    }
+    
+    int result = SUCCESS;
+    for (size_t t = 0; t < threads; t++) {
+        if (spawned[t]) pthread_join(tids[t], NULL);
+        if (loaders[t].status != SUCCESS) result = loaders[t].status;
+    }
+    munmap(base, length);
+    
+    if (result != SUCCESS) {
+        for (size_t i = 0; i < count; i++) {
+            if (entries[i]) free_entry(entries[i]);
+        }
+        safe_free((void**)&entries);
+        return result;
+    }
+    
+    // Serial phase: pointer linking only, in file (recency) order
+    pthread_rwlock_wrlock(&cache->lock);
+    
+    for (size_t i = 0; i < count; i++) {
+        cache_entry_t* entry = entries[i];
+        if (!entry) continue;
+        
+        cache_entry_t* existing = find_entry(cache, entry->key, entry->hash);
+        if (existing) {
+            remove_entry(cache, existing);
+        }
+        
+        if (cache->policy == EVICTION_TINYLFU) {
+            sketch_record(&cache->sketch, entry->hash);
+        } else {
+            entry->segment = SEGMENT_MAIN;
+        }
+        link_entry(cache, entry);
+    }
+    
+    rebalance_after_load(cache);
     
     pthread_rwlock_unlock(&cache->lock);
     
+    safe_free((void**)&entries);
     return SUCCESS;
 }
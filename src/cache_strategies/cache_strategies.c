@@ -1,151 +1,3221 @@
+#define _POSIX_C_SOURCE 200809L
 #include "cache_strategies.h"
+#include "concurrency.h"
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fnmatch.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
 
-// Stub implementations - all functions return SUCCESS or dummy values
+// In-memory store: the key space is split over up to CACHE_MAX_SHARDS shards,
+// each with its own mutex, chained hash table and recency list, so unrelated
+// keys never contend. Small caches use fewer shards so that eviction order
+// stays close to the global policy.
+#define CACHE_MAX_SHARDS 16
+#define CACHE_MIN_ENTRIES_PER_SHARD 256
+#define CACHE_SHARD_MIN_BUCKETS 16
+
+// Entries examined from the cold end of a shard for LFU eviction
+#define CACHE_EVICTION_SAMPLES 5
+
+// How long cache_get_with_lock waits for another caller's load by default
+#define CACHE_DEFAULT_LOCK_TIMEOUT_MS 5000
+
+// XFetch beta when early_expiration_factor is left at 0
+#define XFETCH_DEFAULT_BETA 1.0
+
+// Write-behind defaults for settings left at 0
+#define WRITE_BEHIND_DEFAULT_BATCH 64
+#define WRITE_BEHIND_DEFAULT_INTERVAL_MS 100
+#define WRITE_BEHIND_DEFAULT_RETRIES 3
+#define WRITE_BEHIND_DEFAULT_BACKOFF_MS 10
+
+// Tag and pattern invalidation remove at most this many keys per shard lock
+// hold, and glob matching visits at most INVALIDATE_SCAN trie nodes per hold
+#define INVALIDATE_BATCH 256
+#define INVALIDATE_SCAN 4096
+
+// Threads scanning shards for globs without a literal prefix
+#define PATTERN_SCAN_THREADS 4
+
+// Values compressed by default when enable_compression is set, and the
+// saving below which a value is kept raw (compressed size must be at most
+// 1 - 1/COMPRESSION_MIN_SAVING of the original)
+#define COMPRESSION_DEFAULT_THRESHOLD 1024
+#define COMPRESSION_MIN_SAVING 8
+
+#define BYTES_PER_MB (1024.0 * 1024.0)
+
+// Key changes remembered for near caches; an L1 that falls further behind
+// drops all its entries
+#define INVALIDATION_LOG_SIZE 4096
+
+struct cache_entry {
+    char* key;
+    void* value;
+    size_t value_size;        // Bytes stored, compressed or not
+    size_t raw_size;          // Size as set and returned
+    bool compressed;
+    size_t charge;            // Bytes accounted against max_memory_mb
+    uint32_t hash;
+    uint64_t created_at;
+    uint64_t last_access;
+    uint64_t ttl_ms;          // 0 = no TTL
+    uint64_t expires_at;
+    uint64_t access_count;
+    uint64_t recompute_us;    // Duration of the load that produced the value
+    struct trie_node* trie_node;
+    struct tag_link* tags;    // One membership per tag
+    uint32_t tag_count;
+    struct cache_entry* prev; // Shard recency list, head = most recent
+    struct cache_entry* next;
+    struct cache_entry* hash_next;
+};
+
+// Path-compressed trie over a shard's keys, so prefix patterns visit only
+// the matching keys. A node ends a key when entry is set. Siblings are kept
+// in order of their first label byte, so a pre-order walk visits keys in
+// sorted order and can resume after any key. Built on the first pattern
+// invalidation, so caches that never use patterns don't pay for it.
+typedef struct trie_node {
+    cache_entry_t* entry;
+    struct trie_node* parent;
+    struct trie_node* children;
+    struct trie_node* sibling;
+    size_t label_len;
+    char label[];             // Edge from the parent, not NUL-terminated
+} trie_node_t;
+
+// Reverse index from a tag to the shard's live keys carrying it
+typedef struct tag_link {
+    struct tag_node* tag;
+    cache_entry_t* entry;
+    struct tag_link* prev;
+    struct tag_link* next;
+} tag_link_t;
+
+typedef struct tag_node {
+    char* name;
+    uint32_t hash;
+    tag_link_t* members;
+    size_t member_count;
+    struct tag_node* hash_next;
+} tag_node_t;
+
+// A load or explicit key lock in progress. Callers that miss on a key with a
+// flight attached wait for it instead of going to the backend themselves.
+// The flight is freed by whoever drops the last reference after it is done.
+typedef struct flight {
+    char* key;
+    uint32_t hash;
+    pthread_cond_t cond;
+    bool done;
+    bool has_value;           // False for explicit locks: waiters re-check the cache
+    int status;
+    void* value;
+    size_t value_size;
+    size_t waiters;
+    struct flight* next;
+} flight_t;
+
+// Ring of recently changed key hashes, published by the shards once a near
+// cache is attached. Slots are written seqlock-style: seq is cleared, the
+// payload stored, then seq set to the slot's sequence number + 1, so a reader
+// can tell a valid slot from one not yet written or already reused.
+typedef struct {
+    uint64_t seq;
+    uint32_t hash;
+    uint64_t published_ns;
+} invalidation_t;
+
+typedef struct {
+    uint64_t head;            // Next sequence number
+    invalidation_t slots[INVALIDATION_LOG_SIZE];
+} invalidation_log_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    cache_entry_t** buckets;
+    size_t bucket_count;      // Power of two
+    cache_entry_t* head;
+    cache_entry_t* tail;
+    size_t size;
+    size_t max_size;          // 0 = unbounded
+    size_t memory_used;
+    size_t max_memory;        // 0 = unbounded
+    flight_t* flights;
+    uint64_t rng;
+    trie_node_t* trie;        // Root, labelled ""; NULL until first needed
+    tag_node_t** tag_buckets; // Allocated with the first tag
+    size_t tag_bucket_count;
+    size_t tag_count;
+    invalidation_log_t* invalidations; // Set once a near cache is attached
+    
+    // Statistics
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t sets;
+    uint64_t deletes;
+    uint64_t evictions;
+    uint64_t expirations;
+    uint64_t early_refreshes;
+    uint64_t ttl_total_ms;    // Sum of TTLs of live entries that have one
+    uint64_t compressed_count;    // Live compressed entries
+    uint64_t compression_saved;   // Their raw minus stored bytes
+    uint64_t compression_skipped;
+    uint64_t compression_ns;
+    uint64_t decompression_ns;
+    uint64_t ttl_entries;
+} cache_shard_t;
+
+// Background reload queued by STAMPEDE_PRECOMPUTE. The job owns the key's
+// flight until the reload completes.
+typedef struct refresh_job {
+    cache_shard_t* shard;
+    flight_t* flight;
+    cache_loader_fn loader;
+    void* ctx;
+    struct refresh_job* next;
+} refresh_job_t;
+
+typedef struct resp_pool resp_pool_t;
+typedef struct op_histogram op_histogram_t;
+
+struct cache_instance {
+    cache_config_t config;
+    cache_shard_t* shards;
+    size_t shard_count;
+    uint32_t shard_bits;
+    stampede_config_t stampede;
+    bool connected;
+    resp_pool_t* remote;      // CACHE_TYPE_REDIS connections while connected
+    invalidation_log_t* invalidations;
+    
+    // Refresh-ahead worker
+    pthread_t refresher;
+    pthread_mutex_t refresh_lock;
+    pthread_cond_t refresh_cond;
+    refresh_job_t* refresh_head;
+    refresh_job_t* refresh_tail;
+    bool refresher_running;
+    bool refresher_stop;
+    
+    // Per-operation latency histograms, one set per thread
+    bool op_timing;
+    bool op_key_created;
+    pthread_key_t op_key;
+    pthread_mutex_t op_lock;
+    op_histogram_t* op_threads;
+    op_histogram_t* op_retired;   // Counts from threads that have exited
+    uint64_t op_generation;       // Bumped by cache_reset_stats
+};
+
+struct cache_lock {
+    cache_shard_t* shard;
+    flight_t* flight;
+};
+
+// A key waiting to be written back. Later writes to the key replace the value
+// in place until the flusher detaches the entry.
+typedef struct wb_write {
+    char* key;
+    uint32_t hash;
+    void* value;
+    size_t value_size;
+    uint64_t queued_at;       // First unflushed write to the key
+    struct wb_write* next;    // Queue order
+    struct wb_write* hash_next;
+} wb_write_t;
+
+struct write_behind_cache {
+    cache_instance_t* cache;
+    cache_writer_fn writer;
+    void* writer_ctx;
+    write_behind_config_t config;
+    
+    pthread_mutex_t lock;
+    pthread_cond_t work;      // Flusher: batch ready, flush requested or stop
+    pthread_cond_t space;     // Writers: queue below queue_size
+    pthread_cond_t idle;      // write_behind_flush: nothing pending or in flight
+    wb_write_t** buckets;
+    size_t bucket_count;
+    wb_write_t* head;
+    wb_write_t* tail;
+    size_t pending;
+    size_t in_flight;
+    int flush_waiters;
+    bool stop;
+    pthread_t flusher;
+    
+    write_behind_stats_t stats;
+    uint64_t lag_total_ms;
+};
+
+// =============================================================================
+// Store internals
+// =============================================================================
+
+// FNV-1a
+static uint32_t hash_key(const char* key) {
+    uint32_t hash = 2166136261u;
+    while (*key) {
+        hash ^= (uint8_t)*key++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Fibonacci hashing picks the shard from bits independent of the bucket index
+static cache_shard_t* shard_for(cache_instance_t* cache, uint32_t hash) {
+    if (cache->shard_bits == 0) {
+        return &cache->shards[0];
+    }
+    return &cache->shards[(uint32_t)(hash * 2654435769u) >> (32 - cache->shard_bits)];
+}
+
+static bool entry_expired(const cache_entry_t* entry, uint64_t now) {
+    return entry->ttl_ms > 0 && now >= entry->expires_at;
+}
+
+static void list_unlink(cache_shard_t* shard, cache_entry_t* entry) {
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        shard->head = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        shard->tail = entry->prev;
+    }
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+static void list_push_head(cache_shard_t* shard, cache_entry_t* entry) {
+    entry->prev = NULL;
+    entry->next = shard->head;
+    if (shard->head) {
+        shard->head->prev = entry;
+    }
+    shard->head = entry;
+    if (!shard->tail) {
+        shard->tail = entry;
+    }
+}
+
+static cache_entry_t* shard_find(cache_shard_t* shard, const char* key, uint32_t hash) {
+    cache_entry_t* entry = shard->buckets[hash & (shard->bucket_count - 1)];
+    while (entry) {
+        if (entry->hash == hash && strcmp(entry->key, key) == 0) {
+            return entry;
+        }
+        entry = entry->hash_next;
+    }
+    return NULL;
+}
+
+static void shard_grow(cache_shard_t* shard) {
+    size_t new_count = shard->bucket_count * 2;
+    cache_entry_t** buckets = safe_calloc(new_count, sizeof(cache_entry_t*));
+    
+    for (size_t i = 0; i < shard->bucket_count; i++) {
+        cache_entry_t* entry = shard->buckets[i];
+        while (entry) {
+            cache_entry_t* next = entry->hash_next;
+            size_t bucket = entry->hash & (new_count - 1);
+            entry->hash_next = buckets[bucket];
+            buckets[bucket] = entry;
+            entry = next;
+        }
+    }
+    
+    safe_free((void**)&shard->buckets);
+    shard->buckets = buckets;
+    shard->bucket_count = new_count;
+}
+
+static void entry_set_ttl(cache_shard_t* shard, cache_entry_t* entry, uint64_t ttl_ms, uint64_t now) {
+    if (entry->ttl_ms > 0) {
+        shard->ttl_total_ms -= entry->ttl_ms;
+        shard->ttl_entries--;
+    }
+    entry->ttl_ms = ttl_ms;
+    entry->expires_at = ttl_ms > 0 ? now + ttl_ms : 0;
+    if (ttl_ms > 0) {
+        shard->ttl_total_ms += ttl_ms;
+        shard->ttl_entries++;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Key trie
+// -----------------------------------------------------------------------------
+
+static trie_node_t* trie_node_new(trie_node_t* parent, const char* label, size_t label_len) {
+    trie_node_t* node = safe_calloc(1, sizeof(trie_node_t) + label_len);
+    memcpy(node->label, label, label_len);
+    node->label_len = label_len;
+    node->parent = parent;
+    return node;
+}
+
+static trie_node_t* trie_child(trie_node_t* node, char c) {
+    for (trie_node_t* child = node->children; child; child = child->sibling) {
+        if (child->label[0] == c) {
+            return child;
+        }
+    }
+    return NULL;
+}
+
+// Put new_child where old_child sits in parent's child list
+static void trie_replace_child(trie_node_t* parent, trie_node_t* old_child, trie_node_t* new_child) {
+    trie_node_t** link = &parent->children;
+    while (*link != old_child) {
+        link = &(*link)->sibling;
+    }
+    new_child->sibling = old_child->sibling;
+    *link = new_child;
+}
+
+static void trie_insert(cache_shard_t* shard, cache_entry_t* entry) {
+    trie_node_t* node = shard->trie;
+    if (!node) {
+        return;
+    }
+    const char* rest = entry->key;
+    size_t length = strlen(rest);
+    
+    while (length > 0) {
+        trie_node_t* child = trie_child(node, rest[0]);
+        if (!child) {
+            child = trie_node_new(node, rest, length);
+            trie_node_t** link = &node->children;
+            while (*link && (unsigned char)(*link)->label[0] < (unsigned char)rest[0]) {
+                link = &(*link)->sibling;
+            }
+            child->sibling = *link;
+            *link = child;
+            node = child;
+            break;
+        }
+        
+        size_t common = 1;
+        while (common < child->label_len && common < length && child->label[common] == rest[common]) {
+            common++;
+        }
+        
+        if (common < child->label_len) {
+            // Split the edge; the old child keeps the tail of its label
+            trie_node_t* middle = trie_node_new(node, child->label, common);
+            trie_replace_child(node, child, middle);
+            memmove(child->label, child->label + common, child->label_len - common);
+            child->label_len -= common;
+            child->parent = middle;
+            child->sibling = NULL;
+            middle->children = child;
+            child = middle;
+        }
+        
+        node = child;
+        rest += common;
+        length -= common;
+    }
+    
+    node->entry = entry;
+    entry->trie_node = node;
+}
+
+// Detach entry from the trie, pruning empty leaves and folding pass-through
+// nodes into their only child
+static void trie_remove(cache_entry_t* entry) {
+    trie_node_t* node = entry->trie_node;
+    if (!node) {
+        return;
+    }
+    node->entry = NULL;
+    entry->trie_node = NULL;
+    
+    while (node->parent && !node->entry) {
+        trie_node_t* parent = node->parent;
+        
+        if (!node->children) {
+            trie_node_t** link = &parent->children;
+            while (*link != node) {
+                link = &(*link)->sibling;
+            }
+            *link = node->sibling;
+            safe_free((void**)&node);
+            node = parent;
+            continue;
+        }
+        
+        if (!node->children->sibling) {
+            trie_node_t* child = node->children;
+            size_t label_len = node->label_len + child->label_len;
+            trie_node_t* merged = safe_calloc(1, sizeof(trie_node_t) + label_len);
+            memcpy(merged->label, node->label, node->label_len);
+            memcpy(merged->label + node->label_len, child->label, child->label_len);
+            merged->label_len = label_len;
+            merged->parent = parent;
+            merged->entry = child->entry;
+            if (merged->entry) {
+                merged->entry->trie_node = merged;
+            }
+            merged->children = child->children;
+            for (trie_node_t* grandchild = merged->children; grandchild; grandchild = grandchild->sibling) {
+                grandchild->parent = merged;
+            }
+            trie_replace_child(parent, node, merged);
+            safe_free((void**)&child);
+            safe_free((void**)&node);
+        }
+        break;
+    }
+}
+
+static void shard_index_keys(cache_shard_t* shard) {
+    if (shard->trie) {
+        return;
+    }
+    shard->trie = trie_node_new(NULL, "", 0);
+    for (cache_entry_t* entry = shard->head; entry; entry = entry->next) {
+        trie_insert(shard, entry);
+    }
+}
+
+// Node whose subtree holds exactly the keys starting with prefix
+static trie_node_t* trie_find_prefix(trie_node_t* root, const char* prefix, size_t length) {
+    trie_node_t* node = root;
+    while (length > 0) {
+        trie_node_t* child = trie_child(node, prefix[0]);
+        if (!child) {
+            return NULL;
+        }
+        size_t compare = child->label_len < length ? child->label_len : length;
+        if (memcmp(child->label, prefix, compare) != 0) {
+            return NULL;
+        }
+        node = child;
+        prefix += compare;
+        length -= compare;
+    }
+    return node;
+}
+
+// Gather up to max entries from node's subtree into out, starting at out[count]
+static size_t trie_collect(trie_node_t* node, cache_entry_t** out, size_t max, size_t count) {
+    if (node->entry && count < max) {
+        out[count++] = node->entry;
+    }
+    for (trie_node_t* child = node->children; child && count < max; child = child->sibling) {
+        count = trie_collect(child, out, max, count);
+    }
+    return count;
+}
+
+// -----------------------------------------------------------------------------
+// Tag index
+// -----------------------------------------------------------------------------
+
+static tag_node_t* tag_find(cache_shard_t* shard, const char* name, uint32_t hash) {
+    if (!shard->tag_buckets) {
+        return NULL;
+    }
+    for (tag_node_t* tag = shard->tag_buckets[hash & (shard->tag_bucket_count - 1)]; tag; tag = tag->hash_next) {
+        if (tag->hash == hash && strcmp(tag->name, name) == 0) {
+            return tag;
+        }
+    }
+    return NULL;
+}
+
+static void tag_grow(cache_shard_t* shard) {
+    size_t new_count = shard->tag_bucket_count * 2;
+    tag_node_t** buckets = safe_calloc(new_count, sizeof(tag_node_t*));
+    
+    for (size_t i = 0; i < shard->tag_bucket_count; i++) {
+        tag_node_t* tag = shard->tag_buckets[i];
+        while (tag) {
+            tag_node_t* next = tag->hash_next;
+            size_t bucket = tag->hash & (new_count - 1);
+            tag->hash_next = buckets[bucket];
+            buckets[bucket] = tag;
+            tag = next;
+        }
+    }
+    
+    safe_free((void**)&shard->tag_buckets);
+    shard->tag_buckets = buckets;
+    shard->tag_bucket_count = new_count;
+}
+
+static tag_node_t* tag_get(cache_shard_t* shard, const char* name) {
+    uint32_t hash = hash_key(name);
+    tag_node_t* tag = tag_find(shard, name, hash);
+    if (tag) {
+        return tag;
+    }
+    
+    if (!shard->tag_buckets) {
+        shard->tag_bucket_count = CACHE_SHARD_MIN_BUCKETS;
+        shard->tag_buckets = safe_calloc(shard->tag_bucket_count, sizeof(tag_node_t*));
+    } else if (shard->tag_count >= shard->tag_bucket_count) {
+        tag_grow(shard);
+    }
+    
+    tag = safe_calloc(1, sizeof(tag_node_t));
+    tag->name = safe_strdup(name);
+    tag->hash = hash;
+    size_t bucket = hash & (shard->tag_bucket_count - 1);
+    tag->hash_next = shard->tag_buckets[bucket];
+    shard->tag_buckets[bucket] = tag;
+    shard->tag_count++;
+    return tag;
+}
+
+// Drop the entry from every tag it carries; tags left without keys are freed
+static void entry_clear_tags(cache_shard_t* shard, cache_entry_t* entry) {
+    for (uint32_t i = 0; i < entry->tag_count; i++) {
+        tag_link_t* link = &entry->tags[i];
+        tag_node_t* tag = link->tag;
+        if (link->prev) {
+            link->prev->next = link->next;
+        } else {
+            tag->members = link->next;
+        }
+        if (link->next) {
+            link->next->prev = link->prev;
+        }
+        
+        if (--tag->member_count == 0) {
+            tag_node_t** slot = &shard->tag_buckets[tag->hash & (shard->tag_bucket_count - 1)];
+            while (*slot != tag) {
+                slot = &(*slot)->hash_next;
+            }
+            *slot = tag->hash_next;
+            shard->tag_count--;
+            safe_free((void**)&tag->name);
+            safe_free((void**)&tag);
+        }
+    }
+    safe_free((void**)&entry->tags);
+    entry->tag_count = 0;
+}
+
+static void entry_set_tags(cache_shard_t* shard, cache_entry_t* entry, const char** tags, size_t tag_count) {
+    entry_clear_tags(shard, entry);
+    if (tag_count == 0) {
+        return;
+    }
+    
+    entry->tags = safe_calloc(tag_count, sizeof(tag_link_t));
+    for (size_t i = 0; i < tag_count; i++) {
+        bool duplicate = !tags[i];
+        for (uint32_t j = 0; j < entry->tag_count && !duplicate; j++) {
+            duplicate = strcmp(entry->tags[j].tag->name, tags[i]) == 0;
+        }
+        if (duplicate) {
+            continue;
+        }
+        
+        tag_node_t* tag = tag_get(shard, tags[i]);
+        tag_link_t* link = &entry->tags[entry->tag_count++];
+        link->tag = tag;
+        link->entry = entry;
+        link->next = tag->members;
+        if (tag->members) {
+            tag->members->prev = link;
+        }
+        tag->members = link;
+        tag->member_count++;
+    }
+}
+
+static void copy_value_out(const void* data, size_t size, void** value, size_t* value_size) {
+    if (value) {
+        *value = safe_malloc(size > 0 ? size : 1);
+        memcpy(*value, data, size);
+    }
+    if (value_size) {
+        *value_size = size;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Value compression
+// -----------------------------------------------------------------------------
+
+// LZ77 in the LZ4 block layout: each sequence is a token (literal count in
+// the high nibble, match length - 4 in the low one, 15 meaning more length
+// bytes follow), the literals, then a 2-byte little-endian match offset. The
+// last sequence has literals only. One pass with a small hash table of
+// recent positions, so compression costs a few ns per byte.
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+#define LZ_MAX_OFFSET 65535
+
+static uint32_t lz_load32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Write the part of a length beyond its 15 in the token
+static size_t lz_put_length(uint8_t* dst, size_t length) {
+    size_t written = 0;
+    for (length -= 15; length >= 255; length -= 255) {
+        dst[written++] = 255;
+    }
+    dst[written++] = (uint8_t)length;
+    return written;
+}
+
+static bool lz_get_length(const uint8_t* src, size_t size, size_t* pos, size_t* length) {
+    uint8_t byte;
+    do {
+        if (*pos >= size) {
+            return false;
+        }
+        byte = src[(*pos)++];
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// Emit one sequence; returns false if it would not fit in capacity
+static bool lz_put_sequence(uint8_t* dst, size_t capacity, size_t* out, const uint8_t* literals,
+                            size_t literal_count, size_t offset, size_t match_length) {
+    size_t needed = 1 + literal_count + literal_count / 255 + 1 + (match_length > 0 ? 2 + match_length / 255 + 1 : 0);
+    if (*out + needed > capacity) {
+        return false;
+    }
+    
+    uint8_t* token = &dst[(*out)++];
+    *token = (uint8_t)((literal_count < 15 ? literal_count : 15) << 4);
+    if (literal_count >= 15) {
+        *out += lz_put_length(dst + *out, literal_count);
+    }
+    memcpy(dst + *out, literals, literal_count);
+    *out += literal_count;
+    
+    if (match_length > 0) {
+        dst[(*out)++] = (uint8_t)offset;
+        dst[(*out)++] = (uint8_t)(offset >> 8);
+        size_t extra = match_length - LZ_MIN_MATCH;
+        *token |= (uint8_t)(extra < 15 ? extra : 15);
+        if (extra >= 15) {
+            *out += lz_put_length(dst + *out, extra);
+        }
+    }
+    return true;
+}
+
+// Compress src into dst. Returns the compressed size, or 0 if it would not
+// fit in capacity.
+static size_t lz_compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity) {
+    uint32_t table[1 << LZ_HASH_BITS];
+    memset(table, 0, sizeof(table));
+    size_t pos = 0;
+    size_t anchor = 0;
+    size_t out = 0;
+    size_t misses = 0;
+    
+    while (pos + LZ_MIN_MATCH <= size) {
+        uint32_t sequence = lz_load32(src + pos);
+        uint32_t slot = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+        size_t candidate = table[slot];
+        table[slot] = (uint32_t)pos;
+        
+        if (candidate >= pos || pos - candidate > LZ_MAX_OFFSET || lz_load32(src + candidate) != sequence) {
+            // Skip ahead faster through data that isn't matching
+            pos += 1 + (misses++ >> 5);
+            continue;
+        }
+        misses = 0;
+        
+        size_t length = LZ_MIN_MATCH;
+        while (pos + length < size && src[candidate + length] == src[pos + length]) {
+            length++;
+        }
+        if (!lz_put_sequence(dst, capacity, &out, src + anchor, pos - anchor, pos - candidate, length)) {
+            return 0;
+        }
+        pos += length;
+        anchor = pos;
+    }
+    
+    if (!lz_put_sequence(dst, capacity, &out, src + anchor, size - anchor, 0, 0)) {
+        return 0;
+    }
+    return out;
+}
+
+// Decompress exactly size bytes into dst; false on malformed input
+static bool lz_decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t size) {
+    size_t in = 0;
+    size_t out = 0;
+    
+    while (in < src_size) {
+        uint8_t token = src[in++];
+        size_t literals = token >> 4;
+        if (literals == 15 && !lz_get_length(src, src_size, &in, &literals)) {
+            return false;
+        }
+        if (literals > src_size - in || literals > size - out) {
+            return false;
+        }
+        memcpy(dst + out, src + in, literals);
+        in += literals;
+        out += literals;
+        if (in == src_size) {
+            break;
+        }
+        
+        if (src_size - in < 2) {
+            return false;
+        }
+        size_t offset = (size_t)src[in] | (size_t)src[in + 1] << 8;
+        in += 2;
+        size_t length = token & 15;
+        if (length == 15 && !lz_get_length(src, src_size, &in, &length)) {
+            return false;
+        }
+        length += LZ_MIN_MATCH;
+        if (offset == 0 || offset > out || length > size - out) {
+            return false;
+        }
+        
+        // Matches may overlap their own output (runs), so copy forwards
+        uint8_t* to = dst + out;
+        const uint8_t* from = to - offset;
+        if (offset >= length) {
+            memcpy(to, from, length);
+        } else {
+            for (size_t i = 0; i < length; i++) {
+                to[i] = from[i];
+            }
+        }
+        out += length;
+    }
+    return out == size;
+}
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// A value ready to store: compressed when enable_compression is set, it
+// reaches the threshold and compressing saves at least 1/COMPRESSION_MIN_SAVING
+// of it; otherwise the caller's bytes
+typedef struct {
+    const void* data;
+    size_t size;
+    size_t raw_size;
+    void* buffer;             // Compressed copy, owned until stored
+    bool attempted;
+    uint64_t cpu_ns;
+} packed_value_t;
+
+static bool compression_applies(const cache_instance_t* cache, size_t size) {
+    size_t threshold = cache->config.compression_threshold > 0 ? cache->config.compression_threshold
+                                                               : COMPRESSION_DEFAULT_THRESHOLD;
+    return cache->config.enable_compression && size >= threshold && size <= UINT32_MAX;
+}
+
+static void value_pack(const cache_instance_t* cache, const void* value, size_t size, packed_value_t* packed) {
+    memset(packed, 0, sizeof(packed_value_t));
+    packed->data = value;
+    packed->size = size;
+    packed->raw_size = size;
+    if (!compression_applies(cache, size)) {
+        return;
+    }
+    
+    uint64_t start = monotonic_ns();
+    size_t capacity = size - size / COMPRESSION_MIN_SAVING;
+    uint8_t* buffer = safe_malloc(capacity);
+    size_t compressed = lz_compress(value, size, buffer, capacity);
+    if (compressed > 0) {
+        packed->buffer = safe_realloc(buffer, compressed);
+        packed->data = packed->buffer;
+        packed->size = compressed;
+    } else {
+        safe_free((void**)&buffer);
+    }
+    packed->attempted = true;
+    packed->cpu_ns = monotonic_ns() - start;
+}
+
+// Hand the stored bytes to an entry, taking over a compressed buffer
+static void* value_take(packed_value_t* packed) {
+    if (packed->buffer) {
+        void* data = packed->buffer;
+        packed->buffer = NULL;
+        return data;
+    }
+    void* copy = safe_malloc(packed->size > 0 ? packed->size : 1);
+    memcpy(copy, packed->data, packed->size);
+    return copy;
+}
+
+// Attach a packed value to entry, replacing any previous one, and account
+// for it. The caller adjusts charge for the stored size change.
+static void entry_set_value(cache_shard_t* shard, cache_entry_t* entry, packed_value_t* packed) {
+    if (entry->compressed) {
+        shard->compressed_count--;
+        shard->compression_saved -= entry->raw_size - entry->value_size;
+    }
+    safe_free((void**)&entry->value);
+    
+    entry->compressed = packed->size < packed->raw_size;
+    entry->value = value_take(packed);
+    entry->value_size = packed->size;
+    entry->raw_size = packed->raw_size;
+    
+    if (entry->compressed) {
+        shard->compressed_count++;
+        shard->compression_saved += entry->raw_size - entry->value_size;
+    } else if (packed->attempted) {
+        shard->compression_skipped++;
+    }
+    shard->compression_ns += packed->cpu_ns;
+}
+
+// Copy the entry's value out, decompressing if needed
+static void entry_copy_out(cache_shard_t* shard, const cache_entry_t* entry, void** value, size_t* value_size) {
+    if (!entry->compressed) {
+        copy_value_out(entry->value, entry->value_size, value, value_size);
+        return;
+    }
+    
+    if (value) {
+        uint64_t start = monotonic_ns();
+        *value = safe_malloc(entry->raw_size);
+        // Our own output for exactly raw_size bytes, so it always decodes
+        lz_decompress(entry->value, entry->value_size, *value, entry->raw_size);
+        shard->decompression_ns += monotonic_ns() - start;
+    }
+    if (value_size) {
+        *value_size = entry->raw_size;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Shard storage
+// -----------------------------------------------------------------------------
+
+// Tell near caches that key's value or TTL changed; called with the shard
+// lock held, after the change
+static void near_publish(cache_shard_t* shard, uint32_t hash) {
+    invalidation_log_t* log = shard->invalidations;
+    if (!log) {
+        return;
+    }
+    uint64_t seq = __atomic_fetch_add(&log->head, 1, __ATOMIC_ACQ_REL);
+    invalidation_t* slot = &log->slots[seq & (INVALIDATION_LOG_SIZE - 1)];
+    __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&slot->hash, hash, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->published_ns, monotonic_ns(), __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+// Single exit point for entries leaving the store; keeps the trie and tag
+// index in step with deletes, evictions and expiry
+static void shard_remove(cache_shard_t* shard, cache_entry_t* entry) {
+    near_publish(shard, entry->hash);
+    cache_entry_t** link = &shard->buckets[entry->hash & (shard->bucket_count - 1)];
+    while (*link && *link != entry) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = entry->hash_next;
+    }
+    
+    list_unlink(shard, entry);
+    trie_remove(entry);
+    entry_clear_tags(shard, entry);
+    entry_set_ttl(shard, entry, 0, 0);
+    if (entry->compressed) {
+        shard->compressed_count--;
+        shard->compression_saved -= entry->raw_size - entry->value_size;
+    }
+    shard->memory_used -= entry->charge;
+    shard->size--;
+    
+    safe_free((void**)&entry->key);
+    safe_free((void**)&entry->value);
+    safe_free((void**)&entry);
+}
+
+static void shard_clear(cache_shard_t* shard) {
+    while (shard->head) {
+        shard_remove(shard, shard->head);
+    }
+}
+
+// Returns the live entry for key, dropping it first if it has expired
+static cache_entry_t* shard_lookup(cache_shard_t* shard, const char* key, uint32_t hash, uint64_t now) {
+    cache_entry_t* entry = shard_find(shard, key, hash);
+    if (entry && entry_expired(entry, now)) {
+        shard_remove(shard, entry);
+        shard->expirations++;
+        return NULL;
+    }
+    return entry;
+}
+
+static void shard_touch(cache_instance_t* cache, cache_shard_t* shard,
+                        cache_entry_t* entry, uint64_t now) {
+    entry->access_count++;
+    entry->last_access = now;
+    if (cache->config.eviction_policy == CACHE_EVICTION_LRU && shard->head != entry) {
+        list_unlink(shard, entry);
+        list_push_head(shard, entry);
+    }
+}
+
+static uint64_t shard_random(cache_shard_t* shard) {
+    shard->rng ^= shard->rng << 13;
+    shard->rng ^= shard->rng >> 7;
+    shard->rng ^= shard->rng << 17;
+    return shard->rng;
+}
+
+// Pick the entry to evict other than keep, or NULL when the policy refuses
+// to evict. The shard holds at least one entry besides keep.
+static cache_entry_t* shard_pick_victim(cache_instance_t* cache, cache_shard_t* shard,
+                                        const cache_entry_t* keep, uint64_t now) {
+    cache_entry_t* coldest = shard->tail != keep ? shard->tail : shard->tail->prev;
+    switch (cache->config.eviction_policy) {
+        case CACHE_EVICTION_LFU: {
+            // Approximate LFU: least used among the coldest few entries
+            cache_entry_t* victim = coldest;
+            cache_entry_t* candidate = coldest;
+            for (int i = 0; i < CACHE_EVICTION_SAMPLES && candidate; i++) {
+                if (candidate != keep && candidate->access_count < victim->access_count) {
+                    victim = candidate;
+                }
+                candidate = candidate->prev;
+            }
+            return victim;
+        }
+        case CACHE_EVICTION_RANDOM: {
+            size_t bucket = shard_random(shard) & (shard->bucket_count - 1);
+            while (!shard->buckets[bucket] || (shard->buckets[bucket] == keep && !keep->hash_next)) {
+                bucket = (bucket + 1) & (shard->bucket_count - 1);
+            }
+            cache_entry_t* victim = shard->buckets[bucket];
+            return victim != keep ? victim : victim->hash_next;
+        }
+        case CACHE_EVICTION_TTL: {
+            // Only expired entries may go
+            for (cache_entry_t* entry = shard->tail; entry; entry = entry->prev) {
+                if (entry != keep && entry_expired(entry, now)) {
+                    return entry;
+                }
+            }
+            return NULL;
+        }
+        case CACHE_EVICTION_LRU:
+        case CACHE_EVICTION_FIFO:
+        default:
+            return coldest;
+    }
+}
+
+// Evict until `charge` more bytes fit. keep, when set, is the entry about to
+// grow by that much: it is never evicted and adds nothing to the count.
+static int shard_make_room(cache_instance_t* cache, cache_shard_t* shard, size_t charge,
+                           const cache_entry_t* keep, uint64_t now) {
+    size_t kept = keep ? 1 : 0;
+    while (shard->size > kept &&
+           ((!keep && shard->max_size > 0 && shard->size >= shard->max_size) ||
+            (shard->max_memory > 0 && shard->memory_used + charge > shard->max_memory))) {
+        cache_entry_t* victim = shard_pick_victim(cache, shard, keep, now);
+        if (!victim) {
+            return ERROR_FULL;
+        }
+        if (entry_expired(victim, now)) {
+            shard->expirations++;
+        } else {
+            shard->evictions++;
+        }
+        shard_remove(shard, victim);
+    }
+    return SUCCESS;
+}
+
+// Insert or overwrite key with a packed value
+static int shard_store_packed(cache_instance_t* cache, cache_shard_t* shard, const char* key, uint32_t hash,
+                              packed_value_t* packed, uint64_t ttl_ms, uint64_t now) {
+    cache_entry_t* entry = shard_lookup(shard, key, hash, now);
+    if (entry) {
+        if (packed->size > entry->value_size) {
+            int result = shard_make_room(cache, shard, packed->size - entry->value_size, entry, now);
+            if (result != SUCCESS) {
+                return result;
+            }
+        }
+        shard->memory_used -= entry->value_size;
+        shard->memory_used += packed->size;
+        entry->charge = entry->charge - entry->value_size + packed->size;
+        entry_set_value(shard, entry, packed);
+        entry_set_ttl(shard, entry, ttl_ms, now);
+        shard_touch(cache, shard, entry, now);
+        shard->sets++;
+        near_publish(shard, hash);
+        return SUCCESS;
+    }
+    
+    size_t key_length = strlen(key);
+    size_t charge = sizeof(cache_entry_t) + key_length + 1 + packed->size;
+    int result = shard_make_room(cache, shard, charge, NULL, now);
+    if (result != SUCCESS) {
+        return result;
+    }
+    
+    entry = safe_calloc(1, sizeof(cache_entry_t));
+    entry->key = safe_malloc(key_length + 1);
+    memcpy(entry->key, key, key_length + 1);
+    entry_set_value(shard, entry, packed);
+    entry->charge = charge;
+    entry->hash = hash;
+    entry->created_at = now;
+    entry->last_access = now;
+    entry_set_ttl(shard, entry, ttl_ms, now);
+    
+    size_t bucket = hash & (shard->bucket_count - 1);
+    entry->hash_next = shard->buckets[bucket];
+    shard->buckets[bucket] = entry;
+    list_push_head(shard, entry);
+    trie_insert(shard, entry);
+    shard->size++;
+    shard->memory_used += charge;
+    shard->sets++;
+    
+    if (shard->size > shard->bucket_count) {
+        shard_grow(shard);
+    }
+    return SUCCESS;
+}
+
+// Insert or overwrite key. The value is copied, compressed if configured.
+static int shard_store(cache_instance_t* cache, cache_shard_t* shard, const char* key, uint32_t hash,
+                       const void* value, size_t value_size, uint64_t ttl_ms, uint64_t now) {
+    packed_value_t packed;
+    value_pack(cache, value, value_size, &packed);
+    int result = shard_store_packed(cache, shard, key, hash, &packed, ttl_ms, now);
+    safe_free(&packed.buffer);
+    return result;
+}
+
+// Adds delta to the decimal integer stored at key (missing keys count as 0),
+// keeping any TTL
+static int shard_add(cache_instance_t* cache, cache_shard_t* shard, const char* key, uint32_t hash,
+                     int64_t delta, int64_t* new_value, uint64_t now) {
+    cache_entry_t* entry = shard_lookup(shard, key, hash, now);
+    int64_t current = 0;
+    uint64_t ttl_ms = cache->config.default_ttl_ms;
+    
+    if (entry) {
+        char digits[32];
+        if (entry->compressed || entry->value_size == 0 || entry->value_size >= sizeof(digits)) {
+            return ERROR_INVALID_PARAM;
+        }
+        memcpy(digits, entry->value, entry->value_size);
+        digits[entry->value_size] = '\0';
+        
+        char* end = NULL;
+        errno = 0;
+        current = strtoll(digits, &end, 10);
+        if (errno != 0 || *end != '\0') {
+            return ERROR_INVALID_PARAM;
+        }
+        ttl_ms = entry->ttl_ms > 0 && entry->expires_at > now ? entry->expires_at - now : 0;
+    }
+    
+    if ((delta > 0 && current > INT64_MAX - delta) || (delta < 0 && current < INT64_MIN - delta)) {
+        return ERROR_INVALID_PARAM;
+    }
+    current += delta;
+    
+    char digits[32];
+    int length = snprintf(digits, sizeof(digits), "%lld", (long long)current);
+    int result = shard_store(cache, shard, key, hash, digits, (size_t)length, ttl_ms, now);
+    if (result == SUCCESS && new_value) {
+        *new_value = current;
+    }
+    return result;
+}
+
+// -----------------------------------------------------------------------------
+// Operation timing
+// -----------------------------------------------------------------------------
+
+// Each thread records into its own log-linear histograms, merged when stats
+// are read: values below OP_HIST_SUB ticks get a bucket each, and every power
+// of two above is split into OP_HIST_SUB buckets, bounding the error of a
+// percentile to 1/OP_HIST_SUB. Ticks come from the invariant TSC where there
+// is one and CLOCK_MONOTONIC otherwise.
+#define OP_HIST_SUB_BITS 4
+#define OP_HIST_SUB (1 << OP_HIST_SUB_BITS)
+#define OP_HIST_MAX_EXP 44
+#define OP_HIST_BUCKETS ((OP_HIST_MAX_EXP - OP_HIST_SUB_BITS + 2) * OP_HIST_SUB)
+
+// Shortest TSC interval used to work out its rate
+#define OP_CLOCK_CALIBRATION_NS 10000000ULL
+
+typedef enum {
+    CACHE_OP_GET,
+    CACHE_OP_SET,
+    CACHE_OP_DELETE,
+    CACHE_OP_MGET,
+    CACHE_OP_MSET,
+    CACHE_OP_MDELETE,
+    CACHE_OP_LOAD,
+    CACHE_OP_COUNT
+} cache_op_t;
+
+static const char* const cache_op_names[CACHE_OP_COUNT] = {
+    "get", "set", "delete", "mget", "mset", "mdelete", "load"
+};
+
+// Written only by the owning thread (relaxed, so readers see whole values)
+struct op_histogram {
+    cache_instance_t* cache;
+    uint64_t generation;      // Stale after cache_reset_stats
+    uint64_t count[CACHE_OP_COUNT];
+    uint64_t total[CACHE_OP_COUNT];
+    uint64_t min[CACHE_OP_COUNT];
+    uint64_t max[CACHE_OP_COUNT];
+    uint64_t buckets[CACHE_OP_COUNT][OP_HIST_BUCKETS];
+    struct op_histogram* next;
+};
+
+static pthread_once_t op_clock_once = PTHREAD_ONCE_INIT;
+static bool op_clock_tsc;
+static uint64_t op_clock_base_ticks;
+static uint64_t op_clock_base_ns;
+
+static void op_clock_init(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+    op_clock_tsc = __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8));
+    if (op_clock_tsc) {
+        op_clock_base_ticks = __rdtsc();
+    }
+#endif
+    op_clock_base_ns = monotonic_ns();
+}
+
+static inline uint64_t op_clock(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (op_clock_tsc) {
+        return __rdtsc();
+    }
+#endif
+    return monotonic_ns();
+}
+
+// Nanoseconds per tick, measured against CLOCK_MONOTONIC since startup
+static double op_clock_ns_per_tick(void) {
+    if (!op_clock_tsc) {
+        return 1.0;
+    }
+    uint64_t ns = monotonic_ns();
+    if (ns - op_clock_base_ns < OP_CLOCK_CALIBRATION_NS) {
+        struct timespec wait = { 0, (long)(OP_CLOCK_CALIBRATION_NS - (ns - op_clock_base_ns)) };
+        nanosleep(&wait, NULL);
+    }
+    uint64_t ticks = op_clock();
+    ns = monotonic_ns();
+    return ticks > op_clock_base_ticks ? (double)(ns - op_clock_base_ns) / (ticks - op_clock_base_ticks) : 1.0;
+}
+
+static size_t op_bucket(uint64_t ticks) {
+    if (ticks < OP_HIST_SUB) {
+        return (size_t)ticks;
+    }
+    int exp = 63 - __builtin_clzll(ticks);
+    if (exp > OP_HIST_MAX_EXP) {
+        return OP_HIST_BUCKETS - 1;
+    }
+    return (size_t)(exp - OP_HIST_SUB_BITS + 1) * OP_HIST_SUB +
+           ((ticks >> (exp - OP_HIST_SUB_BITS)) & (OP_HIST_SUB - 1));
+}
+
+// Middle of the bucket's range, in ticks
+static double op_bucket_value(size_t bucket) {
+    if (bucket < OP_HIST_SUB) {
+        return (double)bucket;
+    }
+    int shift = (int)(bucket / OP_HIST_SUB) - 1;
+    uint64_t low = (uint64_t)(OP_HIST_SUB + bucket % OP_HIST_SUB) << shift;
+    return low + ((1ULL << shift) - 1) / 2.0;
+}
+
+static void op_store(uint64_t* field, uint64_t value) {
+    __atomic_store_n(field, value, __ATOMIC_RELAXED);
+}
+
+static uint64_t op_load(const uint64_t* field) {
+    return __atomic_load_n(field, __ATOMIC_RELAXED);
+}
+
+// Thread exit: fold the thread's counts into the instance's retired totals
+static void op_histogram_release(void* arg) {
+    op_histogram_t* histogram = (op_histogram_t*)arg;
+    cache_instance_t* cache = histogram->cache;
+    
+    pthread_mutex_lock(&cache->op_lock);
+    op_histogram_t** link = &cache->op_threads;
+    while (*link != histogram) {
+        link = &(*link)->next;
+    }
+    *link = histogram->next;
+    op_histogram_t* retired = cache->op_retired;
+    if (histogram->generation == cache->op_generation) {
+        for (int op = 0; op < CACHE_OP_COUNT; op++) {
+            if (histogram->count[op] == 0) {
+                continue;
+            }
+            if (retired->count[op] == 0 || histogram->min[op] < retired->min[op]) {
+                op_store(&retired->min[op], histogram->min[op]);
+            }
+            if (histogram->max[op] > retired->max[op]) {
+                op_store(&retired->max[op], histogram->max[op]);
+            }
+            op_store(&retired->count[op], retired->count[op] + histogram->count[op]);
+            op_store(&retired->total[op], retired->total[op] + histogram->total[op]);
+            for (size_t i = 0; i < OP_HIST_BUCKETS; i++) {
+                retired->buckets[op][i] += histogram->buckets[op][i];
+            }
+        }
+    }
+    pthread_mutex_unlock(&cache->op_lock);
+    safe_free((void**)&histogram);
+}
+
+// 0 when timing is off
+static inline uint64_t op_timer_start(cache_instance_t* cache) {
+    return cache && __atomic_load_n(&cache->op_timing, __ATOMIC_RELAXED) ? op_clock() : 0;
+}
+
+static void op_timer_stop(cache_instance_t* cache, cache_op_t op, uint64_t start) {
+    if (start == 0) {
+        return;
+    }
+    uint64_t elapsed = op_clock() - start;
+    
+    op_histogram_t* histogram = pthread_getspecific(cache->op_key);
+    if (!histogram) {
+        histogram = safe_calloc(1, sizeof(op_histogram_t));
+        histogram->cache = cache;
+        pthread_mutex_lock(&cache->op_lock);
+        histogram->generation = cache->op_generation;
+        histogram->next = cache->op_threads;
+        cache->op_threads = histogram;
+        pthread_mutex_unlock(&cache->op_lock);
+        pthread_setspecific(cache->op_key, histogram);
+    }
+    
+    uint64_t generation = __atomic_load_n(&cache->op_generation, __ATOMIC_RELAXED);
+    if (histogram->generation != generation) {
+        // Stats were reset: start over
+        for (int i = 0; i < CACHE_OP_COUNT; i++) {
+            op_store(&histogram->count[i], 0);
+            op_store(&histogram->total[i], 0);
+            op_store(&histogram->max[i], 0);
+            for (size_t b = 0; b < OP_HIST_BUCKETS; b++) {
+                op_store(&histogram->buckets[i][b], 0);
+            }
+        }
+        __atomic_store_n(&histogram->generation, generation, __ATOMIC_RELEASE);
+    }
+    
+    uint64_t count = histogram->count[op];
+    if (count == 0 || elapsed < histogram->min[op]) {
+        op_store(&histogram->min[op], elapsed);
+    }
+    if (elapsed > histogram->max[op]) {
+        op_store(&histogram->max[op], elapsed);
+    }
+    op_store(&histogram->total[op], histogram->total[op] + elapsed);
+    size_t bucket = op_bucket(elapsed);
+    op_store(&histogram->buckets[op][bucket], histogram->buckets[op][bucket] + 1);
+    op_store(&histogram->count[op], count + 1);
+}
+
+static void flight_release(flight_t* flight) {
+    if (!flight->done || flight->waiters > 0) {
+        return;
+    }
+    pthread_cond_destroy(&flight->cond);
+    safe_free((void**)&flight->key);
+    safe_free((void**)&flight->value);
+    safe_free((void**)&flight);
+}
+
+static flight_t* flight_find(cache_shard_t* shard, const char* key, uint32_t hash) {
+    for (flight_t* flight = shard->flights; flight; flight = flight->next) {
+        if (flight->hash == hash && strcmp(flight->key, key) == 0) {
+            return flight;
+        }
+    }
+    return NULL;
+}
+
+static flight_t* flight_begin(cache_shard_t* shard, const char* key, uint32_t hash) {
+    flight_t* flight = safe_calloc(1, sizeof(flight_t));
+    flight->key = safe_strdup(key);
+    flight->hash = hash;
+    flight->status = SUCCESS;
+    pthread_cond_init(&flight->cond, NULL);
+    
+    flight->next = shard->flights;
+    shard->flights = flight;
+    return flight;
+}
+
+// Detach the flight, wake its waiters and drop the owner's reference
+static void flight_finish(cache_shard_t* shard, flight_t* flight) {
+    flight_t** link = &shard->flights;
+    while (*link && *link != flight) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = flight->next;
+    }
+    
+    flight->done = true;
+    pthread_cond_broadcast(&flight->cond);
+    flight_release(flight);
+}
+
+// Wait under the shard lock for a flight to finish. Returns false on timeout;
+// either way the caller no longer counts as a waiter.
+static bool flight_wait(cache_shard_t* shard, flight_t* flight, const struct timespec* deadline) {
+    flight->waiters++;
+    int rc = 0;
+    while (!flight->done && rc != ETIMEDOUT) {
+        rc = pthread_cond_timedwait(&flight->cond, &shard->lock, deadline);
+    }
+    flight->waiters--;
+    return flight->done;
+}
+
+static uint64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
+
+// Publish a finished load under the shard lock: cache the value along with
+// how long it took to compute, and hand it to the flight's waiters. The
+// flight takes ownership of `loaded`.
+static int load_complete(cache_instance_t* cache, cache_shard_t* shard, flight_t* flight,
+                         void* loaded, size_t loaded_size, uint64_t elapsed_us) {
+    if (!loaded) {
+        flight->status = ERROR_NOT_FOUND;
+        return flight->status;
+    }
+    
+    shard_store(cache, shard, flight->key, flight->hash, loaded, loaded_size,
+                cache->config.default_ttl_ms, get_timestamp_ms());
+    cache_entry_t* entry = shard_find(shard, flight->key, flight->hash);
+    if (entry) {
+        entry->recompute_us = elapsed_us > 0 ? elapsed_us : 1;
+    }
+    
+    flight->value = loaded;
+    flight->value_size = loaded_size;
+    flight->has_value = true;
+    return SUCCESS;
+}
+
+// Decide on a hit whether the value should be recomputed before it expires.
+// STAMPEDE_PROBABILISTIC uses XFetch: refresh when
+//   now - recompute_time * beta * ln(rand()) >= expiry
+// so the chance grows as expiry nears and expensive values start earlier,
+// spreading refreshes of a hot key out instead of piling them at the deadline.
+static bool refresh_due(cache_instance_t* cache, cache_shard_t* shard,
+                        const cache_entry_t* entry, uint64_t now) {
+    if (entry->ttl_ms == 0) {
+        return false;
+    }
+    
+    switch (cache->stampede.method) {
+        case STAMPEDE_PROBABILISTIC: {
+            if (entry->recompute_us == 0) {
+                return false;  // Not produced by a loader, cost unknown
+            }
+            double beta = cache->stampede.early_expiration_factor > 0.0
+                              ? cache->stampede.early_expiration_factor
+                              : XFETCH_DEFAULT_BETA;
+            double u = (double)((shard_random(shard) >> 11) + 1) / 9007199254740992.0;
+            double gap_ms = -(entry->recompute_us / 1000.0) * beta * log(u);
+            return (double)now + gap_ms >= (double)entry->expires_at;
+        }
+        case STAMPEDE_PRECOMPUTE:
+            return entry->expires_at - now <= cache->stampede.refresh_threshold_ms;
+        default:
+            return false;
+    }
+}
+
+static void* refresher_main(void* arg) {
+    cache_instance_t* cache = (cache_instance_t*)arg;
+    
+    pthread_mutex_lock(&cache->refresh_lock);
+    while (!cache->refresher_stop) {
+        refresh_job_t* job = cache->refresh_head;
+        if (!job) {
+            pthread_cond_wait(&cache->refresh_cond, &cache->refresh_lock);
+            continue;
+        }
+        cache->refresh_head = job->next;
+        if (!cache->refresh_head) {
+            cache->refresh_tail = NULL;
+        }
+        pthread_mutex_unlock(&cache->refresh_lock);
+        
+        uint64_t start = monotonic_us();
+        uint64_t timer = op_timer_start(cache);
+        size_t loaded_size = 0;
+        void* loaded = job->loader(job->flight->key, job->ctx, &loaded_size);
+        op_timer_stop(cache, CACHE_OP_LOAD, timer);
+        uint64_t elapsed = monotonic_us() - start;
+        
+        pthread_mutex_lock(&job->shard->lock);
+        load_complete(cache, job->shard, job->flight, loaded, loaded_size, elapsed);
+        flight_finish(job->shard, job->flight);
+        pthread_mutex_unlock(&job->shard->lock);
+        safe_free((void**)&job);
+        
+        pthread_mutex_lock(&cache->refresh_lock);
+    }
+    pthread_mutex_unlock(&cache->refresh_lock);
+    
+    return NULL;
+}
+
+// Queue a background reload of key; called with the shard lock held
+static void refresh_schedule(cache_instance_t* cache, cache_shard_t* shard, const char* key,
+                             uint32_t hash, cache_loader_fn loader, void* ctx) {
+    refresh_job_t* job = safe_calloc(1, sizeof(refresh_job_t));
+    job->shard = shard;
+    job->flight = flight_begin(shard, key, hash);
+    job->loader = loader;
+    job->ctx = ctx;
+    
+    pthread_mutex_lock(&cache->refresh_lock);
+    if (cache->refresh_tail) {
+        cache->refresh_tail->next = job;
+    } else {
+        cache->refresh_head = job;
+    }
+    cache->refresh_tail = job;
+    pthread_cond_signal(&cache->refresh_cond);
+    pthread_mutex_unlock(&cache->refresh_lock);
+}
+
+// Stop the worker; queued reloads are dropped and their waiters re-check the cache
+static void refresher_stop(cache_instance_t* cache) {
+    if (!cache->refresher_running) {
+        return;
+    }
+    
+    pthread_mutex_lock(&cache->refresh_lock);
+    cache->refresher_stop = true;
+    pthread_cond_signal(&cache->refresh_cond);
+    pthread_mutex_unlock(&cache->refresh_lock);
+    pthread_join(cache->refresher, NULL);
+    cache->refresher_running = false;
+    
+    while (cache->refresh_head) {
+        refresh_job_t* job = cache->refresh_head;
+        cache->refresh_head = job->next;
+        pthread_mutex_lock(&job->shard->lock);
+        flight_finish(job->shard, job->flight);
+        pthread_mutex_unlock(&job->shard->lock);
+        safe_free((void**)&job);
+    }
+    cache->refresh_tail = NULL;
+}
+
+static struct timespec deadline_after(uint64_t timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += (time_t)(timeout_ms / 1000);
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return deadline;
+}
+
+// =============================================================================
+// Redis backend
+// =============================================================================
+
+// CACHE_TYPE_REDIS instances talk RESP2 to redis_host:redis_port. Each call
+// borrows one connection from a small pool for its whole exchange, and batch
+// calls pipeline their commands so they cost a single round trip. Replies are
+// parsed in place in the connection's read buffer; only values handed back to
+// the caller are copied.
+#define RESP_POOL_SIZE 4
+#define RESP_BUFFER_SIZE 16384
+#define RESP_IO_TIMEOUT_MS 5000
+#define RESP_MAX_FANOUT 8
+#define RESP_MAX_DEPTH 8                       // Nested arrays; replies we use go 2 deep
+#define RESP_MAX_ELEMENTS (1024 * 1024)
+#define RESP_MAX_BULK (512LL * 1024 * 1024)    // Redis's own proto-max-bulk-len
+
+typedef enum {
+    RESP_STATUS,
+    RESP_ERROR,
+    RESP_INTEGER,
+    RESP_BULK,
+    RESP_NIL,
+    RESP_ARRAY
+} resp_type_t;
+
+// A reply as it sits in the read buffer. For arrays, data points at the first
+// element and length is the element count; other strings are not terminated.
+typedef struct {
+    resp_type_t type;
+    const char* data;
+    size_t length;
+    int64_t integer;
+} resp_reply_t;
+
+typedef struct {
+    int fd;                   // -1 until (re)connected
+    char* in;
+    size_t in_start;          // Unparsed bytes are in[in_start, in_end)
+    size_t in_end;
+    size_t in_capacity;
+    char* out;
+    size_t out_len;
+    size_t out_capacity;
+} resp_conn_t;
+
+struct resp_pool {
+    const cache_config_t* config;
+    pthread_mutex_t lock;
+    pthread_cond_t available;
+    resp_conn_t conns[RESP_POOL_SIZE];
+    resp_conn_t* idle[RESP_POOL_SIZE];
+    size_t idle_count;
+};
+
+static int resp_open(const cache_config_t* config) {
+    char port[16];
+    snprintf(port, sizeof(port), "%d", config->redis_port);
+    
+    struct addrinfo hints = {0};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* addrs;
+    const char* host = config->redis_host[0] ? config->redis_host : "127.0.0.1";
+    if (getaddrinfo(host, port, &hints, &addrs) != 0) {
+        return -1;
+    }
+    
+    int fd = -1;
+    for (struct addrinfo* addr = addrs; addr && fd < 0; addr = addr->ai_next) {
+        fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+        if (fd >= 0 && connect(fd, addr->ai_addr, addr->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addrs);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    // Small requests go out immediately; a dead server fails calls instead
+    // of hanging them
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct timeval timeout = {RESP_IO_TIMEOUT_MS / 1000, (RESP_IO_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+static void resp_reserve(resp_conn_t* conn, size_t extra) {
+    if (conn->out_len + extra <= conn->out_capacity) {
+        return;
+    }
+    size_t capacity = conn->out_capacity;
+    while (conn->out_len + extra > capacity) {
+        capacity *= 2;
+    }
+    conn->out = safe_realloc(conn->out, capacity);
+    conn->out_capacity = capacity;
+}
+
+// Queue one command; nothing is sent until resp_flush
+static void resp_append(resp_conn_t* conn, size_t argc, const char** argv, const size_t* lens) {
+    resp_reserve(conn, 32);
+    conn->out_len += (size_t)sprintf(conn->out + conn->out_len, "*%zu\r\n", argc);
+    for (size_t i = 0; i < argc; i++) {
+        size_t len = lens ? lens[i] : strlen(argv[i]);
+        resp_reserve(conn, len + 32);
+        conn->out_len += (size_t)sprintf(conn->out + conn->out_len, "$%zu\r\n", len);
+        memcpy(conn->out + conn->out_len, argv[i], len);
+        conn->out_len += len;
+        conn->out[conn->out_len++] = '\r';
+        conn->out[conn->out_len++] = '\n';
+    }
+}
+
+static int resp_flush(resp_conn_t* conn) {
+    size_t sent = 0;
+    while (sent < conn->out_len) {
+        ssize_t n = send(conn->fd, conn->out + sent, conn->out_len - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return ERROR_IO;
+        }
+        sent += (size_t)n;
+    }
+    conn->out_len = 0;
+    return SUCCESS;
+}
+
+// Read a CRLF-terminated decimal at p. Returns the bytes up to and including
+// the CRLF, 0 if the line is incomplete and -1 if it is malformed.
+static long resp_parse_number(const char* p, size_t available, int64_t* number) {
+    const char* end = memchr(p, '\r', available);
+    if (!end || (size_t)(end - p) + 1 >= available) {
+        return 0;
+    }
+    if (end[1] != '\n' || end == p) {
+        return -1;
+    }
+    
+    bool negative = *p == '-';
+    const char* digit = negative ? p + 1 : p;
+    if (digit == end) {
+        return -1;
+    }
+    uint64_t value = 0;
+    for (; digit < end; digit++) {
+        if (*digit < '0' || *digit > '9' || value > (UINT64_MAX - 9) / 10) {
+            return -1;
+        }
+        value = value * 10 + (uint64_t)(*digit - '0');
+    }
+    if (value > (uint64_t)INT64_MAX + (negative ? 1 : 0)) {
+        return -1;
+    }
+    *number = negative ? (int64_t)(0 - value) : (int64_t)value;
+    return end + 2 - p;
+}
+
+// Parse the reply at p. Returns the bytes it spans, 0 if more data is needed
+// and -1 on a protocol error. Array elements are checked for completeness
+// here and decoded later with resp_next. Replies nested deeper than
+// RESP_MAX_DEPTH or longer than the element and bulk caps are protocol
+// errors, so a hostile server cannot exhaust the stack or the read buffer.
+static long resp_parse_depth(const char* p, size_t available, resp_reply_t* reply, int depth) {
+    if (available < 1) {
+        return 0;
+    }
+    
+    const char* line = p + 1;
+    size_t rest = available - 1;
+    long used;
+    switch (*p) {
+        case '+':
+        case '-': {
+            const char* end = memchr(line, '\r', rest);
+            if (!end || (size_t)(end - line) + 1 >= rest) {
+                return 0;
+            }
+            if (end[1] != '\n') {
+                return -1;
+            }
+            reply->type = *p == '+' ? RESP_STATUS : RESP_ERROR;
+            reply->data = line;
+            reply->length = (size_t)(end - line);
+            return end + 2 - p;
+        }
+        case ':':
+            used = resp_parse_number(line, rest, &reply->integer);
+            if (used <= 0) {
+                return used;
+            }
+            reply->type = RESP_INTEGER;
+            return used + 1;
+        case '$': {
+            int64_t length;
+            used = resp_parse_number(line, rest, &length);
+            if (used <= 0) {
+                return used;
+            }
+            if (length < 0) {
+                reply->type = RESP_NIL;
+                return used + 1;
+            }
+            if (length > RESP_MAX_BULK) {
+                return -1;
+            }
+            if ((uint64_t)length + 2 > rest - (size_t)used) {
+                return 0;
+            }
+            const char* data = line + used;
+            if (data[length] != '\r' || data[length + 1] != '\n') {
+                return -1;
+            }
+            reply->type = RESP_BULK;
+            reply->data = data;
+            reply->length = (size_t)length;
+            return used + 1 + length + 2;
+        }
+        case '*': {
+            int64_t count;
+            used = resp_parse_number(line, rest, &count);
+            if (used <= 0) {
+                return used;
+            }
+            if (count < 0) {
+                reply->type = RESP_NIL;
+                return used + 1;
+            }
+            if (count > RESP_MAX_ELEMENTS || (count > 0 && depth >= RESP_MAX_DEPTH)) {
+                return -1;
+            }
+            size_t offset = 1 + (size_t)used;
+            for (int64_t i = 0; i < count; i++) {
+                resp_reply_t element;
+                long element_used = resp_parse_depth(p + offset, available - offset, &element,
+                                                     depth + 1);
+                if (element_used <= 0) {
+                    return element_used;
+                }
+                offset += (size_t)element_used;
+            }
+            reply->type = RESP_ARRAY;
+            reply->data = p + 1 + used;
+            reply->length = (size_t)count;
+            return (long)offset;
+        }
+        default:
+            return -1;
+    }
+}
+
+static long resp_parse(const char* p, size_t available, resp_reply_t* reply) {
+    return resp_parse_depth(p, available, reply, 0);
+}
+
+// Decode the array element at *cursor and step past it. The array was
+// validated by resp_parse, so this cannot fail.
+static void resp_next(const char** cursor, resp_reply_t* element) {
+    long used = resp_parse(*cursor, SIZE_MAX / 2, element);
+    *cursor += used;
+}
+
+// Read the next reply. It points into the read buffer and stays valid until
+// the next read on the connection.
+static int resp_read(resp_conn_t* conn, resp_reply_t* reply) {
+    while (true) {
+        long used = resp_parse(conn->in + conn->in_start, conn->in_end - conn->in_start, reply);
+        if (used < 0) {
+            return ERROR_IO;
+        }
+        if (used > 0) {
+            conn->in_start += (size_t)used;
+            return SUCCESS;
+        }
+        
+        // Incomplete: make room at the end of the buffer and read more
+        if (conn->in_start > 0) {
+            memmove(conn->in, conn->in + conn->in_start, conn->in_end - conn->in_start);
+            conn->in_end -= conn->in_start;
+            conn->in_start = 0;
+        }
+        if (conn->in_end == conn->in_capacity) {
+            conn->in_capacity *= 2;
+            conn->in = safe_realloc(conn->in, conn->in_capacity);
+        }
+        
+        ssize_t n = recv(conn->fd, conn->in + conn->in_end, conn->in_capacity - conn->in_end, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return ERROR_IO;
+        }
+        conn->in_end += (size_t)n;
+    }
+}
+
+static void resp_close(resp_conn_t* conn) {
+    if (conn->fd >= 0) {
+        close(conn->fd);
+        conn->fd = -1;
+    }
+    conn->in_start = conn->in_end = 0;
+    conn->out_len = 0;
+}
+
+// Open the connection and run AUTH/SELECT as configured, in one round trip
+static int resp_connect(resp_pool_t* pool, resp_conn_t* conn) {
+    conn->fd = resp_open(pool->config);
+    if (conn->fd < 0) {
+        return ERROR_IO;
+    }
+    
+    size_t expected = 0;
+    if (pool->config->redis_password[0]) {
+        const char* argv[] = {"AUTH", pool->config->redis_password};
+        resp_append(conn, 2, argv, NULL);
+        expected++;
+    }
+    if (pool->config->redis_db != 0) {
+        char db[16];
+        snprintf(db, sizeof(db), "%d", pool->config->redis_db);
+        const char* argv[] = {"SELECT", db};
+        resp_append(conn, 2, argv, NULL);
+        expected++;
+    }
+    
+    int result = resp_flush(conn);
+    for (size_t i = 0; i < expected && result == SUCCESS; i++) {
+        resp_reply_t reply;
+        result = resp_read(conn, &reply);
+        if (result == SUCCESS && reply.type == RESP_ERROR) {
+            result = ERROR_IO;
+        }
+    }
+    if (result != SUCCESS) {
+        resp_close(conn);
+    }
+    return result;
+}
+
+// Connections open lazily, except the first: connecting fails early if the
+// server is unreachable
+static resp_pool_t* resp_pool_create(const cache_config_t* config) {
+    resp_pool_t* pool = safe_calloc(1, sizeof(resp_pool_t));
+    pool->config = config;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->available, NULL);
+    
+    for (size_t i = 0; i < RESP_POOL_SIZE; i++) {
+        resp_conn_t* conn = &pool->conns[i];
+        conn->fd = -1;
+        conn->in_capacity = RESP_BUFFER_SIZE;
+        conn->in = safe_malloc(conn->in_capacity);
+        conn->out_capacity = RESP_BUFFER_SIZE;
+        conn->out = safe_malloc(conn->out_capacity);
+        pool->idle[pool->idle_count++] = conn;
+    }
+    return pool;
+}
+
+static void resp_pool_destroy(resp_pool_t* pool) {
+    if (!pool) return;
+    
+    for (size_t i = 0; i < RESP_POOL_SIZE; i++) {
+        resp_close(&pool->conns[i]);
+        safe_free((void**)&pool->conns[i].in);
+        safe_free((void**)&pool->conns[i].out);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->available);
+    safe_free((void**)&pool);
+}
+
+// Borrow a connection, waiting if all are in use. Returns NULL if it could
+// not be (re)connected.
+static resp_conn_t* resp_acquire(resp_pool_t* pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->idle_count == 0) {
+        pthread_cond_wait(&pool->available, &pool->lock);
+    }
+    resp_conn_t* conn = pool->idle[--pool->idle_count];
+    pthread_mutex_unlock(&pool->lock);
+    
+    if (conn->fd < 0 && resp_connect(pool, conn) != SUCCESS) {
+        pthread_mutex_lock(&pool->lock);
+        pool->idle[pool->idle_count++] = conn;
+        pthread_cond_signal(&pool->available);
+        pthread_mutex_unlock(&pool->lock);
+        return NULL;
+    }
+    return conn;
+}
+
+// A connection that failed mid-exchange may have replies in flight, so it
+// is closed and reopened by its next user
+static void resp_release(resp_pool_t* pool, resp_conn_t* conn, int status) {
+    if (status == ERROR_IO) {
+        resp_close(conn);
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    pool->idle[pool->idle_count++] = conn;
+    pthread_cond_signal(&pool->available);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Status for a reply that should be an integer. Error replies mean the
+// server rejected the command (e.g. INCR on a non-number).
+static int resp_integer(const resp_reply_t* reply, int64_t* value) {
+    if (reply->type == RESP_INTEGER) {
+        *value = reply->integer;
+        return SUCCESS;
+    }
+    return reply->type == RESP_ERROR ? ERROR_INVALID_PARAM : ERROR_IO;
+}
+
+static int resp_ok(const resp_reply_t* reply) {
+    if (reply->type == RESP_STATUS) {
+        return SUCCESS;
+    }
+    return reply->type == RESP_ERROR ? ERROR_INVALID_PARAM : ERROR_IO;
+}
+
+// Run one command on a pooled connection and decode its reply with the
+// caller's handler while the reply buffer is still valid
+typedef int (*resp_handler_fn)(const resp_reply_t* reply, void* ctx);
+
+static int remote_command(cache_instance_t* cache, size_t argc, const char** argv, const size_t* lens,
+                          resp_handler_fn handler, void* ctx) {
+    if (!cache->remote) {
+        return ERROR_IO;
+    }
+    resp_conn_t* conn = resp_acquire(cache->remote);
+    if (!conn) {
+        return ERROR_IO;
+    }
+    
+    resp_append(conn, argc, argv, lens);
+    resp_reply_t reply;
+    int result = resp_flush(conn);
+    if (result == SUCCESS) {
+        result = resp_read(conn, &reply);
+    }
+    if (result == SUCCESS) {
+        result = handler(&reply, ctx);
+    }
+    resp_release(cache->remote, conn, result);
+    return result;
+}
+
+static int handle_ok(const resp_reply_t* reply, void* ctx) {
+    (void)ctx;
+    return resp_ok(reply);
+}
+
+static int handle_integer(const resp_reply_t* reply, void* ctx) {
+    return resp_integer(reply, ctx);
+}
+
+typedef struct {
+    void** value;
+    size_t* value_size;
+} value_out_t;
+
+static int handle_value(const resp_reply_t* reply, void* ctx) {
+    value_out_t* out = ctx;
+    if (reply->type == RESP_NIL) {
+        if (out->value) *out->value = NULL;
+        if (out->value_size) *out->value_size = 0;
+        return ERROR_NOT_FOUND;
+    }
+    if (reply->type != RESP_BULK) {
+        return reply->type == RESP_ERROR ? ERROR_INVALID_PARAM : ERROR_IO;
+    }
+    copy_value_out(reply->data, reply->length, out->value, out->value_size);
+    return SUCCESS;
+}
+
+static int remote_set(cache_instance_t* cache, const char* key, const void* value, size_t value_size,
+                      uint64_t ttl_ms) {
+    char ttl[24];
+    snprintf(ttl, sizeof(ttl), "%" PRIu64, ttl_ms);
+    const char* argv[] = {"SET", key, value_size > 0 ? value : "", "PX", ttl};
+    size_t lens[] = {3, strlen(key), value_size, 2, strlen(ttl)};
+    return remote_command(cache, ttl_ms > 0 ? 5 : 3, argv, lens, handle_ok, NULL);
+}
+
+static int remote_get(cache_instance_t* cache, const char* key, void** value, size_t* value_size) {
+    const char* argv[] = {"GET", key};
+    value_out_t out = {value, value_size};
+    int result = remote_command(cache, 2, argv, NULL, handle_value, &out);
+    if (result != SUCCESS && result != ERROR_NOT_FOUND) {
+        if (value) *value = NULL;
+        if (value_size) *value_size = 0;
+    }
+    return result;
+}
+
+// Commands answering with a count of keys affected
+static int remote_count(cache_instance_t* cache, size_t argc, const char** argv, int64_t* count) {
+    *count = 0;
+    return remote_command(cache, argc, argv, NULL, handle_integer, count);
+}
+
+typedef struct {
+    void** values;
+    size_t* sizes;
+    const size_t* slots;      // Caller index of each requested key
+} mget_out_t;
+
+static int handle_mget(const resp_reply_t* reply, void* ctx) {
+    mget_out_t* out = ctx;
+    if (reply->type != RESP_ARRAY) {
+        return reply->type == RESP_ERROR ? ERROR_INVALID_PARAM : ERROR_IO;
+    }
+    
+    const char* cursor = reply->data;
+    for (size_t i = 0; i < reply->length; i++) {
+        resp_reply_t element;
+        resp_next(&cursor, &element);
+        if (element.type == RESP_BULK) {
+            size_t slot = out->slots[i];
+            copy_value_out(element.data, element.length, &out->values[slot], &out->sizes[slot]);
+        }
+    }
+    return SUCCESS;
+}
+
+// One MGET for every non-NULL key
+static int remote_mget(cache_instance_t* cache, const char** keys, size_t key_count,
+                       void** values, size_t* sizes) {
+    const char** argv = safe_malloc((key_count + 1) * sizeof(char*));
+    size_t* slots = safe_malloc((key_count > 0 ? key_count : 1) * sizeof(size_t));
+    size_t argc = 0;
+    argv[argc++] = "MGET";
+    for (size_t i = 0; i < key_count; i++) {
+        if (keys[i]) {
+            slots[argc - 1] = i;
+            argv[argc++] = keys[i];
+        }
+    }
+    
+    mget_out_t out = {values, sizes, slots};
+    int result = argc > 1 ? remote_command(cache, argc, argv, NULL, handle_mget, &out) : SUCCESS;
+    safe_free((void**)&argv);
+    safe_free((void**)&slots);
+    return result;
+}
+
+// MSET when there is no default TTL; otherwise a pipeline of SET ... PX, all
+// sent before the first reply is read
+static int remote_mset(cache_instance_t* cache, const char** keys, void** values, size_t* value_sizes,
+                       size_t count) {
+    if (count == 0) {
+        return SUCCESS;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!keys[i] || (!values[i] && value_sizes[i] > 0)) {
+            return ERROR_INVALID_PARAM;
+        }
+    }
+    if (!cache->remote) {
+        return ERROR_IO;
+    }
+    resp_conn_t* conn = resp_acquire(cache->remote);
+    if (!conn) {
+        return ERROR_IO;
+    }
+    
+    uint64_t ttl_ms = cache->config.default_ttl_ms;
+    size_t replies;
+    if (ttl_ms == 0) {
+        size_t argc = 1 + count * 2;
+        const char** argv = safe_malloc(argc * sizeof(char*));
+        size_t* lens = safe_malloc(argc * sizeof(size_t));
+        argv[0] = "MSET";
+        lens[0] = 4;
+        for (size_t i = 0; i < count; i++) {
+            argv[1 + i * 2] = keys[i];
+            lens[1 + i * 2] = strlen(keys[i]);
+            argv[2 + i * 2] = value_sizes[i] > 0 ? values[i] : "";
+            lens[2 + i * 2] = value_sizes[i];
+        }
+        resp_append(conn, argc, argv, lens);
+        safe_free((void**)&argv);
+        safe_free((void**)&lens);
+        replies = 1;
+    } else {
+        char ttl[24];
+        snprintf(ttl, sizeof(ttl), "%" PRIu64, ttl_ms);
+        for (size_t i = 0; i < count; i++) {
+            const char* argv[] = {"SET", keys[i], value_sizes[i] > 0 ? values[i] : "", "PX", ttl};
+            size_t lens[] = {3, strlen(keys[i]), value_sizes[i], 2, strlen(ttl)};
+            resp_append(conn, 5, argv, lens);
+        }
+        replies = count;
+    }
+    
+    // Every reply is read even after a rejection so the connection stays in
+    // step
+    int result = resp_flush(conn);
+    int rejected = SUCCESS;
+    for (size_t i = 0; i < replies && result == SUCCESS; i++) {
+        resp_reply_t reply;
+        result = resp_read(conn, &reply);
+        if (result == SUCCESS && resp_ok(&reply) != SUCCESS) {
+            rejected = resp_ok(&reply);
+        }
+    }
+    resp_release(cache->remote, conn, result);
+    return result != SUCCESS ? result : rejected;
+}
+
+static int remote_mdelete(cache_instance_t* cache, const char** keys, size_t key_count) {
+    const char** argv = safe_malloc((key_count + 1) * sizeof(char*));
+    size_t argc = 0;
+    argv[argc++] = "DEL";
+    for (size_t i = 0; i < key_count; i++) {
+        if (keys[i]) {
+            argv[argc++] = keys[i];
+        }
+    }
+    
+    int64_t deleted;
+    int result = argc > 1 ? remote_count(cache, argc, argv, &deleted) : SUCCESS;
+    safe_free((void**)&argv);
+    return result;
+}
+
+// PEXPIRE, or for ttl_ms == 0 a pipelined PERSIST + EXISTS: PERSIST alone
+// can't tell a missing key from one that had no TTL
+static int remote_set_ttl(cache_instance_t* cache, const char* key, uint64_t ttl_ms) {
+    if (ttl_ms > 0) {
+        char ttl[24];
+        snprintf(ttl, sizeof(ttl), "%" PRIu64, ttl_ms);
+        const char* argv[] = {"PEXPIRE", key, ttl};
+        int64_t updated;
+        int result = remote_count(cache, 3, argv, &updated);
+        return result == SUCCESS && updated == 0 ? ERROR_NOT_FOUND : result;
+    }
+    
+    if (!cache->remote) {
+        return ERROR_IO;
+    }
+    resp_conn_t* conn = resp_acquire(cache->remote);
+    if (!conn) {
+        return ERROR_IO;
+    }
+    const char* persist[] = {"PERSIST", key};
+    const char* exists[] = {"EXISTS", key};
+    resp_append(conn, 2, persist, NULL);
+    resp_append(conn, 2, exists, NULL);
+    
+    resp_reply_t reply;
+    int64_t found = 0;
+    int result = resp_flush(conn);
+    if (result == SUCCESS) {
+        result = resp_read(conn, &reply);
+    }
+    if (result == SUCCESS) {
+        result = resp_read(conn, &reply);
+    }
+    if (result == SUCCESS) {
+        result = resp_integer(&reply, &found);
+    }
+    resp_release(cache->remote, conn, result);
+    return result == SUCCESS && found == 0 ? ERROR_NOT_FOUND : result;
+}
+
+// Send one command to several remote instances before reading any reply, so
+// writing to N replicas costs one round trip instead of N. Connections are
+// taken in address order: concurrent fan-outs over overlapping node sets
+// then can't each hold one pool while waiting on the other's. At most
+// RESP_MAX_FANOUT instances.
+static void remote_fanout(cache_instance_t** caches, size_t count, size_t argc, const char** argv,
+                          const size_t* lens, int64_t* integers, int* results) {
+    size_t order[RESP_MAX_FANOUT];
+    resp_conn_t* conns[RESP_MAX_FANOUT];
+    for (size_t i = 0; i < count; i++) {
+        size_t j = i;
+        while (j > 0 && (uintptr_t)caches[order[j - 1]] > (uintptr_t)caches[i]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+    
+    for (size_t k = 0; k < count; k++) {
+        size_t i = order[k];
+        conns[i] = caches[i]->remote ? resp_acquire(caches[i]->remote) : NULL;
+        results[i] = conns[i] ? SUCCESS : ERROR_IO;
+        if (conns[i]) {
+            resp_append(conns[i], argc, argv, lens);
+            results[i] = resp_flush(conns[i]);
+        }
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        if (!conns[i]) {
+            continue;
+        }
+        resp_reply_t reply;
+        if (results[i] == SUCCESS) {
+            results[i] = resp_read(conns[i], &reply);
+        }
+        if (results[i] == SUCCESS) {
+            results[i] = integers ? resp_integer(&reply, &integers[i]) : resp_ok(&reply);
+        }
+        resp_release(caches[i]->remote, conns[i], results[i]);
+    }
+}
+
+static bool is_remote(const cache_instance_t* cache) {
+    return cache->config.type == CACHE_TYPE_REDIS;
+}
+
+static int remote_get_ttl(cache_instance_t* cache, const char* key, uint64_t* ttl_ms) {
+    const char* argv[] = {"PTTL", key};
+    int64_t remaining;
+    int result = remote_count(cache, 2, argv, &remaining);
+    if (result != SUCCESS) {
+        return result;
+    }
+    if (remaining == -2) {
+        return ERROR_NOT_FOUND;
+    }
+    if (ttl_ms) {
+        *ttl_ms = remaining > 0 ? (uint64_t)remaining : 0;
+    }
+    return SUCCESS;
+}
+
+// =============================================================================
+// Cache instance management
+// =============================================================================
 
 cache_instance_t* cache_instance_create(cache_config_t* config) {
-    (void)config;
-    return (cache_instance_t*)calloc(1, 64);
+    if (!config) {
+        return NULL;
+    }
+    
+    cache_instance_t* cache = safe_calloc(1, sizeof(cache_instance_t));
+    cache->config = *config;
+    cache->stampede.method = STAMPEDE_LOCK;
+    cache->stampede.lock_timeout_ms = CACHE_DEFAULT_LOCK_TIMEOUT_MS;
+    pthread_mutex_init(&cache->refresh_lock, NULL);
+    pthread_cond_init(&cache->refresh_cond, NULL);
+    
+    pthread_once(&op_clock_once, op_clock_init);
+    pthread_mutex_init(&cache->op_lock, NULL);
+    cache->op_retired = safe_calloc(1, sizeof(op_histogram_t));
+    cache->op_key_created = pthread_key_create(&cache->op_key, op_histogram_release) == 0;
+    cache->op_timing = cache->op_key_created;
+    
+    // Shard count: a power of two, but never so many that shards hold only a
+    // handful of entries each
+    size_t shards = 1;
+    while (shards < CACHE_MAX_SHARDS &&
+           (config->max_size == 0 || config->max_size / (shards * 2) >= CACHE_MIN_ENTRIES_PER_SHARD)) {
+        shards *= 2;
+        cache->shard_bits++;
+    }
+    cache->shard_count = shards;
+    cache->shards = safe_calloc(shards, sizeof(cache_shard_t));
+    
+    size_t max_memory = config->max_memory_mb * 1024 * 1024;
+    for (size_t i = 0; i < shards; i++) {
+        cache_shard_t* shard = &cache->shards[i];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->bucket_count = CACHE_SHARD_MIN_BUCKETS;
+        shard->buckets = safe_calloc(shard->bucket_count, sizeof(cache_entry_t*));
+        shard->max_size = config->max_size > 0 ? (config->max_size + shards - 1) / shards : 0;
+        shard->max_memory = max_memory > 0 ? (max_memory + shards - 1) / shards : 0;
+        shard->rng = 0x9E3779B97F4A7C15ULL ^ (uint64_t)(i + 1);
+    }
+    
+    return cache;
 }
 
 void cache_instance_destroy(cache_instance_t* cache) {
-    free(cache);
+    if (!cache) return;
+    
+    refresher_stop(cache);
+    resp_pool_destroy(cache->remote);
+    pthread_mutex_destroy(&cache->refresh_lock);
+    pthread_cond_destroy(&cache->refresh_cond);
+    
+    if (cache->op_key_created) {
+        pthread_key_delete(cache->op_key);
+    }
+    while (cache->op_threads) {
+        op_histogram_t* histogram = cache->op_threads;
+        cache->op_threads = histogram->next;
+        safe_free((void**)&histogram);
+    }
+    safe_free((void**)&cache->op_retired);
+    pthread_mutex_destroy(&cache->op_lock);
+    
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        cache_shard_t* shard = &cache->shards[i];
+        shard_clear(shard);
+        safe_free((void**)&shard->buckets);
+        safe_free((void**)&shard->tag_buckets);
+        safe_free((void**)&shard->trie);
+        pthread_mutex_destroy(&shard->lock);
+    }
+    safe_free((void**)&cache->shards);
+    safe_free((void**)&cache->invalidations);
+    safe_free((void**)&cache);
 }
 
 int cache_instance_connect(cache_instance_t* cache) {
-    (void)cache;
+    if (!cache) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (cache->config.type == CACHE_TYPE_REDIS && !cache->remote) {
+        resp_pool_t* pool = resp_pool_create(&cache->config);
+        resp_conn_t* conn = resp_acquire(pool);
+        if (!conn) {
+            resp_pool_destroy(pool);
+            return ERROR_IO;
+        }
+        resp_release(pool, conn, SUCCESS);
+        cache->remote = pool;
+    }
+    cache->connected = true;
     return SUCCESS;
 }
 
 int cache_instance_disconnect(cache_instance_t* cache) {
-    (void)cache;
+    if (!cache) {
+        return ERROR_INVALID_PARAM;
+    }
+    resp_pool_destroy(cache->remote);
+    cache->remote = NULL;
+    cache->connected = false;
     return SUCCESS;
 }
 
+// =============================================================================
+// Basic cache operations
+// =============================================================================
+
 int cache_set(cache_instance_t* cache, const char* key, const void* value, size_t value_size) {
-    (void)cache; (void)key; (void)value; (void)value_size;
+    if (!cache) {
+        return ERROR_INVALID_PARAM;
+    }
+    return cache_set_with_ttl(cache, key, value, value_size, cache->config.default_ttl_ms);
+}
+
+// The single-key operations without timing; batches call these per key so
+// only the batch is recorded
+static int instance_set(cache_instance_t* cache, const char* key, const void* value, size_t value_size,
+                        uint64_t ttl_ms) {
+    if (!key || (!value && value_size > 0)) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (is_remote(cache)) {
+        return remote_set(cache, key, value, value_size, ttl_ms);
+    }
+    
+    uint32_t hash = hash_key(key);
+    cache_shard_t* shard = shard_for(cache, hash);
+    
+    // Compress before taking the shard lock
+    packed_value_t packed;
+    value_pack(cache, value, value_size, &packed);
+    
+    pthread_mutex_lock(&shard->lock);
+    int result = shard_store_packed(cache, shard, key, hash, &packed, ttl_ms, get_timestamp_ms());
+    pthread_mutex_unlock(&shard->lock);
+    
+    safe_free(&packed.buffer);
+    return result;
+}
+
+static int instance_get(cache_instance_t* cache, const char* key, void** value, size_t* value_size) {
+    if (!key) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (is_remote(cache)) {
+        return remote_get(cache, key, value, value_size);
+    }
+    
+    uint32_t hash = hash_key(key);
+    cache_shard_t* shard = shard_for(cache, hash);
+    uint64_t now = get_timestamp_ms();
+    
+    pthread_mutex_lock(&shard->lock);
+    
+    cache_entry_t* entry = shard_lookup(shard, key, hash, now);
+    if (!entry) {
+        shard->misses++;
+        pthread_mutex_unlock(&shard->lock);
+        if (value) *value = NULL;
+        if (value_size) *value_size = 0;
+        return ERROR_NOT_FOUND;
+    }
+    
+    shard->hits++;
+    shard_touch(cache, shard, entry, now);
+    entry_copy_out(shard, entry, value, value_size);
+    
+    pthread_mutex_unlock(&shard->lock);
     return SUCCESS;
 }
 
+static int instance_delete(cache_instance_t* cache, const char* key) {
+    if (!key) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (is_remote(cache)) {
+        const char* argv[] = {"DEL", key};
+        int64_t deleted;
+        int result = remote_count(cache, 2, argv, &deleted);
+        return result == SUCCESS && deleted == 0 ? ERROR_NOT_FOUND : result;
+    }
+    
+    uint32_t hash = hash_key(key);
+    cache_shard_t* shard = shard_for(cache, hash);
+    
+    pthread_mutex_lock(&shard->lock);
+    cache_entry_t* entry = shard_lookup(shard, key, hash, get_timestamp_ms());
+    if (entry) {
+        shard_remove(shard, entry);
+        shard->deletes++;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    
+    return entry ? SUCCESS : ERROR_NOT_FOUND;
+}
+
 int cache_set_with_ttl(cache_instance_t* cache, const char* key, const void* value, size_t value_size, uint64_t ttl_ms) {
-    (void)cache; (void)key; (void)value; (void)value_size; (void)ttl_ms;
-    return SUCCESS;
+    if (!cache) {
+        return ERROR_INVALID_PARAM;
+    }
+    uint64_t start = op_timer_start(cache);
+    int result = instance_set(cache, key, value, value_size, ttl_ms);
+    op_timer_stop(cache, CACHE_OP_SET, start);
+    return result;
 }
 
 int cache_get(cache_instance_t* cache, const char* key, void** value, size_t* value_size) {
-    (void)cache; (void)key;
-    *value = NULL;
-    if (value_size) *value_size = 0;
-    return SUCCESS;
+    if (!cache) {
+        return ERROR_INVALID_PARAM;
+    }
+    uint64_t start = op_timer_start(cache);
+    int result = instance_get(cache, key, value, value_size);
+    op_timer_stop(cache, CACHE_OP_GET, start);
+    return result;
 }
 
 int cache_delete(cache_instance_t* cache, const char* key) {
-    (void)cache; (void)key;
-    return SUCCESS;
+    if (!cache) {
+        return ERROR_INVALID_PARAM;
+    }
+    uint64_t start = op_timer_start(cache);
+    int result = instance_delete(cache, key);
+    op_timer_stop(cache, CACHE_OP_DELETE, start);
+    return result;
 }
 
 bool cache_exists(cache_instance_t* cache, const char* key) {
-    (void)cache; (void)key;
-    return false;
+    if (!cache || !key) {
+        return false;
+    }
+    if (is_remote(cache)) {
+        const char* argv[] = {"EXISTS", key};
+        int64_t found;
+        return remote_count(cache, 2, argv, &found) == SUCCESS && found > 0;
+    }
+    
+    uint32_t hash = hash_key(key);
+    cache_shard_t* shard = shard_for(cache, hash);
+    
+    pthread_mutex_lock(&shard->lock);
+    bool exists = shard_lookup(shard, key, hash, get_timestamp_ms()) != NULL;
+    pthread_mutex_unlock(&shard->lock);
+    
+    return exists;
 }
 
 int cache_increment(cache_instance_t* cache, const char* key, int64_t delta, int64_t* new_value) {
-    (void)cache; (void)key; (void)delta;
-    if (new_value) *new_value = 0;
-    return SUCCESS;
+    if (!cache || !key) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (is_remote(cache)) {
+        char amount[24];
+        snprintf(amount, sizeof(amount), "%" PRId64, delta);
+        const char* argv[] = {"INCRBY", key, amount};
+        int64_t value;
+        int result = remote_count(cache, 3, argv, &value);
+        if (result == SUCCESS && new_value) {
+            *new_value = value;
+        }
+        return result;
+    }
+    
+    uint32_t hash = hash_key(key);
+    cache_shard_t* shard = shard_for(cache, hash);
+    
+    pthread_mutex_lock(&shard->lock);
+    int result = shard_add(cache, shard, key, hash, delta, new_value, get_timestamp_ms());
+    pthread_mutex_unlock(&shard->lock);
+    
+    return result;
 }
 
 int cache_decrement(cache_instance_t* cache, const char* key, int64_t delta, int64_t* new_value) {
-    (void)cache; (void)key; (void)delta;
-    if (new_value) *new_value = 0;
-    return SUCCESS;
+    if (delta == INT64_MIN) {
+        return ERROR_INVALID_PARAM;
+    }
+    return cache_increment(cache, key, -delta, new_value);
 }
 
 int cache_append(cache_instance_t* cache, const char* key, const void* value, size_t value_size) {
-    (void)cache; (void)key; (void)value; (void)value_size;
-    return SUCCESS;
+    if (!cache || !key || (!value && value_size > 0)) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (is_remote(cache)) {
+        const char* argv[] = {"APPEND", key, value_size > 0 ? value : ""};
+        size_t lens[] = {6, strlen(key), value_size};
+        int64_t length;
+        return remote_command(cache, 3, argv, lens, handle_integer, &length);
+    }
+    
+    uint32_t hash = hash_key(key);
+    cache_shard_t* shard = shard_for(cache, hash);
+    uint64_t now = get_timestamp_ms();
+    
+    pthread_mutex_lock(&shard->lock);
+    
+    int result;
+    cache_entry_t* entry = shard_lookup(shard, key, hash, now);
+    if (!entry) {
+        result = shard_store(cache, shard, key, hash, value, value_size,
+                             cache->config.default_ttl_ms, now);
+    } else if (entry->compressed || compression_applies(cache, entry->raw_size + value_size)) {
+        // Recompress the whole value; the entry keeps its TTL
+        void* joined;
+        size_t joined_size;
+        entry_copy_out(shard, entry, &joined, &joined_size);
+        joined = safe_realloc(joined, joined_size + value_size);
+        memcpy((char*)joined + joined_size, value, value_size);
+        joined_size += value_size;
+        
+        packed_value_t packed;
+        value_pack(cache, joined, joined_size, &packed);
+        result = packed.size > entry->value_size
+                     ? shard_make_room(cache, shard, packed.size - entry->value_size, entry, now)
+                     : SUCCESS;
+        if (result == SUCCESS) {
+            shard->memory_used = shard->memory_used - entry->value_size + packed.size;
+            entry->charge = entry->charge - entry->value_size + packed.size;
+            entry_set_value(shard, entry, &packed);
+            shard_touch(cache, shard, entry, now);
+            shard->sets++;
+        }
+        safe_free(&packed.buffer);
+        safe_free(&joined);
+    } else if ((result = shard_make_room(cache, shard, value_size, entry, now)) == SUCCESS) {
+        entry->value = safe_realloc(entry->value, entry->value_size + value_size);
+        memcpy((char*)entry->value + entry->value_size, value, value_size);
+        entry->value_size += value_size;
+        entry->raw_size += value_size;
+        entry->charge += value_size;
+        shard->memory_used += value_size;
+        shard_touch(cache, shard, entry, now);
+        shard->sets++;
+    }
+    if (entry && result == SUCCESS) {
+        near_publish(shard, hash);
+    }
+    
+    pthread_mutex_unlock(&shard->lock);
+    return result;
 }
 
+// Batch operations: misses come back as NULL values with size 0. The arrays
+// (and each value) belong to the caller.
 int cache_mget(cache_instance_t* cache, const char** keys, size_t key_count, void*** values, size_t** value_sizes) {
-    (void)cache; (void)keys; (void)key_count;
-    *values = NULL;
-    *value_sizes = NULL;
-    return SUCCESS;
+    if (!cache || !values || (!keys && key_count > 0)) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    uint64_t start = op_timer_start(cache);
+    *values = safe_calloc(key_count > 0 ? key_count : 1, sizeof(void*));
+    size_t* sizes = safe_calloc(key_count > 0 ? key_count : 1, sizeof(size_t));
+    
+    int result = SUCCESS;
+    if (is_remote(cache)) {
+        result = remote_mget(cache, keys, key_count, *values, sizes);
+    } else {
+        for (size_t i = 0; i < key_count; i++) {
+            if (keys[i]) {
+                instance_get(cache, keys[i], &(*values)[i], &sizes[i]);
+            }
+        }
+    }
+    op_timer_stop(cache, CACHE_OP_MGET, start);
+    
+    if (value_sizes) {
+        *value_sizes = sizes;
+    } else {
+        safe_free((void**)&sizes);
+    }
+    return result;
 }
 
 int cache_mset(cache_instance_t* cache, const char** keys, void** values, size_t* value_sizes, size_t count) {
-    (void)cache; (void)keys; (void)values; (void)value_sizes; (void)count;
-    return SUCCESS;
+    if (!cache || (count > 0 && (!keys || !values || !value_sizes))) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    uint64_t start = op_timer_start(cache);
+    int result = SUCCESS;
+    if (is_remote(cache)) {
+        result = remote_mset(cache, keys, values, value_sizes, count);
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            int status = instance_set(cache, keys[i], values[i], value_sizes[i], cache->config.default_ttl_ms);
+            if (status != SUCCESS) {
+                result = status;
+            }
+        }
+    }
+    op_timer_stop(cache, CACHE_OP_MSET, start);
+    return result;
 }
 
 int cache_mdelete(cache_instance_t* cache, const char** keys, size_t key_count) {
-    (void)cache; (void)keys; (void)key_count;
-    return SUCCESS;
+    if (!cache || (!keys && key_count > 0)) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    uint64_t start = op_timer_start(cache);
+    int result = SUCCESS;
+    if (is_remote(cache)) {
+        result = remote_mdelete(cache, keys, key_count);
+    } else {
+        for (size_t i = 0; i < key_count; i++) {
+            if (keys[i]) {
+                instance_delete(cache, keys[i]);
+            }
+        }
+    }
+    op_timer_stop(cache, CACHE_OP_MDELETE, start);
+    return result;
 }
 
+// =============================================================================
+// TTL management
+// =============================================================================
+
+// ttl_ms == 0 removes the TTL
 int cache_set_ttl(cache_instance_t* cache, const char* key, uint64_t ttl_ms) {
-    (void)cache; (void)key; (void)ttl_ms;
-    return SUCCESS;
+    if (!cache || !key) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (is_remote(cache)) {
+        return remote_set_ttl(cache, key, ttl_ms);
+    }
+    
+    uint32_t hash = hash_key(key);
+    cache_shard_t* shard = shard_for(cache, hash);
+    uint64_t now = get_timestamp_ms();
+    
+    pthread_mutex_lock(&shard->lock);
+    cache_entry_t* entry = shard_lookup(shard, key, hash, now);
+    if (entry) {
+        entry_set_ttl(shard, entry, ttl_ms, now);
+        near_publish(shard, hash);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    
+    return entry ? SUCCESS : ERROR_NOT_FOUND;
 }
 
+// Remaining time to live; 0 for keys without a TTL
 int cache_get_ttl(cache_instance_t* cache, const char* key, uint64_t* ttl_ms) {
-    (void)cache; (void)key;
-    if (ttl_ms) *ttl_ms = 0;
-    return SUCCESS;
+    if (!cache || !key) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (is_remote(cache)) {
+        return remote_get_ttl(cache, key, ttl_ms);
+    }
+    
+    uint32_t hash = hash_key(key);
+    cache_shard_t* shard = shard_for(cache, hash);
+    uint64_t now = get_timestamp_ms();
+    
+    pthread_mutex_lock(&shard->lock);
+    cache_entry_t* entry = shard_lookup(shard, key, hash, now);
+    if (entry && ttl_ms) {
+        *ttl_ms = entry->ttl_ms > 0 ? entry->expires_at - now : 0;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    
+    return entry ? SUCCESS : ERROR_NOT_FOUND;
 }
 
 int cache_persist(cache_instance_t* cache, const char* key) {
-    (void)cache; (void)key;
-    return SUCCESS;
+    return cache_set_ttl(cache, key, 0);
 }
 
+// Restart the key's TTL from now
 int cache_touch(cache_instance_t* cache, const char* key) {
-    (void)cache; (void)key;
-    return SUCCESS;
+    if (!cache || !key) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    uint32_t hash = hash_key(key);
+    cache_shard_t* shard = shard_for(cache, hash);
+    uint64_t now = get_timestamp_ms();
+    
+    pthread_mutex_lock(&shard->lock);
+    cache_entry_t* entry = shard_lookup(shard, key, hash, now);
+    if (entry) {
+        entry_set_ttl(shard, entry, entry->ttl_ms, now);
+        shard_touch(cache, shard, entry, now);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    
+    return entry ? SUCCESS : ERROR_NOT_FOUND;
 }
 
+// Drop every expired entry; returns how many were removed
 int cache_expire_keys(cache_instance_t* cache) {
-    (void)cache;
-    return SUCCESS;
+    if (!cache) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    int expired = 0;
+    uint64_t now = get_timestamp_ms();
+    
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        cache_shard_t* shard = &cache->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        cache_entry_t* entry = shard->head;
+        while (entry) {
+            cache_entry_t* next = entry->next;
+            if (entry_expired(entry, now)) {
+                shard_remove(shard, entry);
+                shard->expirations++;
+                expired++;
+            }
+            entry = next;
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+    
+    return expired;
 }
 
-int cache_get_expiring_keys(cache_instance_t* cache, uint64_t within_ms, char*** keys, size_t* count) {
-    (void)cache; (void)within_ms;
-    *keys = NULL;
+// Snapshot live keys into a caller-owned array, optionally only those
+// expiring within `within_ms`
+static int collect_keys(cache_instance_t* cache, bool expiring_only, uint64_t within_ms,
+                        char*** keys, size_t* count) {
+    if (!cache || !keys || !count) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    size_t capacity = 16;
+    *keys = safe_malloc(capacity * sizeof(char*));
     *count = 0;
+    uint64_t now = get_timestamp_ms();
+    
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        cache_shard_t* shard = &cache->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        for (cache_entry_t* entry = shard->head; entry; entry = entry->next) {
+            if (entry_expired(entry, now)) {
+                continue;
+            }
+            if (expiring_only && (entry->ttl_ms == 0 || entry->expires_at > now + within_ms)) {
+                continue;
+            }
+            if (*count == capacity) {
+                capacity *= 2;
+                *keys = safe_realloc(*keys, capacity * sizeof(char*));
+            }
+            (*keys)[(*count)++] = safe_strdup(entry->key);
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+    
     return SUCCESS;
 }
 
+int cache_get_expiring_keys(cache_instance_t* cache, uint64_t within_ms, char*** keys, size_t* count) {
+    return collect_keys(cache, true, within_ms, keys, count);
+}
+
+// =============================================================================
+// Cache invalidation
+// =============================================================================
+
 int cache_invalidate_key(cache_instance_t* cache, const char* key) {
-    (void)cache; (void)key;
-    return SUCCESS;
+    int result = cache_delete(cache, key);
+    return result == ERROR_NOT_FOUND ? SUCCESS : result;
+}
+
+// Remove keys starting with prefix, a batch per lock hold. Each batch costs
+// the prefix walk plus the keys it removes.
+static size_t shard_invalidate_prefix(cache_shard_t* shard, const char* prefix, size_t prefix_len) {
+    cache_entry_t* batch[INVALIDATE_BATCH];
+    size_t removed = 0;
+    size_t count;
+    
+    do {
+        pthread_mutex_lock(&shard->lock);
+        shard_index_keys(shard);
+        trie_node_t* node = trie_find_prefix(shard->trie, prefix, prefix_len);
+        count = node ? trie_collect(node, batch, INVALIDATE_BATCH, 0) : 0;
+        for (size_t i = 0; i < count; i++) {
+            shard_remove(shard, batch[i]);
+        }
+        shard->deletes += count;
+        pthread_mutex_unlock(&shard->lock);
+        removed += count;
+    } while (count == INVALIDATE_BATCH);
+    
+    return removed;
+}
+
+// Longest run of plain characters in a glob: every match must contain it, so
+// a strstr can reject most keys before fnmatch. Left empty when the pattern
+// has escapes.
+static void glob_literal(const char* pattern, char* literal, size_t literal_size) {
+    literal[0] = '\0';
+    if (strchr(pattern, '\\')) {
+        return;
+    }
+    
+    size_t best = 0;
+    const char* p = pattern;
+    while (*p) {
+        if (*p == '*' || *p == '?') {
+            p++;
+            continue;
+        }
+        if (*p == '[') {
+            // Skip the bracket expression; a ']' right after "[" or "[!" is a member
+            p++;
+            if (*p == '!' || *p == '^') p++;
+            if (*p == ']') p++;
+            while (*p && *p != ']') p++;
+            if (*p) p++;
+            continue;
+        }
+        
+        size_t run = strcspn(p, "*?[");
+        if (run > best && run < literal_size) {
+            memcpy(literal, p, run);
+            literal[run] = '\0';
+            best = run;
+        }
+        p += run;
+    }
+}
+
+// One lock hold's share of a glob walk. The trie may change between holds,
+// so the walk resumes by key: cursor is the path of the last node visited,
+// and only nodes whose path sorts after it are visited again.
+typedef struct {
+    const char* pattern;
+    const char* literal;
+    char* path;               // Path of the node being visited
+    size_t path_capacity;
+    char* cursor;             // NULL on the first hold
+    size_t cursor_len;
+    cache_entry_t* batch[INVALIDATE_BATCH];
+    size_t count;
+    size_t budget;            // Nodes left to visit this hold
+    bool stopped;
+} glob_walk_t;
+
+static void glob_walk_extend(glob_walk_t* walk, size_t length, const trie_node_t* node) {
+    if (length + node->label_len > walk->path_capacity) {
+        walk->path_capacity = (length + node->label_len) * 2;
+        walk->path = safe_realloc(walk->path, walk->path_capacity);
+    }
+    memcpy(walk->path + length, node->label, node->label_len);
+}
+
+// Whether the subtree at a path of this length holds paths after the cursor:
+// 1 if all of it does, 0 if only some can (the path leads to the cursor) and
+// -1 if none does
+static int glob_walk_position(const glob_walk_t* walk, size_t length) {
+    if (!walk->cursor) {
+        return 1;
+    }
+    size_t common = length < walk->cursor_len ? length : walk->cursor_len;
+    int order = memcmp(walk->path, walk->cursor, common);
+    if (order != 0) {
+        return order > 0 ? 1 : -1;
+    }
+    return length > walk->cursor_len ? 1 : 0;
+}
+
+// Pre-order walk of node (whose path fills walk->path[0, length)), stopping
+// once the batch fills or the budget runs out
+static void glob_walk_node(glob_walk_t* walk, trie_node_t* node, size_t length, bool after) {
+    if (after) {
+        cache_entry_t* entry = node->entry;
+        if (entry && strstr(entry->key, walk->literal) && fnmatch(walk->pattern, entry->key, 0) == 0) {
+            walk->batch[walk->count++] = entry;
+        }
+        if (--walk->budget == 0 || walk->count == INVALIDATE_BATCH) {
+            walk->stopped = true;
+            walk->cursor = safe_realloc(walk->cursor, length + 1);
+            memcpy(walk->cursor, walk->path, length);
+            walk->cursor_len = length;
+            return;
+        }
+    }
+    
+    for (trie_node_t* child = node->children; child && !walk->stopped; child = child->sibling) {
+        glob_walk_extend(walk, length, child);
+        size_t child_length = length + child->label_len;
+        int position = after ? 1 : glob_walk_position(walk, child_length);
+        if (position >= 0) {
+            glob_walk_node(walk, child, child_length, position > 0);
+        }
+    }
+}
+
+// Remove keys under the pattern's literal prefix that match it. Each lock
+// hold visits a bounded slice of the trie and deletes what it matched, so
+// writers get at the shard between holds even when the glob has no prefix
+// and the walk covers every key.
+static size_t shard_invalidate_glob(cache_shard_t* shard, const char* pattern, size_t prefix_len,
+                                    const char* literal) {
+    glob_walk_t walk = { .pattern = pattern, .literal = literal, .path_capacity = 64 };
+    walk.path = safe_malloc(walk.path_capacity);
+    size_t removed = 0;
+    
+    do {
+        walk.count = 0;
+        walk.budget = INVALIDATE_SCAN;
+        walk.stopped = false;
+        
+        pthread_mutex_lock(&shard->lock);
+        shard_index_keys(shard);
+        trie_node_t* node = trie_find_prefix(shard->trie, pattern, prefix_len);
+        if (node) {
+            // Rebuild the start node's path; it can be longer than the prefix
+            size_t length = 0;
+            for (trie_node_t* up = node; up->parent; up = up->parent) {
+                length += up->label_len;
+            }
+            if (length > walk.path_capacity) {
+                walk.path_capacity = length * 2;
+                walk.path = safe_realloc(walk.path, walk.path_capacity);
+            }
+            size_t end = length;
+            for (trie_node_t* up = node; up->parent; up = up->parent) {
+                end -= up->label_len;
+                memcpy(walk.path + end, up->label, up->label_len);
+            }
+            
+            int position = glob_walk_position(&walk, length);
+            if (position >= 0) {
+                glob_walk_node(&walk, node, length, position > 0);
+            }
+        }
+        for (size_t i = 0; i < walk.count; i++) {
+            shard_remove(shard, walk.batch[i]);
+        }
+        shard->deletes += walk.count;
+        pthread_mutex_unlock(&shard->lock);
+        removed += walk.count;
+    } while (walk.stopped);
+    
+    safe_free((void**)&walk.path);
+    safe_free((void**)&walk.cursor);
+    return removed;
+}
+
+typedef struct {
+    cache_instance_t* cache;
+    const char* pattern;
+    size_t prefix_len;
+    const char* literal;
+    bool glob;
+    size_t first_shard;
+    size_t stride;
+    size_t removed;
+} pattern_job_t;
+
+static void* pattern_worker(void* arg) {
+    pattern_job_t* job = (pattern_job_t*)arg;
+    for (size_t i = job->first_shard; i < job->cache->shard_count; i += job->stride) {
+        cache_shard_t* shard = &job->cache->shards[i];
+        job->removed += job->glob ? shard_invalidate_glob(shard, job->pattern, job->prefix_len, job->literal)
+                                  : shard_invalidate_prefix(shard, job->pattern, job->prefix_len);
+    }
+    return NULL;
 }
 
 int cache_invalidate_pattern(cache_instance_t* cache, const char* pattern) {
-    (void)cache; (void)pattern;
-    return SUCCESS;
+    if (!cache || !pattern) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    size_t prefix_len = strcspn(pattern, "*?[\\");
+    if (pattern[prefix_len] == '\0') {
+        return cache_delete(cache, pattern) == SUCCESS ? 1 : 0;
+    }
+    
+    // "prefix*" is answered from the trie alone; anything else is matched
+    // with fnmatch, by several threads when there is no prefix to narrow it
+    bool glob = strcmp(pattern + prefix_len, "*") != 0;
+    char literal[64];
+    glob_literal(pattern, literal, sizeof(literal));
+    
+    size_t threads = 1;
+    if (glob && prefix_len == 0) {
+        threads = cache->shard_count < PATTERN_SCAN_THREADS ? cache->shard_count : PATTERN_SCAN_THREADS;
+    }
+    
+    pattern_job_t jobs[PATTERN_SCAN_THREADS];
+    pthread_t workers[PATTERN_SCAN_THREADS];
+    bool started[PATTERN_SCAN_THREADS] = { false };
+    for (size_t t = 0; t < threads; t++) {
+        jobs[t] = (pattern_job_t){ cache, pattern, prefix_len, literal, glob, t, threads, 0 };
+        if (t > 0) {
+            started[t] = pthread_create(&workers[t], NULL, pattern_worker, &jobs[t]) == 0;
+        }
+    }
+    
+    size_t removed = 0;
+    for (size_t t = 0; t < threads; t++) {
+        if (started[t]) {
+            pthread_join(workers[t], NULL);
+        } else {
+            pattern_worker(&jobs[t]);
+        }
+        removed += jobs[t].removed;
+    }
+    
+    return (int)removed;
 }
 
 int cache_invalidate_tag(cache_instance_t* cache, const char* tag) {
-    (void)cache; (void)tag;
-    return SUCCESS;
+    if (!cache || !tag) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    uint32_t hash = hash_key(tag);
+    size_t removed = 0;
+    
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        cache_shard_t* shard = &cache->shards[i];
+        size_t count;
+        do {
+            pthread_mutex_lock(&shard->lock);
+            tag_node_t* node;
+            for (count = 0; count < INVALIDATE_BATCH && (node = tag_find(shard, tag, hash)) != NULL; count++) {
+                shard_remove(shard, node->members->entry);
+            }
+            shard->deletes += count;
+            pthread_mutex_unlock(&shard->lock);
+            removed += count;
+        } while (count == INVALIDATE_BATCH);
+    }
+    
+    return (int)removed;
 }
 
 int cache_invalidate_all(cache_instance_t* cache) {
-    (void)cache;
+    if (!cache) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (is_remote(cache)) {
+        const char* argv[] = {"FLUSHDB"};
+        return remote_command(cache, 1, argv, NULL, handle_ok, NULL);
+    }
+    
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        cache_shard_t* shard = &cache->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        shard->deletes += shard->size;
+        shard_clear(shard);
+        pthread_mutex_unlock(&shard->lock);
+    }
     return SUCCESS;
 }
 
 int cache_set_with_tags(cache_instance_t* cache, const char* key, const void* value, size_t value_size, const char** tags, size_t tag_count) {
-    (void)cache; (void)key; (void)value; (void)value_size; (void)tags; (void)tag_count;
-    return SUCCESS;
+    if (!cache || !key || (!value && value_size > 0) || (!tags && tag_count > 0)) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    uint32_t hash = hash_key(key);
+    cache_shard_t* shard = shard_for(cache, hash);
+    
+    pthread_mutex_lock(&shard->lock);
+    int result = shard_store(cache, shard, key, hash, value, value_size,
+                             cache->config.default_ttl_ms, get_timestamp_ms());
+    if (result == SUCCESS) {
+        entry_set_tags(shard, shard_find(shard, key, hash), tags, tag_count);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    
+    return result;
 }
 
 int cache_get_keys_by_tag(cache_instance_t* cache, const char* tag, char*** keys, size_t* count) {
-    (void)cache; (void)tag;
-    *keys = NULL;
+    if (!cache || !tag || !keys || !count) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    uint32_t hash = hash_key(tag);
+    size_t capacity = 16;
+    *keys = safe_malloc(capacity * sizeof(char*));
     *count = 0;
+    uint64_t now = get_timestamp_ms();
+    
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        cache_shard_t* shard = &cache->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        tag_node_t* node = tag_find(shard, tag, hash);
+        for (tag_link_t* link = node ? node->members : NULL; link; link = link->next) {
+            if (entry_expired(link->entry, now)) {
+                continue;
+            }
+            if (*count == capacity) {
+                capacity *= 2;
+                *keys = safe_realloc(*keys, capacity * sizeof(char*));
+            }
+            (*keys)[(*count)++] = safe_strdup(link->entry->key);
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+    
     return SUCCESS;
 }
 
@@ -167,32 +3237,192 @@ int cache_invalidate_version(cache_instance_t* cache, uint64_t version) {
     return SUCCESS;
 }
 
+// =============================================================================
+// Stampede prevention
+// =============================================================================
+
 cache_instance_t* cache_with_stampede_prevention(cache_instance_t* cache, stampede_config_t* config) {
-    (void)cache; (void)config;
+    if (!cache || !config) {
+        return cache;
+    }
+    
+    cache->stampede = *config;
+    if (cache->stampede.lock_timeout_ms == 0) {
+        cache->stampede.lock_timeout_ms = CACHE_DEFAULT_LOCK_TIMEOUT_MS;
+    }
+    
+    if (config->method == STAMPEDE_PRECOMPUTE && !cache->refresher_running) {
+        cache->refresher_stop = false;
+        cache->refresher_running =
+            pthread_create(&cache->refresher, NULL, refresher_main, cache) == 0;
+    }
     return cache;
 }
 
-int cache_get_with_lock(cache_instance_t* cache, const char* key, void** value, size_t* value_size, void* (*loader_fn)(const char* key, void* ctx), void* ctx) {
-    (void)cache; (void)key; (void)loader_fn; (void)ctx;
-    *value = NULL;
-    if (value_size) *value_size = 0;
-    return SUCCESS;
+// Single-flight read-through: on a miss exactly one caller per key runs the
+// loader while the others wait (up to lock_timeout_ms) for its result. A
+// failed load (loader returns NULL) is reported to every waiter and nothing
+// is cached, so the next caller retries.
+//
+// Hits may also trigger an early reload (see refresh_due): inline in the
+// hitting caller for STAMPEDE_PROBABILISTIC, on the refresher thread for
+// STAMPEDE_PRECOMPUTE. Either way other readers keep getting the current
+// value until the new one lands.
+int cache_get_with_lock(cache_instance_t* cache, const char* key, void** value, size_t* value_size,
+                        cache_loader_fn loader, void* ctx) {
+    if (!cache || !key || !loader) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    uint32_t hash = hash_key(key);
+    cache_shard_t* shard = shard_for(cache, hash);
+    struct timespec deadline = deadline_after(cache->stampede.lock_timeout_ms);
+    
+    pthread_mutex_lock(&shard->lock);
+    
+    flight_t* flight;
+    bool early = false;
+    for (;;) {
+        uint64_t now = get_timestamp_ms();
+        cache_entry_t* entry = shard_lookup(shard, key, hash, now);
+        flight = flight_find(shard, key, hash);
+        
+        if (entry) {
+            shard->hits++;
+            shard_touch(cache, shard, entry, now);
+            
+            if (!flight && refresh_due(cache, shard, entry, now)) {
+                shard->early_refreshes++;
+                if (!cache->refresher_running) {
+                    early = true;
+                    break;
+                }
+                refresh_schedule(cache, shard, key, hash, loader, ctx);
+            }
+            
+            entry_copy_out(shard, entry, value, value_size);
+            pthread_mutex_unlock(&shard->lock);
+            return SUCCESS;
+        }
+        
+        if (!flight) {
+            shard->misses++;
+            break;
+        }
+        
+        if (!flight_wait(shard, flight, &deadline)) {
+            pthread_mutex_unlock(&shard->lock);
+            return ERROR_TIMEOUT;
+        }
+        
+        if (flight->has_value || flight->status != SUCCESS) {
+            int status = flight->status;
+            if (status == SUCCESS) {
+                shard->hits++;
+                copy_value_out(flight->value, flight->value_size, value, value_size);
+            }
+            flight_release(flight);
+            pthread_mutex_unlock(&shard->lock);
+            return status;
+        }
+        
+        // An explicit key lock ended; whoever held it may have filled the cache
+        flight_release(flight);
+    }
+    
+    // This caller loads
+    flight = flight_begin(shard, key, hash);
+    pthread_mutex_unlock(&shard->lock);
+    
+    uint64_t start = monotonic_us();
+    uint64_t timer = op_timer_start(cache);
+    size_t loaded_size = 0;
+    void* loaded = loader(key, ctx, &loaded_size);
+    op_timer_stop(cache, CACHE_OP_LOAD, timer);
+    uint64_t elapsed = monotonic_us() - start;
+    
+    pthread_mutex_lock(&shard->lock);
+    
+    int status = load_complete(cache, shard, flight, loaded, loaded_size, elapsed);
+    if (status == SUCCESS) {
+        copy_value_out(flight->value, flight->value_size, value, value_size);
+    } else if (early) {
+        // A failed early refresh still leaves the current value usable
+        cache_entry_t* entry = shard_lookup(shard, key, hash, get_timestamp_ms());
+        if (entry) {
+            entry_copy_out(shard, entry, value, value_size);
+            status = SUCCESS;
+        }
+    }
+    flight_finish(shard, flight);
+    
+    pthread_mutex_unlock(&shard->lock);
+    return status;
 }
 
+// Explicit per-key locks share the in-flight table with cache_get_with_lock,
+// so a key held here also makes loaders for that key wait
 cache_lock_t* cache_lock_acquire(cache_instance_t* cache, const char* key, uint64_t timeout_ms) {
-    (void)cache; (void)key; (void)timeout_ms;
-    return (cache_lock_t*)calloc(1, 64);
+    if (!cache || !key) {
+        return NULL;
+    }
+    
+    uint32_t hash = hash_key(key);
+    cache_shard_t* shard = shard_for(cache, hash);
+    struct timespec deadline = deadline_after(timeout_ms);
+    
+    pthread_mutex_lock(&shard->lock);
+    
+    flight_t* holder;
+    while ((holder = flight_find(shard, key, hash)) != NULL) {
+        bool done = flight_wait(shard, holder, &deadline);
+        flight_release(holder);
+        if (!done) {
+            pthread_mutex_unlock(&shard->lock);
+            return NULL;
+        }
+    }
+    
+    cache_lock_t* lock = safe_malloc(sizeof(cache_lock_t));
+    lock->shard = shard;
+    lock->flight = flight_begin(shard, key, hash);
+    
+    pthread_mutex_unlock(&shard->lock);
+    return lock;
 }
 
 int cache_lock_release(cache_lock_t* lock) {
-    free(lock);
+    if (!lock) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    pthread_mutex_lock(&lock->shard->lock);
+    flight_finish(lock->shard, lock->flight);
+    pthread_mutex_unlock(&lock->shard->lock);
+    
+    safe_free((void**)&lock);
     return SUCCESS;
 }
 
 bool cache_lock_try_acquire(cache_instance_t* cache, const char* key, cache_lock_t** lock) {
-    (void)cache; (void)key;
-    *lock = (cache_lock_t*)calloc(1, 64);
-    return true;
+    if (!cache || !key || !lock) {
+        return false;
+    }
+    
+    uint32_t hash = hash_key(key);
+    cache_shard_t* shard = shard_for(cache, hash);
+    
+    pthread_mutex_lock(&shard->lock);
+    
+    *lock = NULL;
+    if (!flight_find(shard, key, hash)) {
+        *lock = safe_malloc(sizeof(cache_lock_t));
+        (*lock)->shard = shard;
+        (*lock)->flight = flight_begin(shard, key, hash);
+    }
+    
+    pthread_mutex_unlock(&shard->lock);
+    return *lock != NULL;
 }
 
 read_through_cache_t* read_through_cache_create(cache_instance_t* cache, cache_loader_fn loader, void* loader_ctx) {
@@ -230,121 +3460,1639 @@ int write_through_delete(write_through_cache_t* wt_cache, const char* key) {
     return SUCCESS;
 }
 
+// =============================================================================
+// Write-behind
+// =============================================================================
+
+static wb_write_t** wb_bucket(write_behind_cache_t* wb, uint32_t hash) {
+    return &wb->buckets[hash & (wb->bucket_count - 1)];
+}
+
+static wb_write_t* wb_find(write_behind_cache_t* wb, const char* key, uint32_t hash) {
+    for (wb_write_t* w = *wb_bucket(wb, hash); w; w = w->hash_next) {
+        if (w->hash == hash && strcmp(w->key, key) == 0) {
+            return w;
+        }
+    }
+    return NULL;
+}
+
+static void wb_write_free(wb_write_t* w) {
+    safe_free((void**)&w->key);
+    safe_free((void**)&w->value);
+    safe_free((void**)&w);
+}
+
+// Whether the flusher should write a batch now
+static bool wb_batch_ready(write_behind_cache_t* wb, uint64_t now) {
+    if (wb->pending == 0) {
+        return false;
+    }
+    return wb->stop || wb->flush_waiters > 0 || wb->pending >= wb->config.batch_size ||
+           now - wb->head->queued_at >= wb->config.flush_interval_ms;
+}
+
+// Detach up to batch_size writes from the head of the queue
+static wb_write_t* wb_take_batch(write_behind_cache_t* wb) {
+    wb_write_t* batch = wb->head;
+    wb_write_t* last = NULL;
+    size_t taken = 0;
+    
+    for (wb_write_t* w = wb->head; w && taken < wb->config.batch_size; w = w->next) {
+        wb_write_t** link = wb_bucket(wb, w->hash);
+        while (*link != w) {
+            link = &(*link)->hash_next;
+        }
+        *link = w->hash_next;
+        last = w;
+        taken++;
+    }
+    
+    wb->head = last->next;
+    if (!wb->head) {
+        wb->tail = NULL;
+    }
+    last->next = NULL;
+    wb->pending -= taken;
+    wb->in_flight = taken;
+    return batch;
+}
+
+// Write a detached batch to the backend without holding the queue lock. A key
+// that still fails after max_retries is dropped; the cache keeps its value.
+static void wb_write_batch(write_behind_cache_t* wb, wb_write_t* batch, write_behind_stats_t* delta,
+                           uint64_t* lag_total) {
+    while (batch) {
+        wb_write_t* w = batch;
+        batch = w->next;
+        
+        uint64_t backoff = wb->config.retry_backoff_ms;
+        int rc = wb->writer(w->key, w->value, w->value_size, wb->writer_ctx);
+        for (uint32_t attempt = 0; rc != SUCCESS && attempt < wb->config.max_retries; attempt++) {
+            struct timespec delay = { (time_t)(backoff / 1000), (long)(backoff % 1000) * 1000000L };
+            nanosleep(&delay, NULL);
+            backoff *= 2;
+            delta->retries++;
+            rc = wb->writer(w->key, w->value, w->value_size, wb->writer_ctx);
+        }
+        
+        if (rc == SUCCESS) {
+            uint64_t lag = get_timestamp_ms() - w->queued_at;
+            delta->flushed++;
+            *lag_total += lag;
+            if (lag > delta->max_lag_ms) {
+                delta->max_lag_ms = lag;
+            }
+        } else {
+            delta->failed++;
+        }
+        wb_write_free(w);
+    }
+}
+
+static void* wb_flusher_main(void* arg) {
+    write_behind_cache_t* wb = (write_behind_cache_t*)arg;
+    
+    pthread_mutex_lock(&wb->lock);
+    for (;;) {
+        uint64_t now = get_timestamp_ms();
+        if (!wb_batch_ready(wb, now)) {
+            if (wb->stop) {
+                break;
+            }
+            if (wb->pending == 0) {
+                pthread_cond_wait(&wb->work, &wb->lock);
+            } else {
+                struct timespec deadline =
+                    deadline_after(wb->head->queued_at + wb->config.flush_interval_ms - now);
+                pthread_cond_timedwait(&wb->work, &wb->lock, &deadline);
+            }
+            continue;
+        }
+        
+        wb_write_t* batch = wb_take_batch(wb);
+        pthread_cond_broadcast(&wb->space);
+        pthread_mutex_unlock(&wb->lock);
+        
+        write_behind_stats_t delta = { 0 };
+        uint64_t lag_total = 0;
+        wb_write_batch(wb, batch, &delta, &lag_total);
+        
+        pthread_mutex_lock(&wb->lock);
+        wb->in_flight = 0;
+        wb->stats.batches++;
+        wb->stats.flushed += delta.flushed;
+        wb->stats.retries += delta.retries;
+        wb->stats.failed += delta.failed;
+        wb->lag_total_ms += lag_total;
+        if (delta.max_lag_ms > wb->stats.max_lag_ms) {
+            wb->stats.max_lag_ms = delta.max_lag_ms;
+        }
+        if (wb->pending == 0) {
+            pthread_cond_broadcast(&wb->idle);
+        }
+    }
+    pthread_mutex_unlock(&wb->lock);
+    
+    return NULL;
+}
+
 write_behind_cache_t* write_behind_cache_create(cache_instance_t* cache, cache_writer_fn writer, void* writer_ctx, size_t queue_size) {
-    (void)cache; (void)writer; (void)writer_ctx; (void)queue_size;
-    return (write_behind_cache_t*)calloc(1, 64);
+    write_behind_config_t config = {
+        .queue_size = queue_size,
+        .max_retries = WRITE_BEHIND_DEFAULT_RETRIES,
+        .retry_backoff_ms = WRITE_BEHIND_DEFAULT_BACKOFF_MS,
+    };
+    return write_behind_cache_create_with_config(cache, writer, writer_ctx, &config);
+}
+
+write_behind_cache_t* write_behind_cache_create_with_config(cache_instance_t* cache, cache_writer_fn writer,
+                                                             void* writer_ctx,
+                                                             const write_behind_config_t* config) {
+    if (!cache || !writer || !config || config->queue_size == 0) {
+        return NULL;
+    }
+    
+    write_behind_cache_t* wb = safe_calloc(1, sizeof(write_behind_cache_t));
+    wb->cache = cache;
+    wb->writer = writer;
+    wb->writer_ctx = writer_ctx;
+    wb->config = *config;
+    if (wb->config.batch_size == 0) {
+        wb->config.batch_size = WRITE_BEHIND_DEFAULT_BATCH;
+    }
+    if (wb->config.flush_interval_ms == 0) {
+        wb->config.flush_interval_ms = WRITE_BEHIND_DEFAULT_INTERVAL_MS;
+    }
+    
+    // The queue is bounded, so the index never needs to grow
+    wb->bucket_count = CACHE_SHARD_MIN_BUCKETS;
+    while (wb->bucket_count < config->queue_size) {
+        wb->bucket_count *= 2;
+    }
+    wb->buckets = safe_calloc(wb->bucket_count, sizeof(wb_write_t*));
+    
+    pthread_mutex_init(&wb->lock, NULL);
+    pthread_cond_init(&wb->work, NULL);
+    pthread_cond_init(&wb->space, NULL);
+    pthread_cond_init(&wb->idle, NULL);
+    
+    if (pthread_create(&wb->flusher, NULL, wb_flusher_main, wb) != 0) {
+        pthread_mutex_destroy(&wb->lock);
+        pthread_cond_destroy(&wb->work);
+        pthread_cond_destroy(&wb->space);
+        pthread_cond_destroy(&wb->idle);
+        safe_free((void**)&wb->buckets);
+        safe_free((void**)&wb);
+        return NULL;
+    }
+    
+    return wb;
 }
 
+// Writes everything still queued before returning
 void write_behind_cache_destroy(write_behind_cache_t* wb_cache) {
-    free(wb_cache);
+    if (!wb_cache) return;
+    
+    pthread_mutex_lock(&wb_cache->lock);
+    wb_cache->stop = true;
+    pthread_cond_signal(&wb_cache->work);
+    pthread_mutex_unlock(&wb_cache->lock);
+    pthread_join(wb_cache->flusher, NULL);
+    
+    pthread_mutex_destroy(&wb_cache->lock);
+    pthread_cond_destroy(&wb_cache->work);
+    pthread_cond_destroy(&wb_cache->space);
+    pthread_cond_destroy(&wb_cache->idle);
+    safe_free((void**)&wb_cache->buckets);
+    safe_free((void**)&wb_cache);
 }
 
 int write_behind_set(write_behind_cache_t* wb_cache, const char* key, const void* value, size_t value_size) {
-    (void)wb_cache; (void)key; (void)value; (void)value_size;
+    if (!wb_cache || !key || !value) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    uint32_t hash = hash_key(key);
+    void* copy = safe_malloc(value_size > 0 ? value_size : 1);
+    memcpy(copy, value, value_size);
+    
+    pthread_mutex_lock(&wb_cache->lock);
+    wb_cache->stats.writes++;
+    
+    wb_write_t* w = wb_find(wb_cache, key, hash);
+    if (!w) {
+        // Backpressure: wait for the flusher to take a batch
+        while (wb_cache->pending >= wb_cache->config.queue_size) {
+            pthread_cond_wait(&wb_cache->space, &wb_cache->lock);
+        }
+        w = wb_find(wb_cache, key, hash);  // Another writer may have queued it meanwhile
+    }
+    
+    // Update the cache under the queue lock so that it and the backend see
+    // writes to a key in the same order
+    int rc = cache_set(wb_cache->cache, key, value, value_size);
+    if (rc != SUCCESS) {
+        pthread_mutex_unlock(&wb_cache->lock);
+        safe_free(&copy);
+        return rc;
+    }
+    
+    if (w) {
+        wb_cache->stats.coalesced++;
+        safe_free((void**)&w->value);
+        w->value = copy;
+        w->value_size = value_size;
+        pthread_mutex_unlock(&wb_cache->lock);
+        return SUCCESS;
+    }
+    
+    w = safe_calloc(1, sizeof(wb_write_t));
+    w->key = safe_strdup(key);
+    w->hash = hash;
+    w->value = copy;
+    w->value_size = value_size;
+    w->queued_at = get_timestamp_ms();
+    
+    wb_write_t** bucket = wb_bucket(wb_cache, hash);
+    w->hash_next = *bucket;
+    *bucket = w;
+    if (wb_cache->tail) {
+        wb_cache->tail->next = w;
+    } else {
+        wb_cache->head = w;
+    }
+    wb_cache->tail = w;
+    wb_cache->pending++;
+    
+    // Wake the flusher to start the interval timer or write a full batch
+    if (wb_cache->pending == 1 || wb_cache->pending >= wb_cache->config.batch_size) {
+        pthread_cond_signal(&wb_cache->work);
+    }
+    pthread_mutex_unlock(&wb_cache->lock);
     return SUCCESS;
 }
 
+// Wait until every queued write has reached the backend. Returns ERROR_IO if
+// any key was dropped by the writer meanwhile.
 int write_behind_flush(write_behind_cache_t* wb_cache) {
-    (void)wb_cache;
+    if (!wb_cache) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    pthread_mutex_lock(&wb_cache->lock);
+    uint64_t failed = wb_cache->stats.failed;
+    wb_cache->flush_waiters++;
+    pthread_cond_signal(&wb_cache->work);
+    while (wb_cache->pending > 0 || wb_cache->in_flight > 0) {
+        pthread_cond_wait(&wb_cache->idle, &wb_cache->lock);
+    }
+    wb_cache->flush_waiters--;
+    bool dropped = wb_cache->stats.failed > failed;
+    pthread_mutex_unlock(&wb_cache->lock);
+    
+    return dropped ? ERROR_IO : SUCCESS;
+}
+
+int write_behind_get_stats(write_behind_cache_t* wb_cache, write_behind_stats_t* stats) {
+    if (!wb_cache || !stats) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    pthread_mutex_lock(&wb_cache->lock);
+    *stats = wb_cache->stats;
+    stats->pending = wb_cache->pending;
+    stats->oldest_pending_ms = wb_cache->head ? get_timestamp_ms() - wb_cache->head->queued_at : 0;
+    stats->avg_lag_ms = stats->flushed > 0 ? (double)wb_cache->lag_total_ms / stats->flushed : 0.0;
+    pthread_mutex_unlock(&wb_cache->lock);
+    
+    return SUCCESS;
+}
+
+// =============================================================================
+// Near cache
+// =============================================================================
+
+// Each thread gets a 4-way set-associative L1 of l1_entries slots, touched
+// only by that thread. The shared cache publishes every overwrite, delete, eviction
+// and TTL change of its keys to an invalidation log, and each L1 applies the
+// log every max_stale_ops of its own operations. An L1 that falls more than
+// INVALIDATION_LOG_SIZE changes behind is dropped whole.
+#define NEAR_DEFAULT_ENTRIES 256
+#define NEAR_DEFAULT_MAX_VALUE 4096
+#define NEAR_DEFAULT_STALE_OPS 16
+#define NEAR_WAYS 4
+
+typedef struct {
+    char* key;                // NULL = empty
+    uint32_t hash;
+    void* value;
+    size_t value_size;
+    uint64_t expires_at;      // 0 = no expiry
+    uint64_t used;            // Owner's operation count at last use, for LRU
+} near_slot_t;
+
+// Counters are written only by the owning thread; stats read them relaxed
+typedef struct near_l1 {
+    near_cache_t* near;
+    near_slot_t* slots;
+    uint64_t applied;         // Next log sequence to apply
+    uint64_t ops;
+    uint64_t ops_since_sync;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t invalidated;
+    uint64_t flushes;
+    uint64_t staleness_ns;    // Total over invalidated entries
+    uint64_t max_staleness_ns;
+    struct near_l1* next;
+} near_l1_t;
+
+struct near_cache {
+    cache_instance_t* cache;
+    invalidation_log_t* log;
+    near_cache_config_t config;
+    size_t set_mask;          // Sets of NEAR_WAYS slots
+    uint64_t first_seq;       // Log head when attached
+    pthread_key_t key;
+    
+    pthread_mutex_t lock;     // Guards threads and retired
+    near_l1_t* threads;
+    near_l1_t retired;        // Counters of L1s whose threads exited
+};
+
+static void near_slot_clear(near_slot_t* slot) {
+    safe_free((void**)&slot->key);
+    safe_free((void**)&slot->value);
+}
+
+static void near_l1_flush(near_l1_t* l1) {
+    for (size_t i = 0; i < (l1->near->set_mask + 1) * NEAR_WAYS; i++) {
+        near_slot_clear(&l1->slots[i]);
+    }
+}
+
+static near_slot_t* near_set(near_l1_t* l1, uint32_t hash) {
+    return &l1->slots[(hash & l1->near->set_mask) * NEAR_WAYS];
+}
+
+static near_slot_t* near_l1_find(near_l1_t* l1, const char* key, uint32_t hash) {
+    near_slot_t* set = near_set(l1, hash);
+    for (int way = 0; way < NEAR_WAYS; way++) {
+        if (set[way].key && set[way].hash == hash && strcmp(set[way].key, key) == 0) {
+            return &set[way];
+        }
+    }
+    return NULL;
+}
+
+// Drop every entry whose key hashes to hash; returns how many
+static int near_l1_forget(near_l1_t* l1, uint32_t hash) {
+    near_slot_t* set = near_set(l1, hash);
+    int dropped = 0;
+    for (int way = 0; way < NEAR_WAYS; way++) {
+        if (set[way].key && set[way].hash == hash) {
+            near_slot_clear(&set[way]);
+            dropped++;
+        }
+    }
+    return dropped;
+}
+
+// An empty slot in hash's set, else its least recently used
+static near_slot_t* near_l1_victim(near_l1_t* l1, uint32_t hash) {
+    near_slot_t* set = near_set(l1, hash);
+    near_slot_t* victim = &set[0];
+    for (int way = 0; way < NEAR_WAYS; way++) {
+        if (!set[way].key) {
+            return &set[way];
+        }
+        if (set[way].used < victim->used) {
+            victim = &set[way];
+        }
+    }
+    near_slot_clear(victim);
+    return victim;
+}
+
+static void near_counter_add(uint64_t* counter, uint64_t amount) {
+    __atomic_store_n(counter, *counter + amount, __ATOMIC_RELAXED);
+}
+
+static void near_l1_fold(near_l1_t* into, const near_l1_t* from) {
+    into->hits += __atomic_load_n(&from->hits, __ATOMIC_RELAXED);
+    into->misses += __atomic_load_n(&from->misses, __ATOMIC_RELAXED);
+    into->invalidated += __atomic_load_n(&from->invalidated, __ATOMIC_RELAXED);
+    into->flushes += __atomic_load_n(&from->flushes, __ATOMIC_RELAXED);
+    into->staleness_ns += __atomic_load_n(&from->staleness_ns, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&from->max_staleness_ns, __ATOMIC_RELAXED);
+    if (max > into->max_staleness_ns) {
+        into->max_staleness_ns = max;
+    }
+}
+
+// Thread exit: keep the counters, drop the entries
+static void near_l1_release(void* arg) {
+    near_l1_t* l1 = (near_l1_t*)arg;
+    near_cache_t* near = l1->near;
+    
+    pthread_mutex_lock(&near->lock);
+    near_l1_t** link = &near->threads;
+    while (*link != l1) {
+        link = &(*link)->next;
+    }
+    *link = l1->next;
+    near_l1_fold(&near->retired, l1);
+    pthread_mutex_unlock(&near->lock);
+    
+    near_l1_flush(l1);
+    safe_free((void**)&l1->slots);
+    safe_free((void**)&l1);
+}
+
+static near_l1_t* near_l1_get(near_cache_t* near) {
+    near_l1_t* l1 = pthread_getspecific(near->key);
+    if (l1) {
+        return l1;
+    }
+    
+    l1 = safe_calloc(1, sizeof(near_l1_t));
+    l1->near = near;
+    l1->slots = safe_calloc((near->set_mask + 1) * NEAR_WAYS, sizeof(near_slot_t));
+    l1->applied = __atomic_load_n(&near->log->head, __ATOMIC_ACQUIRE);
+    
+    pthread_mutex_lock(&near->lock);
+    l1->next = near->threads;
+    near->threads = l1;
+    pthread_mutex_unlock(&near->lock);
+    
+    pthread_setspecific(near->key, l1);
+    return l1;
+}
+
+// Apply the log entries published since the last sync
+static void near_l1_sync(near_l1_t* l1) {
+    invalidation_log_t* log = l1->near->log;
+    uint64_t head = __atomic_load_n(&log->head, __ATOMIC_ACQUIRE);
+    if (head == l1->applied) {
+        return;
+    }
+    if (head - l1->applied > INVALIDATION_LOG_SIZE) {
+        near_l1_flush(l1);
+        near_counter_add(&l1->flushes, 1);
+        l1->applied = head;
+        return;
+    }
+    
+    uint64_t now = 0;
+    for (uint64_t seq = l1->applied; seq < head; seq++) {
+        invalidation_t* entry = &log->slots[seq & (INVALIDATION_LOG_SIZE - 1)];
+        uint64_t written = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+        if (written < seq + 1) {
+            // Claimed but not yet written; pick it up next time
+            head = seq;
+            break;
+        }
+        uint32_t hash = __atomic_load_n(&entry->hash, __ATOMIC_RELAXED);
+        uint64_t published = __atomic_load_n(&entry->published_ns, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (written != seq + 1 || __atomic_load_n(&entry->seq, __ATOMIC_RELAXED) != seq + 1) {
+            // Reused by a later change: we fell behind
+            near_l1_flush(l1);
+            near_counter_add(&l1->flushes, 1);
+            l1->applied = __atomic_load_n(&log->head, __ATOMIC_ACQUIRE);
+            return;
+        }
+        
+        int dropped = near_l1_forget(l1, hash);
+        if (dropped > 0) {
+            if (now == 0) {
+                now = monotonic_ns();
+            }
+            uint64_t staleness = now > published ? now - published : 0;
+            near_counter_add(&l1->invalidated, dropped);
+            near_counter_add(&l1->staleness_ns, staleness * dropped);
+            if (staleness > l1->max_staleness_ns) {
+                __atomic_store_n(&l1->max_staleness_ns, staleness, __ATOMIC_RELAXED);
+            }
+        }
+    }
+    l1->applied = head;
+}
+
+// The calling thread's L1, brought up to date if it is due
+static near_l1_t* near_l1_enter(near_cache_t* near) {
+    near_l1_t* l1 = near_l1_get(near);
+    l1->ops++;
+    if (++l1->ops_since_sync >= near->config.max_stale_ops) {
+        l1->ops_since_sync = 0;
+        near_l1_sync(l1);
+    }
+    return l1;
+}
+
+// cache_get, also reporting when the value expires (0 = never)
+static int cache_get_expiring(cache_instance_t* cache, const char* key, void** value, size_t* value_size,
+                              uint64_t* expires_at) {
+    *expires_at = 0;
+    if (is_remote(cache)) {
+        return cache_get(cache, key, value, value_size);
+    }
+    
+    uint32_t hash = hash_key(key);
+    cache_shard_t* shard = shard_for(cache, hash);
+    uint64_t now = get_timestamp_ms();
+    
+    pthread_mutex_lock(&shard->lock);
+    cache_entry_t* entry = shard_lookup(shard, key, hash, now);
+    if (entry) {
+        shard->hits++;
+        shard_touch(cache, shard, entry, now);
+        entry_copy_out(shard, entry, value, value_size);
+        *expires_at = entry->expires_at;
+    } else {
+        shard->misses++;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    
+    return entry ? SUCCESS : ERROR_NOT_FOUND;
+}
+
+near_cache_t* near_cache_create(cache_instance_t* cache, const near_cache_config_t* config) {
+    if (!cache) {
+        return NULL;
+    }
+    
+    near_cache_t* near = safe_calloc(1, sizeof(near_cache_t));
+    near->cache = cache;
+    if (config) {
+        near->config = *config;
+    }
+    if (near->config.l1_entries == 0) near->config.l1_entries = NEAR_DEFAULT_ENTRIES;
+    if (near->config.max_value_size == 0) near->config.max_value_size = NEAR_DEFAULT_MAX_VALUE;
+    if (near->config.max_stale_ops == 0) near->config.max_stale_ops = NEAR_DEFAULT_STALE_OPS;
+    size_t sets = 1;
+    while (sets * NEAR_WAYS < near->config.l1_entries) {
+        sets <<= 1;
+    }
+    near->set_mask = sets - 1;
+    
+    if (pthread_key_create(&near->key, near_l1_release) != 0) {
+        safe_free((void**)&near);
+        return NULL;
+    }
+    pthread_mutex_init(&near->lock, NULL);
+    
+    // One log per instance, shared by its near caches; shards keep
+    // publishing to it for the instance's lifetime
+    invalidation_log_t* log = __atomic_load_n(&cache->invalidations, __ATOMIC_ACQUIRE);
+    if (!log) {
+        invalidation_log_t* fresh = safe_calloc(1, sizeof(invalidation_log_t));
+        if (__atomic_compare_exchange_n(&cache->invalidations, &log, fresh, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            log = fresh;
+        } else {
+            safe_free((void**)&fresh);
+        }
+    }
+    near->log = log;
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        pthread_mutex_lock(&cache->shards[i].lock);
+        cache->shards[i].invalidations = log;
+        pthread_mutex_unlock(&cache->shards[i].lock);
+    }
+    near->first_seq = __atomic_load_n(&log->head, __ATOMIC_ACQUIRE);
+    
+    return near;
+}
+
+// Other threads must be done with the near cache; their L1s are freed here
+void near_cache_destroy(near_cache_t* near) {
+    if (!near) return;
+    
+    pthread_key_delete(near->key);
+    while (near->threads) {
+        near_l1_t* l1 = near->threads;
+        near->threads = l1->next;
+        near_l1_flush(l1);
+        safe_free((void**)&l1->slots);
+        safe_free((void**)&l1);
+    }
+    pthread_mutex_destroy(&near->lock);
+    safe_free((void**)&near);
+}
+
+int near_cache_get(near_cache_t* near, const char* key, void** value, size_t* value_size) {
+    if (!near || !key) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (value) {
+        *value = NULL;
+    }
+    
+    near_l1_t* l1 = near_l1_enter(near);
+    uint32_t hash = hash_key(key);
+    near_slot_t* slot = near_l1_find(l1, key, hash);
+    
+    if (slot) {
+        if (slot->expires_at == 0 || get_timestamp_ms() < slot->expires_at) {
+            slot->used = l1->ops;
+            near_counter_add(&l1->hits, 1);
+            copy_value_out(slot->value, slot->value_size, value, value_size);
+            return SUCCESS;
+        }
+        near_slot_clear(slot);
+    }
+    near_counter_add(&l1->misses, 1);
+    
+    // Changes from here on are still ahead of this L1 in the log, so a value
+    // overwritten while we fetch it is dropped at a later sync
+    void* fetched = NULL;
+    size_t fetched_size = 0;
+    uint64_t expires_at;
+    int result = cache_get_expiring(near->cache, key, &fetched, &fetched_size, &expires_at);
+    if (result != SUCCESS) {
+        return result;
+    }
+    
+    if (fetched_size <= near->config.max_value_size) {
+        uint64_t l1_expiry = near->config.l1_ttl_ms > 0 ? get_timestamp_ms() + near->config.l1_ttl_ms : 0;
+        if (l1_expiry > 0 && (expires_at == 0 || l1_expiry < expires_at)) {
+            expires_at = l1_expiry;
+        }
+        slot = near_l1_victim(l1, hash);
+        slot->key = safe_strdup(key);
+        slot->hash = hash;
+        slot->value = safe_malloc(fetched_size > 0 ? fetched_size : 1);
+        memcpy(slot->value, fetched, fetched_size);
+        slot->value_size = fetched_size;
+        slot->expires_at = expires_at;
+        slot->used = l1->ops;
+    }
+    
+    if (value) {
+        *value = fetched;
+    } else {
+        safe_free(&fetched);
+    }
+    if (value_size) {
+        *value_size = fetched_size;
+    }
+    return SUCCESS;
+}
+
+// Writes go to the shared cache; the writer's own L1 forgets the key at once
+// so it reads its own writes, other threads' L1s via the log
+int near_cache_set(near_cache_t* near, const char* key, const void* value, size_t value_size) {
+    if (!near || !key) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    near_l1_forget(near_l1_enter(near), hash_key(key));
+    return cache_set(near->cache, key, value, value_size);
+}
+
+int near_cache_delete(near_cache_t* near, const char* key) {
+    if (!near || !key) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    near_l1_forget(near_l1_enter(near), hash_key(key));
+    return cache_delete(near->cache, key);
+}
+
+int near_cache_get_stats(near_cache_t* near, near_cache_stats_t* stats) {
+    if (!near || !stats) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    memset(stats, 0, sizeof(near_cache_stats_t));
+    near_l1_t total;
+    memset(&total, 0, sizeof(total));
+    
+    pthread_mutex_lock(&near->lock);
+    near_l1_fold(&total, &near->retired);
+    for (near_l1_t* l1 = near->threads; l1; l1 = l1->next) {
+        near_l1_fold(&total, l1);
+        stats->threads++;
+    }
+    pthread_mutex_unlock(&near->lock);
+    
+    stats->l1_hits = total.hits;
+    stats->l1_misses = total.misses;
+    uint64_t lookups = total.hits + total.misses;
+    stats->l1_hit_rate = lookups > 0 ? (double)total.hits / lookups : 0.0;
+    stats->invalidations = __atomic_load_n(&near->log->head, __ATOMIC_ACQUIRE) - near->first_seq;
+    stats->l1_invalidations = total.invalidated;
+    stats->l1_flushes = total.flushes;
+    stats->avg_staleness_us = total.invalidated > 0 ? total.staleness_ns / 1e3 / total.invalidated : 0.0;
+    stats->max_staleness_us = total.max_staleness_ns / 1e3;
+    stats->max_stale_ops = near->config.max_stale_ops;
+    return SUCCESS;
+}
+
+// =============================================================================
+// Cache warming
+// =============================================================================
+
+// Loader threads; loaders usually wait on a backend, so more than the CPUs
+#define WARMUP_WORKERS 8
+#define WARMUP_DEFAULT_BATCH 100
+
+typedef struct {
+    char* key;
+    uint64_t count;
+} profile_entry_t;
+
+typedef struct {
+    const char* key;
+    uint64_t count;
+    size_t order;             // Position in the caller's list, for ties
+} warmup_key_t;
+
+typedef struct {
+    cache_instance_t* cache;
+    cache_loader_fn loader;
+    void* loader_ctx;
+    const warmup_config_t* config;
+    double cpu_share;         // Per worker, 0 = unthrottled
+    double memory_limit_mb;   // 0 = unbounded
+    
+    pthread_mutex_t lock;
+    uint64_t next_batch_ms;   // Earliest start of the next batch
+    bool memory_exhausted;
+    uint64_t keys_loaded;
+    uint64_t keys_failed;
+    uint64_t keys_skipped;
+} warmup_run_t;
+
+typedef struct {
+    warmup_run_t* run;
+    warmup_key_t* keys;
+    size_t count;
+} warmup_batch_t;
+
+static int profile_entry_compare(const void* a, const void* b) {
+    return strcmp(((const profile_entry_t*)a)->key, ((const profile_entry_t*)b)->key);
+}
+
+static int profile_count_compare(const void* a, const void* b) {
+    const profile_entry_t* x = a;
+    const profile_entry_t* y = b;
+    return x->count < y->count ? 1 : x->count > y->count ? -1 : strcmp(x->key, y->key);
+}
+
+// Hottest first, then in the order given
+static int warmup_key_compare(const void* a, const void* b) {
+    const warmup_key_t* x = a;
+    const warmup_key_t* y = b;
+    if (x->count != y->count) {
+        return x->count < y->count ? 1 : -1;
+    }
+    return x->order < y->order ? -1 : x->order > y->order;
+}
+
+static void profile_free(profile_entry_t* entries, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        safe_free((void**)&entries[i].key);
+    }
+    safe_free((void**)&entries);
+}
+
+// Write one "count<TAB>key" line per live key, most accessed first. Keys
+// containing a newline can't be represented and are left out.
+int cache_save_access_profile(cache_instance_t* cache, const char* path) {
+    if (!cache || !path) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    size_t capacity = 16;
+    size_t count = 0;
+    profile_entry_t* entries = safe_malloc(capacity * sizeof(profile_entry_t));
+    uint64_t now = get_timestamp_ms();
+    
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        cache_shard_t* shard = &cache->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        for (cache_entry_t* entry = shard->head; entry; entry = entry->next) {
+            if (entry_expired(entry, now) || strchr(entry->key, '\n')) {
+                continue;
+            }
+            if (count == capacity) {
+                capacity *= 2;
+                entries = safe_realloc(entries, capacity * sizeof(profile_entry_t));
+            }
+            entries[count].key = safe_strdup(entry->key);
+            entries[count].count = entry->access_count;
+            count++;
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+    qsort(entries, count, sizeof(profile_entry_t), profile_count_compare);
+    
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        profile_free(entries, count);
+        return ERROR_IO;
+    }
+    for (size_t i = 0; i < count; i++) {
+        fprintf(file, "%" PRIu64 "\t%s\n", entries[i].count, entries[i].key);
+    }
+    int result = fclose(file) == 0 ? SUCCESS : ERROR_IO;
+    
+    profile_free(entries, count);
+    return result;
+}
+
+// Read a profile written by cache_save_access_profile, sorted by key. A
+// missing file is an empty profile: there was no previous run.
+static int profile_load(const char* path, profile_entry_t** entries, size_t* count) {
+    *entries = NULL;
+    *count = 0;
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return errno == ENOENT ? SUCCESS : ERROR_IO;
+    }
+    
+    size_t capacity = 16;
+    *entries = safe_malloc(capacity * sizeof(profile_entry_t));
+    char* line = NULL;
+    size_t line_capacity = 0;
+    ssize_t length;
+    
+    while ((length = getline(&line, &line_capacity, file)) > 0) {
+        if (line[length - 1] == '\n') {
+            line[--length] = '\0';
+        }
+        char* end;
+        errno = 0;
+        unsigned long long accesses = strtoull(line, &end, 10);
+        if (end == line || *end != '\t' || errno != 0 || end[1] == '\0') {
+            continue;
+        }
+        if (*count == capacity) {
+            capacity *= 2;
+            *entries = safe_realloc(*entries, capacity * sizeof(profile_entry_t));
+        }
+        (*entries)[*count].key = safe_strdup(end + 1);
+        (*entries)[*count].count = accesses;
+        (*count)++;
+    }
+    free(line);
+    fclose(file);
+    
+    qsort(*entries, *count, sizeof(profile_entry_t), profile_entry_compare);
     return SUCCESS;
 }
 
+static void sleep_ms(uint64_t ms) {
+    struct timespec delay = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000L };
+    nanosleep(&delay, NULL);
+}
+
+static uint64_t thread_cpu_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void warmup_load_batch(void* arg) {
+    warmup_batch_t* batch = (warmup_batch_t*)arg;
+    warmup_run_t* run = batch->run;
+    
+    // Batches start at least delay_between_batches_ms apart across all workers
+    pthread_mutex_lock(&run->lock);
+    uint64_t now = get_timestamp_ms();
+    uint64_t start = run->next_batch_ms > now ? run->next_batch_ms : now;
+    run->next_batch_ms = start + run->config->delay_between_batches_ms;
+    bool stopped = run->memory_exhausted;
+    pthread_mutex_unlock(&run->lock);
+    
+    if (stopped) {
+        pthread_mutex_lock(&run->lock);
+        run->keys_skipped += batch->count;
+        pthread_mutex_unlock(&run->lock);
+        return;
+    }
+    if (start > now) {
+        sleep_ms(start - now);
+    }
+    
+    uint64_t wall_start = monotonic_ns();
+    uint64_t cpu_start = thread_cpu_ns();
+    uint64_t loaded = 0, failed = 0, skipped = 0;
+    
+    for (size_t i = 0; i < batch->count; i++) {
+        const char* key = batch->keys[i].key;
+        if (cache_exists(run->cache, key)) {
+            skipped++;
+            continue;
+        }
+        size_t size = 0;
+        uint64_t timer = op_timer_start(run->cache);
+        void* value = run->loader(key, run->loader_ctx, &size);
+        op_timer_stop(run->cache, CACHE_OP_LOAD, timer);
+        if (value && cache_set(run->cache, key, value, size) == SUCCESS) {
+            loaded++;
+        } else {
+            failed++;
+        }
+        free(value);
+    }
+    
+    bool exhausted = false;
+    if (run->memory_limit_mb > 0) {
+        cache_stats_t stats;
+        exhausted = cache_get_stats(run->cache, &stats) == SUCCESS && stats.memory_used_mb >= run->memory_limit_mb;
+    }
+    
+    pthread_mutex_lock(&run->lock);
+    run->keys_loaded += loaded;
+    run->keys_failed += failed;
+    run->keys_skipped += skipped;
+    run->memory_exhausted = run->memory_exhausted || exhausted;
+    pthread_mutex_unlock(&run->lock);
+    
+    // Idle long enough that this worker's CPU time stays within its share
+    if (run->cpu_share > 0) {
+        uint64_t cpu = thread_cpu_ns() - cpu_start;
+        uint64_t wall = monotonic_ns() - wall_start;
+        double busy_ns = cpu / run->cpu_share;
+        if (busy_ns > wall) {
+            sleep_ms((uint64_t)((busy_ns - wall) / 1e6));
+        }
+    }
+}
+
+// Keys come from config->keys, or for WARMUP_POPULAR from the profile when
+// no list is given. WARMUP_POPULAR loads the keys the profile saw most
+// first; the other strategies keep the given order, and WARMUP_INCREMENTAL
+// uses a single loader thread. The loader is called from several threads at
+// once and returns a malloc'd value that warmup frees.
 warmup_result_t* cache_warmup(cache_instance_t* cache, cache_loader_fn loader, void* loader_ctx, warmup_config_t* config) {
-    (void)cache; (void)loader; (void)loader_ctx; (void)config;
-    warmup_result_t* result = (warmup_result_t*)malloc(sizeof(warmup_result_t));
-    if (result) memset(result, 0, sizeof(warmup_result_t));
+    if (!cache || !loader || !config) {
+        return NULL;
+    }
+    
+    profile_entry_t* profile = NULL;
+    size_t profile_count = 0;
+    if (config->strategy == WARMUP_POPULAR && config->profile_path &&
+        profile_load(config->profile_path, &profile, &profile_count) != SUCCESS) {
+        return NULL;
+    }
+    
+    size_t key_count = config->keys ? config->key_count : profile_count;
+    warmup_key_t* keys = safe_malloc((key_count > 0 ? key_count : 1) * sizeof(warmup_key_t));
+    for (size_t i = 0; i < key_count; i++) {
+        keys[i].key = config->keys ? config->keys[i] : profile[i].key;
+        keys[i].order = i;
+        keys[i].count = 0;
+        if (profile_count > 0) {
+            profile_entry_t probe = { (char*)keys[i].key, 0 };
+            profile_entry_t* found = bsearch(&probe, profile, profile_count, sizeof(profile_entry_t),
+                                             profile_entry_compare);
+            keys[i].count = found ? found->count : 0;
+        }
+    }
+    if (config->strategy == WARMUP_POPULAR) {
+        qsort(keys, key_count, sizeof(warmup_key_t), warmup_key_compare);
+    }
+    if (config->max_keys > 0 && key_count > config->max_keys) {
+        key_count = config->max_keys;
+    }
+    
+    size_t batch_size = config->batch_size > 0 ? config->batch_size : WARMUP_DEFAULT_BATCH;
+    size_t batch_count = (key_count + batch_size - 1) / batch_size;
+    
+    size_t workers = config->strategy == WARMUP_INCREMENTAL ? 1 : WARMUP_WORKERS;
+    if (workers > batch_count) workers = batch_count;
+    if (workers == 0) workers = 1;
+    
+    // max_cpu_usage is a fraction of the machine's CPU time, split evenly
+    // into per-worker duty cycles. Time spent waiting on the loader's backend
+    // doesn't count against it.
+    double cpu_share = 0.0;
+    if (config->max_cpu_usage > 0.0 && config->max_cpu_usage < 1.0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        cpu_share = (cpus > 0 ? cpus : 1) * config->max_cpu_usage / workers;
+        if (cpu_share >= 1.0) cpu_share = 0.0;
+    }
+    
+    warmup_run_t run = {
+        .cache = cache,
+        .loader = loader,
+        .loader_ctx = loader_ctx,
+        .config = config,
+        .cpu_share = cpu_share,
+        .memory_limit_mb = config->max_memory_usage > 0.0 && cache->config.max_memory_mb > 0
+                               ? config->max_memory_usage * cache->config.max_memory_mb : 0.0,
+    };
+    pthread_mutex_init(&run.lock, NULL);
+    
+    cache_stats_t before;
+    cache_get_stats(cache, &before);
+    uint64_t start = monotonic_ns();
+    
+    warmup_batch_t* batches = safe_malloc((batch_count > 0 ? batch_count : 1) * sizeof(warmup_batch_t));
+    for (size_t i = 0; i < batch_count; i++) {
+        batches[i].run = &run;
+        batches[i].keys = keys + i * batch_size;
+        batches[i].count = i + 1 < batch_count ? batch_size : key_count - i * batch_size;
+    }
+    
+    if (batch_count > 0) {
+        thread_pool_config_t pool_config = { .type = THREAD_POOL_FIXED, .max_threads = workers };
+        thread_pool_t* pool = thread_pool_create(&pool_config);
+        if (pool && thread_pool_start(pool) == SUCCESS) {
+            for (size_t i = 0; i < batch_count; i++) {
+                thread_pool_task_release(thread_pool_submit(pool, warmup_load_batch, &batches[i]));
+            }
+            thread_pool_shutdown(pool, true);
+        } else {
+            // No threads to be had: load on the caller's
+            for (size_t i = 0; i < batch_count; i++) {
+                warmup_load_batch(&batches[i]);
+            }
+        }
+        thread_pool_destroy(pool);
+    }
+    
+    uint64_t elapsed_ns = monotonic_ns() - start;
+    cache_stats_t after;
+    cache_get_stats(cache, &after);
+    
+    warmup_result_t* result = safe_calloc(1, sizeof(warmup_result_t));
+    result->keys_loaded = run.keys_loaded;
+    result->keys_failed = run.keys_failed;
+    result->keys_skipped = run.keys_skipped;
+    result->total_time_ms = elapsed_ns / 1000000;
+    result->memory_used_mb = after.memory_used_mb - before.memory_used_mb;
+    result->keys_per_second = elapsed_ns > 0 ? run.keys_loaded * 1e9 / elapsed_ns : 0.0;
+    
+    pthread_mutex_destroy(&run.lock);
+    safe_free((void**)&batches);
+    safe_free((void**)&keys);
+    profile_free(profile, profile_count);
     return result;
 }
 
+// Load keys not already cached, in order. ERROR_IO if the loader or the
+// cache failed any of them.
 int cache_preload_keys(cache_instance_t* cache, const char** keys, size_t key_count, cache_loader_fn loader, void* loader_ctx) {
-    (void)cache; (void)keys; (void)key_count; (void)loader; (void)loader_ctx;
-    return SUCCESS;
+    if (!cache || (!keys && key_count > 0) || !loader) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    warmup_config_t config = {
+        .strategy = WARMUP_ALL,
+        .batch_size = WARMUP_DEFAULT_BATCH,
+        .keys = keys,
+        .key_count = key_count,
+    };
+    warmup_result_t* result = cache_warmup(cache, loader, loader_ctx, &config);
+    if (!result) {
+        return ERROR_MEMORY;
+    }
+    int status = result->keys_failed > 0 ? ERROR_IO : SUCCESS;
+    warmup_result_destroy(result);
+    return status;
 }
 
 void warmup_result_destroy(warmup_result_t* result) {
     free(result);
 }
 
+// =============================================================================
+// Statistics
+// =============================================================================
+
 int cache_get_stats(cache_instance_t* cache, cache_stats_t* stats) {
-    (void)cache;
-    if (stats) memset(stats, 0, sizeof(cache_stats_t));
+    if (!cache || !stats) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    memset(stats, 0, sizeof(cache_stats_t));
+    size_t memory_used = 0;
+    uint64_t ttl_total_ms = 0;
+    uint64_t ttl_entries = 0;
+    
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        cache_shard_t* shard = &cache->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        stats->hits += shard->hits;
+        stats->misses += shard->misses;
+        stats->sets += shard->sets;
+        stats->deletes += shard->deletes;
+        stats->evictions += shard->evictions;
+        stats->expirations += shard->expirations;
+        stats->early_refreshes += shard->early_refreshes;
+        stats->compressed_values += shard->compressed_count;
+        stats->compression_bytes_saved += shard->compression_saved;
+        stats->compression_skipped += shard->compression_skipped;
+        stats->compression_time_ns += shard->compression_ns;
+        stats->decompression_time_ns += shard->decompression_ns;
+        stats->current_size += shard->size;
+        memory_used += shard->memory_used;
+        ttl_total_ms += shard->ttl_total_ms;
+        ttl_entries += shard->ttl_entries;
+        pthread_mutex_unlock(&shard->lock);
+    }
+    
+    uint64_t lookups = stats->hits + stats->misses;
+    stats->hit_rate = lookups > 0 ? (double)stats->hits / lookups : 0.0;
+    stats->miss_rate = lookups > 0 ? (double)stats->misses / lookups : 0.0;
+    stats->max_size = cache->config.max_size;
+    stats->memory_used_mb = memory_used / BYTES_PER_MB;
+    stats->memory_max_mb = (double)cache->config.max_memory_mb;
+    stats->total_keys = stats->current_size;
+    stats->avg_ttl_ms = ttl_entries > 0 ? (double)ttl_total_ms / ttl_entries : 0.0;
+    
     return SUCCESS;
 }
 
 int cache_reset_stats(cache_instance_t* cache) {
-    (void)cache;
+    if (!cache) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        cache_shard_t* shard = &cache->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        shard->hits = 0;
+        shard->misses = 0;
+        shard->sets = 0;
+        shard->deletes = 0;
+        shard->evictions = 0;
+        shard->expirations = 0;
+        shard->early_refreshes = 0;
+        shard->compression_skipped = 0;
+        shard->compression_ns = 0;
+        shard->decompression_ns = 0;
+        pthread_mutex_unlock(&shard->lock);
+    }
+    
+    // Threads clear their own histograms on their next operation
+    pthread_mutex_lock(&cache->op_lock);
+    memset(cache->op_retired, 0, sizeof(op_histogram_t));
+    __atomic_add_fetch(&cache->op_generation, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&cache->op_lock);
     return SUCCESS;
 }
 
 int cache_get_key_info(cache_instance_t* cache, const char* key, cache_key_info_t* info) {
-    (void)cache; (void)key;
-    if (info) memset(info, 0, sizeof(cache_key_info_t));
-    return SUCCESS;
+    if (!cache || !key || !info) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    uint32_t hash = hash_key(key);
+    cache_shard_t* shard = shard_for(cache, hash);
+    
+    pthread_mutex_lock(&shard->lock);
+    cache_entry_t* entry = shard_lookup(shard, key, hash, get_timestamp_ms());
+    if (entry) {
+        memset(info, 0, sizeof(cache_key_info_t));
+        strncpy(info->key, entry->key, sizeof(info->key) - 1);
+        info->value_size = entry->raw_size;
+        info->access_count = entry->access_count;
+        info->last_access_time = entry->last_access;
+        info->created_at = entry->created_at;
+        info->ttl_ms = entry->ttl_ms;
+        info->is_expired = false;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    
+    return entry ? SUCCESS : ERROR_NOT_FOUND;
 }
 
 int cache_get_all_keys(cache_instance_t* cache, char*** keys, size_t* count) {
-    (void)cache;
-    *keys = NULL;
-    *count = 0;
-    return SUCCESS;
+    return collect_keys(cache, false, 0, keys, count);
 }
 
 int cache_get_size(cache_instance_t* cache, size_t* size) {
-    (void)cache;
-    if (size) *size = 0;
+    if (!cache || !size) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (is_remote(cache)) {
+        const char* argv[] = {"DBSIZE"};
+        int64_t count;
+        int result = remote_count(cache, 1, argv, &count);
+        *size = result == SUCCESS ? (size_t)count : 0;
+        return result;
+    }
+    
+    *size = 0;
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        cache_shard_t* shard = &cache->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        *size += shard->size;
+        pthread_mutex_unlock(&shard->lock);
+    }
     return SUCCESS;
 }
 
+// Add one thread's histograms into the merged set
+static void op_histogram_merge(op_histogram_t* into, const op_histogram_t* from) {
+    for (int op = 0; op < CACHE_OP_COUNT; op++) {
+        uint64_t count = op_load(&from->count[op]);
+        if (count == 0) {
+            continue;
+        }
+        uint64_t min = op_load(&from->min[op]);
+        uint64_t max = op_load(&from->max[op]);
+        if (into->count[op] == 0 || min < into->min[op]) {
+            into->min[op] = min;
+        }
+        if (max > into->max[op]) {
+            into->max[op] = max;
+        }
+        into->count[op] += count;
+        into->total[op] += op_load(&from->total[op]);
+        for (size_t i = 0; i < OP_HIST_BUCKETS; i++) {
+            into->buckets[op][i] += op_load(&from->buckets[op][i]);
+        }
+    }
+}
+
+// Smallest recorded value with at least fraction of the samples at or below
+// it, in ticks
+static double op_percentile(const op_histogram_t* merged, int op, double fraction) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < OP_HIST_BUCKETS; i++) {
+        total += merged->buckets[op][i];
+    }
+    uint64_t rank = (uint64_t)ceil(fraction * total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < OP_HIST_BUCKETS; i++) {
+        seen += merged->buckets[op][i];
+        if (seen >= rank && seen > 0) {
+            double value = op_bucket_value(i);
+            if (value < merged->min[op]) value = merged->min[op];
+            if (value > merged->max[op]) value = merged->max[op];
+            return value;
+        }
+    }
+    return merged->max[op];
+}
+
+// One entry per operation type seen since the last reset; *stats is malloc'd
+// and belongs to the caller. Reading merges every thread's histograms, so
+// percentiles are within 1/16 of the recorded latency.
 int cache_get_operation_stats(cache_instance_t* cache, cache_operation_stats_t** stats, size_t* count) {
-    (void)cache;
-    *stats = NULL;
+    if (!cache || !stats || !count) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    op_histogram_t* merged = safe_calloc(1, sizeof(op_histogram_t));
+    pthread_mutex_lock(&cache->op_lock);
+    uint64_t generation = __atomic_load_n(&cache->op_generation, __ATOMIC_RELAXED);
+    op_histogram_merge(merged, cache->op_retired);
+    for (op_histogram_t* histogram = cache->op_threads; histogram; histogram = histogram->next) {
+        if (__atomic_load_n(&histogram->generation, __ATOMIC_ACQUIRE) == generation) {
+            op_histogram_merge(merged, histogram);
+        }
+    }
+    pthread_mutex_unlock(&cache->op_lock);
+    
+    double ms_per_tick = op_clock_ns_per_tick() / 1e6;
+    *stats = safe_calloc(CACHE_OP_COUNT, sizeof(cache_operation_stats_t));
     *count = 0;
+    for (int op = 0; op < CACHE_OP_COUNT; op++) {
+        if (merged->count[op] == 0) {
+            continue;
+        }
+        cache_operation_stats_t* out = &(*stats)[(*count)++];
+        snprintf(out->operation, sizeof(out->operation), "%s", cache_op_names[op]);
+        out->count = merged->count[op];
+        out->total_time_ms = merged->total[op] * ms_per_tick;
+        out->min_time_ms = merged->min[op] * ms_per_tick;
+        out->max_time_ms = merged->max[op] * ms_per_tick;
+        out->avg_time_ms = out->total_time_ms / out->count;
+        out->p95_time_ms = op_percentile(merged, op, 0.95) * ms_per_tick;
+        out->p99_time_ms = op_percentile(merged, op, 0.99) * ms_per_tick;
+    }
+    
+    safe_free((void**)&merged);
     return SUCCESS;
 }
 
+// Timing is on for new instances
+int cache_set_operation_timing(cache_instance_t* cache, bool enabled) {
+    if (!cache || (enabled && !cache->op_key_created)) {
+        return ERROR_INVALID_PARAM;
+    }
+    __atomic_store_n(&cache->op_timing, enabled, __ATOMIC_RELAXED);
+    return SUCCESS;
+}
+
+// =============================================================================
+// Distributed cluster
+// =============================================================================
+
+// Client-side sharding over CACHE_TYPE_REDIS nodes. Each node owns
+// CLUSTER_VNODES points on a hash ring; a key's replicas are the first
+// replication_factor distinct nodes clockwise from its hash, so adding or
+// removing a node only moves the keys on the arcs it gains or gives up.
+#define CLUSTER_VNODES 160
+#define CLUSTER_MAX_REPLICAS RESP_MAX_FANOUT
+
+typedef struct {
+    char id[64];              // "host:port"
+    char host[256];
+    int port;
+    cache_instance_t* cache;
+} cluster_node_t;
+
+typedef struct {
+    uint32_t hash;
+    cluster_node_t* node;
+} ring_point_t;
+
+struct cache_cluster {
+    replication_config_t config;
+    pthread_rwlock_t lock;    // Membership; operations hold it shared
+    cluster_node_t** nodes;
+    size_t node_count;
+    ring_point_t* ring;       // Sorted by hash
+    size_t ring_size;
+    uint64_t reads;           // Spreads replica reads round-robin
+};
+
+// FNV-1a alone clusters similar strings such as "node#1", "node#2"; the
+// murmur3 finalizer spreads them around the ring
+static uint32_t ring_hash(const char* key) {
+    uint32_t hash = hash_key(key);
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+static int ring_point_compare(const void* a, const void* b) {
+    uint32_t x = ((const ring_point_t*)a)->hash;
+    uint32_t y = ((const ring_point_t*)b)->hash;
+    return x < y ? -1 : x > y;
+}
+
+// Fill replicas with the key's owners, primary first. Returns how many.
+static size_t cluster_replicas(cache_cluster_t* cluster, const char* key, cluster_node_t** replicas) {
+    size_t wanted = cluster->config.replication_factor;
+    if (wanted == 0) {
+        wanted = 1;
+    }
+    if (wanted > CLUSTER_MAX_REPLICAS) {
+        wanted = CLUSTER_MAX_REPLICAS;
+    }
+    if (wanted > cluster->node_count) {
+        wanted = cluster->node_count;
+    }
+    if (wanted == 0) {
+        return 0;
+    }
+    
+    // First point at or after the key's hash, wrapping past the end
+    uint32_t hash = ring_hash(key);
+    size_t low = 0;
+    size_t high = cluster->ring_size;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (cluster->ring[mid].hash < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    
+    size_t found = 0;
+    for (size_t i = 0; i < cluster->ring_size && found < wanted; i++) {
+        cluster_node_t* node = cluster->ring[(low + i) % cluster->ring_size].node;
+        bool seen = false;
+        for (size_t j = 0; j < found && !seen; j++) {
+            seen = replicas[j] == node;
+        }
+        if (!seen) {
+            replicas[found++] = node;
+        }
+    }
+    return found;
+}
+
+static void cluster_node_destroy(cluster_node_t* node) {
+    cache_instance_destroy(node->cache);
+    safe_free((void**)&node);
+}
+
 cache_cluster_t* cache_cluster_create(replication_config_t* config) {
-    (void)config;
-    return (cache_cluster_t*)calloc(1, 64);
+    if (!config) {
+        return NULL;
+    }
+    
+    cache_cluster_t* cluster = safe_calloc(1, sizeof(cache_cluster_t));
+    cluster->config = *config;
+    pthread_rwlock_init(&cluster->lock, NULL);
+    return cluster;
 }
 
 void cache_cluster_destroy(cache_cluster_t* cluster) {
-    free(cluster);
+    if (!cluster) return;
+    
+    for (size_t i = 0; i < cluster->node_count; i++) {
+        cluster_node_destroy(cluster->nodes[i]);
+    }
+    safe_free((void**)&cluster->nodes);
+    safe_free((void**)&cluster->ring);
+    pthread_rwlock_destroy(&cluster->lock);
+    safe_free((void**)&cluster);
 }
 
+// The node is connected before it joins the ring, so it never owns keys it
+// can't serve. Keys it takes over start out as misses.
 int cache_cluster_add_node(cache_cluster_t* cluster, const char* host, int port) {
-    (void)cluster; (void)host; (void)port;
+    if (!cluster || !host || port <= 0 || port > 65535 || strlen(host) >= sizeof(((cluster_node_t*)0)->host)) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    cluster_node_t* node = safe_calloc(1, sizeof(cluster_node_t));
+    snprintf(node->id, sizeof(node->id), "%.50s:%d", host, port);
+    snprintf(node->host, sizeof(node->host), "%s", host);
+    node->port = port;
+    
+    cache_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.type = CACHE_TYPE_REDIS;
+    config.max_size = 1;      // The local store goes unused
+    snprintf(config.redis_host, sizeof(config.redis_host), "%s", host);
+    config.redis_port = port;
+    node->cache = cache_instance_create(&config);
+    if (cache_instance_connect(node->cache) != SUCCESS) {
+        cluster_node_destroy(node);
+        return ERROR_IO;
+    }
+    
+    pthread_rwlock_wrlock(&cluster->lock);
+    for (size_t i = 0; i < cluster->node_count; i++) {
+        if (strcmp(cluster->nodes[i]->id, node->id) == 0) {
+            pthread_rwlock_unlock(&cluster->lock);
+            cluster_node_destroy(node);
+            return ERROR_ALREADY_EXISTS;
+        }
+    }
+    
+    cluster->nodes = safe_realloc(cluster->nodes, (cluster->node_count + 1) * sizeof(cluster_node_t*));
+    cluster->nodes[cluster->node_count++] = node;
+    cluster->ring = safe_realloc(cluster->ring, (cluster->ring_size + CLUSTER_VNODES) * sizeof(ring_point_t));
+    char vnode[96];
+    for (int i = 0; i < CLUSTER_VNODES; i++) {
+        snprintf(vnode, sizeof(vnode), "%s#%d", node->id, i);
+        cluster->ring[cluster->ring_size++] = (ring_point_t){ ring_hash(vnode), node };
+    }
+    qsort(cluster->ring, cluster->ring_size, sizeof(ring_point_t), ring_point_compare);
+    pthread_rwlock_unlock(&cluster->lock);
+    
     return SUCCESS;
 }
 
+// node_id is "host:port" as reported by cache_cluster_get_nodes
 int cache_cluster_remove_node(cache_cluster_t* cluster, const char* node_id) {
-    (void)cluster; (void)node_id;
+    if (!cluster || !node_id) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    pthread_rwlock_wrlock(&cluster->lock);
+    cluster_node_t* node = NULL;
+    for (size_t i = 0; i < cluster->node_count && !node; i++) {
+        if (strcmp(cluster->nodes[i]->id, node_id) == 0) {
+            node = cluster->nodes[i];
+            cluster->nodes[i] = cluster->nodes[--cluster->node_count];
+        }
+    }
+    if (node) {
+        size_t kept = 0;
+        for (size_t i = 0; i < cluster->ring_size; i++) {
+            if (cluster->ring[i].node != node) {
+                cluster->ring[kept++] = cluster->ring[i];
+            }
+        }
+        cluster->ring_size = kept;
+    }
+    pthread_rwlock_unlock(&cluster->lock);
+    
+    if (!node) {
+        return ERROR_NOT_FOUND;
+    }
+    cluster_node_destroy(node);
     return SUCCESS;
 }
 
 int cache_cluster_get_nodes(cache_cluster_t* cluster, cache_node_info_t** nodes, size_t* count) {
-    (void)cluster;
-    *nodes = NULL;
-    *count = 0;
+    if (!cluster || !nodes || !count) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    pthread_rwlock_rdlock(&cluster->lock);
+    *count = cluster->node_count;
+    *nodes = safe_calloc(*count > 0 ? *count : 1, sizeof(cache_node_info_t));
+    for (size_t i = 0; i < *count; i++) {
+        cluster_node_t* node = cluster->nodes[i];
+        cache_node_info_t* info = &(*nodes)[i];
+        snprintf(info->node_id, sizeof(info->node_id), "%s", node->id);
+        snprintf(info->host, sizeof(info->host), "%s", node->host);
+        info->port = node->port;
+        info->is_master = true;   // Every node is primary for its own arcs
+        info->is_connected = true;
+    }
+    pthread_rwlock_unlock(&cluster->lock);
     return SUCCESS;
 }
 
+// Written to every replica in parallel; fails if any replica rejects it
 int cache_cluster_set(cache_cluster_t* cluster, const char* key, const void* value, size_t value_size) {
-    (void)cluster; (void)key; (void)value; (void)value_size;
-    return SUCCESS;
+    if (!cluster || !key || (!value && value_size > 0)) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    pthread_rwlock_rdlock(&cluster->lock);
+    cluster_node_t* replicas[CLUSTER_MAX_REPLICAS];
+    size_t count = cluster_replicas(cluster, key, replicas);
+    cache_instance_t* caches[CLUSTER_MAX_REPLICAS];
+    int results[CLUSTER_MAX_REPLICAS];
+    for (size_t i = 0; i < count; i++) {
+        caches[i] = replicas[i]->cache;
+    }
+    
+    const char* argv[] = {"SET", key, value_size > 0 ? value : ""};
+    size_t lens[] = {3, strlen(key), value_size};
+    remote_fanout(caches, count, 3, argv, lens, NULL, results);
+    pthread_rwlock_unlock(&cluster->lock);
+    
+    int result = count > 0 ? SUCCESS : ERROR_NOT_FOUND;
+    for (size_t i = 0; i < count && result == SUCCESS; i++) {
+        result = results[i];
+    }
+    return result;
 }
 
+// Reads go to the primary, or round-robin over the replicas with
+// enable_read_from_replicas. Unreachable nodes are skipped.
 int cache_cluster_get(cache_cluster_t* cluster, const char* key, void** value, size_t* value_size) {
-    (void)cluster; (void)key;
-    *value = NULL;
+    if (!cluster || !key) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (value) *value = NULL;
     if (value_size) *value_size = 0;
-    return SUCCESS;
+    
+    pthread_rwlock_rdlock(&cluster->lock);
+    cluster_node_t* replicas[CLUSTER_MAX_REPLICAS];
+    size_t count = cluster_replicas(cluster, key, replicas);
+    size_t first = 0;
+    if (cluster->config.enable_read_from_replicas && count > 1) {
+        first = __atomic_fetch_add(&cluster->reads, 1, __ATOMIC_RELAXED) % count;
+    }
+    
+    int result = count > 0 ? ERROR_IO : ERROR_NOT_FOUND;
+    for (size_t i = 0; i < count && result == ERROR_IO; i++) {
+        result = cache_get(replicas[(first + i) % count]->cache, key, value, value_size);
+    }
+    pthread_rwlock_unlock(&cluster->lock);
+    return result;
 }
 
 int cache_cluster_delete(cache_cluster_t* cluster, const char* key) {
-    (void)cluster; (void)key;
-    return SUCCESS;
+    if (!cluster || !key) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    pthread_rwlock_rdlock(&cluster->lock);
+    cluster_node_t* replicas[CLUSTER_MAX_REPLICAS];
+    size_t count = cluster_replicas(cluster, key, replicas);
+    cache_instance_t* caches[CLUSTER_MAX_REPLICAS];
+    int results[CLUSTER_MAX_REPLICAS];
+    int64_t deleted[CLUSTER_MAX_REPLICAS];
+    for (size_t i = 0; i < count; i++) {
+        caches[i] = replicas[i]->cache;
+    }
+    
+    const char* argv[] = {"DEL", key};
+    remote_fanout(caches, count, 2, argv, NULL, deleted, results);
+    pthread_rwlock_unlock(&cluster->lock);
+    
+    int result = ERROR_NOT_FOUND;
+    for (size_t i = 0; i < count; i++) {
+        if (results[i] != SUCCESS) {
+            return results[i];
+        }
+        if (deleted[i] > 0) {
+            result = SUCCESS;
+        }
+    }
+    return result;
 }
 
+// =============================================================================
+// Consistency and correctness
+// =============================================================================
+
 int cache_validate_consistency(cache_instance_t* cache, const char* key, const void* expected_value, size_t expected_size) {
     (void)cache; (void)key; (void)expected_value; (void)expected_size;
     return SUCCESS;
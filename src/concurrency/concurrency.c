@@ -1,64 +1,478 @@
+#define _POSIX_C_SOURCE 200809L
 #include "concurrency.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+// The thread pool is implemented; the rest of the module is still minimal
+// stubs that return SUCCESS or allocate dummy structs
+
+// =============================================================================
+// Thread pool
+// =============================================================================
+
+// Workers take tasks from per-priority FIFO queues, highest priority first
+// (a single FIFO unless enable_priority_queue is set).
+// A task is shared by the pool and its submitter: the pool lets go once the
+// task has finished or been cancelled, the submitter with
+// thread_pool_task_release, and the last one out frees it.
+#define THREAD_POOL_DEFAULT_THREADS 4
+#define TASK_PRIORITY_LEVELS (TASK_PRIORITY_CRITICAL + 1)
+
+typedef struct pool_task {
+    task_t task;              // First, so a task_t* is a pool_task_t*
+    thread_pool_t* pool;
+    int refs;
+    uint64_t queued_ns;
+    struct pool_task* next;
+} pool_task_t;
+
+struct thread_pool {
+    thread_pool_config_t config;
+    pthread_mutex_t lock;
+    pthread_cond_t work;      // Task queued, resize or shutdown
+    pthread_cond_t finished;  // A task completed or was cancelled
+    pthread_cond_t resized;   // A resize or shutdown let go of the workers
+    pool_task_t* heads[TASK_PRIORITY_LEVELS];
+    pool_task_t* tails[TASK_PRIORITY_LEVELS];
+    size_t queued;
+    size_t unfinished;        // Queued or running
+    size_t active;            // Running
+    
+    pthread_t* threads;
+    size_t thread_count;
+    size_t thread_target;     // Workers at or past this index exit
+    bool resizing;            // A resize or shutdown owns threads[], joining without the lock
+    bool started;
+    bool stopping;
+    bool draining;            // Shutdown runs the queued tasks first
+    
+    uint64_t next_id;
+    uint64_t completed;
+    uint64_t rejected;
+    uint64_t task_ns;
+    uint64_t wait_ns;
+    uint64_t started_ns;
+};
+
+typedef struct {
+    thread_pool_t* pool;
+    size_t index;
+} pool_worker_t;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void task_unref(pool_task_t* task) {
+    if (__atomic_sub_fetch(&task->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(task);
+    }
+}
+
+static int pool_queue_of(thread_pool_t* pool, pool_task_t* task) {
+    return pool->config.enable_priority_queue ? (int)task->task.priority : TASK_PRIORITY_NORMAL;
+}
+
+static pool_task_t* pool_dequeue(thread_pool_t* pool) {
+    for (int priority = TASK_PRIORITY_LEVELS - 1; priority >= 0; priority--) {
+        pool_task_t* task = pool->heads[priority];
+        if (task) {
+            pool->heads[priority] = task->next;
+            if (!task->next) {
+                pool->tails[priority] = NULL;
+            }
+            task->next = NULL;
+            pool->queued--;
+            return task;
+        }
+    }
+    return NULL;
+}
 
-// Minimal stub implementations for concurrency module
-// All functions return SUCCESS or allocate dummy structs
+// Record the outcome and wake waiters; called with the lock held
+static void task_finish(thread_pool_t* pool, pool_task_t* task, task_state_t state) {
+    task->task.state = state;
+    task->task.completed_at = get_timestamp_ms();
+    pool->unfinished--;
+    pthread_cond_broadcast(&pool->finished);
+}
+
+// Drop everything still queued; called with the lock held
+static void pool_cancel_queued(thread_pool_t* pool) {
+    pool_task_t* task;
+    while ((task = pool_dequeue(pool)) != NULL) {
+        task_finish(pool, task, TASK_STATE_CANCELLED);
+        task_unref(task);
+    }
+}
+
+static void* pool_worker_main(void* arg) {
+    pool_worker_t* worker = (pool_worker_t*)arg;
+    thread_pool_t* pool = worker->pool;
+    size_t index = worker->index;
+    free(worker);
+    
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (index < pool->thread_target && pool->queued == 0 && !pool->stopping) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if (index >= pool->thread_target || pool->queued == 0 || (pool->stopping && !pool->draining)) {
+            break;
+        }
+        
+        pool_task_t* task = pool_dequeue(pool);
+        uint64_t start = monotonic_ns();
+        pool->wait_ns += start - task->queued_ns;
+        pool->active++;
+        task->task.state = TASK_STATE_RUNNING;
+        task->task.started_at = get_timestamp_ms();
+        pthread_mutex_unlock(&pool->lock);
+        
+        task->task.function(task->task.arg);
+        if (task->task.on_complete) {
+            task->task.on_complete(task->task.arg, task->task.completion_arg);
+        }
+        
+        pthread_mutex_lock(&pool->lock);
+        pool->active--;
+        pool->completed++;
+        pool->task_ns += monotonic_ns() - start;
+        task_finish(pool, task, TASK_STATE_COMPLETED);
+        task_unref(task);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
 
+// Start one more worker; called with the lock held
+static int pool_spawn(thread_pool_t* pool) {
+    pool_worker_t* worker = malloc(sizeof(pool_worker_t));
+    pthread_t* threads = realloc(pool->threads, (pool->thread_count + 1) * sizeof(pthread_t));
+    if (!worker || !threads) {
+        free(worker);
+        if (threads) pool->threads = threads;
+        return ERROR_MEMORY;
+    }
+    pool->threads = threads;
+    worker->pool = pool;
+    worker->index = pool->thread_count;
+    
+    if (pthread_create(&pool->threads[pool->thread_count], NULL, pool_worker_main, worker) != 0) {
+        free(worker);
+        return ERROR_MEMORY;
+    }
+    pool->thread_count++;
+    pool->thread_target = pool->thread_count;
+    return SUCCESS;
+}
+
+// Wait until no resize or shutdown is under way, then become the one; called
+// with the lock held. While resizing is set nothing else spawns or joins
+// workers, so threads[] can be read without the lock.
+static void pool_begin_resize(thread_pool_t* pool) {
+    while (pool->resizing) {
+        pthread_cond_wait(&pool->resized, &pool->lock);
+    }
+    pool->resizing = true;
+}
+
+static void pool_end_resize(thread_pool_t* pool) {
+    pool->resizing = false;
+    pthread_cond_broadcast(&pool->resized);
+}
+
+// Join the workers at index first and above; called with the lock held and
+// resizing set. The lock is released while joining.
+static void pool_join_from(thread_pool_t* pool, size_t first) {
+    size_t count = pool->thread_count;
+    pool->thread_target = first;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = first; i < count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->thread_count = first;
+}
+
+// Fixed and work-stealing pools run max_threads workers (min_threads if
+// max_threads is 0). Cached pools start with min_threads and add workers up
+// to max_threads while tasks are waiting; idle workers are kept until
+// shutdown.
 thread_pool_t* thread_pool_create(thread_pool_config_t* config) {
-    (void)config;
-    return (thread_pool_t*)calloc(1, 64);
+    thread_pool_t* pool = calloc(1, sizeof(thread_pool_t));
+    if (!pool) {
+        return NULL;
+    }
+    if (config) {
+        pool->config = *config;
+    }
+    if (pool->config.max_threads == 0) {
+        pool->config.max_threads = pool->config.min_threads > 0 ? pool->config.min_threads
+                                                                : THREAD_POOL_DEFAULT_THREADS;
+    }
+    if (pool->config.min_threads == 0 || pool->config.min_threads > pool->config.max_threads) {
+        pool->config.min_threads = pool->config.type == THREAD_POOL_CACHED ? 1 : pool->config.max_threads;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->finished, NULL);
+    pthread_cond_init(&pool->resized, NULL);
+    return pool;
 }
 
 void thread_pool_destroy(thread_pool_t* pool) {
+    if (!pool) return;
+    
+    thread_pool_shutdown(pool, false);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->finished);
+    pthread_cond_destroy(&pool->resized);
+    free(pool->threads);
     free(pool);
 }
 
 int thread_pool_start(thread_pool_t* pool) {
-    (void)pool;
-    return SUCCESS;
-}
-
+    if (!pool) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    if (pool->started || pool->stopping) {
+        pthread_mutex_unlock(&pool->lock);
+        return ERROR_INVALID_PARAM;
+    }
+    pool->started = true;
+    pool->started_ns = monotonic_ns();
+    
+    size_t threads = pool->config.type == THREAD_POOL_CACHED ? pool->config.min_threads : pool->config.max_threads;
+    int result = SUCCESS;
+    while (pool->thread_count < threads && result == SUCCESS) {
+        result = pool_spawn(pool);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return result;
+}
+
+// Stops accepting tasks and joins the workers. With wait_for_completion the
+// queued tasks run first; otherwise they are cancelled. Running tasks always
+// finish. A resize under way is finished first.
 int thread_pool_shutdown(thread_pool_t* pool, bool wait_for_completion) {
-    (void)pool; (void)wait_for_completion;
-    return SUCCESS;
-}
-
+    if (!pool) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    pool_begin_resize(pool);
+    pool->stopping = true;
+    pool->draining = wait_for_completion && pool->thread_count > 0;
+    if (!pool->draining) {
+        pool_cancel_queued(pool);
+    }
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    
+    // Workers leave once the queue is empty (or at once when not draining)
+    for (size_t i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    pool->thread_count = 0;
+    pool->thread_target = 0;
+    pool_cancel_queued(pool);
+    pool_end_resize(pool);
+    pthread_mutex_unlock(&pool->lock);
+    return SUCCESS;
+}
+
+// Tasks queue until the pool is started. Returns NULL once the pool is
+// shutting down or when queue_size tasks are already waiting.
 task_t* thread_pool_submit(thread_pool_t* pool, task_fn function, void* arg) {
-    (void)pool; (void)function; (void)arg;
-    return (task_t*)calloc(1, sizeof(task_t));
+    return thread_pool_submit_with_priority(pool, function, arg, TASK_PRIORITY_NORMAL);
 }
 
 task_t* thread_pool_submit_with_priority(thread_pool_t* pool, task_fn function, void* arg, task_priority_t priority) {
-    (void)pool; (void)function; (void)arg; (void)priority;
-    return (task_t*)calloc(1, sizeof(task_t));
-}
-
+    if (!pool || !function || priority < TASK_PRIORITY_LOW || priority > TASK_PRIORITY_CRITICAL) {
+        return NULL;
+    }
+    
+    pool_task_t* task = calloc(1, sizeof(pool_task_t));
+    if (!task) {
+        return NULL;
+    }
+    task->task.function = function;
+    task->task.arg = arg;
+    task->task.priority = priority;
+    task->task.state = TASK_STATE_PENDING;
+    task->task.submitted_at = get_timestamp_ms();
+    task->pool = pool;
+    task->refs = 2;           // The pool's and the submitter's
+    task->queued_ns = monotonic_ns();
+    
+    pthread_mutex_lock(&pool->lock);
+    if (pool->stopping || (pool->config.queue_size > 0 && pool->queued >= pool->config.queue_size)) {
+        pool->rejected++;
+        pthread_mutex_unlock(&pool->lock);
+        free(task);
+        return NULL;
+    }
+    
+    snprintf(task->task.id, sizeof(task->task.id), "task-%llu", (unsigned long long)++pool->next_id);
+    int queue = pool_queue_of(pool, task);
+    if (pool->tails[queue]) {
+        pool->tails[queue]->next = task;
+    } else {
+        pool->heads[queue] = task;
+    }
+    pool->tails[queue] = task;
+    pool->queued++;
+    pool->unfinished++;
+    
+    // Cached pools grow while every worker is busy, but not mid-resize
+    if (pool->started && !pool->resizing && pool->config.type == THREAD_POOL_CACHED &&
+        pool->active + pool->queued > pool->thread_count && pool->thread_count < pool->config.max_threads) {
+        pool_spawn(pool);
+    }
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    return &task->task;
+}
+
+// Only tasks that haven't started can be cancelled
 int thread_pool_cancel_task(thread_pool_t* pool, task_t* task) {
-    (void)pool; (void)task;
-    return SUCCESS;
-}
-
+    if (!pool || !task || ((pool_task_t*)task)->pool != pool) {
+        return ERROR_INVALID_PARAM;
+    }
+    pool_task_t* target = (pool_task_t*)task;
+    
+    pthread_mutex_lock(&pool->lock);
+    if (task->state != TASK_STATE_PENDING) {
+        pthread_mutex_unlock(&pool->lock);
+        return ERROR_NOT_FOUND;
+    }
+    
+    int queue = pool_queue_of(pool, target);
+    pool_task_t** link = &pool->heads[queue];
+    pool_task_t* previous = NULL;
+    while (*link != target) {
+        previous = *link;
+        link = &(*link)->next;
+    }
+    *link = target->next;
+    if (pool->tails[queue] == target) {
+        pool->tails[queue] = previous;
+    }
+    target->next = NULL;
+    pool->queued--;
+    task_finish(pool, target, TASK_STATE_CANCELLED);
+    pthread_mutex_unlock(&pool->lock);
+    
+    task_unref(target);
+    return SUCCESS;
+}
+
+// Blocks until the task has run; ERROR_NOT_FOUND if it was cancelled instead
 int thread_pool_wait_for_task(task_t* task) {
-    (void)task;
-    return SUCCESS;
-}
-
+    if (!task) {
+        return ERROR_INVALID_PARAM;
+    }
+    thread_pool_t* pool = ((pool_task_t*)task)->pool;
+    
+    pthread_mutex_lock(&pool->lock);
+    while (task->state == TASK_STATE_PENDING || task->state == TASK_STATE_RUNNING) {
+        pthread_cond_wait(&pool->finished, &pool->lock);
+    }
+    task_state_t state = task->state;
+    pthread_mutex_unlock(&pool->lock);
+    
+    return state == TASK_STATE_COMPLETED ? SUCCESS : ERROR_NOT_FOUND;
+}
+
+// Blocks until nothing is queued or running. The pool must be started.
 int thread_pool_wait_all(thread_pool_t* pool) {
-    (void)pool;
+    if (!pool) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    while (pool->unfinished > 0) {
+        pthread_cond_wait(&pool->finished, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
     return SUCCESS;
 }
 
-int thread_pool_get_stats(thread_pool_t* pool, thread_pool_stats_t* stats) {
-    (void)pool;
-    if (stats) memset(stats, 0, sizeof(thread_pool_stats_t));
-    return SUCCESS;
+void thread_pool_task_release(task_t* task) {
+    if (task) {
+        task_unref((pool_task_t*)task);
+    }
 }
 
+int thread_pool_get_stats(thread_pool_t* pool, thread_pool_stats_t* stats) {
+    if (!pool || !stats) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    memset(stats, 0, sizeof(thread_pool_stats_t));
+    pthread_mutex_lock(&pool->lock);
+    stats->total_threads = pool->thread_count;
+    stats->active_threads = pool->active;
+    stats->idle_threads = pool->thread_count - pool->active;
+    stats->queued_tasks = pool->queued;
+    stats->completed_tasks = pool->completed;
+    stats->rejected_tasks = pool->rejected;
+    if (pool->completed > 0) {
+        stats->avg_task_time_ms = pool->task_ns / 1e6 / pool->completed;
+        stats->avg_wait_time_ms = pool->wait_ns / 1e6 / pool->completed;
+    }
+    uint64_t elapsed = pool->started ? monotonic_ns() - pool->started_ns : 0;
+    if (elapsed > 0 && pool->thread_count > 0) {
+        stats->thread_utilization = (double)pool->task_ns / ((double)elapsed * pool->thread_count);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return SUCCESS;
+}
+
+// Shrinking waits for the surplus workers to finish their current task.
+// Concurrent resizes run one after another.
 int thread_pool_resize(thread_pool_t* pool, size_t new_size) {
-    (void)pool; (void)new_size;
-    return SUCCESS;
-}
+    if (!pool || new_size == 0) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    pool_begin_resize(pool);
+    int result = SUCCESS;
+    if (pool->stopping) {
+        result = ERROR_INVALID_PARAM;
+    } else {
+        pool->config.max_threads = new_size;
+        if (pool->config.min_threads > new_size) {
+            pool->config.min_threads = new_size;
+        }
+        if (pool->started && new_size < pool->thread_count) {
+            pool_join_from(pool, new_size);
+        }
+        while (pool->started && pool->config.type != THREAD_POOL_CACHED &&
+               pool->thread_count < new_size && result == SUCCESS) {
+            result = pool_spawn(pool);
+        }
+    }
+    pool_end_resize(pool);
+    pthread_mutex_unlock(&pool->lock);
+    return result;
+}
+
+// =============================================================================
+// Stubs
+// =============================================================================
 
 async_io_context_t* async_io_create(async_io_config_t* config) {
     (void)config;
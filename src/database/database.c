@@ -4,30 +4,96 @@
 #include <sys/types.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
 
-#define WAL_MAGIC 0x57414C00  // "WAL\0"
 #define MAX_KEY_SIZE 256
 #define MAX_VALUE_SIZE (1024 * 1024)  // 1MB
+#define MAX_BATCH_SIZE (1024 * 1024 * 1024)  // Encoded operations in one write batch
+
+// Group commit defaults: sync as soon as the disk is free, and let a batch
+// grow while the previous one is being synced
+#define DEFAULT_WAL_BATCH_DELAY_US 0
+#define DEFAULT_WAL_BATCH_MAX_BYTES (1024 * 1024)
+
+// A WAL segment this large triggers a background snapshot
+#define DEFAULT_SNAPSHOT_WAL_BYTES (64 * 1024 * 1024)
+
+// Snapshot file: a header, then key-sorted entries of
+// [key_size u32][value_size u32][key][value], covered by body_crc
+#define SNAPSHOT_MAGIC 0x534E4150  // "SNAP"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BUFFER_SIZE (1024 * 1024)
+#define SNAPSHOT_SCAN_BUCKETS 256   // Buckets copied per read-lock hold
+#define SNAPSHOT_WRITE_KEYS 256     // Keys looked up per read-lock hold
+
+// LSM engine defaults
+#define DEFAULT_MEMTABLE_BYTES (4 * 1024 * 1024)
+#define DEFAULT_SSTABLE_BLOCK_SIZE 4096
+#define DEFAULT_LEVEL0_COMPACTION_TRIGGER 4
+#define DEFAULT_LEVEL1_MAX_BYTES (32 * 1024 * 1024)
+#define LSM_MAX_LEVELS 7
+#define LSM_LEVEL_SIZE_RATIO 10               // Each level holds 10x the one above
+#define LSM_TARGET_FILE_BYTES (2 * 1024 * 1024)
+#define MEMTABLE_MAX_HEIGHT 12
+#define SSTABLE_MAGIC 0x53535431              // "SST1"
+#define MANIFEST_MAGIC 0x4D414E31             // "MAN1"
+#define DEFAULT_BLOOM_BITS_PER_KEY 10
+#define DEFAULT_BLOCK_CACHE_BYTES (8 * 1024 * 1024)
+#define BLOCK_CACHE_SHARDS 16
+#define BLOOM_BLOCK_BITS 512                  // One cache line
+#define BLOOM_BLOCK_WORDS (BLOOM_BLOCK_BITS / 64)
+
+// B+tree index: one node per page. Bulk loading fills leaves to 7/8 so the
+// first inserts after it do not split every leaf.
+#define BTREE_PAGE_SIZE 4096
+#define BTREE_LEAF_SLOTS 255
+#define BTREE_INNER_KEYS 169
+#define BTREE_BULK_LEAF_SLOTS (BTREE_LEAF_SLOTS * 7 / 8)
+#define SCAN_BATCH_KEYS 256          // Keys read per lock hold during a scan
+
+// Snapshot of a read that wants the newest committed version
+#define READ_LATEST UINT64_MAX
 
 // WAL entry types
 typedef enum {
     WAL_ENTRY_PUT,
     WAL_ENTRY_DELETE,
     WAL_ENTRY_COMMIT,
-    WAL_ENTRY_ROLLBACK
+    WAL_ENTRY_ROLLBACK,
+    WAL_ENTRY_BATCH
 } wal_entry_type_t;
 
-// WAL entry
+// WAL record: a frame, then a body of header + key + value. The frame's CRC32C
+// covers the whole body, so a torn or corrupt record fails the check. A batch
+// record has no key; its value is the batch's operations, each a
+// wal_batch_op_t followed by key and value, replayed together or not at all.
 typedef struct {
-    uint32_t magic;
-    wal_entry_type_t type;
-    uint64_t txn_id;
-    uint32_t key_size;
+    uint32_t length;           // Body bytes following the frame
+    uint32_t crc;
+} wal_frame_t;
+
+typedef struct {
+    uint32_t type;             // wal_entry_type_t
+    uint32_t key_size;         // Including the terminating NUL
     uint32_t value_size;
-    char data[];  // key + value
+    uint32_t reserved;
+    uint64_t txn_id;
 } wal_entry_t;
 
-// Hash table entry
+typedef struct {
+    uint32_t type;             // WAL_ENTRY_PUT or WAL_ENTRY_DELETE
+    uint32_t key_size;         // Including the terminating NUL
+    uint32_t value_size;
+    uint32_t reserved;
+} wal_batch_op_t;
+
+// Hash table entry. In the engine's table, snapshot readers walk entries
+// without db->lock, so writers store next, value and value_size atomically.
 typedef struct hash_entry {
     char* key;
     void* value;
@@ -40,15 +106,334 @@ typedef struct {
     hash_entry_t** buckets;
     size_t bucket_count;
     size_t size;
+    uint64_t resizes;
+    uint64_t generation;       // Odd while a resize is relinking entries
+    database_t* db;            // Owner of the engine's table; NULL for a private one
 } hash_table_t;
 
+// B+tree slot. Leaves point at table entries, which stay put until deleted;
+// inner nodes own copies of their separator keys. prefix holds the first
+// eight key bytes big-endian so most comparisons skip the string.
+typedef struct {
+    uint64_t prefix;
+    void* ref;
+} btree_slot_t;
+
+typedef struct btree_node {
+    uint32_t count;            // Slots in a leaf, keys in an inner node
+    uint32_t leaf;
+    struct btree_node* next;   // Next leaf in key order
+    union {
+        btree_slot_t slots[BTREE_LEAF_SLOTS];
+        struct {
+            btree_slot_t keys[BTREE_INNER_KEYS];
+            struct btree_node* children[BTREE_INNER_KEYS + 1];
+        } inner;
+    };
+} btree_node_t;
+
+_Static_assert(sizeof(btree_node_t) <= BTREE_PAGE_SIZE, "B-tree node must fit a page");
+
+typedef struct {
+    btree_node_t* root;
+    size_t size;
+    int height;
+} btree_t;
+
+// Registered index; only B-tree indexes over the hash engine carry a tree
+typedef struct db_index {
+    char* name;
+    index_type_t type;
+    btree_t* btree;
+    struct db_index* next;
+} db_index_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t entry_count;
+    uint64_t wal_segment;      // First WAL segment not covered by the snapshot
+    uint32_t body_crc;
+    uint32_t reserved;
+} snapshot_header_t;
+
+// Memtable: a skiplist of versions ordered by key, newest first
+typedef struct mem_node {
+    char* key;
+    void* value;               // NULL for a delete
+    uint32_t value_size;
+    uint32_t type;             // WAL_ENTRY_PUT or WAL_ENTRY_DELETE
+    uint64_t seq;
+    int height;
+    struct mem_node* next[];
+} mem_node_t;
+
+typedef struct {
+    mem_node_t* head;
+    int height;
+    uint32_t rng;
+    size_t bytes;              // Nodes, keys and values
+    size_t entries;
+    uint64_t max_seq;
+} memtable_t;
+
+// Sorted table file: data blocks of entries (sst_entry_t, key, value), each
+// followed by its CRC32C, then the Bloom filter, then an index block with the
+// smallest key and one sst_index_entry_t and last key per data block, then a
+// fixed footer holding the filter and index checksums
+typedef struct {
+    uint32_t key_size;         // Including the terminating NUL
+    uint32_t value_size;
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t seq;
+} sst_entry_t;
+
+typedef struct {
+    uint64_t offset;
+    uint32_t size;             // Block bytes, not counting the CRC
+    uint32_t key_size;         // Last key in the block
+} sst_index_entry_t;
+
+typedef struct {
+    uint64_t filter_offset;
+    uint64_t index_offset;
+    uint64_t index_size;
+    uint64_t entry_count;
+    uint32_t filter_size;      // Bytes, a whole number of 512-bit blocks; 0 without a filter
+    uint32_t filter_probes;
+    uint32_t filter_crc;
+    uint32_t index_crc;
+    uint32_t magic;
+    uint32_t reserved;
+} sst_footer_t;
+
+typedef struct {
+    char* last_key;
+    uint64_t offset;
+    uint32_t size;
+} sst_block_t;
+
+// Block cache: data blocks shared between readers, sharded so lookups in
+// different shards never contend. A block's refs count the readers holding
+// it plus one while it is cached.
+typedef struct cached_block {
+    uint64_t file_number;
+    uint64_t offset;
+    char* data;
+    uint32_t size;
+    int refs;                  // Under the shard lock once shared
+    bool shared;               // Inserted in a cache rather than private to one reader
+    bool cached;
+    struct cached_block* hash_next;
+    struct cached_block* prev; // LRU list, most recent first
+    struct cached_block* next;
+} cached_block_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    cached_block_t** buckets;
+    size_t bucket_count;
+    size_t count;
+    cached_block_t lru;        // List head
+    size_t usage;              // Bytes of blocks and their headers
+    size_t capacity;
+    uint64_t hits;
+    uint64_t misses;
+} block_cache_shard_t;
+
+typedef struct {
+    block_cache_shard_t shards[BLOCK_CACHE_SHARDS];
+} block_cache_t;
+
+// An open table, shared by every version that lists it
+typedef struct {
+    uint64_t number;
+    char* path;
+    int fd;
+    uint64_t size;
+    uint64_t entries;
+    char* smallest;
+    char* largest;
+    sst_block_t* blocks;
+    size_t block_count;
+    uint64_t* filter;          // Cache-line aligned; NULL without a filter
+    size_t filter_blocks;
+    uint32_t filter_probes;
+    block_cache_t* cache;
+    int refs;
+    bool obsolete;             // Compacted away: unlinked with the last reference
+} sst_file_t;
+
+// The set of live tables. Readers pin a version for the length of a lookup;
+// the LSM thread installs a new one for every flush and compaction.
+typedef struct {
+    sst_file_t** files[LSM_MAX_LEVELS];  // Level 0 newest first, others by key
+    size_t counts[LSM_MAX_LEVELS];
+    int refs;
+} lsm_version_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t file_count;
+    uint64_t next_file_number;
+    uint64_t last_seq;         // Newest sequence number in the tables
+    uint64_t wal_segment;      // First WAL segment not flushed to a table
+    uint32_t body_crc;
+    uint32_t reserved;
+} manifest_header_t;
+
+typedef struct {
+    uint32_t level;
+    uint32_t reserved;
+    uint64_t number;
+} manifest_file_t;
+
+// A committed version of a key, newest first
+typedef struct mvcc_version {
+    uint64_t commit_ts;        // 0 for the value before tracking began
+    bool deleted;              // The key did not exist as of commit_ts
+    void* value;
+    size_t value_size;
+    struct mvcc_version* older;
+} mvcc_version_t;
+
+typedef struct mvcc_chain {
+    char* key;
+    mvcc_version_t* newest;
+    struct mvcc_chain* next;
+} mvcc_chain_t;
+
+typedef struct {
+    mvcc_chain_t** buckets;
+    size_t bucket_count;
+    size_t size;
+    size_t versions;
+    uint64_t generation;       // Odd while a resize is relinking chains
+} mvcc_table_t;
+
+// Memory unlinked while a reader without a lock may still hold it
+typedef struct retired {
+    void* ptr;
+    void (*release)(void*);
+    struct retired* next;
+} retired_t;
+
+// Epoch-based reclamation: readers pin the current epoch for the length of a
+// lookup, and what is unlinked during an epoch is released once every reader
+// pinned in it has left
+typedef struct {
+    uint64_t current;
+    uint64_t readers[2];       // Pinned in even and odd epochs
+    retired_t* retired[2];     // Retired during even and odd epochs
+    pthread_mutex_t lock;      // Over retired and moving current on
+} epoch_t;
+
+// Records appended but not yet handed to the committer
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+    size_t records;
+} wal_buffer_t;
+
 struct database {
     char* data_dir;
+    database_config_t config;
     hash_table_t* table;
-    int wal_fd;
+    int wal_fd;                    // Active WAL segment
+    uint64_t wal_segment;
     pthread_rwlock_t lock;
+    pthread_mutex_t commit_lock;   // Writers queue here before taking lock for writing
     uint64_t next_txn_id;
     int is_open;
+    
+    // Group commit: writers append under wal_lock and wait for wal_synced;
+    // the committer thread writes and syncs everything appended so far
+    pthread_mutex_t wal_lock;
+    pthread_cond_t wal_pending;
+    pthread_cond_t wal_synced;
+    pthread_t committer;
+    bool committer_running;
+    bool wal_stopping;
+    bool wal_writing;              // A batch is being written outside the lock
+    int wal_error;                 // Sticky: set when a batch failed to reach disk
+    wal_buffer_t wal_buffer;
+    wal_buffer_t wal_flushing;
+    uint64_t wal_appended;         // Log position after the last appended record
+    uint64_t wal_durable;          // Log position up to which the WAL is synced
+    uint64_t wal_batch_started_us; // When the oldest buffered record was appended
+    uint64_t wal_segment_bytes;    // Size of the active segment, including buffered records
+    uint64_t wal_records;
+    uint64_t wal_syncs;
+    uint64_t wal_truncated_bytes;  // Invalid tail dropped by the last recovery
+    
+    // Snapshots: requests are numbered and the snapshot thread serves all
+    // requests made before it starts a run
+    pthread_mutex_t snapshot_lock;
+    pthread_cond_t snapshot_wanted;
+    pthread_cond_t snapshot_done;
+    pthread_t snapshotter;
+    bool snapshotter_running;
+    bool snapshot_stopping;
+    uint64_t snapshot_requested;
+    uint64_t snapshot_started;
+    uint64_t snapshot_completed;
+    int snapshot_status;
+    uint64_t snapshots;
+    
+    // LSM engine. mem, imm and version change under db->lock; the LSM thread
+    // is the only one to install versions, so it reads them without the lock.
+    // Snapshot readers load them atomically without it too.
+    memtable_t* mem;
+    memtable_t* imm;               // Full memtable waiting to be flushed
+    uint64_t imm_wal_segment;      // First WAL segment written after imm filled
+    lsm_version_t* version;
+    uint64_t last_seq;
+    uint64_t next_file_number;
+    uint64_t manifest_last_seq;
+    uint64_t manifest_wal_segment;
+    char* compact_pointer[LSM_MAX_LEVELS];  // Where the next level compaction starts
+    pthread_mutex_t lsm_lock;
+    pthread_cond_t lsm_work;
+    pthread_cond_t lsm_done;
+    pthread_t lsm_thread;
+    bool lsm_running;
+    bool lsm_stopping;
+    bool lsm_flush_pending;
+    bool lsm_full_compaction;      // The pending request wants a full compaction
+    uint64_t lsm_requested;        // Flush/compaction requests from callers
+    uint64_t lsm_served;
+    int lsm_status;
+    int lsm_error;                 // Sticky: a flush failed
+    uint64_t memtable_flushes;
+    uint64_t compactions;
+    block_cache_t* block_cache;
+    uint64_t bloom_negatives;      // Table lookups the filter ruled out
+    uint64_t bloom_false_positives;  // Table lookups the filter let through for an absent key
+    
+    db_index_t* indexes;           // Under db->lock
+    
+    // MVCC. commit_ts changes under db->lock. The version chains change under
+    // versions_lock, taken inside db->lock by commits and alone by the
+    // collector; snapshot readers search them and the engines with no lock,
+    // pinned in epoch so nothing they reach is freed meanwhile. The list of
+    // active snapshots is under mvcc_lock, and writers read snapshots_active
+    // without it to see whether to keep versions at all.
+    uint64_t commit_ts;            // Of the newest commit
+    mvcc_table_t versions;
+    pthread_mutex_t versions_lock;
+    epoch_t epoch;
+    pthread_mutex_t mvcc_lock;
+    pthread_cond_t mvcc_gc_wanted;
+    transaction_t* snapshots_oldest;
+    transaction_t* snapshots_newest;
+    size_t snapshots_active;
+    pthread_t mvcc_gc;
+    bool mvcc_gc_running;
+    bool mvcc_gc_stopping;
+    bool mvcc_gc_requested;
+    uint64_t txn_conflicts;        // Commits refused for a write-write or read-write conflict
 };
 
 struct transaction {
@@ -56,9 +441,123 @@ struct transaction {
     uint64_t txn_id;
     isolation_level_t level;
     hash_table_t* writes;  // Local write set
+    hash_table_t* deletes; // Keys deleted locally
+    hash_table_t* reads;   // Keys read from the database, kept for serializable validation
+    uint64_t snapshot;     // Commit timestamp reads are served at; READ_LATEST without one
+    struct transaction* older;   // Active snapshots, oldest first
+    struct transaction* newer;
     int committed;
 };
 
+// Puts and deletes encoded as the body of a WAL batch record
+struct database_write_batch {
+    wal_buffer_t ops;          // records counts the operations
+};
+
+// A scan hands out keys a batch at a time; each batch is read under a short
+// lock, starting after the last key the previous batch examined
+struct database_iterator {
+    database_t* db;
+    char* end;                 // Exclusive; NULL for no bound
+    char* resume;              // Where the next batch starts; NULL from the first key
+    bool resume_after;         // Skip resume itself: it was in the last batch
+    bool done;
+    wal_buffer_t batch;        // Keys of the current batch, back to back
+    size_t position;           // Of the next key in batch
+    const char* key;
+    int status;
+};
+
+// =============================================================================
+// Epoch reclamation
+// =============================================================================
+
+// Snapshot reads take no lock, so memory they may reach is retired rather
+// than freed. What was retired during an epoch is released when the epoch
+// after next begins, which waits until no reader pinned in it is left;
+// readers that pin a later epoch started after it was unlinked.
+
+static void epoch_init(epoch_t* epoch) {
+    memset(epoch, 0, sizeof(*epoch));
+    pthread_mutex_init(&epoch->lock, NULL);
+}
+
+static void epoch_release(retired_t* retired) {
+    while (retired) {
+        retired_t* next = retired->next;
+        retired->release(retired->ptr);
+        safe_free((void**)&retired);
+        retired = next;
+    }
+}
+
+static void epoch_destroy(epoch_t* epoch) {
+    epoch_release(epoch->retired[0]);
+    epoch_release(epoch->retired[1]);
+    pthread_mutex_destroy(&epoch->lock);
+}
+
+// Pin the current epoch; pass the result to epoch_exit
+static unsigned epoch_enter(epoch_t* epoch) {
+    for (;;) {
+        uint64_t current = __atomic_load_n(&epoch->current, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&epoch->readers[current & 1], 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&epoch->current, __ATOMIC_SEQ_CST) == current) {
+            return (unsigned)(current & 1);
+        }
+        __atomic_sub_fetch(&epoch->readers[current & 1], 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+static void epoch_exit(epoch_t* epoch, unsigned pin) {
+    __atomic_sub_fetch(&epoch->readers[pin], 1, __ATOMIC_RELEASE);
+}
+
+// Begin the next epoch if nobody is left pinned in the previous one, and
+// release what was retired during it. Two calls in a row release everything
+// retired before them unless a reader is still pinned.
+static void epoch_advance(epoch_t* epoch) {
+    retired_t* released = NULL;
+    pthread_mutex_lock(&epoch->lock);
+    uint64_t current = epoch->current;
+    unsigned previous = (unsigned)((current + 1) & 1);
+    if (__atomic_load_n(&epoch->readers[previous], __ATOMIC_SEQ_CST) == 0) {
+        released = epoch->retired[previous];
+        epoch->retired[previous] = NULL;
+        __atomic_store_n(&epoch->current, current + 1, __ATOMIC_SEQ_CST);
+    }
+    pthread_mutex_unlock(&epoch->lock);
+    epoch_release(released);
+}
+
+// Hand ptr to release once no reader can hold it
+static void epoch_retire(epoch_t* epoch, void* ptr, void (*release)(void*)) {
+    retired_t* retired = safe_malloc(sizeof(retired_t));
+    retired->ptr = ptr;
+    retired->release = release;
+    pthread_mutex_lock(&epoch->lock);
+    unsigned slot = (unsigned)(epoch->current & 1);
+    retired->next = epoch->retired[slot];
+    epoch->retired[slot] = retired;
+    pthread_mutex_unlock(&epoch->lock);
+    epoch_advance(epoch);
+}
+
+// Retire ptr if a snapshot reader may hold it; false when none can, and the
+// caller frees it at once. Called with db->lock held for writing, which keeps
+// a snapshot from beginning in between.
+static bool db_retire(database_t* db, void* ptr, void (*release)(void*)) {
+    if (__atomic_load_n(&db->snapshots_active, __ATOMIC_ACQUIRE) == 0) {
+        return false;
+    }
+    epoch_retire(&db->epoch, ptr, release);
+    return true;
+}
+
+// =============================================================================
+// Hash table
+// =============================================================================
+
 static uint32_t hash_string(const char* str) {
     uint32_t hash = 5381;
     int c;
@@ -75,6 +574,13 @@ static hash_table_t* hash_table_create(size_t bucket_count) {
     return table;
 }
 
+static void hash_entry_free(void* ptr) {
+    hash_entry_t* entry = (hash_entry_t*)ptr;
+    safe_free((void**)&entry->key);
+    safe_free((void**)&entry->value);
+    safe_free((void**)&entry);
+}
+
 static void hash_table_destroy(hash_table_t* table) {
     if (!table) return;
     
@@ -82,9 +588,7 @@ static void hash_table_destroy(hash_table_t* table) {
         hash_entry_t* entry = table->buckets[i];
         while (entry) {
             hash_entry_t* next = entry->next;
-            safe_free((void**)&entry->key);
-            safe_free((void**)&entry->value);
-            safe_free((void**)&entry);
+            hash_entry_free(entry);
             entry = next;
         }
     }
@@ -93,25 +597,79 @@ static void hash_table_destroy(hash_table_t* table) {
     safe_free((void**)&table);
 }
 
+// Free what a snapshot reader may be walking through the engine's table
+static void hash_table_release(hash_table_t* table, void* ptr, void (*release)(void*)) {
+    if (!table->db || !db_retire(table->db, ptr, release)) {
+        release(ptr);
+    }
+}
+
+// The bucket count is loaded before the array: a resize stores the new array
+// first, so the count never indexes past the end of the array seen
+static hash_entry_t* hash_table_find(hash_table_t* table, const char* key) {
+    size_t bucket_count = __atomic_load_n(&table->bucket_count, __ATOMIC_ACQUIRE);
+    hash_entry_t** buckets = __atomic_load_n(&table->buckets, __ATOMIC_ACQUIRE);
+    hash_entry_t* entry = __atomic_load_n(&buckets[hash_string(key) % bucket_count], __ATOMIC_ACQUIRE);
+    while (entry && strcmp(entry->key, key) != 0) {
+        entry = __atomic_load_n(&entry->next, __ATOMIC_ACQUIRE);
+    }
+    return entry;
+}
+
+// Look key up without db->lock. False if a resize overlapped a miss: entries
+// move between chains as they are relinked, so the key may have been missed.
+static bool hash_table_lookup(hash_table_t* table, const char* key, hash_entry_t** entry) {
+    uint64_t generation = __atomic_load_n(&table->generation, __ATOMIC_ACQUIRE);
+    if (generation & 1) {
+        return false;
+    }
+    *entry = hash_table_find(table, key);
+    return *entry || __atomic_load_n(&table->generation, __ATOMIC_ACQUIRE) == generation;
+}
+
+// Double the bucket count once there are as many keys as buckets
+static void hash_table_grow(hash_table_t* table) {
+    __atomic_store_n(&table->generation, table->generation + 1, __ATOMIC_RELEASE);
+    size_t bucket_count = table->bucket_count * 2;
+    hash_entry_t** buckets = safe_calloc(bucket_count, sizeof(hash_entry_t*));
+    for (size_t i = 0; i < table->bucket_count; i++) {
+        hash_entry_t* entry = table->buckets[i];
+        while (entry) {
+            hash_entry_t* next = entry->next;
+            size_t bucket = hash_string(entry->key) % bucket_count;
+            __atomic_store_n(&entry->next, buckets[bucket], __ATOMIC_RELEASE);
+            buckets[bucket] = entry;
+            entry = next;
+        }
+    }
+    hash_entry_t** old = table->buckets;
+    __atomic_store_n(&table->buckets, buckets, __ATOMIC_RELEASE);
+    __atomic_store_n(&table->bucket_count, bucket_count, __ATOMIC_RELEASE);
+    hash_table_release(table, old, free);
+    table->resizes++;
+    __atomic_store_n(&table->generation, table->generation + 1, __ATOMIC_RELEASE);
+}
+
 static int hash_table_put(hash_table_t* table, const char* key, const void* value, size_t value_size) {
     if (!table || !key) return ERROR_INVALID_PARAM;
     
-    uint32_t hash = hash_string(key);
-    size_t bucket = hash % table->bucket_count;
-    
     // Check if key exists
-    hash_entry_t* entry = table->buckets[bucket];
-    while (entry) {
-        if (strcmp(entry->key, key) == 0) {
-            // Update existing entry
-            safe_free((void**)&entry->value);
-            entry->value = safe_malloc(value_size);
-            memcpy(entry->value, value, value_size);
-            entry->value_size = value_size;
-            return SUCCESS;
-        }
-        entry = entry->next;
+    hash_entry_t* entry = hash_table_find(table, key);
+    if (entry) {
+        // Update existing entry; a snapshot reader may still be copying the old value
+        void* old = entry->value;
+        void* copy = safe_malloc(value_size);
+        memcpy(copy, value, value_size);
+        __atomic_store_n(&entry->value, copy, __ATOMIC_RELEASE);
+        __atomic_store_n(&entry->value_size, value_size, __ATOMIC_RELEASE);
+        hash_table_release(table, old, free);
+        return SUCCESS;
+    }
+    
+    if (table->size >= table->bucket_count) {
+        hash_table_grow(table);
     }
+    size_t bucket = hash_string(key) % table->bucket_count;
     
     // Create new entry
     entry = safe_calloc(1, sizeof(hash_entry_t));
@@ -120,7 +678,7 @@ static int hash_table_put(hash_table_t* table, const char* key, const void* valu
     memcpy(entry->value, value, value_size);
     entry->value_size = value_size;
     entry->next = table->buckets[bucket];
-    table->buckets[bucket] = entry;
+    __atomic_store_n(&table->buckets[bucket], entry, __ATOMIC_RELEASE);
     table->size++;
     
     return SUCCESS;
@@ -129,25 +687,18 @@ static int hash_table_put(hash_table_t* table, const char* key, const void* valu
 static int hash_table_get(hash_table_t* table, const char* key, void** value, size_t* value_size) {
     if (!table || !key) return ERROR_INVALID_PARAM;
     
-    uint32_t hash = hash_string(key);
-    size_t bucket = hash % table->bucket_count;
-    
-    hash_entry_t* entry = table->buckets[bucket];
-    while (entry) {
-        if (strcmp(entry->key, key) == 0) {
-            if (value) {
-                *value = safe_malloc(entry->value_size);
-                memcpy(*value, entry->value, entry->value_size);
-            }
-            if (value_size) {
-                *value_size = entry->value_size;
-            }
-            return SUCCESS;
-        }
-        entry = entry->next;
+    hash_entry_t* entry = hash_table_find(table, key);
+    if (!entry) {
+        return ERROR_NOT_FOUND;
     }
-    
-    return ERROR_NOT_FOUND;
+    if (value) {
+        *value = safe_malloc(entry->value_size);
+        memcpy(*value, entry->value, entry->value_size);
+    }
+    if (value_size) {
+        *value_size = entry->value_size;
+    }
+    return SUCCESS;
 }
 
 static int hash_table_delete(hash_table_t* table, const char* key) {
@@ -162,14 +713,12 @@ static int hash_table_delete(hash_table_t* table, const char* key) {
     while (entry) {
         if (strcmp(entry->key, key) == 0) {
             if (prev) {
-                prev->next = entry->next;
+                __atomic_store_n(&prev->next, entry->next, __ATOMIC_RELEASE);
             } else {
-                table->buckets[bucket] = entry->next;
+                __atomic_store_n(&table->buckets[bucket], entry->next, __ATOMIC_RELEASE);
             }
             
-            safe_free((void**)&entry->key);
-            safe_free((void**)&entry->value);
-            safe_free((void**)&entry);
+            hash_table_release(table, entry, hash_entry_free);
             table->size--;
             return SUCCESS;
         }
@@ -180,199 +729,3656 @@ static int hash_table_delete(hash_table_t* table, const char* key) {
     return ERROR_NOT_FOUND;
 }
 
-database_t* database_create(const char* data_dir) {
-    database_t* db = safe_calloc(1, sizeof(database_t));
-    db->data_dir = safe_strdup(data_dir);
-    db->table = hash_table_create(1024);
-    db->wal_fd = -1;
-    pthread_rwlock_init(&db->lock, NULL);
-    db->next_txn_id = 1;
-    return db;
-}
+// =============================================================================
+// B+tree index
+// =============================================================================
 
-void database_destroy(database_t* db) {
-    if (!db) return;
-    
-    if (db->is_open) {
-        database_close(db);
+// Keys compare first by their first 8 bytes as an integer, so a binary search
+// inside a node mostly stays within the node's page
+static uint64_t key_prefix(const char* key) {
+    uint64_t prefix = 0;
+    for (int i = 0; i < 8; i++) {
+        prefix <<= 8;
+        if (*key) {
+            prefix |= (uint8_t)*key++;
+        }
     }
-    
-    safe_free((void**)&db->data_dir);
-    hash_table_destroy(db->table);
-    pthread_rwlock_destroy(&db->lock);
-    safe_free((void**)&db);
+    return prefix;
 }
 
-int database_open(database_t* db) {
-    if (!db || db->is_open) return ERROR_INVALID_PARAM;
-    
-    // Create data directory
-    mkdir(db->data_dir, 0755);
-    
-    // Open WAL file
-    char wal_path[1024];
-    snprintf(wal_path, sizeof(wal_path), "%s/wal.log", db->data_dir);
-    db->wal_fd = open(wal_path, O_CREAT | O_RDWR | O_APPEND, 0644);
-    if (db->wal_fd < 0) {
-        return ERROR_IO;
+static const char* btree_slot_key(const btree_node_t* node, const btree_slot_t* slot) {
+    return node->leaf ? ((const hash_entry_t*)slot->ref)->key : (const char*)slot->ref;
+}
+
+static int btree_compare(uint64_t prefix, const char* key, const btree_node_t* node, const btree_slot_t* slot) {
+    if (prefix != slot->prefix) {
+        return prefix < slot->prefix ? -1 : 1;
     }
-    
-    // Recover from WAL if needed
-    database_recover(db);
-    
-    db->is_open = 1;
-    return SUCCESS;
+    return strcmp(key, btree_slot_key(node, slot));
 }
 
-int database_close(database_t* db) {
-    if (!db || !db->is_open) return ERROR_INVALID_PARAM;
-    
-    database_checkpoint(db);
-    
-    if (db->wal_fd >= 0) {
-        close(db->wal_fd);
-        db->wal_fd = -1;
+// First slot at or after key, or strictly after it
+static uint32_t btree_search(const btree_node_t* node, const btree_slot_t* slots, uint64_t prefix,
+                             const char* key, bool after) {
+    uint32_t low = 0;
+    uint32_t high = node->count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        int cmp = btree_compare(prefix, key, node, &slots[mid]);
+        if (cmp > 0 || (after && cmp == 0)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
     }
-    
-    db->is_open = 0;
-    return SUCCESS;
+    return low;
 }
 
-int database_put(database_t* db, const char* key, const void* value, size_t value_size) {
-    if (!db || !key || !value || value_size == 0) {
-        return ERROR_INVALID_PARAM;
+static btree_node_t* btree_node_create(bool leaf) {
+    void* page = NULL;
+    if (posix_memalign(&page, BTREE_PAGE_SIZE, sizeof(btree_node_t)) != 0) {
+        fprintf(stderr, "Failed to allocate B-tree page\n");
+        exit(1);
     }
-    
-    pthread_rwlock_wrlock(&db->lock);
-    
-    // Write to WAL
-    if (db->wal_fd >= 0) {
-        size_t key_size = strlen(key) + 1;
-        size_t entry_size = sizeof(wal_entry_t) + key_size + value_size;
-        wal_entry_t* entry = safe_malloc(entry_size);
-        
-        entry->magic = WAL_MAGIC;
-        entry->type = WAL_ENTRY_PUT;
-        entry->txn_id = 0;  // Non-transactional
-        entry->key_size = key_size;
-        entry->value_size = value_size;
-        memcpy(entry->data, key, key_size);
-        memcpy(entry->data + key_size, value, value_size);
-        
-        write(db->wal_fd, entry, entry_size);
-        fsync(db->wal_fd);
-        
-        safe_free((void**)&entry);
+    btree_node_t* node = page;
+    node->count = 0;
+    node->leaf = leaf;
+    node->next = NULL;
+    return node;
+}
+
+static void btree_node_destroy(btree_node_t* node) {
+    if (!node->leaf) {
+        for (uint32_t i = 0; i < node->count; i++) {
+            free(node->inner.keys[i].ref);
+        }
+        for (uint32_t i = 0; i <= node->count; i++) {
+            btree_node_destroy(node->inner.children[i]);
+        }
     }
-    
-    int result = hash_table_put(db->table, key, value, value_size);
-    
-    pthread_rwlock_unlock(&db->lock);
-    return result;
+    free(node);
 }
 
-int database_get(database_t* db, const char* key, void** value, size_t* value_size) {
-    if (!db || !key) return ERROR_INVALID_PARAM;
-    
-    pthread_rwlock_rdlock(&db->lock);
-    int result = hash_table_get(db->table, key, value, value_size);
-    pthread_rwlock_unlock(&db->lock);
+static void btree_destroy(btree_t* tree) {
+    if (!tree) return;
     
-    return result;
+    btree_node_destroy(tree->root);
+    safe_free((void**)&tree);
 }
 
-int database_delete(database_t* db, const char* key) {
-    if (!db || !key) return ERROR_INVALID_PARAM;
-    
-    pthread_rwlock_wrlock(&db->lock);
-    
-    // Write to WAL
-    if (db->wal_fd >= 0) {
-        size_t key_size = strlen(key) + 1;
-        size_t entry_size = sizeof(wal_entry_t) + key_size;
-        wal_entry_t* entry = safe_malloc(entry_size);
-        
-        entry->magic = WAL_MAGIC;
-        entry->type = WAL_ENTRY_DELETE;
-        entry->txn_id = 0;
-        entry->key_size = key_size;
-        entry->value_size = 0;
-        memcpy(entry->data, key, key_size);
-        
-        write(db->wal_fd, entry, entry_size);
-        fsync(db->wal_fd);
-        
-        safe_free((void**)&entry);
+static btree_slot_t btree_separator(const btree_slot_t* first, const btree_node_t* node) {
+    btree_slot_t separator = { first->prefix, safe_strdup(btree_slot_key(node, first)) };
+    return separator;
+}
+
+static int compare_entries(const void* a, const void* b) {
+    return strcmp((*(hash_entry_t* const*)a)->key, (*(hash_entry_t* const*)b)->key);
+}
+
+// Build the tree bottom up from entries sorted by key. Leaves are left a
+// little room so the first inserts after loading do not split them all.
+static btree_t* btree_bulk_load(hash_entry_t** entries, size_t count) {
+    btree_t* tree = safe_calloc(1, sizeof(btree_t));
+    tree->size = count;
+    if (count == 0) {
+        tree->root = btree_node_create(true);
+        return tree;
     }
     
-    int result = hash_table_delete(db->table, key);
+    size_t node_count = (count + BTREE_BULK_LEAF_SLOTS - 1) / BTREE_BULK_LEAF_SLOTS;
+    btree_node_t** level = safe_malloc(node_count * sizeof(btree_node_t*));
+    btree_node_t* previous = NULL;
+    for (size_t n = 0; n < node_count; n++) {
+        btree_node_t* leaf = btree_node_create(true);
+        size_t first = n * BTREE_BULK_LEAF_SLOTS;
+        size_t last = first + BTREE_BULK_LEAF_SLOTS < count ? first + BTREE_BULK_LEAF_SLOTS : count;
+        for (size_t i = first; i < last; i++) {
+            leaf->slots[leaf->count].prefix = key_prefix(entries[i]->key);
+            leaf->slots[leaf->count].ref = entries[i];
+            leaf->count++;
+        }
+        if (previous) {
+            previous->next = leaf;
+        }
+        previous = leaf;
+        level[n] = leaf;
+    }
     
-    pthread_rwlock_unlock(&db->lock);
-    return result;
+    // Each parent separates its children by their smallest keys
+    tree->height = 1;
+    while (node_count > 1) {
+        size_t parent_count = (node_count + BTREE_INNER_KEYS) / (BTREE_INNER_KEYS + 1);
+        for (size_t p = 0; p < parent_count; p++) {
+            btree_node_t* parent = btree_node_create(false);
+            size_t first = p * (BTREE_INNER_KEYS + 1);
+            size_t last = first + BTREE_INNER_KEYS + 1 < node_count ? first + BTREE_INNER_KEYS + 1 : node_count;
+            parent->inner.children[0] = level[first];
+            for (size_t c = first + 1; c < last; c++) {
+                btree_node_t* child = level[c];
+                while (!child->leaf) {
+                    child = child->inner.children[0];
+                }
+                parent->inner.keys[parent->count] = btree_separator(&child->slots[0], child);
+                parent->inner.children[++parent->count] = level[c];
+            }
+            level[p] = parent;
+        }
+        node_count = parent_count;
+        tree->height++;
+    }
+    tree->root = level[0];
+    safe_free((void**)&level);
+    return tree;
 }
 
-int database_exists(database_t* db, const char* key) {
-    if (!db || !key) return 0;
+// Insert into the subtree under node. When node splits, the new right half
+// is returned and *separator set to the smallest key in it.
+static btree_node_t* btree_insert_node(btree_node_t* node, uint64_t prefix, hash_entry_t* entry,
+                                       btree_slot_t* separator) {
+    if (node->leaf) {
+        btree_node_t* target = node;
+        btree_node_t* right = NULL;
+        uint32_t index = btree_search(node, node->slots, prefix, entry->key, false);
+        if (node->count == BTREE_LEAF_SLOTS) {
+            uint32_t half = node->count / 2;
+            right = btree_node_create(true);
+            right->count = node->count - half;
+            memcpy(right->slots, node->slots + half, right->count * sizeof(btree_slot_t));
+            node->count = half;
+            right->next = node->next;
+            node->next = right;
+            if (index > half) {
+                target = right;
+                index -= half;
+            }
+        }
+        memmove(target->slots + index + 1, target->slots + index, (target->count - index) * sizeof(btree_slot_t));
+        target->slots[index].prefix = prefix;
+        target->slots[index].ref = entry;
+        target->count++;
+        if (right) {
+            *separator = btree_separator(&right->slots[0], right);
+        }
+        return right;
+    }
     
-    pthread_rwlock_rdlock(&db->lock);
-    int result = (hash_table_get(db->table, key, NULL, NULL) == SUCCESS);
-    pthread_rwlock_unlock(&db->lock);
+    uint32_t index = btree_search(node, node->inner.keys, prefix, entry->key, true);
+    btree_slot_t child_separator;
+    btree_node_t* child_right = btree_insert_node(node->inner.children[index], prefix, entry, &child_separator);
+    if (!child_right) {
+        return NULL;
+    }
     
-    return result;
+    // The middle key moves up; the halves keep the keys on either side
+    btree_node_t* target = node;
+    btree_node_t* right = NULL;
+    if (node->count == BTREE_INNER_KEYS) {
+        uint32_t middle = node->count / 2;
+        right = btree_node_create(false);
+        *separator = node->inner.keys[middle];
+        right->count = node->count - middle - 1;
+        memcpy(right->inner.keys, node->inner.keys + middle + 1, right->count * sizeof(btree_slot_t));
+        memcpy(right->inner.children, node->inner.children + middle + 1, (right->count + 1) * sizeof(btree_node_t*));
+        node->count = middle;
+        if (index > middle) {
+            target = right;
+            index -= middle + 1;
+        }
+    }
+    memmove(target->inner.keys + index + 1, target->inner.keys + index, (target->count - index) * sizeof(btree_slot_t));
+    memmove(target->inner.children + index + 2, target->inner.children + index + 1,
+            (target->count - index) * sizeof(btree_node_t*));
+    target->inner.keys[index] = child_separator;
+    target->inner.children[index + 1] = child_right;
+    target->count++;
+    return right;
 }
 
-transaction_t* database_begin_transaction(database_t* db, isolation_level_t level) {
+static void btree_insert(btree_t* tree, hash_entry_t* entry) {
+    btree_slot_t separator;
+    btree_node_t* right = btree_insert_node(tree->root, key_prefix(entry->key), entry, &separator);
+    if (right) {
+        btree_node_t* root = btree_node_create(false);
+        root->count = 1;
+        root->inner.keys[0] = separator;
+        root->inner.children[0] = tree->root;
+        root->inner.children[1] = right;
+        tree->root = root;
+        tree->height++;
+    }
+    tree->size++;
+}
+
+// Leaf and slot of the first key at or after key (or strictly after it);
+// the slot may be past the leaf's end
+static btree_node_t* btree_seek(const btree_t* tree, const char* key, bool after, uint32_t* index) {
+    uint64_t prefix = key_prefix(key);
+    btree_node_t* node = tree->root;
+    while (!node->leaf) {
+        node = node->inner.children[btree_search(node, node->inner.keys, prefix, key, true)];
+    }
+    *index = btree_search(node, node->slots, prefix, key, after);
+    return node;
+}
+
+// Leaves are not merged as they empty; recreating the index repacks them
+static void btree_delete(btree_t* tree, const char* key) {
+    uint32_t index;
+    btree_node_t* leaf = btree_seek(tree, key, false, &index);
+    if (index < leaf->count && strcmp(btree_slot_key(leaf, &leaf->slots[index]), key) == 0) {
+        memmove(leaf->slots + index, leaf->slots + index + 1, (leaf->count - index - 1) * sizeof(btree_slot_t));
+        leaf->count--;
+        tree->size--;
+    }
+}
+
+// Bulk-load a tree over the table; called with db->lock held for writing
+static btree_t* index_build(database_t* db) {
+    hash_entry_t** entries = safe_malloc((db->table->size + 1) * sizeof(hash_entry_t*));
+    size_t count = 0;
+    for (size_t bucket = 0; bucket < db->table->bucket_count; bucket++) {
+        for (hash_entry_t* entry = db->table->buckets[bucket]; entry; entry = entry->next) {
+            entries[count++] = entry;
+        }
+    }
+    qsort(entries, count, sizeof(hash_entry_t*), compare_entries);
+    btree_t* tree = btree_bulk_load(entries, count);
+    safe_free((void**)&entries);
+    return tree;
+}
+
+// Rebuild every B-tree after the table was loaded behind their backs
+static void index_rebuild_all(database_t* db) {
+    for (db_index_t* index = db->indexes; index; index = index->next) {
+        if (index->btree) {
+            btree_destroy(index->btree);
+            index->btree = index_build(db);
+        }
+    }
+}
+
+static btree_t* index_find_btree(const database_t* db) {
+    for (const db_index_t* index = db->indexes; index; index = index->next) {
+        if (index->btree) {
+            return index->btree;
+        }
+    }
+    return NULL;
+}
+
+// =============================================================================
+// CRC32C
+// =============================================================================
+
+#define CRC32C_POLY 0x82F63B78  // Castagnoli, reflected
+
+static uint32_t crc32c_table[256];
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+static bool crc32c_hardware;
+
+static void crc32c_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0U - (crc & 1)));
+        }
+        crc32c_table[i] = crc;
+    }
+#if defined(__x86_64__)
+    crc32c_hardware = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+static uint32_t crc32c_software(uint32_t crc, const uint8_t* data, size_t size) {
+    while (size--) {
+        crc = crc32c_table[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+// SSE4.2 CRC32 instruction, eight bytes at a time
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t* data, size_t size) {
+    uint64_t crc64 = crc;
+    while (size >= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += 8;
+        size -= 8;
+    }
+    crc = (uint32_t)crc64;
+    while (size--) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return crc;
+}
+#endif
+
+// Continue a CRC32C over more data; start from 0
+static uint32_t crc32c_extend(uint32_t crc, const void* data, size_t size) {
+    pthread_once(&crc32c_once, crc32c_init);
+    crc = ~crc;
+#if defined(__x86_64__)
+    if (crc32c_hardware) {
+        return ~crc32c_sse42(crc, data, size);
+    }
+#endif
+    return ~crc32c_software(crc, data, size);
+}
+
+// =============================================================================
+// Group commit WAL
+// =============================================================================
+
+static uint64_t snapshot_request(database_t* db, bool always);
+
+static uint64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static struct timespec deadline_after_us(uint64_t timeout_us) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += (time_t)(timeout_us / 1000000);
+    deadline.tv_nsec += (long)(timeout_us % 1000000) * 1000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return deadline;
+}
+
+static void wal_buffer_append(wal_buffer_t* buffer, const void* data, size_t size) {
+    if (buffer->size + size > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+        while (capacity < buffer->size + size) {
+            capacity *= 2;
+        }
+        buffer->data = safe_realloc(buffer->data, capacity);
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+static int write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return ERROR_IO;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+    return SUCCESS;
+}
+
+// Queue a record for the committer; returns the log position the caller must
+// wait for. Called with db->lock held for writing, so records reach the log
+// in the same order their changes reach the table.
+static uint64_t wal_append_record(database_t* db, wal_entry_type_t type, uint64_t txn_id, const char* key,
+                                  size_t key_size, const void* value, size_t value_size) {
+    wal_entry_t header;
+    memset(&header, 0, sizeof(header));
+    header.type = type;
+    header.txn_id = txn_id;
+    header.key_size = key_size;
+    header.value_size = value_size;
+    
+    // Checksum before taking the log lock
+    wal_frame_t frame;
+    frame.length = (uint32_t)(sizeof(header) + key_size + value_size);
+    frame.crc = crc32c_extend(0, &header, sizeof(header));
+    frame.crc = crc32c_extend(frame.crc, key, key_size);
+    frame.crc = crc32c_extend(frame.crc, value, value_size);
+    
+    pthread_mutex_lock(&db->wal_lock);
+    wal_buffer_t* buffer = &db->wal_buffer;
+    if (buffer->size == 0) {
+        db->wal_batch_started_us = monotonic_us();
+    }
+    wal_buffer_append(buffer, &frame, sizeof(frame));
+    wal_buffer_append(buffer, &header, sizeof(header));
+    if (key_size > 0) {
+        wal_buffer_append(buffer, key, key_size);
+    }
+    if (value_size > 0) {
+        wal_buffer_append(buffer, value, value_size);
+    }
+    buffer->records++;
+    db->wal_appended += sizeof(frame) + frame.length;
+    db->wal_segment_bytes += sizeof(frame) + frame.length;
+    uint64_t position = db->wal_appended;
+    bool snapshot_due = db->config.engine == DATABASE_ENGINE_HASH &&
+                        db->wal_segment_bytes >= db->config.snapshot_wal_bytes;
+    
+    // Wake the committer for a new batch, or early once this one is full
+    if (buffer->records == 1 || buffer->size >= db->config.wal_batch_max_bytes) {
+        pthread_cond_signal(&db->wal_pending);
+    }
+    pthread_mutex_unlock(&db->wal_lock);
+    
+    if (snapshot_due) {
+        snapshot_request(db, false);
+    }
+    return position;
+}
+
+static uint64_t wal_append(database_t* db, wal_entry_type_t type, uint64_t txn_id,
+                           const char* key, const void* value, size_t value_size) {
+    return wal_append_record(db, type, txn_id, key, strlen(key) + 1, value, value_size);
+}
+
+// Block until the WAL is synced up to position
+static int wal_wait(database_t* db, uint64_t position) {
+    pthread_mutex_lock(&db->wal_lock);
+    while (db->wal_durable < position && db->wal_error == SUCCESS) {
+        pthread_cond_wait(&db->wal_synced, &db->wal_lock);
+    }
+    int status = db->wal_durable >= position ? SUCCESS : db->wal_error;
+    pthread_mutex_unlock(&db->wal_lock);
+    return status;
+}
+
+// Block until everything appended so far is synced
+static int wal_wait_appended(database_t* db) {
+    pthread_mutex_lock(&db->wal_lock);
+    uint64_t position = db->wal_appended;
+    pthread_mutex_unlock(&db->wal_lock);
+    return wal_wait(db, position);
+}
+
+// Once a batch has failed the WAL accepts nothing more, so writers check this
+// before applying anything
+static int wal_status(database_t* db) {
+    pthread_mutex_lock(&db->wal_lock);
+    int status = db->wal_error;
+    pthread_mutex_unlock(&db->wal_lock);
+    return status;
+}
+
+// One write and one fdatasync per batch. A batch closes when the disk is free
+// and either the delay since its first record has passed or it is full.
+static void* wal_committer_main(void* arg) {
+    database_t* db = (database_t*)arg;
+    
+    pthread_mutex_lock(&db->wal_lock);
+    for (;;) {
+        while (db->wal_buffer.size == 0 && !db->wal_stopping) {
+            pthread_cond_wait(&db->wal_pending, &db->wal_lock);
+        }
+        if (db->wal_buffer.size == 0) {
+            break;
+        }
+        
+        uint64_t delay = db->config.wal_batch_delay_us;
+        while (delay > 0 && !db->wal_stopping &&
+               db->wal_buffer.size < db->config.wal_batch_max_bytes) {
+            uint64_t waited = monotonic_us() - db->wal_batch_started_us;
+            if (waited >= delay) {
+                break;
+            }
+            struct timespec deadline = deadline_after_us(delay - waited);
+            pthread_cond_timedwait(&db->wal_pending, &db->wal_lock, &deadline);
+        }
+        
+        // Swap buffers so writers keep appending while this batch is written
+        wal_buffer_t batch = db->wal_buffer;
+        db->wal_buffer = db->wal_flushing;
+        db->wal_buffer.size = 0;
+        db->wal_buffer.records = 0;
+        uint64_t position = db->wal_appended;
+        db->wal_writing = true;
+        pthread_mutex_unlock(&db->wal_lock);
+        
+        int status = db->wal_error;
+        if (status == SUCCESS) {
+            status = write_all(db->wal_fd, batch.data, batch.size);
+        }
+        if (status == SUCCESS && fdatasync(db->wal_fd) != 0) {
+            status = ERROR_IO;
+        }
+        
+        pthread_mutex_lock(&db->wal_lock);
+        db->wal_flushing = batch;
+        db->wal_writing = false;
+        if (status == SUCCESS) {
+            db->wal_durable = position;
+            db->wal_records += batch.records;
+            db->wal_syncs++;
+        } else {
+            db->wal_error = status;
+        }
+        pthread_cond_broadcast(&db->wal_synced);
+    }
+    pthread_mutex_unlock(&db->wal_lock);
+    return NULL;
+}
+
+// Wait until nothing appended is still in flight
+static int wal_drain_locked(database_t* db) {
+    while ((db->wal_buffer.size > 0 || db->wal_writing) && db->wal_error == SUCCESS &&
+           db->committer_running) {
+        pthread_cond_wait(&db->wal_synced, &db->wal_lock);
+    }
+    return db->wal_error;
+}
+
+static void wal_committer_stop(database_t* db) {
+    if (!db->committer_running) {
+        return;
+    }
+    pthread_mutex_lock(&db->wal_lock);
+    db->wal_stopping = true;
+    pthread_cond_signal(&db->wal_pending);
+    pthread_mutex_unlock(&db->wal_lock);
+    
+    // The committer drains the buffer before it exits
+    pthread_join(db->committer, NULL);
+    db->committer_running = false;
+    db->wal_stopping = false;
+}
+
+static void wal_segment_path(const database_t* db, uint64_t segment, char* path, size_t size) {
+    snprintf(path, size, "%s/wal-%06llu.log", db->data_dir, (unsigned long long)segment);
+}
+
+static int compare_segments(const void* a, const void* b) {
+    uint64_t left = *(const uint64_t*)a;
+    uint64_t right = *(const uint64_t*)b;
+    return left < right ? -1 : left > right;
+}
+
+// WAL segment numbers in the data directory, ascending
+static uint64_t* wal_list_segments(const database_t* db, size_t* count) {
+    *count = 0;
+    DIR* dir = opendir(db->data_dir);
+    if (!dir) {
+        return NULL;
+    }
+    
+    size_t capacity = 8;
+    uint64_t* segments = safe_malloc(capacity * sizeof(uint64_t));
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        unsigned long long segment;
+        int length = 0;
+        if (sscanf(entry->d_name, "wal-%llu.log%n", &segment, &length) != 1 ||
+            entry->d_name[length] != '\0') {
+            continue;
+        }
+        if (*count == capacity) {
+            capacity *= 2;
+            segments = safe_realloc(segments, capacity * sizeof(uint64_t));
+        }
+        segments[(*count)++] = segment;
+    }
+    closedir(dir);
+    
+    qsort(segments, *count, sizeof(uint64_t), compare_segments);
+    return segments;
+}
+
+// Make renames and new files in the data directory durable
+static int sync_directory(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return ERROR_IO;
+    }
+    int status = fsync(fd) == 0 ? SUCCESS : ERROR_IO;
+    close(fd);
+    return status;
+}
+
+// Start a new WAL segment. Records after this point go to the new segment,
+// which is where replay on top of the next snapshot or table flush begins.
+// Called with db->lock held for writing and wal_lock held.
+static int wal_rotate_locked(database_t* db, uint64_t* segment) {
+    char path[1024];
+    
+    int status = wal_drain_locked(db);
+    if (status == SUCCESS) {
+        wal_segment_path(db, db->wal_segment + 1, path, sizeof(path));
+        int fd = open(path, O_CREAT | O_RDWR | O_APPEND | O_TRUNC, 0644);
+        if (fd < 0) {
+            status = ERROR_IO;
+        } else {
+            close(db->wal_fd);
+            db->wal_fd = fd;
+            db->wal_segment++;
+            db->wal_segment_bytes = 0;
+            *segment = db->wal_segment;
+        }
+    }
+    return status;
+}
+
+static int wal_rotate(database_t* db, uint64_t* segment) {
+    pthread_rwlock_wrlock(&db->lock);
+    pthread_mutex_lock(&db->wal_lock);
+    int status = wal_rotate_locked(db, segment);
+    pthread_mutex_unlock(&db->wal_lock);
+    pthread_rwlock_unlock(&db->lock);
+    
+    return status == SUCCESS ? sync_directory(db->data_dir) : status;
+}
+
+// Segments before segment are covered by a snapshot or by tables
+static void wal_remove_segments_before(database_t* db, uint64_t segment) {
+    char path[1024];
+    size_t count = 0;
+    uint64_t* segments = wal_list_segments(db, &count);
+    for (size_t i = 0; i < count && segments[i] < segment; i++) {
+        wal_segment_path(db, segments[i], path, sizeof(path));
+        unlink(path);
+    }
+    safe_free((void**)&segments);
+}
+
+// =============================================================================
+// Snapshots
+// =============================================================================
+
+// A snapshot is fuzzy: it starts a new WAL segment, then copies the table in
+// chunks under short read locks while writers carry on. Changes racing the
+// copy may or may not be in it, but all of them are in the new segment, and
+// replaying puts and deletes over the snapshot converges on the same table.
+
+static int compare_keys(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Copies of every key, taken a few buckets per read lock. A resize moves keys
+// between buckets, so the scan starts over if one happens in between.
+static char** snapshot_collect_keys(database_t* db, size_t* count) {
+    size_t capacity = 0;
+    char** keys = NULL;
+
+restart:
+    *count = 0;
+    pthread_rwlock_rdlock(&db->lock);
+    uint64_t resizes = db->table->resizes;
+    size_t bucket_count = db->table->bucket_count;
+    pthread_rwlock_unlock(&db->lock);
+    
+    for (size_t start = 0; start < bucket_count; start += SNAPSHOT_SCAN_BUCKETS) {
+        pthread_rwlock_rdlock(&db->lock);
+        if (db->table->resizes != resizes) {
+            pthread_rwlock_unlock(&db->lock);
+            for (size_t i = 0; i < *count; i++) {
+                safe_free((void**)&keys[i]);
+            }
+            goto restart;
+        }
+        size_t end = start + SNAPSHOT_SCAN_BUCKETS < bucket_count ? start + SNAPSHOT_SCAN_BUCKETS : bucket_count;
+        for (size_t bucket = start; bucket < end; bucket++) {
+            for (hash_entry_t* entry = db->table->buckets[bucket]; entry; entry = entry->next) {
+                if (*count == capacity) {
+                    capacity = capacity ? capacity * 2 : 1024;
+                    keys = safe_realloc(keys, capacity * sizeof(char*));
+                }
+                keys[(*count)++] = safe_strdup(entry->key);
+            }
+        }
+        pthread_rwlock_unlock(&db->lock);
+    }
+    return keys;
+}
+
+// Values are looked up again in key order, a batch per read lock, and written
+// outside the lock
+static int snapshot_write_entries(database_t* db, int fd, char** keys, size_t count,
+                                  uint64_t* entries, uint32_t* crc) {
+    wal_buffer_t out;
+    memset(&out, 0, sizeof(out));
+    int status = SUCCESS;
+    
+    size_t i = 0;
+    while (i < count && status == SUCCESS) {
+        pthread_rwlock_rdlock(&db->lock);
+        for (size_t n = 0; i < count && n < SNAPSHOT_WRITE_KEYS && out.size < SNAPSHOT_BUFFER_SIZE; i++, n++) {
+            hash_entry_t* entry = hash_table_find(db->table, keys[i]);
+            if (!entry) {
+                continue;  // Deleted since; the delete is in the new segment
+            }
+            uint32_t sizes[2] = { (uint32_t)strlen(entry->key) + 1, (uint32_t)entry->value_size };
+            wal_buffer_append(&out, sizes, sizeof(sizes));
+            wal_buffer_append(&out, entry->key, sizes[0]);
+            wal_buffer_append(&out, entry->value, sizes[1]);
+            (*entries)++;
+        }
+        pthread_rwlock_unlock(&db->lock);
+        
+        if (out.size >= SNAPSHOT_BUFFER_SIZE || i == count) {
+            *crc = crc32c_extend(*crc, out.data, out.size);
+            status = write_all(fd, out.data, out.size);
+            out.size = 0;
+        }
+    }
+    
+    safe_free((void**)&out.data);
+    return status;
+}
+
+// Write snapshot.db for the current table, then drop the segments it covers
+static int snapshot_write(database_t* db) {
+    uint64_t segment = 0;
+    int status = wal_rotate(db, &segment);
+    if (status != SUCCESS) {
+        return status;
+    }
+    
+    size_t count = 0;
+    char** keys = snapshot_collect_keys(db, &count);
+    if (count > 1) {
+        qsort(keys, count, sizeof(char*), compare_keys);
+    }
+    
+    char tmp_path[1024];
+    char path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s/snapshot.tmp", db->data_dir);
+    snprintf(path, sizeof(path), "%s/snapshot.db", db->data_dir);
+    
+    snapshot_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.wal_segment = segment;
+    
+    // The header goes in last, once the body checksum is known
+    int fd = open(tmp_path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    if (fd < 0 || lseek(fd, sizeof(header), SEEK_SET) < 0) {
+        status = ERROR_IO;
+    }
+    if (status == SUCCESS) {
+        status = snapshot_write_entries(db, fd, keys, count, &header.entry_count, &header.body_crc);
+    }
+    
+    // Every change copied above was appended to the WAL before it was applied.
+    // If its batch failed, the write was reported as failed and must not
+    // survive in the snapshot.
+    if (status == SUCCESS) {
+        status = wal_wait_appended(db);
+    }
+    if (status == SUCCESS && (pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+                              fdatasync(fd) != 0)) {
+        status = ERROR_IO;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    
+    // Swap it in atomically
+    if (status == SUCCESS && rename(tmp_path, path) != 0) {
+        status = ERROR_IO;
+    }
+    if (status == SUCCESS) {
+        status = sync_directory(db->data_dir);
+    } else {
+        unlink(tmp_path);
+    }
+    
+    if (status == SUCCESS) {
+        wal_remove_segments_before(db, segment);
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        safe_free((void**)&keys[i]);
+    }
+    safe_free((void**)&keys);
+    return status;
+}
+
+// Load snapshot.db into the table. *wal_segment is the first segment to
+// replay on top of it, or 0 when there is no snapshot.
+static int snapshot_load(database_t* db, uint64_t* wal_segment) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/snapshot.db", db->data_dir);
+    *wal_segment = 0;
+    
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return errno == ENOENT ? SUCCESS : ERROR_IO;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(snapshot_header_t)) {
+        close(fd);
+        return ERROR_IO;
+    }
+    size_t file_size = (size_t)st.st_size;
+    char* data = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return ERROR_IO;
+    }
+    posix_madvise(data, file_size, POSIX_MADV_SEQUENTIAL);
+    
+    snapshot_header_t header;
+    memcpy(&header, data, sizeof(header));
+    const char* body = data + sizeof(header);
+    size_t body_size = file_size - sizeof(header);
+    int status = SUCCESS;
+    if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION ||
+        crc32c_extend(0, body, body_size) != header.body_crc) {
+        status = ERROR_IO;
+    }
+    
+    size_t offset = 0;
+    for (uint64_t i = 0; i < header.entry_count && status == SUCCESS; i++) {
+        uint32_t sizes[2];
+        if (body_size - offset < sizeof(sizes)) {
+            status = ERROR_IO;
+            break;
+        }
+        memcpy(sizes, body + offset, sizeof(sizes));
+        offset += sizeof(sizes);
+        if (sizes[0] == 0 || (uint64_t)sizes[0] + sizes[1] > body_size - offset ||
+            body[offset + sizes[0] - 1] != '\0') {
+            status = ERROR_IO;
+            break;
+        }
+        hash_table_put(db->table, body + offset, body + offset + sizes[0], sizes[1]);
+        offset += (size_t)sizes[0] + sizes[1];
+    }
+    munmap(data, file_size);
+    
+    if (status == SUCCESS) {
+        *wal_segment = header.wal_segment;
+    }
+    return status;
+}
+
+// Queue a snapshot and return its request number. Automatic requests are
+// dropped while one is already pending or running.
+static uint64_t snapshot_request(database_t* db, bool always) {
+    pthread_mutex_lock(&db->snapshot_lock);
+    if (always || db->snapshot_requested == db->snapshot_completed) {
+        db->snapshot_requested++;
+        pthread_cond_signal(&db->snapshot_wanted);
+    }
+    uint64_t request = db->snapshot_requested;
+    pthread_mutex_unlock(&db->snapshot_lock);
+    return request;
+}
+
+static void* snapshot_main(void* arg) {
+    database_t* db = (database_t*)arg;
+    
+    pthread_mutex_lock(&db->snapshot_lock);
+    for (;;) {
+        while (db->snapshot_started == db->snapshot_requested && !db->snapshot_stopping) {
+            pthread_cond_wait(&db->snapshot_wanted, &db->snapshot_lock);
+        }
+        if (db->snapshot_started == db->snapshot_requested) {
+            break;
+        }
+        
+        // One run serves every request made before it starts
+        uint64_t request = db->snapshot_requested;
+        db->snapshot_started = request;
+        pthread_mutex_unlock(&db->snapshot_lock);
+        
+        int status = snapshot_write(db);
+        
+        pthread_mutex_lock(&db->snapshot_lock);
+        db->snapshot_completed = request;
+        db->snapshot_status = status;
+        if (status == SUCCESS) {
+            db->snapshots++;
+        }
+        pthread_cond_broadcast(&db->snapshot_done);
+    }
+    pthread_mutex_unlock(&db->snapshot_lock);
+    return NULL;
+}
+
+static void snapshot_thread_stop(database_t* db) {
+    if (!db->snapshotter_running) {
+        return;
+    }
+    pthread_mutex_lock(&db->snapshot_lock);
+    db->snapshot_stopping = true;
+    pthread_cond_signal(&db->snapshot_wanted);
+    pthread_mutex_unlock(&db->snapshot_lock);
+    
+    pthread_join(db->snapshotter, NULL);
+    db->snapshotter_running = false;
+    db->snapshot_stopping = false;
+}
+
+// =============================================================================
+// LSM engine: memtable
+// =============================================================================
+
+// Orders versions by key, then newest first
+static int version_compare(const char* key, uint64_t seq, const mem_node_t* node) {
+    int cmp = strcmp(key, node->key);
+    if (cmp != 0) {
+        return cmp;
+    }
+    return seq > node->seq ? -1 : seq < node->seq;
+}
+
+static memtable_t* memtable_create(void) {
+    memtable_t* mem = safe_calloc(1, sizeof(memtable_t));
+    mem->head = safe_calloc(1, sizeof(mem_node_t) + MEMTABLE_MAX_HEIGHT * sizeof(mem_node_t*));
+    mem->head->height = MEMTABLE_MAX_HEIGHT;
+    mem->height = 1;
+    mem->rng = 0x9E3779B9u;
+    return mem;
+}
+
+static void memtable_destroy(memtable_t* mem) {
+    if (!mem) return;
+    
+    mem_node_t* node = mem->head;
+    while (node) {
+        mem_node_t* next = node->next[0];
+        safe_free((void**)&node->key);
+        safe_free((void**)&node->value);
+        safe_free((void**)&node);
+        node = next;
+    }
+    safe_free((void**)&mem);
+}
+
+static void memtable_release(void* mem) {
+    memtable_destroy((memtable_t*)mem);
+}
+
+// Each level up holds a quarter of the nodes below it
+static int memtable_random_height(memtable_t* mem) {
+    int height = 1;
+    while (height < MEMTABLE_MAX_HEIGHT) {
+        mem->rng ^= mem->rng << 13;
+        mem->rng ^= mem->rng >> 17;
+        mem->rng ^= mem->rng << 5;
+        if ((mem->rng & 3) != 0) {
+            break;
+        }
+        height++;
+    }
+    return height;
+}
+
+// Older versions of the key stay behind the new one until the flush
+static void memtable_add(memtable_t* mem, uint64_t seq, wal_entry_type_t type, const char* key,
+                         const void* value, size_t value_size) {
+    mem_node_t* update[MEMTABLE_MAX_HEIGHT];
+    mem_node_t* node = mem->head;
+    for (int level = mem->height - 1; level >= 0; level--) {
+        while (node->next[level] && version_compare(key, seq, node->next[level]) > 0) {
+            node = node->next[level];
+        }
+        update[level] = node;
+    }
+    
+    int height = memtable_random_height(mem);
+    for (int level = mem->height; level < height; level++) {
+        update[level] = mem->head;
+    }
+    if (height > mem->height) {
+        __atomic_store_n(&mem->height, height, __ATOMIC_RELEASE);
+    }
+    
+    if (type != WAL_ENTRY_PUT) {
+        value_size = 0;
+    }
+    mem_node_t* added = safe_malloc(sizeof(mem_node_t) + (size_t)height * sizeof(mem_node_t*));
+    added->key = safe_strdup(key);
+    added->value = NULL;
+    if (value_size > 0) {
+        added->value = safe_malloc(value_size);
+        memcpy(added->value, value, value_size);
+    }
+    added->value_size = (uint32_t)value_size;
+    added->type = type;
+    added->seq = seq;
+    added->height = height;
+    for (int level = 0; level < height; level++) {
+        added->next[level] = update[level]->next[level];
+    }
+    
+    // Linked bottom up with release stores, so a snapshot reader searching
+    // without db->lock sees the node whole at every level it reaches
+    for (int level = 0; level < height; level++) {
+        __atomic_store_n(&update[level]->next[level], added, __ATOMIC_RELEASE);
+    }
+    
+    mem->bytes += sizeof(mem_node_t) + (size_t)height * sizeof(mem_node_t*) + strlen(key) + 1 + value_size;
+    mem->entries++;
+    if (seq > mem->max_seq) {
+        mem->max_seq = seq;
+    }
+}
+
+// Newest version of key, or NULL; safe without db->lock
+static const mem_node_t* memtable_find(const memtable_t* mem, const char* key) {
+    const mem_node_t* node = mem->head;
+    for (int level = __atomic_load_n(&mem->height, __ATOMIC_ACQUIRE) - 1; level >= 0; level--) {
+        const mem_node_t* next = __atomic_load_n(&node->next[level], __ATOMIC_ACQUIRE);
+        while (next && strcmp(next->key, key) < 0) {
+            node = next;
+            next = __atomic_load_n(&node->next[level], __ATOMIC_ACQUIRE);
+        }
+    }
+    node = __atomic_load_n(&node->next[0], __ATOMIC_ACQUIRE);
+    return node && strcmp(node->key, key) == 0 ? node : NULL;
+}
+
+// First node at or after key, or strictly after it; NULL key means the start
+static const mem_node_t* memtable_seek(const memtable_t* mem, const char* key, bool after) {
+    const mem_node_t* node = mem->head;
+    if (key) {
+        for (int level = mem->height - 1; level >= 0; level--) {
+            while (node->next[level]) {
+                int cmp = strcmp(node->next[level]->key, key);
+                if (cmp > 0 || (cmp == 0 && !after)) {
+                    break;
+                }
+                node = node->next[level];
+            }
+        }
+    }
+    return node->next[0];
+}
+
+// =============================================================================
+// LSM engine: block cache and Bloom filters
+// =============================================================================
+
+static uint64_t hash_mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static block_cache_shard_t* block_cache_shard(block_cache_t* cache, uint64_t file_number, uint64_t offset) {
+    uint64_t h = hash_mix64(file_number * 0x9E3779B97F4A7C15ULL ^ offset);
+    return &cache->shards[h % BLOCK_CACHE_SHARDS];
+}
+
+static size_t block_cache_bucket(const block_cache_shard_t* shard, uint64_t file_number, uint64_t offset) {
+    return hash_mix64(file_number ^ (offset * 0xC2B2AE3D27D4EB4FULL)) % shard->bucket_count;
+}
+
+// No cache when capacity is 0
+static block_cache_t* block_cache_create(size_t capacity) {
+    if (capacity == 0) {
+        return NULL;
+    }
+    block_cache_t* cache = safe_calloc(1, sizeof(block_cache_t));
+    for (int i = 0; i < BLOCK_CACHE_SHARDS; i++) {
+        block_cache_shard_t* shard = &cache->shards[i];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->bucket_count = 256;
+        shard->buckets = safe_calloc(shard->bucket_count, sizeof(cached_block_t*));
+        shard->lru.prev = shard->lru.next = &shard->lru;
+        shard->capacity = capacity / BLOCK_CACHE_SHARDS;
+    }
+    return cache;
+}
+
+static void cached_block_free(cached_block_t* block) {
+    safe_free((void**)&block->data);
+    safe_free((void**)&block);
+}
+
+// Take a block out of its shard; it is freed once no reader holds it
+static void block_cache_remove_locked(block_cache_shard_t* shard, cached_block_t* block) {
+    cached_block_t** link = &shard->buckets[block_cache_bucket(shard, block->file_number, block->offset)];
+    while (*link != block) {
+        link = &(*link)->hash_next;
+    }
+    *link = block->hash_next;
+    block->prev->next = block->next;
+    block->next->prev = block->prev;
+    block->cached = false;
+    shard->count--;
+    shard->usage -= sizeof(cached_block_t) + block->size;
+    if (--block->refs == 0) {
+        cached_block_free(block);
+    }
+}
+
+static void block_cache_clear(block_cache_t* cache) {
+    if (!cache) return;
+    
+    for (int i = 0; i < BLOCK_CACHE_SHARDS; i++) {
+        block_cache_shard_t* shard = &cache->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        while (shard->lru.next != &shard->lru) {
+            block_cache_remove_locked(shard, shard->lru.next);
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+static void block_cache_destroy(block_cache_t* cache) {
+    if (!cache) return;
+    
+    block_cache_clear(cache);
+    for (int i = 0; i < BLOCK_CACHE_SHARDS; i++) {
+        pthread_mutex_destroy(&cache->shards[i].lock);
+        safe_free((void**)&cache->shards[i].buckets);
+    }
+    safe_free((void**)&cache);
+}
+
+static void block_cache_grow_locked(block_cache_shard_t* shard) {
+    cached_block_t** old = shard->buckets;
+    size_t old_count = shard->bucket_count;
+    shard->bucket_count *= 2;
+    shard->buckets = safe_calloc(shard->bucket_count, sizeof(cached_block_t*));
+    for (size_t i = 0; i < old_count; i++) {
+        cached_block_t* block = old[i];
+        while (block) {
+            cached_block_t* next = block->hash_next;
+            size_t bucket = block_cache_bucket(shard, block->file_number, block->offset);
+            block->hash_next = shard->buckets[bucket];
+            shard->buckets[bucket] = block;
+            block = next;
+        }
+    }
+    safe_free((void**)&old);
+}
+
+// A referenced block moved to the front of the LRU list, or NULL
+static cached_block_t* block_cache_lookup(block_cache_t* cache, uint64_t file_number, uint64_t offset) {
+    block_cache_shard_t* shard = block_cache_shard(cache, file_number, offset);
+    pthread_mutex_lock(&shard->lock);
+    cached_block_t* block = shard->buckets[block_cache_bucket(shard, file_number, offset)];
+    while (block && (block->file_number != file_number || block->offset != offset)) {
+        block = block->hash_next;
+    }
+    if (block) {
+        block->prev->next = block->next;
+        block->next->prev = block->prev;
+        block->next = shard->lru.next;
+        block->prev = &shard->lru;
+        shard->lru.next->prev = block;
+        shard->lru.next = block;
+        block->refs++;
+        shard->hits++;
+    } else {
+        shard->misses++;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return block;
+}
+
+// Cache a block read from disk and return it referenced. The least
+// recently used blocks are evicted to stay within the shard's budget;
+// readers still holding one keep it until they release it.
+static cached_block_t* block_cache_insert(block_cache_t* cache, uint64_t file_number, uint64_t offset,
+                                          char* data, uint32_t size) {
+    cached_block_t* block = safe_calloc(1, sizeof(cached_block_t));
+    block->file_number = file_number;
+    block->offset = offset;
+    block->data = data;
+    block->size = size;
+    block->refs = 1;
+    if (!cache) {
+        return block;
+    }
+    block->shared = true;
+    
+    block_cache_shard_t* shard = block_cache_shard(cache, file_number, offset);
+    pthread_mutex_lock(&shard->lock);
+    size_t bucket = block_cache_bucket(shard, file_number, offset);
+    cached_block_t* existing = shard->buckets[bucket];
+    while (existing && (existing->file_number != file_number || existing->offset != offset)) {
+        existing = existing->hash_next;
+    }
+    if (existing) {
+        // Another reader loaded it first
+        existing->refs++;
+        pthread_mutex_unlock(&shard->lock);
+        cached_block_free(block);
+        return existing;
+    }
+    
+    if (shard->count >= shard->bucket_count) {
+        block_cache_grow_locked(shard);
+        bucket = block_cache_bucket(shard, file_number, offset);
+    }
+    block->refs = 2;  // The caller and the cache
+    block->cached = true;
+    block->hash_next = shard->buckets[bucket];
+    shard->buckets[bucket] = block;
+    block->next = shard->lru.next;
+    block->prev = &shard->lru;
+    shard->lru.next->prev = block;
+    shard->lru.next = block;
+    shard->count++;
+    shard->usage += sizeof(cached_block_t) + size;
+    while (shard->usage > shard->capacity && shard->lru.prev != block) {
+        block_cache_remove_locked(shard, shard->lru.prev);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return block;
+}
+
+static void block_cache_release(block_cache_t* cache, cached_block_t* block) {
+    if (!block->shared) {
+        cached_block_free(block);
+        return;
+    }
+    block_cache_shard_t* shard = block_cache_shard(cache, block->file_number, block->offset);
+    pthread_mutex_lock(&shard->lock);
+    bool last = --block->refs == 0;
+    pthread_mutex_unlock(&shard->lock);
+    if (last) {
+        cached_block_free(block);
+    }
+}
+
+// Drop a deleted table's blocks
+static void block_cache_erase(block_cache_t* cache, uint64_t file_number, uint64_t offset) {
+    if (!cache) return;
+    
+    block_cache_shard_t* shard = block_cache_shard(cache, file_number, offset);
+    pthread_mutex_lock(&shard->lock);
+    cached_block_t* block = shard->buckets[block_cache_bucket(shard, file_number, offset)];
+    while (block && (block->file_number != file_number || block->offset != offset)) {
+        block = block->hash_next;
+    }
+    if (block) {
+        block_cache_remove_locked(shard, block);
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+// FNV-1a, finished with a full avalanche so the filter can use every bit
+static uint64_t key_hash64(const char* key) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    while (*key) {
+        h ^= (uint8_t)*key++;
+        h *= 0x100000001b3ULL;
+    }
+    return hash_mix64(h);
+}
+
+// A blocked Bloom filter: the hash picks one 512-bit block, a cache line,
+// and every probe for the key lands inside it. This costs a little accuracy
+// against a classic filter of the same size but only one cache miss.
+static void bloom_probe_start(uint64_t hash, size_t block_count, size_t* block, uint32_t* probe, uint32_t* delta) {
+    *block = (size_t)(((hash >> 32) * (uint64_t)block_count) >> 32);
+    uint64_t mixed = hash_mix64(hash);
+    *probe = (uint32_t)mixed;
+    *delta = (uint32_t)(mixed >> 32) | 1;
+}
+
+static void bloom_add(uint64_t* filter, size_t block_count, uint32_t probes, uint64_t hash) {
+    size_t block;
+    uint32_t probe;
+    uint32_t delta;
+    bloom_probe_start(hash, block_count, &block, &probe, &delta);
+    uint64_t* words = filter + block * BLOOM_BLOCK_WORDS;
+    for (uint32_t i = 0; i < probes; i++) {
+        uint32_t bit = probe & (BLOOM_BLOCK_BITS - 1);
+        words[bit / 64] |= 1ULL << (bit % 64);
+        probe += delta;
+    }
+}
+
+static bool bloom_may_contain(const uint64_t* filter, size_t block_count, uint32_t probes, uint64_t hash) {
+    size_t block;
+    uint32_t probe;
+    uint32_t delta;
+    bloom_probe_start(hash, block_count, &block, &probe, &delta);
+    const uint64_t* words = filter + block * BLOOM_BLOCK_WORDS;
+    for (uint32_t i = 0; i < probes; i++) {
+        uint32_t bit = probe & (BLOOM_BLOCK_BITS - 1);
+        if (!(words[bit / 64] & (1ULL << (bit % 64)))) {
+            return false;
+        }
+        probe += delta;
+    }
+    return true;
+}
+
+// =============================================================================
+// LSM engine: sorted table files
+// =============================================================================
+
+typedef enum {
+    LOOKUP_MISSING,            // Not in this source; keep looking in older ones
+    LOOKUP_FOUND,
+    LOOKUP_DELETED,            // A tombstone hides any older version
+    LOOKUP_ERROR
+} lookup_result_t;
+
+typedef struct {
+    int fd;
+    uint64_t number;
+    wal_buffer_t block;        // Data block being filled
+    wal_buffer_t index;        // Index entries so far
+    wal_buffer_t out;          // Finished blocks not yet written
+    size_t last_key_offset;    // Of the last key added, in block
+    uint32_t last_key_size;
+    char* smallest;
+    wal_buffer_t hashes;       // Key hashes for the filter
+    uint64_t offset;           // File bytes in finished blocks
+    uint64_t entries;
+    size_t block_size;
+    int bits_per_key;
+    int status;
+} sst_builder_t;
+
+// Iterates the entries of consecutive tables, a block at a time
+typedef struct {
+    sst_file_t** files;
+    size_t file_count;
+    size_t file;
+    size_t block;              // Next block to read in files[file]
+    char* data;
+    uint32_t size;
+    size_t offset;             // Of the next entry in data
+    bool valid;
+    sst_entry_t entry;
+    const char* key;
+    const char* value;
+    int status;
+} sst_iter_t;
+
+static void sst_path(const database_t* db, uint64_t number, char* path, size_t size) {
+    snprintf(path, size, "%s/%06llu.sst", db->data_dir, (unsigned long long)number);
+}
+
+static void copy_value(const void* data, size_t size, void** value, size_t* value_size) {
+    if (value) {
+        *value = safe_malloc(size);
+        memcpy(*value, data, size);
+    }
+    if (value_size) {
+        *value_size = size;
+    }
+}
+
+// Length of the entry at offset in a block, or 0 if it is corrupt
+static size_t sst_entry_parse(const char* data, size_t size, size_t offset, sst_entry_t* entry) {
+    if (size - offset < sizeof(*entry)) {
+        return 0;
+    }
+    memcpy(entry, data + offset, sizeof(*entry));
+    uint64_t length = (uint64_t)sizeof(*entry) + entry->key_size + entry->value_size;
+    if (entry->key_size == 0 || length > size - offset ||
+        data[offset + sizeof(*entry) + entry->key_size - 1] != '\0') {
+        return 0;
+    }
+    return (size_t)length;
+}
+
+static int sst_builder_start(database_t* db, sst_builder_t* builder, uint64_t number) {
+    char path[1024];
+    memset(builder, 0, sizeof(*builder));
+    sst_path(db, number, path, sizeof(path));
+    builder->number = number;
+    builder->block_size = db->config.sstable_block_size;
+    builder->bits_per_key = db->config.bloom_bits_per_key;
+    builder->fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    builder->status = builder->fd < 0 ? ERROR_IO : SUCCESS;
+    return builder->status;
+}
+
+static void sst_builder_flush_block(sst_builder_t* builder) {
+    if (builder->block.size == 0) {
+        return;
+    }
+    sst_index_entry_t index;
+    index.offset = builder->offset;
+    index.size = (uint32_t)builder->block.size;
+    index.key_size = builder->last_key_size;
+    wal_buffer_append(&builder->index, &index, sizeof(index));
+    wal_buffer_append(&builder->index, builder->block.data + builder->last_key_offset, index.key_size);
+    
+    uint32_t crc = crc32c_extend(0, builder->block.data, builder->block.size);
+    wal_buffer_append(&builder->out, builder->block.data, builder->block.size);
+    wal_buffer_append(&builder->out, &crc, sizeof(crc));
+    builder->offset += builder->block.size + sizeof(crc);
+    builder->block.size = 0;
+    
+    if (builder->out.size >= SNAPSHOT_BUFFER_SIZE && builder->status == SUCCESS) {
+        builder->status = write_all(builder->fd, builder->out.data, builder->out.size);
+        builder->out.size = 0;
+    }
+}
+
+// Entries must arrive in key order, one version per key
+static void sst_builder_add(sst_builder_t* builder, const char* key, wal_entry_type_t type, uint64_t seq,
+                            const void* value, size_t value_size) {
+    sst_entry_t entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.key_size = (uint32_t)strlen(key) + 1;
+    entry.value_size = (uint32_t)value_size;
+    entry.type = type;
+    entry.seq = seq;
+    
+    size_t length = sizeof(entry) + entry.key_size + entry.value_size;
+    if (builder->block.size > 0 && builder->block.size + length > builder->block_size) {
+        sst_builder_flush_block(builder);
+    }
+    if (builder->entries == 0) {
+        builder->smallest = safe_strdup(key);
+    }
+    if (builder->bits_per_key > 0) {
+        uint64_t hash = key_hash64(key);
+        wal_buffer_append(&builder->hashes, &hash, sizeof(hash));
+    }
+    wal_buffer_append(&builder->block, &entry, sizeof(entry));
+    builder->last_key_offset = builder->block.size;
+    builder->last_key_size = entry.key_size;
+    wal_buffer_append(&builder->block, key, entry.key_size);
+    if (value_size > 0) {
+        wal_buffer_append(&builder->block, value, value_size);
+    }
+    builder->entries++;
+}
+
+static uint64_t sst_builder_size(const sst_builder_t* builder) {
+    return builder->offset + builder->block.size;
+}
+
+static void sst_builder_release(sst_builder_t* builder) {
+    if (builder->fd >= 0) {
+        close(builder->fd);
+        builder->fd = -1;
+    }
+    safe_free((void**)&builder->block.data);
+    safe_free((void**)&builder->index.data);
+    safe_free((void**)&builder->out.data);
+    safe_free((void**)&builder->hashes.data);
+    safe_free((void**)&builder->smallest);
+}
+
+static void sst_builder_abandon(database_t* db, sst_builder_t* builder) {
+    char path[1024];
+    sst_builder_release(builder);
+    sst_path(db, builder->number, path, sizeof(path));
+    unlink(path);
+}
+
+static int sst_open(database_t* db, uint64_t number, sst_file_t** result);
+
+// Write the filter, index and footer, sync, and open the finished table
+static int sst_builder_finish(database_t* db, sst_builder_t* builder, sst_file_t** file) {
+    sst_builder_flush_block(builder);
+    
+    sst_footer_t footer;
+    memset(&footer, 0, sizeof(footer));
+    footer.filter_offset = builder->offset;
+    if (builder->bits_per_key > 0) {
+        // About 0.69 bits per key per probe minimizes false positives
+        size_t block_count = (builder->entries * (size_t)builder->bits_per_key + BLOOM_BLOCK_BITS - 1) / BLOOM_BLOCK_BITS;
+        uint32_t probes = (uint32_t)(builder->bits_per_key * 69 / 100);
+        probes = probes < 1 ? 1 : probes > 16 ? 16 : probes;
+        uint64_t* filter = safe_calloc(block_count, BLOOM_BLOCK_BITS / 8);
+        const uint64_t* hashes = (const uint64_t*)builder->hashes.data;
+        for (uint64_t i = 0; i < builder->entries; i++) {
+            bloom_add(filter, block_count, probes, hashes[i]);
+        }
+        footer.filter_size = (uint32_t)(block_count * BLOOM_BLOCK_BITS / 8);
+        footer.filter_probes = probes;
+        footer.filter_crc = crc32c_extend(0, filter, footer.filter_size);
+        wal_buffer_append(&builder->out, filter, footer.filter_size);
+        safe_free((void**)&filter);
+    }
+    
+    // Index block: the smallest key, then one entry per data block
+    uint32_t smallest_size = (uint32_t)strlen(builder->smallest) + 1;
+    footer.index_offset = footer.filter_offset + footer.filter_size;
+    footer.index_size = sizeof(smallest_size) + smallest_size + builder->index.size;
+    footer.entry_count = builder->entries;
+    footer.index_crc = crc32c_extend(0, &smallest_size, sizeof(smallest_size));
+    footer.index_crc = crc32c_extend(footer.index_crc, builder->smallest, smallest_size);
+    footer.index_crc = crc32c_extend(footer.index_crc, builder->index.data, builder->index.size);
+    footer.magic = SSTABLE_MAGIC;
+    wal_buffer_append(&builder->out, &smallest_size, sizeof(smallest_size));
+    wal_buffer_append(&builder->out, builder->smallest, smallest_size);
+    wal_buffer_append(&builder->out, builder->index.data, builder->index.size);
+    wal_buffer_append(&builder->out, &footer, sizeof(footer));
+    
+    int status = builder->status;
+    if (status == SUCCESS) {
+        status = write_all(builder->fd, builder->out.data, builder->out.size);
+    }
+    if (status == SUCCESS && fdatasync(builder->fd) != 0) {
+        status = ERROR_IO;
+    }
+    if (status != SUCCESS) {
+        sst_builder_abandon(db, builder);
+        return status;
+    }
+    sst_builder_release(builder);
+    return sst_open(db, builder->number, file);
+}
+
+static void sst_file_free(sst_file_t* file) {
+    if (file->fd >= 0) {
+        close(file->fd);
+    }
+    if (file->obsolete) {
+        unlink(file->path);
+        for (size_t i = 0; i < file->block_count; i++) {
+            block_cache_erase(file->cache, file->number, file->blocks[i].offset);
+        }
+    }
+    free(file->filter);  // From posix_memalign
+    for (size_t i = 0; i < file->block_count; i++) {
+        safe_free((void**)&file->blocks[i].last_key);
+    }
+    safe_free((void**)&file->blocks);
+    safe_free((void**)&file->smallest);
+    safe_free((void**)&file->largest);
+    safe_free((void**)&file->path);
+    safe_free((void**)&file);
+}
+
+static void sst_file_ref(sst_file_t* file) {
+    __atomic_add_fetch(&file->refs, 1, __ATOMIC_RELAXED);
+}
+
+// The last reference closes the file, and deletes it once compacted away
+static void sst_file_unref(sst_file_t* file) {
+    if (__atomic_sub_fetch(&file->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        sst_file_free(file);
+    }
+}
+
+// Open a table and load its index; the table starts with no references
+static int sst_open(database_t* db, uint64_t number, sst_file_t** result) {
+    char path[1024];
+    sst_path(db, number, path, sizeof(path));
+    *result = NULL;
+    
+    sst_file_t* file = safe_calloc(1, sizeof(sst_file_t));
+    file->number = number;
+    file->path = safe_strdup(path);
+    file->cache = db->block_cache;
+    file->fd = open(path, O_RDONLY);
+    
+    struct stat st;
+    sst_footer_t footer;
+    char* index = NULL;
+    int status = SUCCESS;
+    if (file->fd < 0 || fstat(file->fd, &st) != 0 || (uint64_t)st.st_size < sizeof(footer)) {
+        status = ERROR_IO;
+    }
+    if (status == SUCCESS) {
+        file->size = (uint64_t)st.st_size;
+        if (pread(file->fd, &footer, sizeof(footer), (off_t)(file->size - sizeof(footer))) != (ssize_t)sizeof(footer) ||
+            footer.magic != SSTABLE_MAGIC || footer.index_size < sizeof(uint32_t) ||
+            footer.filter_size % (BLOOM_BLOCK_BITS / 8) != 0 ||
+            footer.filter_offset + footer.filter_size != footer.index_offset ||
+            footer.index_offset + footer.index_size + sizeof(footer) != file->size) {
+            status = ERROR_IO;
+        }
+    }
+    if (status == SUCCESS && footer.filter_size > 0 && footer.filter_probes > 0) {
+        void* filter = NULL;
+        if (posix_memalign(&filter, 64, footer.filter_size) != 0) {
+            status = ERROR_MEMORY;
+        } else {
+            file->filter = filter;
+            file->filter_blocks = footer.filter_size / (BLOOM_BLOCK_BITS / 8);
+            file->filter_probes = footer.filter_probes;
+            if (pread(file->fd, filter, footer.filter_size, (off_t)footer.filter_offset) != (ssize_t)footer.filter_size ||
+                crc32c_extend(0, filter, footer.filter_size) != footer.filter_crc) {
+                status = ERROR_IO;
+            }
+        }
+    }
+    if (status == SUCCESS) {
+        index = safe_malloc(footer.index_size);
+        if (pread(file->fd, index, footer.index_size, (off_t)footer.index_offset) != (ssize_t)footer.index_size ||
+            crc32c_extend(0, index, footer.index_size) != footer.index_crc) {
+            status = ERROR_IO;
+        }
+    }
+    
+    size_t offset = 0;
+    size_t capacity = 0;
+    if (status == SUCCESS) {
+        uint32_t smallest_size;
+        memcpy(&smallest_size, index, sizeof(smallest_size));
+        offset = sizeof(smallest_size);
+        if (smallest_size == 0 || smallest_size > footer.index_size - offset ||
+            index[offset + smallest_size - 1] != '\0') {
+            status = ERROR_IO;
+        } else {
+            file->smallest = safe_strdup(index + offset);
+            offset += smallest_size;
+        }
+    }
+    while (status == SUCCESS && offset < footer.index_size) {
+        sst_index_entry_t entry;
+        if (footer.index_size - offset < sizeof(entry)) {
+            status = ERROR_IO;
+            break;
+        }
+        memcpy(&entry, index + offset, sizeof(entry));
+        offset += sizeof(entry);
+        if (entry.key_size == 0 || entry.key_size > footer.index_size - offset ||
+            index[offset + entry.key_size - 1] != '\0' ||
+            entry.offset + entry.size + sizeof(uint32_t) > footer.filter_offset) {
+            status = ERROR_IO;
+            break;
+        }
+        if (file->block_count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            file->blocks = safe_realloc(file->blocks, capacity * sizeof(sst_block_t));
+        }
+        sst_block_t* block = &file->blocks[file->block_count++];
+        block->last_key = safe_strdup(index + offset);
+        block->offset = entry.offset;
+        block->size = entry.size;
+        offset += entry.key_size;
+    }
+    if (status == SUCCESS && file->block_count == 0) {
+        status = ERROR_IO;
+    }
+    safe_free((void**)&index);
+    
+    if (status != SUCCESS) {
+        sst_file_free(file);
+        return status;
+    }
+    file->entries = footer.entry_count;
+    file->largest = safe_strdup(file->blocks[file->block_count - 1].last_key);
+    *result = file;
+    return SUCCESS;
+}
+
+// Read and verify one data block; the caller frees it
+static char* sst_read_block(const sst_file_t* file, size_t index, uint32_t* size) {
+    const sst_block_t* block = &file->blocks[index];
+    char* data = safe_malloc((size_t)block->size + sizeof(uint32_t));
+    uint32_t crc;
+    if (pread(file->fd, data, (size_t)block->size + sizeof(crc), (off_t)block->offset) !=
+        (ssize_t)(block->size + sizeof(crc))) {
+        safe_free((void**)&data);
+        return NULL;
+    }
+    memcpy(&crc, data + block->size, sizeof(crc));
+    if (crc32c_extend(0, data, block->size) != crc) {
+        safe_free((void**)&data);
+        return NULL;
+    }
+    *size = block->size;
+    return data;
+}
+
+// A data block through the block cache; give it back with block_cache_release
+static cached_block_t* sst_acquire_block(const sst_file_t* file, size_t index) {
+    if (file->cache) {
+        cached_block_t* block = block_cache_lookup(file->cache, file->number, file->blocks[index].offset);
+        if (block) {
+            return block;
+        }
+    }
+    uint32_t size = 0;
+    char* data = sst_read_block(file, index, &size);
+    if (!data) {
+        return NULL;
+    }
+    return block_cache_insert(file->cache, file->number, file->blocks[index].offset, data, size);
+}
+
+// Binary search the index for the one block that could hold key
+static lookup_result_t sst_get(const sst_file_t* file, const char* key, void** value, size_t* value_size) {
+    size_t low = 0;
+    size_t high = file->block_count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (strcmp(file->blocks[mid].last_key, key) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low == file->block_count) {
+        return LOOKUP_MISSING;
+    }
+    
+    cached_block_t* block = sst_acquire_block(file, low);
+    if (!block) {
+        return LOOKUP_ERROR;
+    }
+    const char* data = block->data;
+    uint32_t size = block->size;
+    lookup_result_t result = LOOKUP_MISSING;
+    size_t offset = 0;
+    while (offset < size) {
+        sst_entry_t entry;
+        size_t length = sst_entry_parse(data, size, offset, &entry);
+        if (length == 0) {
+            result = LOOKUP_ERROR;
+            break;
+        }
+        const char* entry_key = data + offset + sizeof(entry);
+        int cmp = strcmp(entry_key, key);
+        if (cmp == 0) {
+            if (entry.type == WAL_ENTRY_PUT) {
+                copy_value(entry_key + entry.key_size, entry.value_size, value, value_size);
+                result = LOOKUP_FOUND;
+            } else {
+                result = LOOKUP_DELETED;
+            }
+            break;
+        }
+        if (cmp > 0) {
+            break;
+        }
+        offset += length;
+    }
+    block_cache_release(file->cache, block);
+    return result;
+}
+
+static void sst_iter_next(sst_iter_t* iter) {
+    iter->valid = false;
+    while (iter->status == SUCCESS) {
+        if (iter->data && iter->offset < iter->size) {
+            size_t length = sst_entry_parse(iter->data, iter->size, iter->offset, &iter->entry);
+            if (length == 0) {
+                iter->status = ERROR_IO;
+                return;
+            }
+            iter->key = iter->data + iter->offset + sizeof(sst_entry_t);
+            iter->value = iter->key + iter->entry.key_size;
+            iter->offset += length;
+            iter->valid = true;
+            return;
+        }
+        
+        safe_free((void**)&iter->data);
+        if (iter->file == iter->file_count) {
+            return;
+        }
+        if (iter->block == iter->files[iter->file]->block_count) {
+            iter->file++;
+            iter->block = 0;
+            continue;
+        }
+        iter->data = sst_read_block(iter->files[iter->file], iter->block++, &iter->size);
+        iter->offset = 0;
+        if (!iter->data) {
+            iter->status = ERROR_IO;
+        }
+    }
+}
+
+static void sst_iter_init(sst_iter_t* iter, sst_file_t** files, size_t file_count) {
+    memset(iter, 0, sizeof(*iter));
+    iter->files = files;
+    iter->file_count = file_count;
+    sst_iter_next(iter);
+}
+
+// Position on the first entry at or after key, or strictly after it, in
+// tables sorted by key
+static void sst_iter_seek(sst_iter_t* iter, sst_file_t** files, size_t file_count, const char* key, bool after) {
+    memset(iter, 0, sizeof(*iter));
+    iter->files = files;
+    iter->file_count = file_count;
+    if (key) {
+        size_t low = 0;
+        size_t high = file_count;
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            if (strcmp(files[mid]->largest, key) < 0) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        iter->file = low;
+        if (low < file_count) {
+            const sst_file_t* file = files[low];
+            size_t block_low = 0;
+            size_t block_high = file->block_count;
+            while (block_low < block_high) {
+                size_t mid = block_low + (block_high - block_low) / 2;
+                if (strcmp(file->blocks[mid].last_key, key) < 0) {
+                    block_low = mid + 1;
+                } else {
+                    block_high = mid;
+                }
+            }
+            iter->block = block_low;
+        }
+    }
+    sst_iter_next(iter);
+    while (key && iter->valid) {
+        int cmp = strcmp(iter->key, key);
+        if (cmp > 0 || (cmp == 0 && !after)) {
+            break;
+        }
+        sst_iter_next(iter);
+    }
+}
+
+static void sst_iter_close(sst_iter_t* iter) {
+    safe_free((void**)&iter->data);
+    iter->valid = false;
+}
+
+// =============================================================================
+// LSM engine: versions and manifest
+// =============================================================================
+
+static lsm_version_t* version_create(void) {
+    lsm_version_t* version = safe_calloc(1, sizeof(lsm_version_t));
+    version->refs = 1;
+    return version;
+}
+
+static void version_ref(lsm_version_t* version) {
+    __atomic_add_fetch(&version->refs, 1, __ATOMIC_RELAXED);
+}
+
+static void version_unref(lsm_version_t* version) {
+    if (!version || __atomic_sub_fetch(&version->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+    for (int level = 0; level < LSM_MAX_LEVELS; level++) {
+        for (size_t i = 0; i < version->counts[level]; i++) {
+            sst_file_unref(version->files[level][i]);
+        }
+        safe_free((void**)&version->files[level]);
+    }
+    safe_free((void**)&version);
+}
+
+static void version_release(void* version) {
+    version_unref((lsm_version_t*)version);
+}
+
+static void version_add_file(lsm_version_t* version, int level, sst_file_t* file) {
+    size_t count = version->counts[level];
+    version->files[level] = safe_realloc(version->files[level], (count + 1) * sizeof(sst_file_t*));
+    version->files[level][count] = file;
+    version->counts[level] = count + 1;
+    sst_file_ref(file);
+}
+
+static int compare_files_newest(const void* a, const void* b) {
+    const sst_file_t* left = *(sst_file_t* const*)a;
+    const sst_file_t* right = *(sst_file_t* const*)b;
+    return left->number > right->number ? -1 : left->number < right->number;
+}
+
+static int compare_files_smallest(const void* a, const void* b) {
+    return strcmp((*(sst_file_t* const*)a)->smallest, (*(sst_file_t* const*)b)->smallest);
+}
+
+static void version_sort(lsm_version_t* version) {
+    for (int level = 0; level < LSM_MAX_LEVELS; level++) {
+        if (version->counts[level] > 1) {
+            qsort(version->files[level], version->counts[level], sizeof(sst_file_t*),
+                  level == 0 ? compare_files_newest : compare_files_smallest);
+        }
+    }
+}
+
+// A copy of base without the removed tables and with the added ones in level
+static lsm_version_t* version_apply(const lsm_version_t* base, sst_file_t* const* removed, size_t removed_count,
+                                    int level, sst_file_t* const* added, size_t added_count) {
+    lsm_version_t* version = version_create();
+    for (int l = 0; l < LSM_MAX_LEVELS; l++) {
+        for (size_t i = 0; i < base->counts[l]; i++) {
+            bool keep = true;
+            for (size_t r = 0; r < removed_count && keep; r++) {
+                keep = base->files[l][i] != removed[r];
+            }
+            if (keep) {
+                version_add_file(version, l, base->files[l][i]);
+            }
+        }
+    }
+    for (size_t i = 0; i < added_count; i++) {
+        version_add_file(version, level, added[i]);
+    }
+    version_sort(version);
+    return version;
+}
+
+// The table in a sorted level whose range holds key, or NULL
+static sst_file_t* version_find_file(const lsm_version_t* version, int level, const char* key) {
+    size_t low = 0;
+    size_t high = version->counts[level];
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (strcmp(version->files[level][mid]->largest, key) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low == version->counts[level] || strcmp(version->files[level][low]->smallest, key) > 0) {
+        return NULL;
+    }
+    return version->files[level][low];
+}
+
+// Look in one table whose range holds key, asking its filter first
+static lookup_result_t version_get_file(database_t* db, const sst_file_t* file, uint64_t hash,
+                                        const char* key, void** value, size_t* value_size) {
+    if (file->filter && !bloom_may_contain(file->filter, file->filter_blocks, file->filter_probes, hash)) {
+        __atomic_add_fetch(&db->bloom_negatives, 1, __ATOMIC_RELAXED);
+        return LOOKUP_MISSING;
+    }
+    lookup_result_t result = sst_get(file, key, value, value_size);
+    if (result == LOOKUP_MISSING && file->filter) {
+        __atomic_add_fetch(&db->bloom_false_positives, 1, __ATOMIC_RELAXED);
+    }
+    return result;
+}
+
+// Level 0 tables may overlap and are searched newest first; each deeper
+// level has at most one table that can hold the key
+static lookup_result_t version_get(database_t* db, const lsm_version_t* version, const char* key,
+                                   void** value, size_t* value_size) {
+    uint64_t hash = key_hash64(key);
+    for (size_t i = 0; i < version->counts[0]; i++) {
+        const sst_file_t* file = version->files[0][i];
+        if (strcmp(key, file->smallest) < 0 || strcmp(key, file->largest) > 0) {
+            continue;
+        }
+        lookup_result_t result = version_get_file(db, file, hash, key, value, value_size);
+        if (result != LOOKUP_MISSING) {
+            return result;
+        }
+    }
+    for (int level = 1; level < LSM_MAX_LEVELS; level++) {
+        const sst_file_t* file = version_find_file(version, level, key);
+        if (file) {
+            lookup_result_t result = version_get_file(db, file, hash, key, value, value_size);
+            if (result != LOOKUP_MISSING) {
+                return result;
+            }
+        }
+    }
+    return LOOKUP_MISSING;
+}
+
+// Record the live tables; written to a temporary file and renamed over
+// MANIFEST, so a crash leaves either the old or the new table set
+static int lsm_write_manifest(database_t* db, const lsm_version_t* version, uint64_t last_seq, uint64_t wal_segment) {
+    char tmp_path[1024];
+    char path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s/MANIFEST.tmp", db->data_dir);
+    snprintf(path, sizeof(path), "%s/MANIFEST", db->data_dir);
+    
+    wal_buffer_t body;
+    memset(&body, 0, sizeof(body));
+    manifest_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MANIFEST_MAGIC;
+    header.next_file_number = db->next_file_number;
+    header.last_seq = last_seq;
+    header.wal_segment = wal_segment;
+    for (int level = 0; level < LSM_MAX_LEVELS; level++) {
+        for (size_t i = 0; i < version->counts[level]; i++) {
+            manifest_file_t entry;
+            memset(&entry, 0, sizeof(entry));
+            entry.level = (uint32_t)level;
+            entry.number = version->files[level][i]->number;
+            wal_buffer_append(&body, &entry, sizeof(entry));
+            header.file_count++;
+        }
+    }
+    header.body_crc = crc32c_extend(0, body.data, body.size);
+    
+    int status = SUCCESS;
+    int fd = open(tmp_path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    if (fd < 0) {
+        status = ERROR_IO;
+    }
+    if (status == SUCCESS) {
+        status = write_all(fd, (const char*)&header, sizeof(header));
+    }
+    if (status == SUCCESS) {
+        status = write_all(fd, body.data, body.size);
+    }
+    if (status == SUCCESS && fdatasync(fd) != 0) {
+        status = ERROR_IO;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    safe_free((void**)&body.data);
+    
+    if (status == SUCCESS && rename(tmp_path, path) != 0) {
+        status = ERROR_IO;
+    }
+    if (status != SUCCESS) {
+        unlink(tmp_path);
+        return status;
+    }
+    db->manifest_last_seq = last_seq;
+    db->manifest_wal_segment = wal_segment;
+    return sync_directory(db->data_dir);
+}
+
+// Open the tables listed in MANIFEST and delete any others, left behind by
+// a flush or compaction that did not finish. *wal_segment is the first WAL
+// segment not yet in a table, or 0 without a manifest.
+static int lsm_load_manifest(database_t* db, uint64_t* wal_segment) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/MANIFEST", db->data_dir);
+    *wal_segment = 0;
+    
+    version_unref(db->version);
+    db->version = version_create();
+    block_cache_clear(db->block_cache);
+    memtable_destroy(db->mem);
+    memtable_destroy(db->imm);
+    db->mem = memtable_create();
+    db->imm = NULL;
+    db->next_file_number = 1;
+    db->last_seq = 0;
+    
+    manifest_header_t header;
+    memset(&header, 0, sizeof(header));
+    manifest_file_t* entries = NULL;
+    int status = SUCCESS;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0 && errno != ENOENT) {
+        return ERROR_IO;
+    }
+    if (fd >= 0) {
+        if (read(fd, &header, sizeof(header)) != (ssize_t)sizeof(header) || header.magic != MANIFEST_MAGIC) {
+            status = ERROR_IO;
+        } else {
+            size_t size = (size_t)header.file_count * sizeof(manifest_file_t);
+            entries = safe_malloc(size + 1);
+            if (read(fd, entries, size) != (ssize_t)size || crc32c_extend(0, entries, size) != header.body_crc) {
+                status = ERROR_IO;
+            }
+        }
+        close(fd);
+    }
+    
+    for (uint32_t i = 0; i < header.file_count && status == SUCCESS; i++) {
+        sst_file_t* file = NULL;
+        if (entries[i].level >= LSM_MAX_LEVELS) {
+            status = ERROR_IO;
+            break;
+        }
+        status = sst_open(db, entries[i].number, &file);
+        if (status == SUCCESS) {
+            version_add_file(db->version, (int)entries[i].level, file);
+        }
+    }
+    version_sort(db->version);
+    
+    if (status == SUCCESS) {
+        if (fd >= 0) {
+            db->next_file_number = header.next_file_number;
+            db->last_seq = header.last_seq;
+            *wal_segment = header.wal_segment;
+        }
+        db->manifest_last_seq = db->last_seq;
+        db->manifest_wal_segment = *wal_segment;
+        
+        DIR* dir = opendir(db->data_dir);
+        struct dirent* entry;
+        while (dir && (entry = readdir(dir)) != NULL) {
+            unsigned long long number;
+            int length = 0;
+            if (sscanf(entry->d_name, "%llu.sst%n", &number, &length) != 1 || entry->d_name[length] != '\0') {
+                continue;
+            }
+            bool live = false;
+            for (uint32_t i = 0; i < header.file_count && !live; i++) {
+                live = entries[i].number == number;
+            }
+            if (!live) {
+                sst_path(db, number, path, sizeof(path));
+                unlink(path);
+            }
+        }
+        if (dir) {
+            closedir(dir);
+        }
+    }
+    safe_free((void**)&entries);
+    return status;
+}
+
+// =============================================================================
+// LSM engine: flush and compaction
+// =============================================================================
+
+static bool version_empty(const lsm_version_t* version) {
+    for (int level = 0; level < LSM_MAX_LEVELS; level++) {
+        if (version->counts[level] > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Write the immutable memtable to a level-0 table with the newest version of
+// each key, install it, then drop the WAL segments it covered
+static int lsm_flush_memtable(database_t* db) {
+    memtable_t* imm = db->imm;
+    lsm_version_t* base = db->version;
+    bool bottom = version_empty(base);  // Tombstones have nothing left to hide
+    
+    sst_builder_t builder;
+    int status = sst_builder_start(db, &builder, db->next_file_number++);
+    if (status != SUCCESS) {
+        sst_builder_release(&builder);
+        return status;
+    }
+    const char* previous = NULL;
+    for (const mem_node_t* node = imm->head->next[0]; node; node = node->next[0]) {
+        if (previous && strcmp(previous, node->key) == 0) {
+            continue;  // Older version
+        }
+        previous = node->key;
+        if (node->type == WAL_ENTRY_DELETE && bottom) {
+            continue;
+        }
+        sst_builder_add(&builder, node->key, node->type, node->seq, node->value, node->value_size);
+    }
+    
+    sst_file_t* file = NULL;
+    if (builder.entries > 0) {
+        status = sst_builder_finish(db, &builder, &file);
+    } else {
+        sst_builder_abandon(db, &builder);
+    }
+    if (status != SUCCESS) {
+        return status;
+    }
+    
+    lsm_version_t* version = version_apply(base, NULL, 0, 0, &file, file ? 1 : 0);
+    uint64_t last_seq = imm->max_seq > db->manifest_last_seq ? imm->max_seq : db->manifest_last_seq;
+    status = lsm_write_manifest(db, version, last_seq, db->imm_wal_segment);
+    if (status != SUCCESS) {
+        version_unref(version);  // The table is unlisted and removed at the next open
+        return status;
+    }
+    
+    // A snapshot reader may have loaded base or imm without the lock
+    pthread_rwlock_wrlock(&db->lock);
+    __atomic_store_n(&db->version, version, __ATOMIC_RELEASE);
+    __atomic_store_n(&db->imm, NULL, __ATOMIC_RELEASE);
+    db->memtable_flushes++;
+    bool retired = db_retire(db, base, version_release);
+    if (retired) {
+        db_retire(db, imm, memtable_release);
+    }
+    pthread_rwlock_unlock(&db->lock);
+    
+    if (!retired) {
+        version_unref(base);
+        memtable_destroy(imm);
+    }
+    wal_remove_segments_before(db, db->manifest_wal_segment);
+    return SUCCESS;
+}
+
+static uint64_t level_bytes(const lsm_version_t* version, int level) {
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < version->counts[level]; i++) {
+        bytes += version->files[level][i]->size;
+    }
+    return bytes;
+}
+
+// Level 0 is scored by table count, since every table there is searched;
+// deeper levels by size. The last level is never compacted.
+static double level_score(const database_t* db, const lsm_version_t* version, int level) {
+    if (level == 0) {
+        return (double)version->counts[0] / (double)db->config.level0_compaction_trigger;
+    }
+    if (level == LSM_MAX_LEVELS - 1) {
+        return 0.0;
+    }
+    double max_bytes = (double)db->config.level1_max_bytes;
+    for (int l = 1; l < level; l++) {
+        max_bytes *= LSM_LEVEL_SIZE_RATIO;
+    }
+    return (double)level_bytes(version, level) / max_bytes;
+}
+
+// The level most in need of compaction, or -1
+static int lsm_pick_level(const database_t* db, const lsm_version_t* version) {
+    int best = -1;
+    double best_score = 1.0;
+    for (int level = 0; level < LSM_MAX_LEVELS - 1; level++) {
+        double score = level_score(db, version, level);
+        if (score >= best_score) {
+            best = level;
+            best_score = score;
+        }
+    }
+    return best;
+}
+
+// Whether a level below level may hold key; a tombstone must be kept if so
+static bool key_in_deeper_levels(const lsm_version_t* version, int level, const char* key) {
+    for (int l = level + 1; l < LSM_MAX_LEVELS; l++) {
+        if (version_find_file(version, l, key)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Merge tables from level with the overlapping ones from level + 1 into new
+// level + 1 tables, keeping the newest version of each key
+static int lsm_merge(database_t* db, int level, sst_file_t** inputs, size_t input_count,
+                     sst_file_t** next, size_t next_count) {
+    lsm_version_t* base = db->version;
+    
+    // Level-0 tables overlap, so each gets its own iterator; the tables of a
+    // deeper level are read back to back
+    size_t iter_count = 0;
+    sst_iter_t* iters = safe_calloc(input_count + 1, sizeof(sst_iter_t));
+    if (level == 0) {
+        for (size_t i = 0; i < input_count; i++) {
+            sst_iter_init(&iters[iter_count++], &inputs[i], 1);
+        }
+    } else {
+        sst_iter_init(&iters[iter_count++], inputs, input_count);
+    }
+    if (next_count > 0) {
+        sst_iter_init(&iters[iter_count++], next, next_count);
+    }
+    
+    sst_file_t** outputs = NULL;
+    size_t output_count = 0;
+    sst_builder_t builder;
+    bool building = false;
+    wal_buffer_t current;
+    memset(&current, 0, sizeof(current));
+    int status = SUCCESS;
+    
+    for (;;) {
+        sst_iter_t* best = NULL;
+        for (size_t i = 0; i < iter_count; i++) {
+            if (iters[i].status != SUCCESS) {
+                status = iters[i].status;
+            }
+            if (!iters[i].valid) {
+                continue;
+            }
+            int cmp = best ? strcmp(iters[i].key, best->key) : -1;
+            if (cmp < 0 || (cmp == 0 && iters[i].entry.seq > best->entry.seq)) {
+                best = &iters[i];
+            }
+        }
+        if (!best || status != SUCCESS) {
+            break;
+        }
+        
+        if (best->entry.type == WAL_ENTRY_PUT || key_in_deeper_levels(base, level + 1, best->key)) {
+            if (!building) {
+                status = sst_builder_start(db, &builder, db->next_file_number++);
+                if (status != SUCCESS) {
+                    sst_builder_release(&builder);
+                    break;
+                }
+                building = true;
+            }
+            sst_builder_add(&builder, best->key, best->entry.type, best->entry.seq,
+                            best->value, best->entry.value_size);
+            if (sst_builder_size(&builder) >= LSM_TARGET_FILE_BYTES) {
+                building = false;
+                outputs = safe_realloc(outputs, (output_count + 1) * sizeof(sst_file_t*));
+                status = sst_builder_finish(db, &builder, &outputs[output_count]);
+                if (status != SUCCESS) {
+                    break;
+                }
+                output_count++;
+            }
+        }
+        
+        // Skip the older versions
+        current.size = 0;
+        wal_buffer_append(&current, best->key, best->entry.key_size);
+        for (size_t i = 0; i < iter_count; i++) {
+            while (iters[i].valid && strcmp(iters[i].key, current.data) == 0) {
+                sst_iter_next(&iters[i]);
+            }
+        }
+    }
+    if (building) {
+        if (status == SUCCESS) {
+            outputs = safe_realloc(outputs, (output_count + 1) * sizeof(sst_file_t*));
+            status = sst_builder_finish(db, &builder, &outputs[output_count]);
+            if (status == SUCCESS) {
+                output_count++;
+            }
+        } else {
+            sst_builder_abandon(db, &builder);
+        }
+    }
+    for (size_t i = 0; i < iter_count; i++) {
+        sst_iter_close(&iters[i]);
+    }
+    safe_free((void**)&iters);
+    safe_free((void**)&current.data);
+    
+    lsm_version_t* version = NULL;
+    if (status == SUCCESS) {
+        sst_file_t** removed = safe_malloc((input_count + next_count + 1) * sizeof(sst_file_t*));
+        memcpy(removed, inputs, input_count * sizeof(sst_file_t*));
+        if (next_count > 0) {
+            memcpy(removed + input_count, next, next_count * sizeof(sst_file_t*));
+        }
+        version = version_apply(base, removed, input_count + next_count, level + 1, outputs, output_count);
+        safe_free((void**)&removed);
+        status = lsm_write_manifest(db, version, db->manifest_last_seq, db->manifest_wal_segment);
+    }
+    if (status != SUCCESS) {
+        // Unlisted outputs are deleted with their last reference
+        for (size_t i = 0; i < output_count; i++) {
+            outputs[i]->obsolete = true;
+            sst_file_ref(outputs[i]);
+            sst_file_unref(outputs[i]);
+        }
+        version_unref(version);
+        safe_free((void**)&outputs);
+        return status;
+    }
+    safe_free((void**)&outputs);
+    
+    // Readers still holding the old version keep the inputs open until done
+    for (size_t i = 0; i < input_count; i++) {
+        inputs[i]->obsolete = true;
+    }
+    for (size_t i = 0; i < next_count; i++) {
+        next[i]->obsolete = true;
+    }
+    
+    pthread_rwlock_wrlock(&db->lock);
+    __atomic_store_n(&db->version, version, __ATOMIC_RELEASE);
+    db->compactions++;
+    bool retired = db_retire(db, base, version_release);
+    pthread_rwlock_unlock(&db->lock);
+    
+    if (!retired) {
+        version_unref(base);
+    }
+    return SUCCESS;
+}
+
+// Compact level into level + 1: all of level 0, or one table of a deeper
+// level, taken round robin through the key space. With whole set, every
+// table in the level is compacted.
+static int lsm_compact_level(database_t* db, int level, bool whole) {
+    lsm_version_t* version = db->version;
+    sst_file_t** files = version->files[level];
+    size_t count = version->counts[level];
+    if (count == 0) {
+        return SUCCESS;
+    }
+    
+    size_t first = 0;
+    size_t input_count = count;
+    if (level > 0 && !whole) {
+        input_count = 1;
+        if (db->compact_pointer[level]) {
+            while (first < count && strcmp(files[first]->smallest, db->compact_pointer[level]) <= 0) {
+                first++;
+            }
+            if (first == count) {
+                first = 0;
+            }
+        }
+    }
+    sst_file_t** inputs = files + first;
+    
+    const char* smallest = inputs[0]->smallest;
+    const char* largest = inputs[0]->largest;
+    for (size_t i = 1; i < input_count; i++) {
+        if (strcmp(inputs[i]->smallest, smallest) < 0) smallest = inputs[i]->smallest;
+        if (strcmp(inputs[i]->largest, largest) > 0) largest = inputs[i]->largest;
+    }
+    
+    size_t next_count = 0;
+    sst_file_t** next = safe_malloc((version->counts[level + 1] + 1) * sizeof(sst_file_t*));
+    for (size_t i = 0; i < version->counts[level + 1]; i++) {
+        sst_file_t* file = version->files[level + 1][i];
+        if (strcmp(file->largest, smallest) >= 0 && strcmp(file->smallest, largest) <= 0) {
+            next[next_count++] = file;
+        }
+    }
+    
+    safe_free((void**)&db->compact_pointer[level]);
+    db->compact_pointer[level] = safe_strdup(largest);
+    
+    int status = SUCCESS;
+    if (input_count == 1 && next_count == 0 && !whole) {
+        // Nothing to merge with: move the table down
+        lsm_version_t* moved = version_apply(version, inputs, 1, level + 1, inputs, 1);
+        status = lsm_write_manifest(db, moved, db->manifest_last_seq, db->manifest_wal_segment);
+        if (status == SUCCESS) {
+            pthread_rwlock_wrlock(&db->lock);
+            __atomic_store_n(&db->version, moved, __ATOMIC_RELEASE);
+            db->compactions++;
+            bool retired = db_retire(db, version, version_release);
+            pthread_rwlock_unlock(&db->lock);
+            if (!retired) {
+                version_unref(version);
+            }
+        } else {
+            version_unref(moved);
+        }
+    } else {
+        status = lsm_merge(db, level, inputs, input_count, next, next_count);
+    }
+    safe_free((void**)&next);
+    return status;
+}
+
+// Runs a pending flush; called on the LSM thread with lsm_lock held
+static void lsm_serve_flush_locked(database_t* db) {
+    if (!db->lsm_flush_pending) {
+        return;
+    }
+    pthread_mutex_unlock(&db->lsm_lock);
+    int status = lsm_flush_memtable(db);
+    pthread_mutex_lock(&db->lsm_lock);
+    db->lsm_flush_pending = false;
+    if (status != SUCCESS) {
+        db->lsm_error = status;
+    }
+    pthread_cond_broadcast(&db->lsm_done);
+}
+
+// Push every level into the one below, down to the deepest level with
+// tables, dropping overwritten versions and tombstones on the way. Flushes
+// are served between levels so writers are not held up.
+static int lsm_compact_all(database_t* db) {
+    int deepest = 1;
+    for (int level = 1; level < LSM_MAX_LEVELS; level++) {
+        if (db->version->counts[level] > 0) {
+            deepest = level;
+        }
+    }
+    for (int level = 0; level < deepest; level++) {
+        pthread_mutex_lock(&db->lsm_lock);
+        lsm_serve_flush_locked(db);
+        int status = db->lsm_error;
+        pthread_mutex_unlock(&db->lsm_lock);
+        if (status == SUCCESS) {
+            status = lsm_compact_level(db, level, true);
+        }
+        if (status != SUCCESS) {
+            return status;
+        }
+    }
+    return SUCCESS;
+}
+
+// Flushes come first, then requested full compactions, then automatic ones
+static void* lsm_main(void* arg) {
+    database_t* db = (database_t*)arg;
+    
+    pthread_mutex_lock(&db->lsm_lock);
+    for (;;) {
+        while (!db->lsm_flush_pending && db->lsm_served == db->lsm_requested && !db->lsm_stopping &&
+               (db->lsm_error != SUCCESS || lsm_pick_level(db, db->version) < 0)) {
+            pthread_cond_wait(&db->lsm_work, &db->lsm_lock);
+        }
+        if (db->lsm_flush_pending) {
+            lsm_serve_flush_locked(db);
+            continue;
+        }
+        if (db->lsm_served != db->lsm_requested) {
+            uint64_t request = db->lsm_requested;
+            int status = db->lsm_error;
+            if (status == SUCCESS) {
+                pthread_mutex_unlock(&db->lsm_lock);
+                status = lsm_compact_all(db);
+                pthread_mutex_lock(&db->lsm_lock);
+            }
+            db->lsm_served = request;
+            db->lsm_status = status;
+            pthread_cond_broadcast(&db->lsm_done);
+            continue;
+        }
+        if (db->lsm_stopping) {
+            break;
+        }
+        
+        int level = lsm_pick_level(db, db->version);
+        pthread_mutex_unlock(&db->lsm_lock);
+        int status = lsm_compact_level(db, level, false);
+        pthread_mutex_lock(&db->lsm_lock);
+        if (status != SUCCESS) {
+            db->lsm_error = status;
+        }
+    }
+    pthread_mutex_unlock(&db->lsm_lock);
+    return NULL;
+}
+
+static void lsm_thread_stop(database_t* db) {
+    if (!db->lsm_running) {
+        return;
+    }
+    pthread_mutex_lock(&db->lsm_lock);
+    db->lsm_stopping = true;
+    pthread_cond_signal(&db->lsm_work);
+    pthread_mutex_unlock(&db->lsm_lock);
+    
+    pthread_join(db->lsm_thread, NULL);
+    db->lsm_running = false;
+    db->lsm_stopping = false;
+}
+
+// Hand the full memtable to the LSM thread. Its records end the current WAL
+// segment, so the segments before the new one can go once it is flushed.
+// Called with db->lock held for writing.
+static int lsm_switch_memtable_locked(database_t* db) {
+    uint64_t segment = 0;
+    pthread_mutex_lock(&db->wal_lock);
+    int status = wal_rotate_locked(db, &segment);
+    pthread_mutex_unlock(&db->wal_lock);
+    if (status == SUCCESS) {
+        status = sync_directory(db->data_dir);
+    }
+    if (status != SUCCESS) {
+        return status;
+    }
+    
+    __atomic_store_n(&db->imm, db->mem, __ATOMIC_RELEASE);
+    db->imm_wal_segment = segment;
+    __atomic_store_n(&db->mem, memtable_create(), __ATOMIC_RELEASE);
+    
+    pthread_mutex_lock(&db->lsm_lock);
+    db->lsm_flush_pending = true;
+    pthread_cond_signal(&db->lsm_work);
+    pthread_mutex_unlock(&db->lsm_lock);
+    return SUCCESS;
+}
+
+static int lsm_wait_flush(database_t* db) {
+    pthread_mutex_lock(&db->lsm_lock);
+    while (db->lsm_flush_pending && db->lsm_error == SUCCESS) {
+        pthread_cond_wait(&db->lsm_done, &db->lsm_lock);
+    }
+    int status = db->lsm_error;
+    pthread_mutex_unlock(&db->lsm_lock);
+    return status;
+}
+
+// Flush whatever is in the memtable and wait for it
+static int lsm_flush(database_t* db) {
+    pthread_rwlock_wrlock(&db->lock);
+    while (db->imm) {
+        pthread_rwlock_unlock(&db->lock);
+        int status = lsm_wait_flush(db);
+        if (status != SUCCESS) {
+            return status;
+        }
+        pthread_rwlock_wrlock(&db->lock);
+    }
+    int status = db->mem->entries > 0 ? lsm_switch_memtable_locked(db) : SUCCESS;
+    pthread_rwlock_unlock(&db->lock);
+    
+    return status == SUCCESS ? lsm_wait_flush(db) : status;
+}
+
+// =============================================================================
+// MVCC: key versions for snapshot transactions
+// =============================================================================
+
+// Repeatable-read and serializable transactions read as of their snapshot,
+// the commit timestamp when they began. The engines only hold the newest
+// version of a key, so while any snapshot is active every write first saves
+// the key's history here: the value before the first tracked write, then
+// each committed version. A key with no chain has not changed since the
+// oldest active snapshot began, so the engine's value is the one to read.
+
+static void mvcc_versions_free(void* ptr) {
+    mvcc_version_t* version = (mvcc_version_t*)ptr;
+    while (version) {
+        mvcc_version_t* older = version->older;
+        safe_free((void**)&version->value);
+        safe_free((void**)&version);
+        version = older;
+    }
+}
+
+static size_t mvcc_versions_count(const mvcc_version_t* version) {
+    size_t count = 0;
+    for (; version; version = version->older) {
+        count++;
+    }
+    return count;
+}
+
+static void mvcc_chain_free(void* ptr) {
+    mvcc_chain_t* chain = (mvcc_chain_t*)ptr;
+    mvcc_versions_free(chain->newest);
+    safe_free((void**)&chain->key);
+    safe_free((void**)&chain);
+}
+
+static void mvcc_table_clear(mvcc_table_t* table) {
+    for (size_t i = 0; i < table->bucket_count; i++) {
+        mvcc_chain_t* chain = table->buckets[i];
+        while (chain) {
+            mvcc_chain_t* next = chain->next;
+            mvcc_chain_free(chain);
+            chain = next;
+        }
+    }
+    safe_free((void**)&table->buckets);
+    table->bucket_count = table->size = table->versions = 0;
+}
+
+// Links are loaded atomically and the bucket count before the array, as in
+// hash_table_find, so this is safe without a lock while pinned in an epoch.
+// It is exact while commits are held off: only a commit resizes the table.
+static mvcc_chain_t* mvcc_find(const mvcc_table_t* table, const char* key) {
+    if (__atomic_load_n(&table->size, __ATOMIC_ACQUIRE) == 0) {
+        return NULL;
+    }
+    size_t bucket_count = __atomic_load_n(&table->bucket_count, __ATOMIC_ACQUIRE);
+    mvcc_chain_t** buckets = __atomic_load_n(&table->buckets, __ATOMIC_ACQUIRE);
+    mvcc_chain_t* chain = __atomic_load_n(&buckets[hash_string(key) % bucket_count], __ATOMIC_ACQUIRE);
+    while (chain && strcmp(chain->key, key) != 0) {
+        chain = __atomic_load_n(&chain->next, __ATOMIC_ACQUIRE);
+    }
+    return chain;
+}
+
+// mvcc_find with commits running. False if a resize overlapped a miss, which
+// may then be wrong.
+static bool mvcc_lookup(const mvcc_table_t* table, const char* key, const mvcc_chain_t** chain) {
+    uint64_t generation = __atomic_load_n(&table->generation, __ATOMIC_ACQUIRE);
+    if (generation & 1) {
+        return false;
+    }
+    *chain = mvcc_find(table, key);
+    return *chain || __atomic_load_n(&table->generation, __ATOMIC_ACQUIRE) == generation;
+}
+
+static void mvcc_push(mvcc_table_t* table, mvcc_chain_t* chain, uint64_t commit_ts, bool deleted,
+                      const void* value, size_t value_size) {
+    mvcc_version_t* version = safe_calloc(1, sizeof(mvcc_version_t));
+    version->commit_ts = commit_ts;
+    version->deleted = deleted;
+    if (!deleted) {
+        version->value = safe_malloc(value_size);
+        memcpy(version->value, value, value_size);
+        version->value_size = value_size;
+    }
+    version->older = chain->newest;
+    __atomic_store_n(&chain->newest, version, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&table->versions, 1, __ATOMIC_RELAXED);
+}
+
+// Add a chain for key holding its value from before the first tracked write.
+// Readers may find the chain as soon as it is linked, so it gets that version
+// first. Called with db->lock held for writing and versions_lock.
+static mvcc_chain_t* mvcc_chain_create(database_t* db, const char* key, bool deleted,
+                                       const void* value, size_t value_size) {
+    mvcc_table_t* table = &db->versions;
+    if (table->size >= table->bucket_count) {
+        __atomic_store_n(&table->generation, table->generation + 1, __ATOMIC_RELEASE);
+        size_t bucket_count = table->bucket_count ? table->bucket_count * 2 : 64;
+        mvcc_chain_t** buckets = safe_calloc(bucket_count, sizeof(mvcc_chain_t*));
+        for (size_t i = 0; i < table->bucket_count; i++) {
+            mvcc_chain_t* chain = table->buckets[i];
+            while (chain) {
+                mvcc_chain_t* next = chain->next;
+                size_t bucket = hash_string(chain->key) % bucket_count;
+                __atomic_store_n(&chain->next, buckets[bucket], __ATOMIC_RELEASE);
+                buckets[bucket] = chain;
+                chain = next;
+            }
+        }
+        mvcc_chain_t** old = table->buckets;
+        __atomic_store_n(&table->buckets, buckets, __ATOMIC_RELEASE);
+        __atomic_store_n(&table->bucket_count, bucket_count, __ATOMIC_RELEASE);
+        if (old && !db_retire(db, old, free)) {
+            free(old);
+        }
+        __atomic_store_n(&table->generation, table->generation + 1, __ATOMIC_RELEASE);
+    }
+    
+    mvcc_chain_t* chain = safe_calloc(1, sizeof(mvcc_chain_t));
+    chain->key = safe_strdup(key);
+    mvcc_push(table, chain, 0, deleted, value, value_size);
+    size_t bucket = hash_string(key) % table->bucket_count;
+    chain->next = table->buckets[bucket];
+    __atomic_store_n(&table->buckets[bucket], chain, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&table->size, 1, __ATOMIC_RELEASE);
+    return chain;
+}
+
+// Unlink the chain at link, with versions_lock held. The collector always
+// retires it, as snapshot readers run beside it; a commit frees it at once,
+// having seen under db->lock that no snapshot is active.
+static void mvcc_chain_remove(database_t* db, mvcc_chain_t** link, bool retire) {
+    mvcc_chain_t* chain = *link;
+    __atomic_store_n(link, chain->next, __ATOMIC_RELEASE);
+    __atomic_sub_fetch(&db->versions.size, 1, __ATOMIC_RELEASE);
+    __atomic_sub_fetch(&db->versions.versions, mvcc_versions_count(chain->newest), __ATOMIC_RELAXED);
+    if (retire) {
+        epoch_retire(&db->epoch, chain, mvcc_chain_free);
+    } else {
+        mvcc_chain_free(chain);
+    }
+}
+
+// Newest version visible at snapshot; the pre-image's timestamp of 0 makes
+// it visible to any snapshot taken before the first tracked write
+static const mvcc_version_t* mvcc_visible(const mvcc_chain_t* chain, uint64_t snapshot) {
+    const mvcc_version_t* version = __atomic_load_n(&chain->newest, __ATOMIC_ACQUIRE);
+    while (version && version->commit_ts > snapshot) {
+        version = __atomic_load_n(&version->older, __ATOMIC_ACQUIRE);
+    }
+    return version;
+}
+
+// Copy out the version of chain visible at snapshot
+static int mvcc_read(const mvcc_chain_t* chain, uint64_t snapshot, void** value, size_t* value_size) {
+    const mvcc_version_t* version = mvcc_visible(chain, snapshot);
+    if (version->deleted) {
+        return ERROR_NOT_FOUND;
+    }
+    copy_value(version->value, version->value_size, value, value_size);
+    return SUCCESS;
+}
+
+// The engine's current value of key; called with db->lock held for writing
+static int engine_read_locked(database_t* db, const char* key, void** value, size_t* value_size) {
+    if (db->config.engine != DATABASE_ENGINE_LSM) {
+        return hash_table_get(db->table, key, value, value_size);
+    }
+    const mem_node_t* node = memtable_find(db->mem, key);
+    if (!node && db->imm) {
+        node = memtable_find(db->imm, key);
+    }
+    if (node) {
+        if (node->type != WAL_ENTRY_PUT) {
+            return ERROR_NOT_FOUND;
+        }
+        copy_value(node->value, node->value_size, value, value_size);
+        return SUCCESS;
+    }
+    lookup_result_t found = version_get(db, db->version, key, value, value_size);
+    if (found == LOOKUP_ERROR) {
+        return ERROR_IO;
+    }
+    return found == LOOKUP_FOUND ? SUCCESS : ERROR_NOT_FOUND;
+}
+
+// Save the history of key before a write at db->commit_ts; called with
+// db->lock held for writing. With no snapshot left to read it, a chain is
+// garbage and is dropped instead. The chain is complete before the engine
+// changes, so a snapshot reader that sees the write finds the chain too.
+static int mvcc_record(database_t* db, wal_entry_type_t type, const char* key, const void* value, size_t value_size) {
+    bool active = __atomic_load_n(&db->snapshots_active, __ATOMIC_ACQUIRE) > 0;
+    pthread_mutex_lock(&db->versions_lock);
+    mvcc_chain_t** link = NULL;
+    mvcc_chain_t* chain = NULL;
+    if (db->versions.size > 0) {
+        link = &db->versions.buckets[hash_string(key) % db->versions.bucket_count];
+        while (*link && strcmp((*link)->key, key) != 0) {
+            link = &(*link)->next;
+        }
+        chain = *link;
+    }
+    if (!active) {
+        if (chain) {
+            mvcc_chain_remove(db, link, false);
+        }
+        pthread_mutex_unlock(&db->versions_lock);
+        return SUCCESS;
+    }
+    
+    if (!chain) {
+        void* current = NULL;
+        size_t current_size = 0;
+        int status = engine_read_locked(db, key, &current, &current_size);
+        if (status == ERROR_IO) {
+            pthread_mutex_unlock(&db->versions_lock);
+            return status;
+        }
+        chain = mvcc_chain_create(db, key, status != SUCCESS, current, current_size);
+        safe_free((void**)&current);
+    }
+    mvcc_push(&db->versions, chain, db->commit_ts, type != WAL_ENTRY_PUT, value, value_size);
+    pthread_mutex_unlock(&db->versions_lock);
+    return SUCCESS;
+}
+
+// Commit timestamp of the newest version of key, or 0 if it has not been
+// written since the oldest active snapshot began
+static uint64_t mvcc_last_commit(const database_t* db, const char* key) {
+    const mvcc_chain_t* chain = mvcc_find(&db->versions, key);
+    return chain ? __atomic_load_n(&chain->newest, __ATOMIC_ACQUIRE)->commit_ts : 0;
+}
+
+// Whether a key in table was committed by someone else after the snapshot
+static bool transaction_conflicts(const transaction_t* txn, const hash_table_t* table) {
+    for (size_t i = 0; table && i < table->bucket_count; i++) {
+        for (const hash_entry_t* entry = table->buckets[i]; entry; entry = entry->next) {
+            if (mvcc_last_commit(txn->db, entry->key) > txn->snapshot) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Whether a snapshot transaction may commit. Called with commit_lock held, so
+// no other commit lands meanwhile, and pinned, as the collector trims chains
+// beside it.
+static bool transaction_valid(const transaction_t* txn) {
+    database_t* db = txn->db;
+    unsigned pin = epoch_enter(&db->epoch);
+    bool valid = !transaction_conflicts(txn, txn->writes) && !transaction_conflicts(txn, txn->deletes) &&
+                 !transaction_conflicts(txn, txn->reads);
+    epoch_exit(&db->epoch, pin);
+    return valid;
+}
+
+// Take a snapshot for txn; called with db->lock held for writing so no
+// commit lands between reading the timestamp and writers seeing the snapshot
+static void mvcc_snapshot_begin(database_t* db, transaction_t* txn) {
+    pthread_mutex_lock(&db->mvcc_lock);
+    txn->snapshot = db->commit_ts;
+    txn->older = db->snapshots_newest;
+    if (db->snapshots_newest) {
+        db->snapshots_newest->newer = txn;
+    } else {
+        db->snapshots_oldest = txn;
+    }
+    db->snapshots_newest = txn;
+    __atomic_add_fetch(&db->snapshots_active, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&db->mvcc_lock);
+}
+
+// When the oldest snapshot ends, versions only it could read are collected
+static void mvcc_snapshot_end(database_t* db, transaction_t* txn) {
+    if (txn->snapshot == READ_LATEST) {
+        return;
+    }
+    pthread_mutex_lock(&db->mvcc_lock);
+    bool oldest = db->snapshots_oldest == txn;
+    if (txn->older) {
+        txn->older->newer = txn->newer;
+    } else {
+        db->snapshots_oldest = txn->newer;
+    }
+    if (txn->newer) {
+        txn->newer->older = txn->older;
+    } else {
+        db->snapshots_newest = txn->older;
+    }
+    __atomic_sub_fetch(&db->snapshots_active, 1, __ATOMIC_RELEASE);
+    if (oldest) {
+        db->mvcc_gc_requested = true;
+        pthread_cond_signal(&db->mvcc_gc_wanted);
+    }
+    pthread_mutex_unlock(&db->mvcc_lock);
+}
+
+// Trim every chain to what the oldest active snapshot can still read, a few
+// buckets per hold of versions_lock; only commits recording history wait for
+// it, and what readers may still hold is retired. A chain whose newest
+// version is visible to every snapshot says nothing the engine does not, so
+// it goes entirely.
+static void mvcc_collect(database_t* db) {
+    for (size_t start = 0;; start += SNAPSHOT_SCAN_BUCKETS) {
+        pthread_mutex_lock(&db->versions_lock);
+        if (start >= db->versions.bucket_count) {
+            pthread_mutex_unlock(&db->versions_lock);
+            break;
+        }
+        pthread_mutex_lock(&db->mvcc_lock);
+        uint64_t oldest = db->snapshots_oldest ? db->snapshots_oldest->snapshot : READ_LATEST;
+        pthread_mutex_unlock(&db->mvcc_lock);
+        
+        size_t end = start + SNAPSHOT_SCAN_BUCKETS;
+        for (size_t bucket = start; bucket < end && bucket < db->versions.bucket_count; bucket++) {
+            mvcc_chain_t** link = &db->versions.buckets[bucket];
+            while (*link) {
+                mvcc_version_t* keep = (mvcc_version_t*)mvcc_visible(*link, oldest);
+                if (keep == (*link)->newest) {
+                    mvcc_chain_remove(db, link, true);
+                    continue;
+                }
+                if (keep && keep->older) {
+                    mvcc_version_t* older = keep->older;
+                    __atomic_store_n(&keep->older, NULL, __ATOMIC_RELEASE);
+                    __atomic_sub_fetch(&db->versions.versions, mvcc_versions_count(older), __ATOMIC_RELAXED);
+                    epoch_retire(&db->epoch, older, mvcc_versions_free);
+                }
+                link = &(*link)->next;
+            }
+        }
+        pthread_mutex_unlock(&db->versions_lock);
+    }
+    
+    // Release what was retired above unless a reader is still pinned
+    epoch_advance(&db->epoch);
+    epoch_advance(&db->epoch);
+}
+
+static void* mvcc_gc_main(void* arg) {
+    database_t* db = (database_t*)arg;
+    
+    pthread_mutex_lock(&db->mvcc_lock);
+    while (!db->mvcc_gc_stopping) {
+        if (!db->mvcc_gc_requested) {
+            pthread_cond_wait(&db->mvcc_gc_wanted, &db->mvcc_lock);
+            continue;
+        }
+        db->mvcc_gc_requested = false;
+        pthread_mutex_unlock(&db->mvcc_lock);
+        
+        mvcc_collect(db);
+        
+        pthread_mutex_lock(&db->mvcc_lock);
+    }
+    pthread_mutex_unlock(&db->mvcc_lock);
+    return NULL;
+}
+
+static void mvcc_gc_stop(database_t* db) {
+    if (!db->mvcc_gc_running) {
+        return;
+    }
+    pthread_mutex_lock(&db->mvcc_lock);
+    db->mvcc_gc_stopping = true;
+    pthread_cond_signal(&db->mvcc_gc_wanted);
+    pthread_mutex_unlock(&db->mvcc_lock);
+    
+    pthread_join(db->mvcc_gc, NULL);
+    db->mvcc_gc_running = false;
+    db->mvcc_gc_stopping = false;
+}
+
+// =============================================================================
+// Storage engine dispatch
+// =============================================================================
+
+// Take commit_lock, then db->lock for writing with room in the memtable.
+// Writers queue on commit_lock, and a snapshot transaction (txn, or NULL) is
+// validated holding only that, so the write lock covers logging and applying.
+// A full memtable is switched out for flushing; while the previous one is
+// still being flushed, writers stall rather than let memory grow without
+// bound. After a WAL failure every write is refused before it is logged or
+// applied.
+static int db_write_begin(database_t* db, const transaction_t* txn) {
+    pthread_mutex_lock(&db->commit_lock);
+    int status = wal_status(db);
+    if (status == SUCCESS && txn && txn->snapshot != READ_LATEST && !transaction_valid(txn)) {
+        __atomic_add_fetch(&db->txn_conflicts, 1, __ATOMIC_RELAXED);
+        status = ERROR_CONFLICT;
+    }
+    if (status != SUCCESS) {
+        pthread_mutex_unlock(&db->commit_lock);
+        return status;
+    }
+    
+    pthread_rwlock_wrlock(&db->lock);
+    while (db->config.engine == DATABASE_ENGINE_LSM && db->lsm_running &&
+           db->mem->bytes >= db->config.memtable_bytes) {
+        if (!db->imm) {
+            status = lsm_switch_memtable_locked(db);
+            if (status != SUCCESS) {
+                pthread_rwlock_unlock(&db->lock);
+                pthread_mutex_unlock(&db->commit_lock);
+                return status;
+            }
+            break;
+        }
+        pthread_rwlock_unlock(&db->lock);
+        status = lsm_wait_flush(db);
+        if (status != SUCCESS) {
+            pthread_mutex_unlock(&db->commit_lock);
+            return status;
+        }
+        pthread_rwlock_wrlock(&db->lock);
+    }
+    return SUCCESS;
+}
+
+static void db_write_end(database_t* db) {
+    pthread_rwlock_unlock(&db->lock);
+    pthread_mutex_unlock(&db->commit_lock);
+}
+
+// Apply a change to the engine as part of the commit at db->commit_ts;
+// called with db->lock held for writing, or during recovery
+static int engine_apply(database_t* db, wal_entry_type_t type, const char* key,
+                        const void* value, size_t value_size) {
+    if (__atomic_load_n(&db->snapshots_active, __ATOMIC_ACQUIRE) > 0 ||
+        __atomic_load_n(&db->versions.size, __ATOMIC_ACQUIRE) > 0) {
+        int status = mvcc_record(db, type, key, value, value_size);
+        if (status != SUCCESS) {
+            return status;
+        }
+    }
+    if (db->config.engine == DATABASE_ENGINE_LSM) {
+        memtable_add(db->mem, ++db->last_seq, type, key, value, value_size);
+        return SUCCESS;
+    }
+    if (type == WAL_ENTRY_PUT) {
+        bool added = db->indexes && !hash_table_find(db->table, key);
+        int status = hash_table_put(db->table, key, value, value_size);
+        if (added && status == SUCCESS) {
+            hash_entry_t* entry = hash_table_find(db->table, key);
+            for (db_index_t* index = db->indexes; index; index = index->next) {
+                if (index->btree) {
+                    btree_insert(index->btree, entry);
+                }
+            }
+        }
+        return status;
+    }
+    for (db_index_t* index = db->indexes; index; index = index->next) {
+        if (index->btree) {
+            btree_delete(index->btree, key);
+        }
+    }
+    return hash_table_delete(db->table, key);
+}
+
+// Look a key up as of snapshot under the read lock; value and value_size
+// may be NULL to test existence. Snapshot readers only come here, pinned,
+// when a resize kept them from searching without it. In LSM mode the
+// memtables are searched under the read lock and the tables after it is
+// released, holding a reference to the current version; later writes only
+// reach the memtable, so the answer still holds.
+static int engine_get(database_t* db, const char* key, uint64_t snapshot, void** value, size_t* value_size) {
+    pthread_rwlock_rdlock(&db->lock);
+    const mvcc_chain_t* chain = snapshot != READ_LATEST ? mvcc_find(&db->versions, key) : NULL;
+    if (chain) {
+        int result = mvcc_read(chain, snapshot, value, value_size);
+        pthread_rwlock_unlock(&db->lock);
+        return result;
+    }
+    if (db->config.engine != DATABASE_ENGINE_LSM) {
+        int result = hash_table_get(db->table, key, value, value_size);
+        pthread_rwlock_unlock(&db->lock);
+        return result;
+    }
+    
+    const mem_node_t* node = memtable_find(db->mem, key);
+    if (!node && db->imm) {
+        node = memtable_find(db->imm, key);
+    }
+    if (node) {
+        int result = ERROR_NOT_FOUND;
+        if (node->type == WAL_ENTRY_PUT) {
+            copy_value(node->value, node->value_size, value, value_size);
+            result = SUCCESS;
+        }
+        pthread_rwlock_unlock(&db->lock);
+        return result;
+    }
+    lsm_version_t* version = db->version;
+    version_ref(version);
+    pthread_rwlock_unlock(&db->lock);
+    
+    lookup_result_t found = version_get(db, version, key, value, value_size);
+    version_unref(version);
+    if (found == LOOKUP_ERROR) {
+        return ERROR_IO;
+    }
+    return found == LOOKUP_FOUND ? SUCCESS : ERROR_NOT_FOUND;
+}
+
+// The engine's value of a key that had no chain, read without db->lock for
+// engine_get_snapshot. The version store is searched again before the value
+// is used: a chain found now means a write raced the read, and the chain
+// holds the snapshot's value.
+static int engine_read_unlocked(database_t* db, const char* key, uint64_t snapshot, void** value, size_t* value_size) {
+    const void* data = NULL;
+    size_t size = 0;
+    int result = ERROR_NOT_FOUND;
+    bool copied = false;       // Already in *value
+    if (db->config.engine != DATABASE_ENGINE_LSM) {
+        hash_entry_t* entry = NULL;
+        if (!hash_table_lookup(db->table, key, &entry)) {
+            return engine_get(db, key, snapshot, value, value_size);
+        }
+        if (entry) {
+            data = __atomic_load_n(&entry->value, __ATOMIC_ACQUIRE);
+            size = __atomic_load_n(&entry->value_size, __ATOMIC_ACQUIRE);
+            result = SUCCESS;
+        }
+    } else {
+        // mem before imm: a switch stores imm first, and a flush clears imm
+        // only after installing the version that holds it
+        const mem_node_t* node = memtable_find(__atomic_load_n(&db->mem, __ATOMIC_ACQUIRE), key);
+        memtable_t* imm = __atomic_load_n(&db->imm, __ATOMIC_ACQUIRE);
+        if (!node && imm) {
+            node = memtable_find(imm, key);
+        }
+        if (node) {
+            data = node->value;
+            size = node->value_size;
+            result = node->type == WAL_ENTRY_PUT ? SUCCESS : ERROR_NOT_FOUND;
+        } else {
+            lsm_version_t* version = __atomic_load_n(&db->version, __ATOMIC_ACQUIRE);
+            version_ref(version);
+            lookup_result_t found = version_get(db, version, key, value, value_size);
+            version_unref(version);
+            result = found == LOOKUP_FOUND ? SUCCESS : found == LOOKUP_ERROR ? ERROR_IO : ERROR_NOT_FOUND;
+            copied = true;
+        }
+    }
+    
+    const mvcc_chain_t* chain = NULL;
+    if (!mvcc_lookup(&db->versions, key, &chain) || chain) {
+        if (copied && result == SUCCESS && value) {
+            safe_free(value);
+        }
+        return chain ? mvcc_read(chain, snapshot, value, value_size) : engine_get(db, key, snapshot, value, value_size);
+    }
+    if (result == SUCCESS && !copied) {
+        copy_value(data, size, value, value_size);
+    }
+    return result;
+}
+
+// Snapshot reads take no lock. A key with a chain in the version store is
+// answered from it; any other key has not changed since the snapshot began,
+// so the engine's value is the one to read. A commit completes the key's
+// chain before it touches the engine, which engine_read_unlocked relies on.
+// An epoch is pinned throughout, so nothing reached is freed meanwhile.
+static int engine_get_snapshot(database_t* db, const char* key, uint64_t snapshot, void** value, size_t* value_size) {
+    unsigned pin = epoch_enter(&db->epoch);
+    const mvcc_chain_t* chain = NULL;
+    int result;
+    if (!mvcc_lookup(&db->versions, key, &chain)) {
+        result = engine_get(db, key, snapshot, value, value_size);
+    } else if (chain) {
+        result = mvcc_read(chain, snapshot, value, value_size);
+    } else {
+        result = engine_read_unlocked(db, key, snapshot, value, value_size);
+    }
+    epoch_exit(&db->epoch, pin);
+    return result;
+}
+
+// =============================================================================
+// Database lifecycle
+// =============================================================================
+
+database_t* database_create(const char* data_dir) {
+    return database_create_with_config(data_dir, NULL);
+}
+
+database_t* database_create_with_config(const char* data_dir, const database_config_t* config) {
+    if (!data_dir) return NULL;
+    
+    database_t* db = safe_calloc(1, sizeof(database_t));
+    db->data_dir = safe_strdup(data_dir);
+    if (config) {
+        db->config = *config;
+    } else {
+        db->config.wal_batch_delay_us = DEFAULT_WAL_BATCH_DELAY_US;
+    }
+    if (db->config.wal_batch_max_bytes == 0) {
+        db->config.wal_batch_max_bytes = DEFAULT_WAL_BATCH_MAX_BYTES;
+    }
+    if (db->config.snapshot_wal_bytes == 0) {
+        db->config.snapshot_wal_bytes = DEFAULT_SNAPSHOT_WAL_BYTES;
+    }
+    if (db->config.memtable_bytes == 0) {
+        db->config.memtable_bytes = DEFAULT_MEMTABLE_BYTES;
+    }
+    if (db->config.sstable_block_size == 0) {
+        db->config.sstable_block_size = DEFAULT_SSTABLE_BLOCK_SIZE;
+    }
+    if (db->config.level0_compaction_trigger == 0) {
+        db->config.level0_compaction_trigger = DEFAULT_LEVEL0_COMPACTION_TRIGGER;
+    }
+    if (db->config.level1_max_bytes == 0) {
+        db->config.level1_max_bytes = DEFAULT_LEVEL1_MAX_BYTES;
+    }
+    if (db->config.bloom_bits_per_key == 0) {
+        db->config.bloom_bits_per_key = DEFAULT_BLOOM_BITS_PER_KEY;
+    }
+    if (db->config.block_cache_bytes == 0) {
+        db->config.block_cache_bytes = DEFAULT_BLOCK_CACHE_BYTES;
+    }
+    if (db->config.engine == DATABASE_ENGINE_LSM) {
+        db->block_cache = block_cache_create(db->config.block_cache_bytes);
+    }
+    db->table = hash_table_create(1024);
+    db->table->db = db;
+    db->mem = memtable_create();
+    db->version = version_create();
+    db->wal_fd = -1;
+    pthread_rwlock_init(&db->lock, NULL);
+    pthread_mutex_init(&db->commit_lock, NULL);
+    pthread_mutex_init(&db->wal_lock, NULL);
+    pthread_cond_init(&db->wal_pending, NULL);
+    pthread_cond_init(&db->wal_synced, NULL);
+    pthread_mutex_init(&db->snapshot_lock, NULL);
+    pthread_cond_init(&db->snapshot_wanted, NULL);
+    pthread_cond_init(&db->snapshot_done, NULL);
+    pthread_mutex_init(&db->lsm_lock, NULL);
+    pthread_cond_init(&db->lsm_work, NULL);
+    pthread_cond_init(&db->lsm_done, NULL);
+    pthread_mutex_init(&db->versions_lock, NULL);
+    epoch_init(&db->epoch);
+    pthread_mutex_init(&db->mvcc_lock, NULL);
+    pthread_cond_init(&db->mvcc_gc_wanted, NULL);
+    db->next_txn_id = 1;
+    return db;
+}
+
+void database_destroy(database_t* db) {
+    if (!db) return;
+    
+    if (db->is_open) {
+        database_close(db);
+    }
+    
+    while (db->indexes) {
+        db_index_t* index = db->indexes;
+        db->indexes = index->next;
+        btree_destroy(index->btree);
+        safe_free((void**)&index->name);
+        safe_free((void**)&index);
+    }
+    safe_free((void**)&db->data_dir);
+    epoch_destroy(&db->epoch);  // Retired versions may still use the block cache
+    hash_table_destroy(db->table);
+    pthread_rwlock_destroy(&db->lock);
+    pthread_mutex_destroy(&db->commit_lock);
+    safe_free((void**)&db->wal_buffer.data);
+    safe_free((void**)&db->wal_flushing.data);
+    pthread_mutex_destroy(&db->wal_lock);
+    pthread_cond_destroy(&db->wal_pending);
+    pthread_cond_destroy(&db->wal_synced);
+    pthread_mutex_destroy(&db->snapshot_lock);
+    pthread_cond_destroy(&db->snapshot_wanted);
+    pthread_cond_destroy(&db->snapshot_done);
+    memtable_destroy(db->mem);
+    memtable_destroy(db->imm);
+    version_unref(db->version);
+    block_cache_destroy(db->block_cache);
+    for (int level = 0; level < LSM_MAX_LEVELS; level++) {
+        safe_free((void**)&db->compact_pointer[level]);
+    }
+    pthread_mutex_destroy(&db->lsm_lock);
+    pthread_cond_destroy(&db->lsm_work);
+    pthread_cond_destroy(&db->lsm_done);
+    mvcc_table_clear(&db->versions);
+    pthread_mutex_destroy(&db->versions_lock);
+    pthread_mutex_destroy(&db->mvcc_lock);
+    pthread_cond_destroy(&db->mvcc_gc_wanted);
+    safe_free((void**)&db);
+}
+
+int database_open(database_t* db) {
+    if (!db || db->is_open) return ERROR_INVALID_PARAM;
+    
+    // Create data directory
+    mkdir(db->data_dir, 0755);
+    
+    // Load the snapshot or table manifest and replay the WAL after it;
+    // leaves the last segment open for appending
+    int status = database_recover(db);
+    if (status != SUCCESS) {
+        return status;
+    }
+    
+    db->wal_error = SUCCESS;
+    db->wal_appended = db->wal_durable = 0;
+    if (pthread_create(&db->committer, NULL, wal_committer_main, db) != 0) {
+        close(db->wal_fd);
+        db->wal_fd = -1;
+        return ERROR_MEMORY;
+    }
+    db->committer_running = true;
+    
+    // The hash engine is persisted by snapshots, the LSM engine by flushes
+    int created;
+    if (db->config.engine == DATABASE_ENGINE_LSM) {
+        db->lsm_flush_pending = false;
+        db->lsm_requested = db->lsm_served = 0;
+        db->lsm_error = SUCCESS;
+        created = pthread_create(&db->lsm_thread, NULL, lsm_main, db);
+        db->lsm_running = created == 0;
+    } else {
+        db->snapshot_requested = db->snapshot_started = db->snapshot_completed = 0;
+        created = pthread_create(&db->snapshotter, NULL, snapshot_main, db);
+        db->snapshotter_running = created == 0;
+    }
+    if (created == 0) {
+        db->mvcc_gc_requested = false;
+        created = pthread_create(&db->mvcc_gc, NULL, mvcc_gc_main, db);
+        db->mvcc_gc_running = created == 0;
+        if (created != 0) {
+            snapshot_thread_stop(db);
+            lsm_thread_stop(db);
+        }
+    }
+    if (created != 0) {
+        wal_committer_stop(db);
+        close(db->wal_fd);
+        db->wal_fd = -1;
+        return ERROR_MEMORY;
+    }
+    
+    db->is_open = 1;
+    return SUCCESS;
+}
+
+int database_close(database_t* db) {
+    if (!db || !db->is_open) return ERROR_INVALID_PARAM;
+    
+    // Persist the table so the next open starts from a snapshot or from
+    // tables, without WAL to replay
+    database_checkpoint(db);
+    mvcc_gc_stop(db);
+    snapshot_thread_stop(db);
+    lsm_thread_stop(db);
+    wal_committer_stop(db);
+    epoch_advance(&db->epoch);  // With no reader left, two advances release everything retired
+    epoch_advance(&db->epoch);
+    
+    if (db->wal_fd >= 0) {
+        close(db->wal_fd);
+        db->wal_fd = -1;
+    }
+    
+    db->is_open = 0;
+    return SUCCESS;
+}
+
+int database_put(database_t* db, const char* key, const void* value, size_t value_size) {
+    if (!db || !key || !value || value_size == 0) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    int status = db_write_begin(db, NULL);
+    if (status != SUCCESS) {
+        return status;
+    }
+    
+    // Queue for the WAL; the sync happens after the lock is released so
+    // other writers can join the same batch
+    uint64_t position = 0;
+    if (db->committer_running) {
+        position = wal_append(db, WAL_ENTRY_PUT, 0, key, value, value_size);  // Non-transactional
+    }
+    
+    db->commit_ts++;
+    int result = engine_apply(db, WAL_ENTRY_PUT, key, value, value_size);
+    
+    db_write_end(db);
+    
+    if (position > 0) {
+        status = wal_wait(db, position);
+        if (status != SUCCESS) {
+            return status;
+        }
+    }
+    return result;
+}
+
+int database_get(database_t* db, const char* key, void** value, size_t* value_size) {
+    if (!db || !key) return ERROR_INVALID_PARAM;
+    
+    return engine_get(db, key, READ_LATEST, value, value_size);
+}
+
+int database_delete(database_t* db, const char* key) {
+    if (!db || !key) return ERROR_INVALID_PARAM;
+    
+    // The LSM engine writes a tombstone rather than removing anything, so
+    // check first that there is a key to delete
+    int status;
+    if (db->config.engine == DATABASE_ENGINE_LSM) {
+        status = engine_get(db, key, READ_LATEST, NULL, NULL);
+        if (status != SUCCESS) {
+            return status;
+        }
+    }
+    
+    status = db_write_begin(db, NULL);
+    if (status != SUCCESS) {
+        return status;
+    }
+    
+    uint64_t position = 0;
+    if (db->committer_running) {
+        position = wal_append(db, WAL_ENTRY_DELETE, 0, key, NULL, 0);
+    }
+    
+    db->commit_ts++;
+    int result = engine_apply(db, WAL_ENTRY_DELETE, key, NULL, 0);
+    
+    db_write_end(db);
+    
+    if (position > 0) {
+        status = wal_wait(db, position);
+        if (status != SUCCESS) {
+            return status;
+        }
+    }
+    return result;
+}
+
+int database_exists(database_t* db, const char* key) {
+    if (!db || !key) return 0;
+    
+    return engine_get(db, key, READ_LATEST, NULL, NULL) == SUCCESS;
+}
+
+transaction_t* database_begin_transaction(database_t* db, isolation_level_t level) {
     if (!db) return NULL;
     
     transaction_t* txn = safe_calloc(1, sizeof(transaction_t));
     txn->db = db;
     txn->level = level;
     txn->writes = hash_table_create(64);
+    txn->deletes = hash_table_create(16);
+    txn->snapshot = READ_LATEST;
+    if (level == ISOLATION_SERIALIZABLE) {
+        txn->reads = hash_table_create(64);
+    }
     
     pthread_rwlock_wrlock(&db->lock);
     txn->txn_id = db->next_txn_id++;
+    if (level >= ISOLATION_REPEATABLE_READ) {
+        mvcc_snapshot_begin(db, txn);
+    }
     pthread_rwlock_unlock(&db->lock);
     
     return txn;
 }
 
-int transaction_commit(transaction_t* txn) {
-    if (!txn || txn->committed) return ERROR_INVALID_PARAM;
+static void transaction_free(transaction_t* txn) {
+    mvcc_snapshot_end(txn->db, txn);
+    hash_table_destroy(txn->writes);
+    hash_table_destroy(txn->deletes);
+    hash_table_destroy(txn->reads);
+    safe_free((void**)&txn);
+}
+
+// =============================================================================
+// Write batches
+// =============================================================================
+
+database_write_batch_t* database_write_batch_create(void) {
+    return safe_calloc(1, sizeof(database_write_batch_t));
+}
+
+void database_write_batch_destroy(database_write_batch_t* batch) {
+    if (!batch) return;
     
-    database_t* db = txn->db;
+    safe_free((void**)&batch->ops.data);
+    safe_free((void**)&batch);
+}
+
+void database_write_batch_clear(database_write_batch_t* batch) {
+    if (!batch) return;
     
-    pthread_rwlock_wrlock(&db->lock);
+    batch->ops.size = 0;
+    batch->ops.records = 0;
+}
+
+size_t database_write_batch_count(const database_write_batch_t* batch) {
+    return batch ? batch->ops.records : 0;
+}
+
+static int write_batch_add(database_write_batch_t* batch, wal_entry_type_t type, const char* key,
+                           const void* value, size_t value_size) {
+    wal_batch_op_t op;
+    memset(&op, 0, sizeof(op));
+    op.type = type;
+    op.key_size = (uint32_t)strlen(key) + 1;
+    op.value_size = (uint32_t)value_size;
+    if (op.key_size > MAX_KEY_SIZE) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (batch->ops.size + sizeof(op) + op.key_size + value_size > MAX_BATCH_SIZE) {
+        return ERROR_FULL;
+    }
+    wal_buffer_append(&batch->ops, &op, sizeof(op));
+    wal_buffer_append(&batch->ops, key, op.key_size);
+    if (value_size > 0) {
+        wal_buffer_append(&batch->ops, value, value_size);
+    }
+    batch->ops.records++;
+    return SUCCESS;
+}
+
+int database_write_batch_put(database_write_batch_t* batch, const char* key, const void* value, size_t value_size) {
+    if (!batch || !key || !value || value_size == 0) {
+        return ERROR_INVALID_PARAM;
+    }
+    return write_batch_add(batch, WAL_ENTRY_PUT, key, value, value_size);
+}
+
+int database_write_batch_delete(database_write_batch_t* batch, const char* key) {
+    if (!batch || !key) return ERROR_INVALID_PARAM;
     
-    // Apply all writes from transaction
-    for (size_t i = 0; i < txn->writes->bucket_count; i++) {
-        hash_entry_t* entry = txn->writes->buckets[i];
-        while (entry) {
-            hash_table_put(db->table, entry->key, entry->value, entry->value_size);
-            entry = entry->next;
+    return write_batch_add(batch, WAL_ENTRY_DELETE, key, NULL, 0);
+}
+
+// Apply encoded operations in order; the caller checked them. Deleting a
+// missing key is not an error inside a batch.
+static int write_batch_apply(database_t* db, const char* ops, size_t size) {
+    int status = SUCCESS;
+    size_t offset = 0;
+    while (offset < size) {
+        wal_batch_op_t op;
+        memcpy(&op, ops + offset, sizeof(op));
+        const char* key = ops + offset + sizeof(op);
+        int result = engine_apply(db, op.type, key, key + op.key_size, op.value_size);
+        if (result != SUCCESS && result != ERROR_NOT_FOUND) {
+            status = result;
         }
+        offset += sizeof(op) + op.key_size + op.value_size;
+    }
+    return status;
+}
+
+// Log a batch as one record and apply it under one hold of the write lock,
+// at one commit timestamp. A snapshot transaction is validated first, before
+// the write lock is taken, so a conflicting commit logs nothing.
+static int write_batch_commit(database_t* db, const database_write_batch_t* batch, transaction_t* txn) {
+    int status = db_write_begin(db, txn);
+    if (status != SUCCESS) {
+        return status;
     }
     
-    txn->committed = 1;
+    uint64_t position = 0;
+    if (db->committer_running) {
+        position = wal_append_record(db, WAL_ENTRY_BATCH, txn ? txn->txn_id : 0, NULL, 0,
+                                     batch->ops.data, batch->ops.size);
+    }
+    db->commit_ts++;
+    int result = write_batch_apply(db, batch->ops.data, batch->ops.size);
     
-    pthread_rwlock_unlock(&db->lock);
+    db_write_end(db);
     
-    hash_table_destroy(txn->writes);
-    safe_free((void**)&txn);
+    if (position > 0) {
+        status = wal_wait(db, position);
+        if (status != SUCCESS) {
+            return status;
+        }
+    }
+    return result;
+}
+
+int database_write_batch(database_t* db, const database_write_batch_t* batch) {
+    if (!db || !batch) return ERROR_INVALID_PARAM;
+    if (batch->ops.records == 0) return SUCCESS;
     
-    return SUCCESS;
+    return write_batch_commit(db, batch, NULL);
+}
+
+// The write set is committed as one write batch. Snapshot transactions are
+// validated first: a key written since the snapshot (or for serializable
+// ones, read and then changed) means another transaction committed first,
+// and this one is rolled back. All writes share one commit timestamp, so
+// snapshots see all of them or none.
+int transaction_commit(transaction_t* txn) {
+    if (!txn || txn->committed) return ERROR_INVALID_PARAM;
+    
+    database_write_batch_t batch;
+    memset(&batch, 0, sizeof(batch));
+    int status = SUCCESS;
+    for (size_t i = 0; i < txn->writes->bucket_count && status == SUCCESS; i++) {
+        for (hash_entry_t* entry = txn->writes->buckets[i]; entry && status == SUCCESS; entry = entry->next) {
+            status = write_batch_add(&batch, WAL_ENTRY_PUT, entry->key, entry->value, entry->value_size);
+        }
+    }
+    for (size_t i = 0; i < txn->deletes->bucket_count && status == SUCCESS; i++) {
+        for (hash_entry_t* entry = txn->deletes->buckets[i]; entry && status == SUCCESS; entry = entry->next) {
+            status = write_batch_add(&batch, WAL_ENTRY_DELETE, entry->key, NULL, 0);
+        }
+    }
+    if (status == SUCCESS && batch.ops.records > 0) {
+        status = write_batch_commit(txn->db, &batch, txn);
+    }
+    safe_free((void**)&batch.ops.data);
+    
+    txn->committed = 1;
+    transaction_free(txn);
+    
+    return status;
 }
 
 int transaction_rollback(transaction_t* txn) {
     if (!txn) return ERROR_INVALID_PARAM;
     
-    hash_table_destroy(txn->writes);
-    safe_free((void**)&txn);
+    transaction_free(txn);
     
     return SUCCESS;
 }
 
 int transaction_put(transaction_t* txn, const char* key, const void* value, size_t value_size) {
     if (!txn || !key || !value) return ERROR_INVALID_PARAM;
+    hash_table_delete(txn->deletes, key);
     return hash_table_put(txn->writes, key, value, value_size);
 }
 
@@ -382,80 +4388,533 @@ int transaction_get(transaction_t* txn, const char* key, void** value, size_t* v
     // Check local writes first
     int result = hash_table_get(txn->writes, key, value, value_size);
     if (result == SUCCESS) return SUCCESS;
+    if (hash_table_find(txn->deletes, key)) return ERROR_NOT_FOUND;
     
-    // Fall back to database
-    return database_get(txn->db, key, value, value_size);
+    // Fall back to database, as of the snapshot if there is one
+    if (txn->reads) {
+        char present = 1;
+        hash_table_put(txn->reads, key, &present, sizeof(present));
+    }
+    if (txn->snapshot != READ_LATEST) {
+        return engine_get_snapshot(txn->db, key, txn->snapshot, value, value_size);
+    }
+    return engine_get(txn->db, key, READ_LATEST, value, value_size);
 }
 
+// Deletes are buffered like puts and applied at commit
 int transaction_delete(transaction_t* txn, const char* key) {
     if (!txn || !key) return ERROR_INVALID_PARAM;
-    return hash_table_delete(txn->writes, key);
+    hash_table_delete(txn->writes, key);
+    char deleted = 1;
+    return hash_table_put(txn->deletes, key, &deleted, sizeof(deleted));
 }
 
 int database_create_index(database_t* db, const char* index_name, index_type_t type) {
-    // Placeholder for index creation
-    (void)db;
-    (void)index_name;
-    (void)type;
+    if (!db || !index_name || (type != INDEX_BTREE && type != INDEX_HASH)) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    pthread_rwlock_wrlock(&db->lock);
+    for (db_index_t* index = db->indexes; index; index = index->next) {
+        if (strcmp(index->name, index_name) == 0) {
+            pthread_rwlock_unlock(&db->lock);
+            return ERROR_ALREADY_EXISTS;
+        }
+    }
+    
+    db_index_t* index = safe_calloc(1, sizeof(db_index_t));
+    index->name = safe_strdup(index_name);
+    index->type = type;
+    if (type == INDEX_BTREE && db->config.engine != DATABASE_ENGINE_LSM) {
+        index->btree = index_build(db);
+    }
+    index->next = db->indexes;
+    db->indexes = index;
+    pthread_rwlock_unlock(&db->lock);
     return SUCCESS;
 }
 
 int database_drop_index(database_t* db, const char* index_name) {
-    // Placeholder for index removal
-    (void)db;
-    (void)index_name;
-    return SUCCESS;
+    if (!db || !index_name) return ERROR_INVALID_PARAM;
+    
+    pthread_rwlock_wrlock(&db->lock);
+    for (db_index_t** link = &db->indexes; *link; link = &(*link)->next) {
+        db_index_t* index = *link;
+        if (strcmp(index->name, index_name) == 0) {
+            *link = index->next;
+            pthread_rwlock_unlock(&db->lock);
+            btree_destroy(index->btree);
+            safe_free((void**)&index->name);
+            safe_free((void**)&index);
+            return SUCCESS;
+        }
+    }
+    pthread_rwlock_unlock(&db->lock);
+    return ERROR_NOT_FOUND;
+}
+
+// =============================================================================
+// Range scans
+// =============================================================================
+
+// One version of a key seen by an LSM scan
+typedef struct {
+    char* key;
+    uint64_t seq;
+    uint32_t type;
+} scan_record_t;
+
+static int compare_scan_records(const void* a, const void* b) {
+    const scan_record_t* left = a;
+    const scan_record_t* right = b;
+    int cmp = strcmp(left->key, right->key);
+    if (cmp != 0) {
+        return cmp;
+    }
+    return left->seq > right->seq ? -1 : left->seq < right->seq;
+}
+
+static bool scan_before_end(const database_iterator_t* it, const char* key) {
+    return !it->end || strcmp(key, it->end) < 0;
+}
+
+static void scan_add_key(database_iterator_t* it, const char* key) {
+    wal_buffer_append(&it->batch, key, strlen(key) + 1);
+    it->batch.records++;
+}
+
+static void scan_resume_after(database_iterator_t* it, const char* key) {
+    char* resume = safe_strdup(key);
+    safe_free((void**)&it->resume);
+    it->resume = resume;
+    it->resume_after = true;
+}
+
+// A source that stopped early has only been read up to its last key, so
+// the batch can only hand out keys up to the first such stop
+static void scan_limit(char** bound, const char* key) {
+    if (!*bound || strcmp(key, *bound) < 0) {
+        safe_free((void**)bound);
+        *bound = safe_strdup(key);
+    }
+}
+
+// Without a B-tree the whole table is walked and the range sorted at once
+static void scan_fill_walk(database_iterator_t* it) {
+    size_t count = 0;
+    size_t kept = 0;
+    char** keys = snapshot_collect_keys(it->db, &count);
+    for (size_t i = 0; i < count; i++) {
+        int cmp = it->resume ? strcmp(keys[i], it->resume) : 1;
+        if ((cmp > 0 || (cmp == 0 && !it->resume_after)) && scan_before_end(it, keys[i])) {
+            keys[kept++] = keys[i];
+        } else {
+            safe_free((void**)&keys[i]);
+        }
+    }
+    qsort(keys, kept, sizeof(char*), compare_keys);
+    for (size_t i = 0; i < kept; i++) {
+        scan_add_key(it, keys[i]);
+        safe_free((void**)&keys[i]);
+    }
+    safe_free((void**)&keys);
+    it->done = true;
+}
+
+// Copy the next keys from the leaf chain; called with db->lock held
+static void scan_fill_btree(database_iterator_t* it, const btree_t* tree) {
+    uint32_t index;
+    const char* key = NULL;
+    const btree_node_t* leaf = btree_seek(tree, it->resume ? it->resume : "", it->resume_after, &index);
+    while (it->batch.records < SCAN_BATCH_KEYS) {
+        if (index == leaf->count) {
+            leaf = leaf->next;
+            index = 0;
+            if (!leaf) {
+                it->done = true;
+                return;
+            }
+            continue;
+        }
+        key = ((const hash_entry_t*)leaf->slots[index++].ref)->key;
+        if (!scan_before_end(it, key)) {
+            it->done = true;
+            return;
+        }
+        scan_add_key(it, key);
+    }
+    scan_resume_after(it, key);
+}
+
+// Read up to a batch of versions from a memtable; called with db->lock held
+static void scan_read_memtable(database_iterator_t* it, const memtable_t* mem, wal_buffer_t* records, char** bound) {
+    size_t read = 0;
+    const mem_node_t* node = memtable_seek(mem, it->resume, it->resume_after);
+    for (; node && scan_before_end(it, node->key); node = node->next[0]) {
+        if (read == SCAN_BATCH_KEYS) {
+            scan_limit(bound, ((const scan_record_t*)(records->data + records->size))[-1].key);
+            return;
+        }
+        scan_record_t record = { safe_strdup(node->key), node->seq, node->type };
+        wal_buffer_append(records, &record, sizeof(record));
+        read++;
+    }
+}
+
+// Read up to a batch of entries from tables sorted by key, stopping early
+// past a bound another source already set
+static int scan_read_tables(database_iterator_t* it, sst_file_t** files, size_t file_count,
+                            wal_buffer_t* records, char** bound) {
+    sst_iter_t iter;
+    sst_iter_seek(&iter, files, file_count, it->resume, it->resume_after);
+    size_t read = 0;
+    for (; iter.valid && scan_before_end(it, iter.key); sst_iter_next(&iter)) {
+        if (*bound && strcmp(iter.key, *bound) > 0) {
+            break;
+        }
+        if (read == SCAN_BATCH_KEYS) {
+            scan_limit(bound, ((const scan_record_t*)(records->data + records->size))[-1].key);
+            break;
+        }
+        scan_record_t record = { safe_strdup(iter.key), iter.entry.seq, iter.entry.type };
+        wal_buffer_append(records, &record, sizeof(record));
+        read++;
+    }
+    int status = iter.status;
+    sst_iter_close(&iter);
+    return status;
+}
+
+// Merge a batch from the memtables and every table of a pinned version. The
+// newest version of each key wins, and keys whose newest version is a
+// tombstone are skipped.
+static void scan_fill_lsm(database_iterator_t* it) {
+    database_t* db = it->db;
+    wal_buffer_t records;
+    memset(&records, 0, sizeof(records));
+    char* bound = NULL;
+    
+    pthread_rwlock_rdlock(&db->lock);
+    scan_read_memtable(it, db->mem, &records, &bound);
+    if (db->imm) {
+        scan_read_memtable(it, db->imm, &records, &bound);
+    }
+    lsm_version_t* version = db->version;
+    version_ref(version);
+    pthread_rwlock_unlock(&db->lock);
+    
+    int status = SUCCESS;
+    for (size_t i = 0; i < version->counts[0] && status == SUCCESS; i++) {
+        status = scan_read_tables(it, &version->files[0][i], 1, &records, &bound);
+    }
+    for (int level = 1; level < LSM_MAX_LEVELS && status == SUCCESS; level++) {
+        status = scan_read_tables(it, version->files[level], version->counts[level], &records, &bound);
+    }
+    version_unref(version);
+    
+    scan_record_t* record = (scan_record_t*)records.data;
+    size_t record_count = records.size / sizeof(scan_record_t);
+    qsort(record, record_count, sizeof(scan_record_t), compare_scan_records);
+    for (size_t i = 0; i < record_count && status == SUCCESS; i++) {
+        bool newest = i == 0 || strcmp(record[i].key, record[i - 1].key) != 0;
+        if (newest && record[i].type == WAL_ENTRY_PUT && (!bound || strcmp(record[i].key, bound) <= 0)) {
+            scan_add_key(it, record[i].key);
+        }
+    }
+    for (size_t i = 0; i < record_count; i++) {
+        safe_free((void**)&record[i].key);
+    }
+    safe_free((void**)&records.data);
+    
+    it->status = status;
+    if (bound) {
+        scan_resume_after(it, bound);
+        safe_free((void**)&bound);
+    } else {
+        it->done = true;
+    }
+}
+
+static void scan_fill(database_iterator_t* it) {
+    it->batch.size = it->batch.records = 0;
+    it->position = 0;
+    
+    if (it->db->config.engine == DATABASE_ENGINE_LSM) {
+        scan_fill_lsm(it);
+        return;
+    }
+    pthread_rwlock_rdlock(&it->db->lock);
+    const btree_t* tree = index_find_btree(it->db);
+    if (tree) {
+        scan_fill_btree(it, tree);
+    }
+    pthread_rwlock_unlock(&it->db->lock);
+    if (!tree) {
+        scan_fill_walk(it);
+    }
+}
+
+database_iterator_t* database_scan(database_t* db, const char* start, const char* end) {
+    if (!db) return NULL;
+    
+    database_iterator_t* it = safe_calloc(1, sizeof(database_iterator_t));
+    it->db = db;
+    it->resume = start ? safe_strdup(start) : NULL;
+    it->end = end ? safe_strdup(end) : NULL;
+    it->status = SUCCESS;
+    return it;
+}
+
+bool database_iterator_next(database_iterator_t* it) {
+    if (!it) return false;
+    
+    while (it->position == it->batch.size) {
+        if (it->done || it->status != SUCCESS) {
+            it->key = NULL;
+            return false;
+        }
+        scan_fill(it);
+    }
+    it->key = it->batch.data + it->position;
+    it->position += strlen(it->key) + 1;
+    return true;
+}
+
+const char* database_iterator_key(const database_iterator_t* it) {
+    return it ? it->key : NULL;
+}
+
+// The value is looked up now, so a key deleted since it was read is not found
+int database_iterator_value(database_iterator_t* it, void** value, size_t* value_size) {
+    if (!it || !it->key) return ERROR_INVALID_PARAM;
+    
+    return engine_get(it->db, it->key, READ_LATEST, value, value_size);
+}
+
+int database_iterator_status(const database_iterator_t* it) {
+    return it ? it->status : ERROR_INVALID_PARAM;
+}
+
+void database_iterator_close(database_iterator_t* it) {
+    if (!it) return;
+    
+    safe_free((void**)&it->batch.data);
+    safe_free((void**)&it->resume);
+    safe_free((void**)&it->end);
+    safe_free((void**)&it);
 }
 
+// Write a snapshot on the background thread, or in LSM mode flush the
+// memtable to a table, and wait for it; the WAL segments covered are deleted
 int database_checkpoint(database_t* db) {
-    if (!db || db->wal_fd < 0) return ERROR_INVALID_PARAM;
+    if (!db) return ERROR_INVALID_PARAM;
+    if (db->config.engine == DATABASE_ENGINE_LSM) {
+        return db->lsm_running ? lsm_flush(db) : ERROR_INVALID_PARAM;
+    }
+    if (!db->snapshotter_running) return ERROR_INVALID_PARAM;
+    
+    uint64_t request = snapshot_request(db, true);
+    pthread_mutex_lock(&db->snapshot_lock);
+    while (db->snapshot_completed < request) {
+        pthread_cond_wait(&db->snapshot_done, &db->snapshot_lock);
+    }
+    int status = db->snapshot_status;
+    pthread_mutex_unlock(&db->snapshot_lock);
+    return status;
+}
+
+// Whether a batch record's body parses as whole operations
+static bool wal_batch_check(const char* ops, size_t size) {
+    size_t offset = 0;
+    while (offset < size) {
+        wal_batch_op_t op;
+        if (size - offset < sizeof(op)) {
+            return false;
+        }
+        memcpy(&op, ops + offset, sizeof(op));
+        offset += sizeof(op);
+        if ((op.type != WAL_ENTRY_PUT && op.type != WAL_ENTRY_DELETE) || op.key_size == 0 ||
+            op.key_size > MAX_KEY_SIZE || (uint64_t)op.key_size + op.value_size > size - offset ||
+            ops[offset + op.key_size - 1] != '\0') {
+            return false;
+        }
+        offset += op.key_size + op.value_size;
+    }
+    return true;
+}
+
+// Length of the valid record at data, or 0 if it is torn or corrupt
+static size_t wal_record_check(const char* data, size_t available) {
+    wal_frame_t frame;
+    wal_entry_t header;
+    if (available < sizeof(frame) + sizeof(header)) {
+        return 0;
+    }
+    memcpy(&frame, data, sizeof(frame));
+    if (frame.length < sizeof(header) || frame.length > available - sizeof(frame)) {
+        return 0;
+    }
     
-    // Truncate WAL after checkpoint
-    if (ftruncate(db->wal_fd, 0) < 0) {
-        perror("ftruncate failed");
+    const char* body = data + sizeof(frame);
+    if (crc32c_extend(0, body, frame.length) != frame.crc) {
+        return 0;
+    }
+    memcpy(&header, body, sizeof(header));
+    if (header.type == WAL_ENTRY_BATCH) {
+        if (header.key_size != 0 || (uint64_t)sizeof(header) + header.value_size != frame.length ||
+            !wal_batch_check(body + sizeof(header), header.value_size)) {
+            return 0;
+        }
+        return sizeof(frame) + frame.length;
+    }
+    if (header.key_size == 0 || header.key_size > MAX_KEY_SIZE ||
+        (uint64_t)sizeof(header) + header.key_size + header.value_size != frame.length ||
+        body[sizeof(header) + header.key_size - 1] != '\0') {
+        return 0;
+    }
+    return sizeof(frame) + frame.length;
+}
+
+// Replays one segment from a sequential mapping, stopping at the first torn
+// or corrupt record and truncating the file there; *truncated is the number
+// of bytes dropped
+static int wal_replay_segment(database_t* db, const char* path, uint64_t* truncated) {
+    *truncated = 0;
+    int fd = open(path, O_RDWR);
+    if (fd < 0) {
+        return ERROR_IO;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
         return ERROR_IO;
     }
+    size_t file_size = (size_t)st.st_size;
+    if (file_size == 0) {
+        close(fd);
+        return SUCCESS;
+    }
     
-    if (lseek(db->wal_fd, 0, SEEK_SET) < 0) {
-        perror("lseek failed");
+    char* data = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
         return ERROR_IO;
     }
+    posix_madvise(data, file_size, POSIX_MADV_SEQUENTIAL);
     
-    return SUCCESS;
+    size_t offset = 0;
+    size_t length;
+    while ((length = wal_record_check(data + offset, file_size - offset)) > 0) {
+        wal_entry_t header;
+        memcpy(&header, data + offset + sizeof(wal_frame_t), sizeof(header));
+        const char* key = data + offset + sizeof(wal_frame_t) + sizeof(header);
+        
+        if (header.type == WAL_ENTRY_PUT || header.type == WAL_ENTRY_DELETE) {
+            engine_apply(db, header.type, key, key + header.key_size, header.value_size);
+        } else if (header.type == WAL_ENTRY_BATCH) {
+            write_batch_apply(db, key, header.value_size);
+        }
+        offset += length;
+    }
+    munmap(data, file_size);
+    
+    int status = SUCCESS;
+    if (offset < file_size) {
+        if (ftruncate(fd, (off_t)offset) != 0 || fdatasync(fd) != 0) {
+            status = ERROR_IO;
+        }
+        *truncated = file_size - offset;
+    }
+    close(fd);
+    return status;
 }
 
+// Loads the snapshot, or the table manifest in LSM mode, replays the WAL
+// segments after it in order and opens the last one for appending. Replay
+// ends at the first invalid record; segments after it follow a gap and are
+// removed.
 int database_recover(database_t* db) {
-    if (!db || db->wal_fd < 0) return ERROR_INVALID_PARAM;
+    if (!db || db->is_open) return ERROR_INVALID_PARAM;
     
-    // Read and replay WAL entries
-    lseek(db->wal_fd, 0, SEEK_SET);
+    uint64_t first = 0;
+    int status = db->config.engine == DATABASE_ENGINE_LSM ? lsm_load_manifest(db, &first)
+                                                          : snapshot_load(db, &first);
+    if (status != SUCCESS) {
+        return status;
+    }
     
-    wal_entry_t header;
-    while (read(db->wal_fd, &header, sizeof(wal_entry_t)) == sizeof(wal_entry_t)) {
-        if (header.magic != WAL_MAGIC) break;
-        
-        char* data = safe_malloc(header.key_size + header.value_size);
-        read(db->wal_fd, data, header.key_size + header.value_size);
-        
-        const char* key = data;
-        
-        if (header.type == WAL_ENTRY_PUT) {
-            const void* value = data + header.key_size;
-            hash_table_put(db->table, key, value, header.value_size);
-        } else if (header.type == WAL_ENTRY_DELETE) {
-            hash_table_delete(db->table, key);
+    size_t count = 0;
+    uint64_t* segments = wal_list_segments(db, &count);
+    if (first == 0) {
+        first = count > 0 ? segments[0] : 1;
+    }
+    
+    char path[1024];
+    uint64_t active = first;
+    bool gap = false;
+    db->wal_truncated_bytes = 0;
+    for (size_t i = 0; i < count && status == SUCCESS; i++) {
+        wal_segment_path(db, segments[i], path, sizeof(path));
+        if (segments[i] < first) {
+            unlink(path);  // Covered by the snapshot; a crash came before trimming
+            continue;
+        }
+        if (gap) {
+            struct stat st;
+            if (stat(path, &st) == 0) {
+                db->wal_truncated_bytes += (uint64_t)st.st_size;
+            }
+            unlink(path);
+            continue;
         }
         
-        safe_free((void**)&data);
+        uint64_t truncated = 0;
+        status = wal_replay_segment(db, path, &truncated);
+        active = segments[i];
+        db->wal_truncated_bytes += truncated;
+        gap = truncated > 0;
+    }
+    safe_free((void**)&segments);
+    if (status != SUCCESS) {
+        return status;
+    }
+    if (db->config.engine != DATABASE_ENGINE_LSM) {
+        index_rebuild_all(db);  // The snapshot was loaded around them
     }
     
+    wal_segment_path(db, active, path, sizeof(path));
+    db->wal_fd = open(path, O_CREAT | O_RDWR | O_APPEND, 0644);
+    if (db->wal_fd < 0) {
+        return ERROR_IO;
+    }
+    struct stat st;
+    db->wal_segment = active;
+    db->wal_segment_bytes = fstat(db->wal_fd, &st) == 0 ? (uint64_t)st.st_size : 0;
     return SUCCESS;
 }
 
+// In LSM mode, flush the memtable and merge every level down into the
+// deepest one, dropping overwritten versions and tombstones. The hash engine
+// keeps one version per key already; compacting it means a fresh snapshot.
 int database_compact(database_t* db) {
-    // Placeholder for compaction logic
-    (void)db;
-    return SUCCESS;
+    if (!db) return ERROR_INVALID_PARAM;
+    if (db->config.engine != DATABASE_ENGINE_LSM || !db->lsm_running) {
+        return database_checkpoint(db);
+    }
+    
+    int status = lsm_flush(db);
+    if (status != SUCCESS) {
+        return status;
+    }
+    pthread_mutex_lock(&db->lsm_lock);
+    uint64_t request = ++db->lsm_requested;
+    pthread_cond_signal(&db->lsm_work);
+    while (db->lsm_served < request) {
+        pthread_cond_wait(&db->lsm_done, &db->lsm_lock);
+    }
+    status = db->lsm_status;
+    pthread_mutex_unlock(&db->lsm_lock);
+    return status;
 }
 
 int database_get_stats(database_t* db, database_stats_t* stats) {
@@ -463,12 +4922,65 @@ int database_get_stats(database_t* db, database_stats_t* stats) {
     
     pthread_rwlock_rdlock(&db->lock);
     
-    stats->num_keys = db->table->size;
+    stats->num_keys = 0;
     stats->total_size = 0;
-    stats->wal_size = db->wal_fd >= 0 ? lseek(db->wal_fd, 0, SEEK_END) : 0;
     stats->num_transactions = db->next_txn_id - 1;
+    stats->txn_conflicts = __atomic_load_n(&db->txn_conflicts, __ATOMIC_RELAXED);
+    stats->mvcc_versions = __atomic_load_n(&db->versions.versions, __ATOMIC_RELAXED);
+    
+    pthread_mutex_lock(&db->wal_lock);
+    stats->wal_size = db->wal_segment_bytes;
+    stats->wal_records = db->wal_records;
+    stats->wal_syncs = db->wal_syncs;
+    stats->wal_truncated_bytes = db->wal_truncated_bytes;
+    pthread_mutex_unlock(&db->wal_lock);
+    
+    pthread_mutex_lock(&db->snapshot_lock);
+    stats->snapshots = db->snapshots;
+    pthread_mutex_unlock(&db->snapshot_lock);
+    
+    stats->sstable_count = 0;
+    stats->sstable_bytes = 0;
+    stats->bloom_negatives = stats->bloom_false_positives = 0;
+    stats->bloom_false_positive_rate = 0.0;
+    stats->block_cache_hits = stats->block_cache_misses = 0;
+    stats->block_cache_usage = 0;
+    stats->block_cache_hit_rate = 0.0;
+    stats->memtable_flushes = db->memtable_flushes;
+    stats->compactions = db->compactions;
+    if (db->config.engine == DATABASE_ENGINE_LSM) {
+        // Versions and tombstones are counted until compaction drops them,
+        // so num_keys is an upper bound
+        for (int level = 0; level < LSM_MAX_LEVELS; level++) {
+            for (size_t i = 0; i < db->version->counts[level]; i++) {
+                stats->num_keys += db->version->files[level][i]->entries;
+                stats->sstable_bytes += db->version->files[level][i]->size;
+            }
+            stats->sstable_count += db->version->counts[level];
+        }
+        stats->num_keys += db->mem->entries + (db->imm ? db->imm->entries : 0);
+        
+        stats->bloom_negatives = __atomic_load_n(&db->bloom_negatives, __ATOMIC_RELAXED);
+        stats->bloom_false_positives = __atomic_load_n(&db->bloom_false_positives, __ATOMIC_RELAXED);
+        uint64_t absent = stats->bloom_negatives + stats->bloom_false_positives;
+        stats->bloom_false_positive_rate = absent ? (double)stats->bloom_false_positives / (double)absent : 0.0;
+        for (int i = 0; db->block_cache && i < BLOCK_CACHE_SHARDS; i++) {
+            block_cache_shard_t* shard = &db->block_cache->shards[i];
+            pthread_mutex_lock(&shard->lock);
+            stats->block_cache_hits += shard->hits;
+            stats->block_cache_misses += shard->misses;
+            stats->block_cache_usage += shard->usage;
+            pthread_mutex_unlock(&shard->lock);
+        }
+        uint64_t lookups = stats->block_cache_hits + stats->block_cache_misses;
+        stats->block_cache_hit_rate = lookups ? (double)stats->block_cache_hits / (double)lookups : 0.0;
+        stats->total_size = stats->sstable_bytes + db->mem->bytes + (db->imm ? db->imm->bytes : 0);
+        pthread_rwlock_unlock(&db->lock);
+        return SUCCESS;
+    }
     
     // Calculate total size
+    stats->num_keys = db->table->size;
     for (size_t i = 0; i < db->table->bucket_count; i++) {
         hash_entry_t* entry = db->table->buckets[i];
         while (entry) {
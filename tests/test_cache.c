@@ -0,0 +1,762 @@
+#define _POSIX_C_SOURCE 200809L
+#include "cache.h"
+#include "common.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+// Test counter
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+static void sleep_ms(uint64_t ms) {
+    struct timespec ts = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+// =============================================================================
+// Basic Operations
+// =============================================================================
+
+void test_cache_put_get(void) {
+    printf("\n=== Test: Cache Put/Get ===\n");
+    
+    cache_t* cache = cache_create(100, EVICTION_LRU);
+    TEST_ASSERT(cache != NULL, "Cache creation");
+    
+    int result = cache_put(cache, "key1", "value1", 7);
+    TEST_ASSERT(result == SUCCESS, "Put key1");
+    
+    void* value = NULL;
+    size_t value_size = 0;
+    result = cache_get(cache, "key1", &value, &value_size);
+    TEST_ASSERT(result == SUCCESS, "Get key1");
+    TEST_ASSERT(value_size == 7 && strcmp((char*)value, "value1") == 0, "Value matches");
+    free(value);
+    
+    result = cache_put(cache, "key1", "value2", 7);
+    cache_get(cache, "key1", &value, NULL);
+    TEST_ASSERT(result == SUCCESS && strcmp((char*)value, "value2") == 0, "Overwrite key1");
+    free(value);
+    
+    TEST_ASSERT(cache_get(cache, "missing", NULL, NULL) == ERROR_NOT_FOUND, "Missing key not found");
+    TEST_ASSERT(cache_exists(cache, "key1"), "Exists reports key1");
+    TEST_ASSERT(cache_delete(cache, "key1") == SUCCESS, "Delete key1");
+    TEST_ASSERT(!cache_exists(cache, "key1"), "key1 gone after delete");
+    
+    cache_destroy(cache);
+}
+
+void test_cache_stats(void) {
+    printf("\n=== Test: Cache Statistics ===\n");
+    
+    cache_t* cache = cache_create(10, EVICTION_LRU);
+    cache_put(cache, "a", "1", 2);
+    cache_get(cache, "a", NULL, NULL);
+    cache_get(cache, "b", NULL, NULL);
+    
+    cache_stats_t stats;
+    int result = cache_get_stats(cache, &stats);
+    TEST_ASSERT(result == SUCCESS, "Get stats");
+    TEST_ASSERT(stats.size == 1 && stats.max_size == 10, "Size and capacity");
+    TEST_ASSERT(stats.hits == 1 && stats.misses == 1, "Hits and misses counted");
+    
+    cache_destroy(cache);
+}
+
+// =============================================================================
+// Eviction Policies
+// =============================================================================
+
+void test_cache_lru_eviction(void) {
+    printf("\n=== Test: LRU Eviction ===\n");
+    
+    cache_t* cache = cache_create(3, EVICTION_LRU);
+    cache_put(cache, "a", "1", 2);
+    cache_put(cache, "b", "2", 2);
+    cache_put(cache, "c", "3", 2);
+    cache_get(cache, "a", NULL, NULL);  // b is now least recently used
+    cache_put(cache, "d", "4", 2);
+    
+    TEST_ASSERT(!cache_exists(cache, "b"), "LRU entry evicted");
+    TEST_ASSERT(cache_exists(cache, "a") && cache_exists(cache, "d"), "Recent entries kept");
+    
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    TEST_ASSERT(stats.evictions == 1 && stats.size == 3, "Eviction counted");
+    
+    cache_destroy(cache);
+}
+
+void test_cache_lfu_eviction(void) {
+    printf("\n=== Test: LFU Eviction ===\n");
+    
+    cache_t* cache = cache_create(3, EVICTION_LFU);
+    cache_put(cache, "a", "1", 2);
+    cache_put(cache, "b", "2", 2);
+    cache_put(cache, "c", "3", 2);
+    cache_get(cache, "a", NULL, NULL);
+    cache_get(cache, "a", NULL, NULL);
+    cache_get(cache, "c", NULL, NULL);
+    cache_put(cache, "d", "4", 2);
+    
+    TEST_ASSERT(!cache_exists(cache, "b"), "Least frequently used entry evicted");
+    TEST_ASSERT(cache_exists(cache, "a") && cache_exists(cache, "c"), "Frequent entries kept");
+    
+    cache_destroy(cache);
+}
+
+void test_cache_lfu_frequency_order(void) {
+    printf("\n=== Test: LFU Frequency Order ===\n");
+    
+    const char* path = "/tmp/test_cache_lfu.bin";
+    cache_t* cache = cache_create(100, EVICTION_LFU);
+    char key[32];
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        cache_put(cache, key, "v", 2);
+        for (int hit = 0; hit < i % 4; hit++) {
+            cache_get(cache, key, NULL, NULL);
+        }
+    }
+    
+    // Each insert evicts the least recently added of the never-hit keys
+    for (int i = 0; i < 10; i++) {
+        snprintf(key, sizeof(key), "new%d", i);
+        cache_put(cache, key, "v", 2);
+    }
+    
+    int evicted = 0;
+    int misplaced = 0;
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        bool expected = i % 4 != 0 || i >= 40;
+        if (!cache_exists(cache, key)) evicted++;
+        if ((cache_exists(cache, key) != 0) != expected) misplaced++;
+    }
+    TEST_ASSERT(evicted == 10 && misplaced == 0, "Lowest count evicted, oldest first");
+    
+    // Counts and run order survive a snapshot
+    TEST_ASSERT(cache_snapshot_save(cache, path) == SUCCESS, "LFU snapshot saved");
+    cache_t* restored = cache_create(100, EVICTION_LFU);
+    TEST_ASSERT(cache_snapshot_load(restored, path) == SUCCESS, "LFU snapshot loaded");
+    for (int i = 0; i < 10; i++) {
+        snprintf(key, sizeof(key), "new%d", i);
+        cache_get(restored, key, NULL, NULL);
+    }
+    cache_put(restored, "late", "v", 2);
+    TEST_ASSERT(!cache_exists(restored, "key40") && cache_exists(restored, "key44") &&
+                cache_exists(restored, "key1"), "Restored cache evicts in the same order");
+    
+    cache_destroy(restored);
+    cache_destroy(cache);
+    remove(path);
+}
+
+void test_cache_tinylfu_basic(void) {
+    printf("\n=== Test: W-TinyLFU Basic Operations ===\n");
+    
+    cache_t* cache = cache_create(100, EVICTION_TINYLFU);
+    TEST_ASSERT(cache != NULL, "W-TinyLFU cache creation");
+    
+    char key[32];
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        cache_put(cache, key, "v", 2);
+    }
+    
+    int found = 0;
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        found += cache_exists(cache, key);
+    }
+    TEST_ASSERT(found == 100, "All entries fit within capacity");
+    
+    for (int i = 100; i < 1000; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        cache_put(cache, key, "v", 2);
+    }
+    
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    TEST_ASSERT(stats.size == 100, "Size bounded by capacity");
+    TEST_ASSERT(stats.evictions == 900, "Evictions counted");
+    
+    TEST_ASSERT(cache_delete(cache, "key999") == SUCCESS, "Delete from admission window");
+    
+    cache_clear(cache);
+    cache_get_stats(cache, &stats);
+    TEST_ASSERT(stats.size == 0, "Clear empties all segments");
+    
+    cache_destroy(cache);
+}
+
+void test_cache_tinylfu_scan_resistance(void) {
+    printf("\n=== Test: W-TinyLFU Scan Resistance ===\n");
+    
+    const int hot_keys = 50;
+    cache_t* lru = cache_create(100, EVICTION_LRU);
+    cache_t* tinylfu = cache_create(100, EVICTION_TINYLFU);
+    cache_t* caches[2] = { lru, tinylfu };
+    char key[32];
+    
+    // Establish a frequently used hot set
+    for (int round = 0; round < 5; round++) {
+        for (int i = 0; i < hot_keys; i++) {
+            snprintf(key, sizeof(key), "hot%d", i);
+            for (int c = 0; c < 2; c++) {
+                if (cache_get(caches[c], key, NULL, NULL) != SUCCESS) {
+                    cache_put(caches[c], key, "v", 2);
+                }
+            }
+        }
+    }
+    
+    // One-off scan larger than the cache
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "scan%d", i);
+        for (int c = 0; c < 2; c++) {
+            if (cache_get(caches[c], key, NULL, NULL) != SUCCESS) {
+                cache_put(caches[c], key, "v", 2);
+            }
+        }
+    }
+    
+    int survivors[2] = { 0, 0 };
+    for (int i = 0; i < hot_keys; i++) {
+        snprintf(key, sizeof(key), "hot%d", i);
+        for (int c = 0; c < 2; c++) {
+            survivors[c] += cache_exists(caches[c], key);
+        }
+    }
+    
+    printf("  Hot keys surviving scan: LRU=%d W-TinyLFU=%d\n", survivors[0], survivors[1]);
+    TEST_ASSERT(survivors[0] == 0, "LRU loses hot set to scan");
+    TEST_ASSERT(survivors[1] >= hot_keys * 9 / 10, "W-TinyLFU keeps hot set through scan");
+    
+    cache_destroy(lru);
+    cache_destroy(tinylfu);
+}
+
+void test_cache_sieve_eviction(void) {
+    printf("\n=== Test: SIEVE Eviction ===\n");
+    
+    cache_t* cache = cache_create(3, EVICTION_SIEVE);
+    cache_put(cache, "a", "1", 2);
+    cache_put(cache, "b", "2", 2);
+    cache_put(cache, "c", "3", 2);
+    cache_get(cache, "a", NULL, NULL);  // a visited, b is the oldest unvisited
+    cache_put(cache, "d", "4", 2);
+    
+    TEST_ASSERT(!cache_exists(cache, "b"), "Oldest unvisited entry evicted");
+    TEST_ASSERT(cache_exists(cache, "a"), "Visited entry survives the hand");
+    
+    cache_put(cache, "e", "5", 2);     // hand moved past a: c goes next
+    TEST_ASSERT(!cache_exists(cache, "c") && cache_exists(cache, "a"), "Hand continues towards head");
+    
+    cache_put(cache, "f", "6", 2);     // hand has not wrapped yet: d goes
+    TEST_ASSERT(!cache_exists(cache, "d") && cache_exists(cache, "a"), "Hand does not revisit before wrapping");
+    
+    void* value = NULL;
+    int result = cache_get(cache, "e", &value, NULL);
+    TEST_ASSERT(result == SUCCESS && strcmp((char*)value, "5") == 0, "Read-lock get returns value");
+    free(value);
+    
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    TEST_ASSERT(stats.size == 3 && stats.evictions == 3, "Size bounded and evictions counted");
+    
+    cache_destroy(cache);
+}
+
+// =============================================================================
+// TTL
+// =============================================================================
+
+void test_cache_ttl(void) {
+    printf("\n=== Test: TTL Expiration ===\n");
+    
+    cache_t* cache = cache_create(10, EVICTION_LRU);
+    cache_put_with_ttl(cache, "short", "v", 2, 20);
+    cache_put(cache, "forever", "v", 2);
+    
+    TEST_ASSERT(cache_exists(cache, "short"), "Entry visible before TTL");
+    sleep_ms(40);
+    TEST_ASSERT(!cache_exists(cache, "short"), "Entry hidden after TTL");
+    TEST_ASSERT(cache_exists(cache, "forever"), "Entry without TTL kept");
+    
+    cache_destroy(cache);
+}
+
+void test_cache_ttl_reput(void) {
+    printf("\n=== Test: Re-put After Expiry ===\n");
+    
+    cache_t* cache = cache_create(10, EVICTION_LRU);
+    cache_put_with_ttl(cache, "session", "old", 4, 10);
+    sleep_ms(30);
+    cache_put_with_ttl(cache, "session", "new", 4, 10000);
+    
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    TEST_ASSERT(stats.size == 1, "Expired entry reused instead of duplicated");
+    
+    void* value = NULL;
+    int result = cache_get(cache, "session", &value, NULL);
+    TEST_ASSERT(result == SUCCESS && strcmp((char*)value, "new") == 0, "New value visible");
+    free(value);
+    
+    cache_destroy(cache);
+}
+
+void test_cache_expire(void) {
+    printf("\n=== Test: Incremental Expiration ===\n");
+    
+    cache_t* cache = cache_create(1000, EVICTION_LRU);
+    char key[32];
+    for (int i = 0; i < 500; i++) {
+        snprintf(key, sizeof(key), "ttl%d", i);
+        cache_put_with_ttl(cache, key, "v", 2, 20);
+    }
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "keep%d", i);
+        cache_put_with_ttl(cache, key, "v", 2, 60000);
+    }
+    
+    TEST_ASSERT(cache_expire(cache, 0) == 0, "Nothing expires early");
+    sleep_ms(50);
+    
+    size_t first = cache_expire(cache, 100);
+    TEST_ASSERT(first > 0 && first <= 100, "Slice bounded by budget");
+    
+    size_t total = first;
+    size_t freed;
+    while ((freed = cache_expire(cache, 100)) > 0) {
+        total += freed;
+    }
+    TEST_ASSERT(total == 500, "All expired entries freed");
+    
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    TEST_ASSERT(stats.size == 100, "Live entries kept");
+    TEST_ASSERT(stats.expirations == 500, "Expirations counted");
+    
+    cache_destroy(cache);
+}
+
+void test_cache_reaper(void) {
+    printf("\n=== Test: Background Reaper ===\n");
+    
+    cache_t* cache = cache_create(1000, EVICTION_TINYLFU);
+    char key[32];
+    for (int i = 0; i < 300; i++) {
+        snprintf(key, sizeof(key), "ttl%d", i);
+        cache_put_with_ttl(cache, key, "v", 2, 10 + i % 20);
+    }
+    
+    TEST_ASSERT(cache_start_reaper(cache, 5, 32) == SUCCESS, "Reaper started");
+    TEST_ASSERT(cache_start_reaper(cache, 5, 32) == ERROR_ALREADY_EXISTS, "Reaper not started twice");
+    
+    cache_stats_t stats;
+    for (int attempt = 0; attempt < 100; attempt++) {
+        sleep_ms(10);
+        cache_get_stats(cache, &stats);
+        if (stats.size == 0) break;
+    }
+    TEST_ASSERT(stats.size == 0, "Reaper frees expired entries");
+    TEST_ASSERT(stats.expirations == 300, "Reaper expirations counted");
+    TEST_ASSERT(cache_stop_reaper(cache) == SUCCESS, "Reaper stopped");
+    
+    cache_destroy(cache);
+}
+
+// =============================================================================
+// Snapshots
+// =============================================================================
+
+void test_cache_snapshot_roundtrip(void) {
+    printf("\n=== Test: Snapshot Save/Load ===\n");
+    
+    const char* path = "/tmp/test_cache_snapshot.bin";
+    cache_t* cache = cache_create(100, EVICTION_LRU);
+    char key[32];
+    char value[32];
+    for (int i = 0; i < 50; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        cache_put(cache, key, value, strlen(value) + 1);
+    }
+    cache_put(cache, "", "empty", 6);
+    cache_put_with_ttl(cache, "short", "v", 2, 10);
+    cache_put_with_ttl(cache, "long", "v", 2, 60000);
+    cache_get(cache, "key0", NULL, NULL);  // key0 becomes most recently used
+    
+    TEST_ASSERT(cache_snapshot_save(cache, path) == SUCCESS, "Snapshot saved");
+    cache_destroy(cache);
+    sleep_ms(30);
+    
+    cache_t* restored = cache_create(100, EVICTION_LRU);
+    TEST_ASSERT(cache_snapshot_load(restored, path) == SUCCESS, "Snapshot loaded");
+    
+    void* loaded = NULL;
+    int result = cache_get(restored, "key7", &loaded, NULL);
+    TEST_ASSERT(result == SUCCESS && strcmp((char*)loaded, "value7") == 0, "Values restored");
+    free(loaded);
+    
+    TEST_ASSERT(!cache_exists(restored, "short"), "Entry expired during downtime dropped");
+    TEST_ASSERT(cache_exists(restored, "long"), "TTL deadline preserved");
+    TEST_ASSERT(cache_exists(restored, ""), "Empty key restored");
+    
+    cache_stats_t stats;
+    cache_get_stats(restored, &stats);
+    TEST_ASSERT(stats.size == 52, "Entry count restored");
+    cache_destroy(restored);
+    
+    // Loading into a smaller cache keeps the most recently used entries
+    cache_t* small = cache_create(2, EVICTION_LRU);
+    cache_snapshot_load(small, path);
+    TEST_ASSERT(cache_exists(small, "key0") && cache_exists(small, "long"), "Recency order preserved");
+    TEST_ASSERT(!cache_exists(small, "key1"), "Least recent entries dropped on overflow");
+    TEST_ASSERT(cache_snapshot_load(small, "/tmp/does-not-exist.snap") == ERROR_NOT_FOUND,
+                "Missing snapshot reported");
+    cache_destroy(small);
+    
+    remove(path);
+}
+
+typedef struct {
+    cache_t* cache;
+    int stop;
+} churn_args_t;
+
+// Reorders, overwrites and deletes entries while a snapshot is being saved
+static void* snapshot_churn(void* arg) {
+    churn_args_t* args = (churn_args_t*)arg;
+    char key[32];
+    for (int i = 0; !__atomic_load_n(&args->stop, __ATOMIC_ACQUIRE); i++) {
+        snprintf(key, sizeof(key), "stable%d", (i * 7919) % 10000);
+        cache_get(args->cache, key, NULL, NULL);
+        snprintf(key, sizeof(key), "churn%d", i % 5000);
+        if (i % 3 == 0) {
+            cache_delete(args->cache, key);
+        } else {
+            cache_put(args->cache, key, "c", 2);
+        }
+    }
+    return NULL;
+}
+
+void test_cache_snapshot_concurrent_save(void) {
+    printf("\n=== Test: Snapshot Save Under Writes ===\n");
+    
+    const char* path = "/tmp/test_cache_concurrent.snap";
+    cache_t* cache = cache_create(20000, EVICTION_LRU);
+    char key[32];
+    char value[32];
+    for (int i = 0; i < 10000; i++) {
+        snprintf(key, sizeof(key), "stable%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        cache_put(cache, key, value, strlen(value) + 1);
+    }
+    
+    churn_args_t args = { .cache = cache, .stop = 0 };
+    pthread_t churn;
+    pthread_create(&churn, NULL, snapshot_churn, &args);
+    sleep_ms(5);
+    int saved = cache_snapshot_save(cache, path);
+    __atomic_store_n(&args.stop, 1, __ATOMIC_RELEASE);
+    pthread_join(churn, NULL);
+    TEST_ASSERT(saved == SUCCESS, "Snapshot saved while writers run");
+    
+    cache_t* restored = cache_create(20000, EVICTION_LRU);
+    TEST_ASSERT(cache_snapshot_load(restored, path) == SUCCESS, "Concurrent snapshot loaded");
+    
+    int missing = 0;
+    for (int i = 0; i < 10000; i++) {
+        snprintf(key, sizeof(key), "stable%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        void* loaded = NULL;
+        if (cache_get(restored, key, &loaded, NULL) != SUCCESS || strcmp(loaded, value) != 0) {
+            missing++;
+        }
+        free(loaded);
+    }
+    TEST_ASSERT(missing == 0, "Entries reordered during the save are all restored");
+    
+    cache_destroy(restored);
+    cache_destroy(cache);
+    remove(path);
+}
+
+void test_cache_snapshot_parallel_load(void) {
+    printf("\n=== Test: Snapshot Parallel Load ===\n");
+    
+    const char* path = "/tmp/test_cache_snapshot_large.bin";
+    const int count = 50000;
+    cache_t* cache = cache_create(count, EVICTION_TINYLFU);
+    char key[32];
+    for (int i = 0; i < count; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        cache_put(cache, key, key, strlen(key) + 1);
+    }
+    cache_stats_t before;
+    cache_get_stats(cache, &before);
+    cache_snapshot_save(cache, path);
+    cache_destroy(cache);
+    
+    cache_t* restored = cache_create(count, EVICTION_TINYLFU);
+    TEST_ASSERT(cache_snapshot_load(restored, path) == SUCCESS, "Large snapshot loaded");
+    
+    cache_stats_t after;
+    cache_get_stats(restored, &after);
+    TEST_ASSERT(after.size == before.size, "All entries restored");
+    
+    int sampled = 0;
+    int matches = 0;
+    for (int i = 0; i < count; i += 997) {
+        sampled++;
+        snprintf(key, sizeof(key), "key%d", i);
+        void* value = NULL;
+        if (cache_get(restored, key, &value, NULL) == SUCCESS) {
+            matches += strcmp((char*)value, key) == 0;
+            free(value);
+        }
+    }
+    TEST_ASSERT(matches == sampled, "Sampled entries match");
+    cache_destroy(restored);
+    
+    // Corrupt file is rejected
+    FILE* file = fopen(path, "r+b");
+    fseek(file, 0, SEEK_SET);
+    fputc('X', file);
+    fclose(file);
+    restored = cache_create(10, EVICTION_LRU);
+    TEST_ASSERT(cache_snapshot_load(restored, path) == ERROR_IO, "Corrupt snapshot rejected");
+    cache_destroy(restored);
+    
+    remove(path);
+}
+
+// =============================================================================
+// Batch Operations
+// =============================================================================
+
+void test_cache_mget_mput(void) {
+    printf("\n=== Test: Batch Get/Put ===\n");
+    
+    // 300 keys exercises the heap-allocated hash array as well
+    enum { BATCH = 300 };
+    static char key_storage[BATCH * 2][16];
+    const char* keys[BATCH * 2];
+    const void* values[BATCH];
+    size_t sizes[BATCH];
+    int numbers[BATCH];
+    
+    for (int i = 0; i < BATCH * 2; i++) {
+        snprintf(key_storage[i], sizeof(key_storage[i]), "key%d", i);
+        keys[i] = key_storage[i];
+    }
+    for (int i = 0; i < BATCH; i++) {
+        numbers[i] = i;
+        values[i] = &numbers[i];
+        sizes[i] = sizeof(int);
+    }
+    
+    eviction_policy_t policies[] = { EVICTION_LRU, EVICTION_SIEVE };
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+        cache_t* cache = cache_create(1000, policies[p]);
+        TEST_ASSERT(cache_mput(cache, keys, BATCH, values, sizes, 0) == SUCCESS, "mput batch");
+        
+        // Second half of the keys were never stored
+        void* got[BATCH * 2];
+        size_t got_sizes[BATCH * 2];
+        TEST_ASSERT(cache_mget(cache, keys, BATCH * 2, got, got_sizes) == SUCCESS, "mget batch");
+        
+        bool hits_ok = true;
+        bool misses_ok = true;
+        for (int i = 0; i < BATCH * 2; i++) {
+            if (i < BATCH) {
+                if (!got[i] || got_sizes[i] != sizeof(int) || *(int*)got[i] != i) hits_ok = false;
+            } else if (got[i] != NULL || got_sizes[i] != 0) {
+                misses_ok = false;
+            }
+            free(got[i]);
+        }
+        TEST_ASSERT(hits_ok, "Stored keys returned in order");
+        TEST_ASSERT(misses_ok, "Missing keys reported as NULL");
+        
+        cache_stats_t stats;
+        cache_get_stats(cache, &stats);
+        TEST_ASSERT(stats.hits == BATCH && stats.misses == BATCH, "Batch hits and misses counted");
+        
+        cache_destroy(cache);
+    }
+    
+    cache_t* cache = cache_create(10, EVICTION_LRU);
+    TEST_ASSERT(cache_mput(cache, keys, 2, values, sizes, 1) == SUCCESS, "mput with TTL");
+    sleep_ms(20);
+    TEST_ASSERT(!cache_exists(cache, "key0") && !cache_exists(cache, "key1"), "Batch TTL applied");
+    
+    const char* bad_keys[] = { "a", NULL };
+    TEST_ASSERT(cache_mget(cache, bad_keys, 2, NULL, NULL) == ERROR_INVALID_PARAM, "NULL key rejected");
+    TEST_ASSERT(cache_mput(cache, bad_keys, 2, values, sizes, 0) == ERROR_INVALID_PARAM &&
+                !cache_exists(cache, "a"), "Invalid batch leaves the cache untouched");
+    TEST_ASSERT(cache_mget(cache, NULL, 0, NULL, NULL) == SUCCESS, "Empty batch");
+    
+    cache_destroy(cache);
+}
+
+// =============================================================================
+// Index Resizing
+// =============================================================================
+
+void test_cache_index_grow_shrink(void) {
+    printf("\n=== Test: Index Grow/Shrink ===\n");
+    
+    const int count = 20000;
+    char key[32];
+    cache_t* cache = cache_create(count, EVICTION_LRU);
+    
+    // Every insert runs while some resize is migrating buckets; check that
+    // earlier keys stay reachable throughout
+    bool all_found = true;
+    for (int i = 0; i < count; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        cache_put(cache, key, &i, sizeof(i));
+        
+        snprintf(key, sizeof(key), "key%d", i / 2);
+        if (!cache_exists(cache, key)) all_found = false;
+    }
+    TEST_ASSERT(all_found, "Keys reachable while the index grows");
+    
+    bool values_match = true;
+    for (int i = 0; i < count; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        void* value = NULL;
+        if (cache_get(cache, key, &value, NULL) != SUCCESS || *(int*)value != i) {
+            values_match = false;
+        }
+        free(value);
+    }
+    TEST_ASSERT(values_match, "All values intact after growth");
+    
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    TEST_ASSERT(stats.size == (size_t)count && stats.evictions == 0, "No entries lost or evicted");
+    
+    // Deleting most keys shrinks the index; survivors must stay reachable
+    bool deletes_ok = true;
+    for (int i = 0; i < count; i++) {
+        if (i % 100 == 0) continue;
+        snprintf(key, sizeof(key), "key%d", i);
+        if (cache_delete(cache, key) != SUCCESS) deletes_ok = false;
+    }
+    TEST_ASSERT(deletes_ok, "Deletes succeed while the index shrinks");
+    
+    bool survivors_ok = true;
+    for (int i = 0; i < count; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        if (cache_exists(cache, key) != (i % 100 == 0)) survivors_ok = false;
+    }
+    TEST_ASSERT(survivors_ok, "Survivors reachable after shrinking");
+    
+    cache_clear(cache);
+    cache_put(cache, "after_clear", "1", 2);
+    TEST_ASSERT(cache_exists(cache, "after_clear"), "Index usable after clear");
+    
+    cache_destroy(cache);
+}
+
+void test_cache_set_max_size(void) {
+    printf("\n=== Test: Runtime Capacity Change ===\n");
+    
+    eviction_policy_t policies[] = { EVICTION_LRU, EVICTION_TINYLFU, EVICTION_SIEVE };
+    char key[32];
+    
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+        cache_t* cache = cache_create(100, policies[p]);
+        for (int i = 0; i < 100; i++) {
+            snprintf(key, sizeof(key), "key%d", i);
+            cache_put(cache, key, &i, sizeof(i));
+        }
+        
+        TEST_ASSERT(cache_set_max_size(cache, 1000) == SUCCESS, "Raise capacity");
+        for (int i = 100; i < 1000; i++) {
+            snprintf(key, sizeof(key), "key%d", i);
+            cache_put(cache, key, &i, sizeof(i));
+        }
+        
+        cache_stats_t stats;
+        cache_get_stats(cache, &stats);
+        TEST_ASSERT(stats.size == 1000 && stats.max_size == 1000, "Cache fills to the new capacity");
+        
+        TEST_ASSERT(cache_set_max_size(cache, 10) == SUCCESS, "Lower capacity");
+        cache_get_stats(cache, &stats);
+        TEST_ASSERT(stats.size == 10 && stats.evictions >= 990, "Overflow evicted on shrink");
+        
+        cache_destroy(cache);
+    }
+    
+    TEST_ASSERT(cache_set_max_size(NULL, 10) == ERROR_INVALID_PARAM, "NULL cache rejected");
+}
+
+// =============================================================================
+// Main Test Runner
+// =============================================================================
+
+int main(void) {
+    printf("========================================\n");
+    printf("Cache System Tests\n");
+    printf("========================================\n");
+    
+    // Basic Operations
+    test_cache_put_get();
+    test_cache_stats();
+    
+    // Eviction Policies
+    test_cache_lru_eviction();
+    test_cache_lfu_eviction();
+    test_cache_lfu_frequency_order();
+    test_cache_tinylfu_basic();
+    test_cache_tinylfu_scan_resistance();
+    test_cache_sieve_eviction();
+    
+    // TTL
+    test_cache_ttl();
+    test_cache_ttl_reput();
+    test_cache_expire();
+    test_cache_reaper();
+    
+    // Snapshots
+    test_cache_snapshot_roundtrip();
+    test_cache_snapshot_parallel_load();
+    test_cache_snapshot_concurrent_save();
+    
+    // Batch Operations
+    test_cache_mget_mput();
+    
+    // Index Resizing
+    test_cache_index_grow_shrink();
+    test_cache_set_max_size();
+    
+    // Summary
+    printf("\n========================================\n");
+    printf("Test Results:\n");
+    printf("  Passed: %d\n", tests_passed);
+    printf("  Failed: %d\n", tests_failed);
+    printf("  Total:  %d\n", tests_passed + tests_failed);
+    printf("========================================\n");
+    
+    return tests_failed == 0 ? 0 : 1;
+}
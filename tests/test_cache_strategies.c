@@ -0,0 +1,1938 @@
+#define _POSIX_C_SOURCE 200809L
+#include "cache_strategies.h"
+#include "common.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Test counter
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+static void sleep_ms(uint64_t ms) {
+    struct timespec ts = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static cache_instance_t* create_memory_cache(size_t max_size) {
+    cache_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.type = CACHE_TYPE_MEMORY;
+    config.strategy = CACHE_STRATEGY_LAZY;
+    config.eviction_policy = CACHE_EVICTION_LRU;
+    config.max_size = max_size;
+    return cache_instance_create(&config);
+}
+
+// =============================================================================
+// Basic Operations
+// =============================================================================
+
+void test_cache_set_get(void) {
+    printf("\n=== Test: Set/Get/Delete ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(100);
+    TEST_ASSERT(cache != NULL, "Cache creation");
+    TEST_ASSERT(cache_instance_connect(cache) == SUCCESS, "Connect memory cache");
+    
+    TEST_ASSERT(cache_set(cache, "user:1", "alice", 6) == SUCCESS, "Set user:1");
+    
+    void* value = NULL;
+    size_t size = 0;
+    TEST_ASSERT(cache_get(cache, "user:1", &value, &size) == SUCCESS &&
+                size == 6 && strcmp(value, "alice") == 0, "Get user:1");
+    free(value);
+    
+    cache_set(cache, "user:1", "bob", 4);
+    cache_get(cache, "user:1", &value, &size);
+    TEST_ASSERT(size == 4 && strcmp(value, "bob") == 0, "Overwrite user:1");
+    free(value);
+    
+    TEST_ASSERT(cache_exists(cache, "user:1"), "Exists user:1");
+    TEST_ASSERT(cache_get(cache, "user:2", &value, &size) == ERROR_NOT_FOUND && value == NULL,
+                "Missing key not found");
+    TEST_ASSERT(cache_delete(cache, "user:1") == SUCCESS, "Delete user:1");
+    TEST_ASSERT(!cache_exists(cache, "user:1"), "user:1 gone");
+    TEST_ASSERT(cache_delete(cache, "user:1") == ERROR_NOT_FOUND, "Second delete not found");
+    
+    cache_instance_destroy(cache);
+}
+
+void test_cache_eviction(void) {
+    printf("\n=== Test: LRU Eviction ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(3);
+    cache_set(cache, "a", "1", 2);
+    cache_set(cache, "b", "2", 2);
+    cache_set(cache, "c", "3", 2);
+    cache_get(cache, "a", NULL, NULL);
+    cache_set(cache, "d", "4", 2);
+    
+    TEST_ASSERT(!cache_exists(cache, "b"), "Least recently used entry evicted");
+    TEST_ASSERT(cache_exists(cache, "a") && cache_exists(cache, "d"), "Recent entries kept");
+    
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    TEST_ASSERT(stats.evictions == 1 && stats.current_size == 3, "Eviction counted");
+    
+    cache_instance_destroy(cache);
+    
+    // Growing existing keys is bounded by max_memory_mb like inserting is
+    cache_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.type = CACHE_TYPE_MEMORY;
+    config.eviction_policy = CACHE_EVICTION_LRU;
+    config.max_memory_mb = 1;
+    cache = cache_instance_create(&config);
+    
+    char chunk[1024];
+    memset(chunk, 'x', sizeof(chunk));
+    char* grown = malloc(64 * sizeof(chunk));
+    memset(grown, 'y', 64 * sizeof(chunk));
+    char key[16];
+    for (int round = 1; round <= 64; round++) {
+        for (int i = 0; i < 64; i++) {
+            snprintf(key, sizeof(key), "grow%d", i);
+            cache_append(cache, key, chunk, sizeof(chunk));
+            snprintf(key, sizeof(key), "over%d", i);
+            cache_set(cache, key, grown, (size_t)round * sizeof(chunk));
+        }
+    }
+    free(grown);
+    
+    cache_get_stats(cache, &stats);
+    TEST_ASSERT(stats.memory_used_mb <= 1.0 && stats.evictions > 0, "Appends and overwrites stay within max_memory_mb");
+    
+    cache_instance_destroy(cache);
+}
+
+void test_cache_ttl(void) {
+    printf("\n=== Test: TTL ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(100);
+    cache_set_with_ttl(cache, "short", "x", 2, 20);
+    cache_set_with_ttl(cache, "long", "y", 2, 60000);
+    cache_set(cache, "forever", "z", 2);
+    
+    uint64_t ttl = 0;
+    TEST_ASSERT(cache_get_ttl(cache, "long", &ttl) == SUCCESS && ttl > 59000 && ttl <= 60000,
+                "Remaining TTL reported");
+    TEST_ASSERT(cache_get_ttl(cache, "forever", &ttl) == SUCCESS && ttl == 0, "No TTL reported as 0");
+    
+    char** keys = NULL;
+    size_t count = 0;
+    cache_get_expiring_keys(cache, 1000, &keys, &count);
+    TEST_ASSERT(count == 1 && strcmp(keys[0], "short") == 0, "Expiring keys listed");
+    for (size_t i = 0; i < count; i++) free(keys[i]);
+    free(keys);
+    
+    TEST_ASSERT(cache_persist(cache, "long") == SUCCESS, "Persist long");
+    cache_get_ttl(cache, "long", &ttl);
+    TEST_ASSERT(ttl == 0, "TTL removed");
+    
+    sleep_ms(30);
+    TEST_ASSERT(cache_expire_keys(cache) == 1, "Expired key reaped");
+    TEST_ASSERT(!cache_exists(cache, "short") && cache_exists(cache, "long"), "Only expired key removed");
+    
+    cache_instance_destroy(cache);
+}
+
+void test_cache_atomic_and_batch(void) {
+    printf("\n=== Test: Counters and Batch Operations ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(100);
+    int64_t counter = 0;
+    TEST_ASSERT(cache_increment(cache, "hits", 5, &counter) == SUCCESS && counter == 5,
+                "Increment missing key");
+    cache_decrement(cache, "hits", 2, &counter);
+    TEST_ASSERT(counter == 3, "Decrement");
+    
+    cache_set(cache, "name", "abc", 3);
+    TEST_ASSERT(cache_increment(cache, "name", 1, &counter) == ERROR_INVALID_PARAM,
+                "Increment of non-integer rejected");
+    
+    cache_append(cache, "name", "def", 3);
+    void* value = NULL;
+    size_t size = 0;
+    cache_get(cache, "name", &value, &size);
+    TEST_ASSERT(size == 6 && memcmp(value, "abcdef", 6) == 0, "Append");
+    free(value);
+    
+    const char* keys[] = { "hits", "missing", "name" };
+    void** values = NULL;
+    size_t* sizes = NULL;
+    TEST_ASSERT(cache_mget(cache, keys, 3, &values, &sizes) == SUCCESS, "Mget");
+    TEST_ASSERT(values[0] && sizes[0] == 1 && values[1] == NULL && sizes[2] == 6,
+                "Mget hits and misses");
+    for (int i = 0; i < 3; i++) free(values[i]);
+    free(values);
+    free(sizes);
+    
+    cache_mdelete(cache, keys, 3);
+    size_t total = 1;
+    cache_get_size(cache, &total);
+    TEST_ASSERT(total == 0, "Mdelete");
+    
+    cache_instance_destroy(cache);
+}
+
+static cache_instance_t* create_compressed_cache(size_t threshold) {
+    cache_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.type = CACHE_TYPE_MEMORY;
+    config.eviction_policy = CACHE_EVICTION_LRU;
+    config.max_size = 1000;
+    config.enable_compression = true;
+    config.compression_threshold = threshold;
+    return cache_instance_create(&config);
+}
+
+// JSON-like text: repetitive structure, varying fields
+static size_t make_document(char* buffer, size_t size, int seed) {
+    size_t length = 0;
+    for (int i = 0; length + 128 < size; i++) {
+        length += (size_t)snprintf(buffer + length, size - length,
+                                   "{\"id\":%d,\"name\":\"product-%d\",\"price\":%d.99,\"tags\":[\"sale\",\"new\"]},",
+                                   seed * 1000 + i, (seed + i) % 97, i % 50);
+    }
+    return length;
+}
+
+static bool round_trips(cache_instance_t* cache, const char* key, const void* data, size_t size) {
+    void* value = NULL;
+    size_t value_size = 0;
+    bool same = cache_set(cache, key, data, size) == SUCCESS &&
+                cache_get(cache, key, &value, &value_size) == SUCCESS &&
+                value_size == size && memcmp(value, data, size) == 0;
+    safe_free(&value);
+    return same;
+}
+
+void test_cache_compression(void) {
+    printf("\n=== Test: Value Compression ===\n");
+    
+    cache_instance_t* cache = create_compressed_cache(0);
+    char document[8192];
+    size_t length = make_document(document, sizeof(document), 1);
+    
+    TEST_ASSERT(round_trips(cache, "doc", document, length), "Compressed value round-trips");
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    TEST_ASSERT(stats.compressed_values == 1 && stats.compression_bytes_saved > length / 2,
+                "Document stored compressed");
+    TEST_ASSERT(stats.compression_time_ns > 0 && stats.decompression_time_ns > 0, "Codec time reported");
+    
+    cache_key_info_t info;
+    TEST_ASSERT(cache_get_key_info(cache, "doc", &info) == SUCCESS && info.value_size == length,
+                "Key info reports the original size");
+    
+    // Below the threshold and incompressible values stay raw
+    TEST_ASSERT(round_trips(cache, "small", document, 512), "Small value round-trips");
+    uint8_t noise[4096];
+    uint64_t seed = 88172645463325252ULL;
+    for (size_t i = 0; i < sizeof(noise); i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        noise[i] = (uint8_t)seed;
+    }
+    TEST_ASSERT(round_trips(cache, "noise", noise, sizeof(noise)), "Incompressible value round-trips");
+    cache_get_stats(cache, &stats);
+    TEST_ASSERT(stats.compressed_values == 1 && stats.compression_skipped == 1, "Poor ratio skipped, small not tried");
+    
+    // Append to a compressed value keeps it compressed and intact
+    TEST_ASSERT(cache_append(cache, "doc", "]", 1) == SUCCESS, "Append to compressed value");
+    void* value = NULL;
+    size_t size = 0;
+    cache_get(cache, "doc", &value, &size);
+    TEST_ASSERT(size == length + 1 && memcmp(value, document, length) == 0 && ((char*)value)[length] == ']',
+                "Appended value intact");
+    safe_free(&value);
+    int64_t counter;
+    TEST_ASSERT(cache_increment(cache, "doc", 1, &counter) == ERROR_INVALID_PARAM, "Increment of compressed value rejected");
+    
+    // Overwrites and deletes keep the saving exact
+    cache_set(cache, "doc", noise, sizeof(noise));
+    cache_get_stats(cache, &stats);
+    TEST_ASSERT(stats.compressed_values == 0 && stats.compression_bytes_saved == 0, "Overwrite releases the saving");
+    cache_set(cache, "doc", document, length);
+    cache_delete(cache, "doc");
+    cache_get_stats(cache, &stats);
+    TEST_ASSERT(stats.compressed_values == 0 && stats.compression_bytes_saved == 0, "Delete releases the saving");
+    cache_instance_destroy(cache);
+    
+    // The same documents take a fraction of the memory
+    cache_instance_t* plain = create_memory_cache(1000);
+    cache = create_compressed_cache(0);
+    char key[32];
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "doc:%d", i);
+        length = make_document(document, sizeof(document), i);
+        cache_set(plain, key, document, length);
+        cache_set(cache, key, document, length);
+    }
+    cache_stats_t plain_stats;
+    cache_get_stats(plain, &plain_stats);
+    cache_get_stats(cache, &stats);
+    printf("  memory: %.2f MB raw, %.2f MB compressed\n", plain_stats.memory_used_mb, stats.memory_used_mb);
+    TEST_ASSERT(stats.memory_used_mb * 3 < plain_stats.memory_used_mb, "Compressed store at least 3x smaller");
+    
+    void** values = NULL;
+    size_t* sizes = NULL;
+    const char* keys[] = { "doc:0", "doc:199" };
+    cache_mget(cache, keys, 2, &values, &sizes);
+    length = make_document(document, sizeof(document), 199);
+    TEST_ASSERT(values[1] && sizes[1] == length && memcmp(values[1], document, length) == 0, "Batch get decompresses");
+    for (int i = 0; i < 2; i++) {
+        safe_free(&values[i]);
+    }
+    safe_free((void**)&values);
+    safe_free((void**)&sizes);
+    
+    cache_instance_destroy(plain);
+    cache_instance_destroy(cache);
+}
+
+// Inputs that exercise the codec's length and offset encodings
+void test_cache_compression_codec(void) {
+    printf("\n=== Test: Compression Codec Edge Cases ===\n");
+    
+    cache_instance_t* cache = create_compressed_cache(16);
+    size_t size = 300000;
+    uint8_t* data = safe_malloc(size);
+    
+    // One long run: a single overlapping match with a multi-byte length
+    memset(data, 'a', size);
+    TEST_ASSERT(round_trips(cache, "run", data, size), "Long run");
+    
+    // Short period, and a long literal run before the first match
+    for (size_t i = 0; i < size; i++) {
+        data[i] = (uint8_t)("abc"[i % 3]);
+    }
+    uint64_t seed = 2463534242ULL;
+    for (size_t i = 0; i < 5000; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        data[i] = (uint8_t)seed;
+    }
+    TEST_ASSERT(round_trips(cache, "period", data, size), "Literal run then period-3 repeats");
+    
+    // A random block repeated at just under and just over the 64 KB window
+    for (size_t i = 0; i < size; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        data[i] = (uint8_t)seed;
+    }
+    memcpy(data + 65535, data, 4096);
+    memcpy(data + 140000, data + 70000, 4096);
+    TEST_ASSERT(round_trips(cache, "window", data, size), "Matches at the window edge");
+    
+    // Matches ending exactly at the end of the input
+    memset(data, 'x', 64);
+    TEST_ASSERT(round_trips(cache, "tail", data, 64), "Match running to the end");
+    memcpy(data, "abcdefgh", 8);
+    TEST_ASSERT(round_trips(cache, "tiny", data, 20), "Input barely over the threshold");
+    
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    TEST_ASSERT(stats.compressed_values >= 3, "Compressible inputs stored compressed");
+    
+    safe_free((void**)&data);
+    cache_instance_destroy(cache);
+}
+
+// =============================================================================
+// Invalidation
+// =============================================================================
+
+static void free_keys(char** keys, size_t count) {
+    for (size_t i = 0; i < count; i++) free(keys[i]);
+    free(keys);
+}
+
+void test_cache_tag_invalidation(void) {
+    printf("\n=== Test: Tag Invalidation ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(10000);
+    const char* shoe_tags[] = { "catalog", "shoes" };
+    const char* hat_tags[] = { "catalog", "hats", "hats" };
+    char key[32];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "product:%d", i);
+        cache_set_with_tags(cache, key, "p", 1, i % 2 ? hat_tags : shoe_tags, i % 2 ? 3 : 2);
+    }
+    cache_set(cache, "untagged", "x", 1);
+    
+    char** keys = NULL;
+    size_t count = 0;
+    TEST_ASSERT(cache_get_keys_by_tag(cache, "hats", &keys, &count) == SUCCESS && count == 500,
+                "Keys by tag");
+    free_keys(keys, count);
+    
+    // Re-tagging moves the key between tags
+    const char* sale_tags[] = { "sale" };
+    cache_set_with_tags(cache, "product:1", "p", 1, sale_tags, 1);
+    cache_get_keys_by_tag(cache, "hats", &keys, &count);
+    TEST_ASSERT(count == 499, "Re-tagged key left its old tags");
+    free_keys(keys, count);
+    
+    cache_delete(cache, "product:3");
+    TEST_ASSERT(cache_invalidate_tag(cache, "hats") == 498, "Invalidate tag removes its keys");
+    TEST_ASSERT(!cache_exists(cache, "product:5") && cache_exists(cache, "product:4"), "Other tags kept");
+    
+    cache_get_keys_by_tag(cache, "catalog", &keys, &count);
+    TEST_ASSERT(count == 500, "Shared tag no longer lists removed keys");
+    free_keys(keys, count);
+    
+    TEST_ASSERT(cache_invalidate_tag(cache, "catalog") == 500, "Invalidate shared tag");
+    TEST_ASSERT(cache_invalidate_tag(cache, "catalog") == 0, "Tag gone once empty");
+    TEST_ASSERT(cache_exists(cache, "untagged") && cache_exists(cache, "product:1"), "Untagged keys kept");
+    
+    cache_instance_destroy(cache);
+}
+
+void test_cache_tag_eviction(void) {
+    printf("\n=== Test: Tag Index Follows Eviction ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(10);
+    const char* tags[] = { "session" };
+    char key[32];
+    for (int i = 0; i < 50; i++) {
+        snprintf(key, sizeof(key), "s%d", i);
+        cache_set_with_tags(cache, key, "v", 1, tags, 1);
+    }
+    
+    char** keys = NULL;
+    size_t count = 0;
+    cache_get_keys_by_tag(cache, "session", &keys, &count);
+    TEST_ASSERT(count == 10, "Evicted keys dropped from the tag index");
+    free_keys(keys, count);
+    
+    cache_set_ttl(cache, "s49", 10);
+    sleep_ms(30);
+    cache_expire_keys(cache);
+    TEST_ASSERT(cache_invalidate_tag(cache, "session") == 9, "Expired keys dropped from the tag index");
+    
+    cache_instance_destroy(cache);
+}
+
+void test_cache_pattern_invalidation(void) {
+    printf("\n=== Test: Pattern Invalidation ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(10000);
+    char key[32];
+    for (int user = 0; user < 100; user++) {
+        snprintf(key, sizeof(key), "user:%d:profile", user);
+        cache_set(cache, key, "p", 1);
+        snprintf(key, sizeof(key), "user:%d:cart", user);
+        cache_set(cache, key, "c", 1);
+    }
+    cache_set(cache, "user:42", "u", 1);
+    cache_set(cache, "users", "all", 3);
+    
+    TEST_ASSERT(cache_invalidate_pattern(cache, "user:42:*") == 2, "Prefix pattern");
+    TEST_ASSERT(cache_exists(cache, "user:42") && cache_exists(cache, "user:43:cart"), "Neighbours kept");
+    TEST_ASSERT(cache_invalidate_pattern(cache, "user:4*") == 21, "Prefix ending inside a segment");
+    TEST_ASSERT(cache_invalidate_pattern(cache, "nothing:*") == 0, "Prefix without matches");
+    TEST_ASSERT(cache_invalidate_pattern(cache, "users") == 1, "Literal pattern removes one key");
+    
+    TEST_ASSERT(cache_invalidate_pattern(cache, "*:cart") == 89, "Glob without prefix");
+    TEST_ASSERT(cache_invalidate_pattern(cache, "user:?:profile") == 9, "Glob with prefix");
+    TEST_ASSERT(cache_exists(cache, "user:10:profile"), "Non-matching key kept");
+    
+    size_t total = 0;
+    cache_get_size(cache, &total);
+    TEST_ASSERT(total == 80, "Remaining key count");
+    
+    TEST_ASSERT(cache_invalidate_pattern(cache, "*") == 80, "Match everything");
+    cache_set(cache, "user:1:profile", "p", 1);
+    TEST_ASSERT(cache_invalidate_pattern(cache, "user:1*") == 1, "Trie usable after emptying");
+    
+    cache_instance_destroy(cache);
+}
+
+void test_cache_pattern_trie_consistency(void) {
+    printf("\n=== Test: Key Trie Consistency ===\n");
+    
+    // Keys sharing long prefixes force edge splits on insert and merges on delete
+    cache_instance_t* cache = create_memory_cache(100000);
+    const char* prefixes[] = { "a", "ab", "abc", "abd", "b" };
+    char key[32];
+    for (int i = 0; i < 2000; i++) {
+        snprintf(key, sizeof(key), "%s%d", prefixes[i % 5], i);
+        cache_set(cache, key, "v", 1);
+    }
+    for (int i = 0; i < 2000; i += 3) {
+        snprintf(key, sizeof(key), "%s%d", prefixes[i % 5], i);
+        cache_delete(cache, key);
+    }
+    
+    // Brute-force count of live keys under "ab"
+    int expected = 0;
+    for (int i = 0; i < 2000; i++) {
+        if (i % 3 != 0 && i % 5 >= 1 && i % 5 <= 3) expected++;
+    }
+    TEST_ASSERT(cache_invalidate_pattern(cache, "ab*") == expected, "Prefix count after mixed deletes");
+    
+    // Enough keys that a prefix-less glob walks each shard over many lock
+    // holds, resuming where the last one stopped
+    for (int i = 0; i < 60000; i++) {
+        snprintf(key, sizeof(key), "glob:%d", i);
+        cache_set(cache, key, "v", 1);
+    }
+    expected = 0;
+    for (int i = 0; i < 60000; i++) {
+        if (i % 10 == 7) expected++;
+    }
+    TEST_ASSERT(cache_invalidate_pattern(cache, "*:*7") == expected, "Glob resumed across lock holds");
+    TEST_ASSERT(cache_exists(cache, "glob:8") && !cache_exists(cache, "glob:59997"), "Only glob matches removed");
+    
+    size_t total = 0;
+    cache_get_size(cache, &total);
+    TEST_ASSERT(cache_invalidate_pattern(cache, "*") == (int)total, "Remaining keys all reachable");
+    
+    cache_instance_destroy(cache);
+}
+
+// =============================================================================
+// Stampede Prevention
+// =============================================================================
+
+typedef struct {
+    int calls;
+    uint64_t delay_ms;
+    bool fail;
+} test_loader_t;
+
+static void* test_loader(const char* key, void* ctx, size_t* size) {
+    test_loader_t* loader = (test_loader_t*)ctx;
+    __atomic_fetch_add(&loader->calls, 1, __ATOMIC_SEQ_CST);
+    sleep_ms(loader->delay_ms);
+    if (loader->fail) {
+        return NULL;
+    }
+    
+    char* value = safe_malloc(64);
+    *size = (size_t)snprintf(value, 64, "loaded:%s", key) + 1;
+    return value;
+}
+
+#define STAMPEDE_THREADS 32
+
+typedef struct {
+    cache_instance_t* cache;
+    test_loader_t* loader;
+    pthread_barrier_t* barrier;
+    int result;
+    bool value_ok;
+} stampede_caller_t;
+
+static void* stampede_caller(void* arg) {
+    stampede_caller_t* caller = (stampede_caller_t*)arg;
+    pthread_barrier_wait(caller->barrier);
+    
+    void* value = NULL;
+    size_t size = 0;
+    caller->result = cache_get_with_lock(caller->cache, "hot", &value, &size,
+                                         test_loader, caller->loader);
+    caller->value_ok = caller->result == SUCCESS && strcmp(value, "loaded:hot") == 0;
+    free(value);
+    return NULL;
+}
+
+// Releases STAMPEDE_THREADS callers on one missing key at once
+static void run_stampede(cache_instance_t* cache, test_loader_t* loader, stampede_caller_t* callers) {
+    pthread_t threads[STAMPEDE_THREADS];
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, STAMPEDE_THREADS);
+    
+    for (int i = 0; i < STAMPEDE_THREADS; i++) {
+        callers[i] = (stampede_caller_t){ cache, loader, &barrier, 0, false };
+        pthread_create(&threads[i], NULL, stampede_caller, &callers[i]);
+    }
+    for (int i = 0; i < STAMPEDE_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    
+    pthread_barrier_destroy(&barrier);
+}
+
+void test_cache_single_flight(void) {
+    printf("\n=== Test: Single-Flight Load ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(100);
+    test_loader_t loader = { 0, 50, false };
+    stampede_caller_t callers[STAMPEDE_THREADS];
+    
+    run_stampede(cache, &loader, callers);
+    
+    bool all_ok = true;
+    for (int i = 0; i < STAMPEDE_THREADS; i++) {
+        if (!callers[i].value_ok) all_ok = false;
+    }
+    TEST_ASSERT(loader.calls == 1, "Loader ran once for concurrent misses");
+    TEST_ASSERT(all_ok, "Every caller received the loaded value");
+    TEST_ASSERT(cache_exists(cache, "hot"), "Loaded value cached");
+    
+    void* value = NULL;
+    cache_get_with_lock(cache, "hot", &value, NULL, test_loader, &loader);
+    TEST_ASSERT(loader.calls == 1, "Cached value served without loading");
+    free(value);
+    
+    cache_instance_destroy(cache);
+}
+
+void test_cache_single_flight_error(void) {
+    printf("\n=== Test: Single-Flight Error Propagation ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(100);
+    test_loader_t loader = { 0, 50, true };
+    stampede_caller_t callers[STAMPEDE_THREADS];
+    
+    run_stampede(cache, &loader, callers);
+    
+    bool all_failed = true;
+    for (int i = 0; i < STAMPEDE_THREADS; i++) {
+        if (callers[i].result != ERROR_NOT_FOUND) all_failed = false;
+    }
+    TEST_ASSERT(loader.calls == 1, "Failing loader ran once");
+    TEST_ASSERT(all_failed, "Failure reported to every waiter");
+    TEST_ASSERT(!cache_exists(cache, "hot"), "Failure not cached");
+    
+    loader.fail = false;
+    loader.delay_ms = 0;
+    void* value = NULL;
+    TEST_ASSERT(cache_get_with_lock(cache, "hot", &value, NULL, test_loader, &loader) == SUCCESS &&
+                loader.calls == 2, "Next caller retries the load");
+    free(value);
+    
+    cache_instance_destroy(cache);
+}
+
+void test_cache_single_flight_timeout(void) {
+    printf("\n=== Test: Single-Flight Timeout ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(100);
+    stampede_config_t config = { STAMPEDE_LOCK, 20, 0.0, 0 };
+    TEST_ASSERT(cache_with_stampede_prevention(cache, &config) == cache, "Configure lock timeout");
+    
+    test_loader_t loader = { 0, 200, false };
+    stampede_caller_t callers[STAMPEDE_THREADS];
+    run_stampede(cache, &loader, callers);
+    
+    int succeeded = 0;
+    int timed_out = 0;
+    for (int i = 0; i < STAMPEDE_THREADS; i++) {
+        if (callers[i].result == SUCCESS) succeeded++;
+        if (callers[i].result == ERROR_TIMEOUT) timed_out++;
+    }
+    TEST_ASSERT(loader.calls == 1 && succeeded == 1, "Only the loading caller succeeded");
+    TEST_ASSERT(timed_out == STAMPEDE_THREADS - 1, "Waiters gave up after the lock timeout");
+    
+    cache_instance_destroy(cache);
+}
+
+void test_cache_key_lock(void) {
+    printf("\n=== Test: Key Locks ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(100);
+    
+    cache_lock_t* lock = cache_lock_acquire(cache, "k", 100);
+    TEST_ASSERT(lock != NULL, "Acquire lock");
+    
+    cache_lock_t* other = NULL;
+    TEST_ASSERT(!cache_lock_try_acquire(cache, "k", &other) && other == NULL, "Held lock not acquired");
+    TEST_ASSERT(cache_lock_acquire(cache, "k", 20) == NULL, "Acquire times out while held");
+    TEST_ASSERT(cache_lock_try_acquire(cache, "other", &other), "Other key lockable");
+    cache_lock_release(other);
+    
+    TEST_ASSERT(cache_lock_release(lock) == SUCCESS, "Release lock");
+    TEST_ASSERT(cache_lock_try_acquire(cache, "k", &other), "Lock free after release");
+    cache_lock_release(other);
+    
+    cache_instance_destroy(cache);
+}
+
+static cache_instance_t* create_ttl_cache(uint64_t default_ttl_ms) {
+    cache_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.type = CACHE_TYPE_MEMORY;
+    config.eviction_policy = CACHE_EVICTION_LRU;
+    config.max_size = 100;
+    config.default_ttl_ms = default_ttl_ms;
+    return cache_instance_create(&config);
+}
+
+void test_cache_probabilistic_refresh(void) {
+    printf("\n=== Test: Probabilistic Early Refresh ===\n");
+    
+    cache_instance_t* cache = create_ttl_cache(200);
+    stampede_config_t config = { STAMPEDE_PROBABILISTIC, 1000, 3.0, 0 };
+    cache_with_stampede_prevention(cache, &config);
+    
+    test_loader_t loader = { 0, 20, false };
+    void* value = NULL;
+    int failures = 0;
+    
+    // Keep reading well past the first TTL; XFetch should reload ahead of expiry
+    for (int i = 0; i < 100; i++) {
+        if (cache_get_with_lock(cache, "hot", &value, NULL, test_loader, &loader) != SUCCESS) {
+            failures++;
+        }
+        free(value);
+        value = NULL;
+        sleep_ms(5);
+    }
+    
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    TEST_ASSERT(failures == 0, "Every read succeeded");
+    TEST_ASSERT(loader.calls >= 2, "Value reloaded while reads continued");
+    TEST_ASSERT(stats.misses == 1, "Only the first read missed");
+    TEST_ASSERT(stats.early_refreshes == (uint64_t)loader.calls - 1, "Reloads counted as early refreshes");
+    
+    cache_instance_destroy(cache);
+}
+
+void test_cache_precompute_refresh(void) {
+    printf("\n=== Test: Background Refresh-Ahead ===\n");
+    
+    cache_instance_t* cache = create_ttl_cache(200);
+    stampede_config_t config = { STAMPEDE_PRECOMPUTE, 1000, 0.0, 100 };
+    cache_with_stampede_prevention(cache, &config);
+    
+    test_loader_t loader = { 0, 30, false };
+    void* value = NULL;
+    TEST_ASSERT(cache_get_with_lock(cache, "hot", &value, NULL, test_loader, &loader) == SUCCESS,
+                "Initial load");
+    free(value);
+    
+    uint64_t ttl = 0;
+    sleep_ms(120);
+    
+    // Inside the refresh window: served from cache without waiting on the load
+    uint64_t start = get_timestamp_ms();
+    TEST_ASSERT(cache_get_with_lock(cache, "hot", &value, NULL, test_loader, &loader) == SUCCESS &&
+                value && strcmp((char*)value, "loaded:hot") == 0, "Hit returns current value");
+    TEST_ASSERT(get_timestamp_ms() - start < 30, "Hit did not block on the reload");
+    free(value);
+    
+    sleep_ms(60);
+    TEST_ASSERT(loader.calls == 2, "Reloaded in the background");
+    TEST_ASSERT(cache_get_ttl(cache, "hot", &ttl) == SUCCESS && ttl > 100, "TTL renewed before expiry");
+    
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    TEST_ASSERT(stats.misses == 1 && stats.early_refreshes == 1, "One miss, one early refresh");
+    
+    cache_instance_destroy(cache);
+}
+
+// =============================================================================
+// Write-Behind
+// =============================================================================
+
+typedef struct {
+    pthread_mutex_t lock;
+    int calls;
+    int writes;        // Successful writes
+    int fail_first;    // Fail this many calls before succeeding
+    bool always_fail;
+    uint64_t delay_ms;
+    char last_value[64];
+} test_writer_t;
+
+static int test_writer(const char* key, const void* value, size_t size, void* ctx) {
+    (void)key;
+    test_writer_t* writer = (test_writer_t*)ctx;
+    sleep_ms(writer->delay_ms);
+    
+    pthread_mutex_lock(&writer->lock);
+    writer->calls++;
+    int rc = SUCCESS;
+    if (writer->always_fail || writer->calls <= writer->fail_first) {
+        rc = ERROR_IO;
+    } else {
+        writer->writes++;
+        snprintf(writer->last_value, sizeof(writer->last_value), "%.*s", (int)size, (const char*)value);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return rc;
+}
+
+static int writer_writes(test_writer_t* writer) {
+    pthread_mutex_lock(&writer->lock);
+    int writes = writer->writes;
+    pthread_mutex_unlock(&writer->lock);
+    return writes;
+}
+
+void test_write_behind_coalescing(void) {
+    printf("\n=== Test: Write-Behind Coalescing ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(100);
+    test_writer_t writer = { .lock = PTHREAD_MUTEX_INITIALIZER };
+    write_behind_config_t config = { 16, 16, 10000, 0, 0 };
+    write_behind_cache_t* wb = write_behind_cache_create_with_config(cache, test_writer, &writer, &config);
+    TEST_ASSERT(wb != NULL, "Create write-behind cache");
+    
+    char value[16];
+    for (int i = 0; i < 10; i++) {
+        snprintf(value, sizeof(value), "v%d", i);
+        write_behind_set(wb, "counter", value, strlen(value));
+    }
+    
+    void* cached = NULL;
+    size_t size = 0;
+    TEST_ASSERT(cache_get(cache, "counter", &cached, &size) == SUCCESS &&
+                size == 2 && memcmp(cached, "v9", 2) == 0, "Cache updated immediately");
+    free(cached);
+    TEST_ASSERT(writer_writes(&writer) == 0, "Nothing written before the flush");
+    
+    TEST_ASSERT(write_behind_flush(wb) == SUCCESS, "Flush");
+    TEST_ASSERT(writer.writes == 1 && strcmp(writer.last_value, "v9") == 0, "One write with the latest value");
+    
+    write_behind_stats_t stats;
+    write_behind_get_stats(wb, &stats);
+    TEST_ASSERT(stats.writes == 10 && stats.coalesced == 9 && stats.flushed == 1, "Coalescing counted");
+    TEST_ASSERT(stats.pending == 0 && stats.max_lag_ms >= stats.avg_lag_ms, "Lag tracked");
+    
+    write_behind_cache_destroy(wb);
+    cache_instance_destroy(cache);
+}
+
+void test_write_behind_triggers(void) {
+    printf("\n=== Test: Write-Behind Flush Triggers ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(100);
+    test_writer_t writer = { .lock = PTHREAD_MUTEX_INITIALIZER };
+    
+    // Size trigger: a full batch goes out without waiting for the interval
+    write_behind_config_t config = { 16, 4, 10000, 0, 0 };
+    write_behind_cache_t* wb = write_behind_cache_create_with_config(cache, test_writer, &writer, &config);
+    char key[16];
+    for (int i = 0; i < 4; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        write_behind_set(wb, key, "x", 1);
+    }
+    sleep_ms(50);
+    TEST_ASSERT(writer_writes(&writer) == 4, "Full batch flushed");
+    write_behind_cache_destroy(wb);
+    
+    // Time trigger: a lone write goes out after flush_interval_ms
+    writer.writes = 0;
+    config = (write_behind_config_t){ 16, 64, 20, 0, 0 };
+    wb = write_behind_cache_create_with_config(cache, test_writer, &writer, &config);
+    write_behind_set(wb, "lone", "x", 1);
+    TEST_ASSERT(writer_writes(&writer) == 0, "Not flushed immediately");
+    sleep_ms(100);
+    TEST_ASSERT(writer_writes(&writer) == 1, "Flushed after the interval");
+    
+    // Destroy writes whatever is still queued
+    write_behind_set(wb, "late", "x", 1);
+    write_behind_cache_destroy(wb);
+    TEST_ASSERT(writer.writes == 2, "Destroy drains the queue");
+    
+    cache_instance_destroy(cache);
+}
+
+void test_write_behind_retry(void) {
+    printf("\n=== Test: Write-Behind Retry ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(100);
+    test_writer_t writer = { .lock = PTHREAD_MUTEX_INITIALIZER, .fail_first = 2 };
+    write_behind_config_t config = { 16, 16, 10000, 3, 1 };
+    write_behind_cache_t* wb = write_behind_cache_create_with_config(cache, test_writer, &writer, &config);
+    
+    write_behind_set(wb, "k", "v", 1);
+    TEST_ASSERT(write_behind_flush(wb) == SUCCESS, "Flush succeeds after retries");
+    
+    write_behind_stats_t stats;
+    write_behind_get_stats(wb, &stats);
+    TEST_ASSERT(writer.writes == 1 && stats.retries == 2, "Two retries before success");
+    
+    writer.always_fail = true;
+    write_behind_set(wb, "k", "v", 1);
+    TEST_ASSERT(write_behind_flush(wb) == ERROR_IO, "Flush reports a dropped write");
+    write_behind_get_stats(wb, &stats);
+    TEST_ASSERT(stats.failed == 1 && stats.retries == 5, "Dropped after max_retries");
+    
+    write_behind_cache_destroy(wb);
+    cache_instance_destroy(cache);
+}
+
+void test_write_behind_backpressure(void) {
+    printf("\n=== Test: Write-Behind Backpressure ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(100);
+    test_writer_t writer = { .lock = PTHREAD_MUTEX_INITIALIZER, .delay_ms = 30 };
+    write_behind_config_t config = { 2, 1, 10000, 0, 0 };
+    write_behind_cache_t* wb = write_behind_cache_create_with_config(cache, test_writer, &writer, &config);
+    
+    // Two keys fit; the flusher takes one at a time, each taking 30 ms
+    uint64_t start = get_timestamp_ms();
+    char key[16];
+    for (int i = 0; i < 6; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        write_behind_set(wb, key, "x", 1);
+    }
+    uint64_t elapsed = get_timestamp_ms() - start;
+    TEST_ASSERT(elapsed >= 60, "Writers blocked while the queue was full");
+    
+    write_behind_stats_t stats;
+    write_behind_get_stats(wb, &stats);
+    TEST_ASSERT(stats.pending <= 2, "Queue bounded by queue_size");
+    
+    TEST_ASSERT(write_behind_flush(wb) == SUCCESS && writer.writes == 6, "All writes reached the backend");
+    
+    write_behind_cache_destroy(wb);
+    cache_instance_destroy(cache);
+}
+
+// =============================================================================
+// Cache Warming
+// =============================================================================
+
+#define WARMUP_KEYS 1000
+
+typedef struct {
+    int calls;
+    size_t value_size;        // 0 = "value:<key>"
+} warmup_source_t;
+
+// Keys starting with "bad" fail to load
+static void* warmup_loader(const char* key, void* ctx, size_t* size) {
+    warmup_source_t* loader = (warmup_source_t*)ctx;
+    __atomic_add_fetch(&loader->calls, 1, __ATOMIC_RELAXED);
+    if (strncmp(key, "bad", 3) == 0) {
+        return NULL;
+    }
+    
+    size_t length = loader->value_size > 0 ? loader->value_size : strlen(key) + 7;
+    char* value = malloc(length);
+    if (loader->value_size > 0) {
+        memset(value, 'v', length);
+    } else {
+        memcpy(value, "value:", 6);
+        memcpy(value + 6, key, strlen(key) + 1);
+    }
+    *size = length;
+    return value;
+}
+
+static void* cpu_bound_loader(const char* key, void* ctx, size_t* size) {
+    (void)ctx;
+    struct timespec start, now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    do {
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1000000000L + (now.tv_nsec - start.tv_nsec) < 2000000L);
+    
+    *size = strlen(key) + 1;
+    return strdup(key);
+}
+
+static char** make_keys(const char* prefix, size_t count) {
+    char** keys = malloc(count * sizeof(char*));
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = malloc(32);
+        snprintf(keys[i], 32, "%s%zu", prefix, i);
+    }
+    return keys;
+}
+
+void test_cache_warmup(void) {
+    printf("\n=== Test: Cache Warmup ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(0);
+    char** keys = make_keys("warm:", WARMUP_KEYS);
+    warmup_source_t loader = { 0, 0 };
+    
+    warmup_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.strategy = WARMUP_ALL;
+    config.batch_size = 50;
+    config.keys = (const char**)keys;
+    config.key_count = WARMUP_KEYS;
+    
+    warmup_result_t* result = cache_warmup(cache, warmup_loader, &loader, &config);
+    TEST_ASSERT(result != NULL, "Warmup ran");
+    TEST_ASSERT(result->keys_loaded == WARMUP_KEYS && result->keys_failed == 0, "Every key loaded");
+    TEST_ASSERT(result->keys_per_second > 0.0, "Throughput reported");
+    TEST_ASSERT(result->memory_used_mb > 0.0, "Memory growth reported");
+    TEST_ASSERT(loader.calls == WARMUP_KEYS, "Loader called once per key");
+    warmup_result_destroy(result);
+    
+    void* value = NULL;
+    size_t value_size = 0;
+    TEST_ASSERT(cache_get(cache, "warm:999", &value, &value_size) == SUCCESS &&
+                strcmp(value, "value:warm:999") == 0, "Warmed value readable");
+    free(value);
+    
+    // A second run finds everything cached
+    result = cache_warmup(cache, warmup_loader, &loader, &config);
+    TEST_ASSERT(result->keys_loaded == 0 && result->keys_skipped == WARMUP_KEYS, "Cached keys skipped");
+    TEST_ASSERT(loader.calls == WARMUP_KEYS, "Loader not called for cached keys");
+    warmup_result_destroy(result);
+    
+    // Loader failures are counted, not fatal
+    const char* mixed[] = {"good:1", "bad:1", "good:2", "bad:2"};
+    config.keys = mixed;
+    config.key_count = 4;
+    config.batch_size = 1;
+    result = cache_warmup(cache, warmup_loader, &loader, &config);
+    TEST_ASSERT(result->keys_loaded == 2 && result->keys_failed == 2, "Failed loads counted");
+    warmup_result_destroy(result);
+    
+    TEST_ASSERT(cache_preload_keys(cache, mixed, 4, warmup_loader, &loader) == ERROR_IO, "Preload reports failures");
+    TEST_ASSERT(cache_preload_keys(cache, mixed, 1, warmup_loader, &loader) == SUCCESS, "Preload of good keys succeeds");
+    TEST_ASSERT(cache_warmup(cache, NULL, NULL, &config) == NULL, "Warmup without loader rejected");
+    
+    free_keys(keys, WARMUP_KEYS);
+    cache_instance_destroy(cache);
+}
+
+void test_cache_warmup_popular(void) {
+    printf("\n=== Test: Cache Warmup Popular Keys ===\n");
+    
+    // Record a run where every tenth key is hot
+    cache_instance_t* cache = create_memory_cache(0);
+    char** keys = make_keys("item:", 100);
+    for (size_t i = 0; i < 100; i++) {
+        cache_set(cache, keys[i], "x", 1);
+    }
+    for (size_t i = 0; i < 100; i += 10) {
+        for (size_t hits = 0; hits < 5 + i; hits++) {
+            cache_get(cache, keys[i], NULL, NULL);
+        }
+    }
+    char path[] = "/tmp/test_warmup_profile_XXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+    TEST_ASSERT(cache_save_access_profile(cache, path) == SUCCESS, "Access profile saved");
+    cache_instance_destroy(cache);
+    
+    // Restart: load the ten hottest keys from the profile alone
+    cache = create_memory_cache(0);
+    warmup_source_t loader = { 0, 0 };
+    warmup_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.strategy = WARMUP_POPULAR;
+    config.batch_size = 4;
+    config.profile_path = path;
+    config.max_keys = 10;
+    
+    warmup_result_t* result = cache_warmup(cache, warmup_loader, &loader, &config);
+    TEST_ASSERT(result != NULL && result->keys_loaded == 10, "Ten keys warmed");
+    bool hot_only = true;
+    for (size_t i = 0; i < 100; i++) {
+        if (cache_exists(cache, keys[i]) != (i % 10 == 0)) {
+            hot_only = false;
+        }
+    }
+    TEST_ASSERT(hot_only, "Exactly the hot keys were warmed");
+    warmup_result_destroy(result);
+    
+    // A given key list is reordered by the profile
+    cache_invalidate_all(cache);
+    const char* candidates[] = {"item:1", "item:2", "item:90", "item:3", "item:50"};
+    config.keys = candidates;
+    config.key_count = 5;
+    config.max_keys = 2;
+    result = cache_warmup(cache, warmup_loader, &loader, &config);
+    TEST_ASSERT(result->keys_loaded == 2 && cache_exists(cache, "item:90") && cache_exists(cache, "item:50"),
+                "Hottest candidates loaded first");
+    warmup_result_destroy(result);
+    
+    // No profile yet: keys load in the order given
+    unlink(path);
+    cache_invalidate_all(cache);
+    result = cache_warmup(cache, warmup_loader, &loader, &config);
+    TEST_ASSERT(result != NULL && cache_exists(cache, "item:1") && cache_exists(cache, "item:2"),
+                "Missing profile falls back to the given order");
+    warmup_result_destroy(result);
+    
+    free_keys(keys, 100);
+    cache_instance_destroy(cache);
+}
+
+void test_cache_warmup_throttling(void) {
+    printf("\n=== Test: Cache Warmup Throttling ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(0);
+    char** keys = make_keys("paced:", 50);
+    warmup_source_t loader = { 0, 0 };
+    
+    warmup_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.strategy = WARMUP_ALL;
+    config.batch_size = 10;
+    config.delay_between_batches_ms = 25;
+    config.keys = (const char**)keys;
+    config.key_count = 50;
+    
+    warmup_result_t* result = cache_warmup(cache, warmup_loader, &loader, &config);
+    printf("  5 batches, 25ms apart: %lu ms\n", (unsigned long)result->total_time_ms);
+    TEST_ASSERT(result->keys_loaded == 50, "Paced warmup loaded everything");
+    TEST_ASSERT(result->total_time_ms >= 95, "Batches started at least the delay apart");
+    warmup_result_destroy(result);
+    free_keys(keys, 50);
+    cache_instance_destroy(cache);
+    
+    // Stop once the cache reaches half of its memory budget
+    cache_config_t cache_config;
+    memset(&cache_config, 0, sizeof(cache_config));
+    cache_config.type = CACHE_TYPE_MEMORY;
+    cache_config.eviction_policy = CACHE_EVICTION_LRU;
+    cache_config.max_memory_mb = 4;
+    cache = cache_instance_create(&cache_config);
+    keys = make_keys("big:", 1000);
+    loader.value_size = 8192;
+    
+    config.delay_between_batches_ms = 0;
+    config.batch_size = 16;
+    config.strategy = WARMUP_INCREMENTAL;   // One loader, so the cutoff is prompt
+    config.max_memory_usage = 0.5;
+    config.keys = (const char**)keys;
+    config.key_count = 1000;
+    result = cache_warmup(cache, warmup_loader, &loader, &config);
+    
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    printf("  Memory limited: %lu loaded, %lu skipped, %.2f MB used\n",
+           (unsigned long)result->keys_loaded, (unsigned long)result->keys_skipped, stats.memory_used_mb);
+    TEST_ASSERT(result->keys_skipped > 0 && result->keys_loaded < 1000, "Warmup stopped at the memory limit");
+    TEST_ASSERT(result->keys_loaded + result->keys_skipped == 1000, "Every key accounted for");
+    TEST_ASSERT(stats.memory_used_mb < 2.5, "Memory stayed near the limit");
+    TEST_ASSERT(stats.evictions == 0, "Warmup didn't evict");
+    warmup_result_destroy(result);
+    free_keys(keys, 1000);
+    cache_instance_destroy(cache);
+    
+    // Half a CPU for a loader that burns 2 ms of CPU per key
+    cache = create_memory_cache(0);
+    keys = make_keys("cpu:", 20);
+    memset(&config, 0, sizeof(config));
+    config.strategy = WARMUP_INCREMENTAL;
+    config.batch_size = 5;
+    config.max_cpu_usage = 0.5 / sysconf(_SC_NPROCESSORS_ONLN);
+    config.keys = (const char**)keys;
+    config.key_count = 20;
+    result = cache_warmup(cache, cpu_bound_loader, NULL, &config);
+    printf("  40 ms of loader CPU at a 50%% cap: %lu ms\n", (unsigned long)result->total_time_ms);
+    TEST_ASSERT(result->keys_loaded == 20, "CPU-capped warmup loaded everything");
+    TEST_ASSERT(result->total_time_ms >= 70, "CPU cap stretched the warmup");
+    warmup_result_destroy(result);
+    free_keys(keys, 20);
+    cache_instance_destroy(cache);
+}
+
+// =============================================================================
+// Near Cache
+// =============================================================================
+
+static near_cache_t* create_near_cache(cache_instance_t* cache, uint64_t max_stale_ops) {
+    near_cache_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.l1_entries = 64;
+    config.max_value_size = 256;
+    config.max_stale_ops = max_stale_ops;
+    return near_cache_create(cache, &config);
+}
+
+static bool near_value_is(near_cache_t* near, const char* key, const char* expected) {
+    void* value = NULL;
+    size_t size = 0;
+    int result = near_cache_get(near, key, &value, &size);
+    bool matches = result == SUCCESS && size == strlen(expected) + 1 && strcmp(value, expected) == 0;
+    free(value);
+    return matches;
+}
+
+void test_near_cache_basic(void) {
+    printf("\n=== Test: Near Cache Basic Operations ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(0);
+    near_cache_t* near = create_near_cache(cache, 1);
+    TEST_ASSERT(near != NULL, "Near cache created");
+    
+    TEST_ASSERT(near_cache_set(near, "user:1", "alice", 6) == SUCCESS, "Set through near cache");
+    TEST_ASSERT(near_value_is(near, "user:1", "alice"), "First read fetched from the shared cache");
+    TEST_ASSERT(near_value_is(near, "user:1", "alice"), "Second read served by L1");
+    
+    near_cache_stats_t stats;
+    near_cache_get_stats(near, &stats);
+    TEST_ASSERT(stats.l1_hits == 1 && stats.l1_misses == 1, "L1 hit and miss counted");
+    TEST_ASSERT(stats.l1_hit_rate == 0.5 && stats.threads == 1, "Hit rate and thread count reported");
+    
+    near_cache_set(near, "user:1", "bob", 4);
+    TEST_ASSERT(near_value_is(near, "user:1", "bob"), "Writer reads its own write");
+    TEST_ASSERT(near_cache_delete(near, "user:1") == SUCCESS, "Delete through near cache");
+    TEST_ASSERT(near_cache_get(near, "user:1", NULL, NULL) == ERROR_NOT_FOUND, "Deleted key gone from L1");
+    
+    // Values over max_value_size aren't kept in L1
+    char big[512];
+    memset(big, 'x', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    near_cache_set(near, "big", big, sizeof(big));
+    near_cache_get_stats(near, &stats);
+    uint64_t hits = stats.l1_hits;
+    TEST_ASSERT(near_value_is(near, "big", big) && near_value_is(near, "big", big), "Large value readable");
+    near_cache_get_stats(near, &stats);
+    TEST_ASSERT(stats.l1_hits == hits, "Large value bypassed L1");
+    
+    // L1 entries expire with the shared entry
+    cache_set_with_ttl(cache, "session", "token", 6, 50);
+    near_value_is(near, "session", "token");
+    TEST_ASSERT(near_value_is(near, "session", "token"), "Entry with TTL cached in L1");
+    sleep_ms(70);
+    TEST_ASSERT(near_cache_get(near, "session", NULL, NULL) == ERROR_NOT_FOUND, "L1 entry expired with its TTL");
+    
+    near_cache_destroy(near);
+    cache_instance_destroy(cache);
+}
+
+void test_near_cache_invalidation(void) {
+    printf("\n=== Test: Near Cache Invalidation ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(0);
+    near_cache_t* near = create_near_cache(cache, 8);
+    cache_set(cache, "price", "100", 4);
+    near_value_is(near, "price", "100");
+    
+    // Changes made straight to the shared cache reach L1 within max_stale_ops
+    cache_set(cache, "price", "120", 4);
+    int ops = 1;
+    while (ops <= 20 && !near_value_is(near, "price", "120")) {
+        ops++;
+    }
+    printf("  Overwrite seen after %d operations\n", ops);
+    TEST_ASSERT(ops <= 8, "Overwrite seen within max_stale_ops");
+    
+    cache_delete(cache, "price");
+    ops = 1;
+    while (ops <= 20 && near_cache_get(near, "price", NULL, NULL) == SUCCESS) {
+        ops++;
+    }
+    TEST_ASSERT(ops <= 8, "Delete seen within max_stale_ops");
+    
+    const char* tags[] = {"catalog"};
+    cache_set_with_tags(cache, "tagged", "v1", 3, tags, 1);
+    near_value_is(near, "tagged", "v1");
+    cache_invalidate_tag(cache, "catalog");
+    for (int i = 0; i < 8; i++) {
+        near_cache_get(near, "other", NULL, NULL);
+    }
+    TEST_ASSERT(near_cache_get(near, "tagged", NULL, NULL) == ERROR_NOT_FOUND, "Tag invalidation reached L1");
+    
+    near_cache_stats_t stats;
+    near_cache_get_stats(near, &stats);
+    printf("  Staleness: %.1f us avg, %.1f us max\n", stats.avg_staleness_us, stats.max_staleness_us);
+    TEST_ASSERT(stats.l1_invalidations >= 3, "L1 invalidations counted");
+    TEST_ASSERT(stats.invalidations >= stats.l1_invalidations, "Published changes counted");
+    TEST_ASSERT(stats.max_staleness_us > 0.0 && stats.max_stale_ops == 8, "Staleness reported");
+    
+    // Falling more than the log behind drops the whole L1
+    cache_set(cache, "price", "130", 4);
+    near_value_is(near, "price", "130");
+    for (int i = 0; i < 5000; i++) {
+        cache_set(cache, "churn", &i, sizeof(i));
+    }
+    cache_set(cache, "price", "140", 4);
+    ops = 1;
+    while (ops <= 20 && !near_value_is(near, "price", "140")) {
+        ops++;
+    }
+    near_cache_get_stats(near, &stats);
+    TEST_ASSERT(ops <= 8 && stats.l1_flushes == 1, "Overrun L1 flushed and refilled");
+    
+    near_cache_destroy(near);
+    cache_instance_destroy(cache);
+}
+
+typedef struct {
+    near_cache_t* near;
+    pthread_barrier_t* barrier;
+    int ops_to_see_update;
+} near_reader_t;
+
+static void* near_reader(void* arg) {
+    near_reader_t* reader = (near_reader_t*)arg;
+    near_value_is(reader->near, "config", "v1");
+    near_value_is(reader->near, "config", "v1");
+    pthread_barrier_wait(reader->barrier);   // L1 warm
+    pthread_barrier_wait(reader->barrier);   // Writer done
+    
+    reader->ops_to_see_update = 1;
+    while (reader->ops_to_see_update <= 100 && !near_value_is(reader->near, "config", "v2")) {
+        reader->ops_to_see_update++;
+    }
+    return NULL;
+}
+
+void test_near_cache_threads(void) {
+    printf("\n=== Test: Near Cache Across Threads ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(0);
+    near_cache_t* near = create_near_cache(cache, 4);
+    near_cache_set(near, "config", "v1", 3);
+    
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, 5);
+    near_reader_t readers[4];
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++) {
+        readers[i] = (near_reader_t){ near, &barrier, 0 };
+        pthread_create(&threads[i], NULL, near_reader, &readers[i]);
+    }
+    
+    pthread_barrier_wait(&barrier);
+    near_cache_stats_t stats;
+    near_cache_get_stats(near, &stats);
+    TEST_ASSERT(stats.threads == 5 && stats.l1_hits == 4, "Each thread has its own L1");
+    
+    near_cache_set(near, "config", "v2", 3);
+    pthread_barrier_wait(&barrier);
+    bool bounded = true;
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+        bounded = bounded && readers[i].ops_to_see_update <= 4;
+    }
+    TEST_ASSERT(bounded, "Every reader saw the write within max_stale_ops");
+    
+    near_cache_get_stats(near, &stats);
+    TEST_ASSERT(stats.threads == 1, "Exited threads' L1s released");
+    TEST_ASSERT(stats.l1_invalidations == 4, "Counters of exited threads kept");
+    
+    pthread_barrier_destroy(&barrier);
+    near_cache_destroy(near);
+    cache_instance_destroy(cache);
+}
+
+// =============================================================================
+// Operation Stats
+// =============================================================================
+
+static const cache_operation_stats_t* find_op_stats(const cache_operation_stats_t* stats,
+                                                    size_t count, const char* operation) {
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(stats[i].operation, operation) == 0) {
+            return &stats[i];
+        }
+    }
+    return NULL;
+}
+
+static void* op_stats_worker(void* arg) {
+    cache_instance_t* cache = (cache_instance_t*)arg;
+    for (int i = 0; i < 100; i++) {
+        cache_get(cache, "key0", NULL, NULL);
+    }
+    return NULL;
+}
+
+void test_cache_operation_stats(void) {
+    printf("\n=== Test: Cache Operation Stats ===\n");
+    
+    cache_instance_t* cache = create_memory_cache(0);
+    char key[32];
+    for (int i = 0; i < 50; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        cache_set(cache, key, "value", 6);
+    }
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "key%d", i % 100);
+        cache_get(cache, key, NULL, NULL);
+    }
+    cache_delete(cache, "key1");
+    
+    test_loader_t loader = { 0, 5, false };
+    void* value = NULL;
+    cache_get_with_lock(cache, "slow", &value, NULL, test_loader, &loader);
+    free(value);
+    
+    cache_operation_stats_t* stats = NULL;
+    size_t count = 0;
+    TEST_ASSERT(cache_get_operation_stats(cache, &stats, &count) == SUCCESS, "Operation stats read");
+    const cache_operation_stats_t* get = find_op_stats(stats, count, "get");
+    const cache_operation_stats_t* set = find_op_stats(stats, count, "set");
+    const cache_operation_stats_t* del = find_op_stats(stats, count, "delete");
+    const cache_operation_stats_t* load = find_op_stats(stats, count, "load");
+    TEST_ASSERT(get && get->count == 200, "Gets counted");
+    TEST_ASSERT(set && set->count == 50, "Sets counted");
+    TEST_ASSERT(del && del->count == 1, "Delete counted");
+    TEST_ASSERT(!find_op_stats(stats, count, "mget"), "Unused operations omitted");
+    TEST_ASSERT(get && get->min_time_ms <= get->p95_time_ms && get->p95_time_ms <= get->p99_time_ms &&
+                get->p99_time_ms <= get->max_time_ms, "Percentiles ordered within [min, max]");
+    TEST_ASSERT(get && get->avg_time_ms > 0 && get->total_time_ms >= get->max_time_ms,
+                "Average and total recorded");
+    TEST_ASSERT(load && load->count == 1 && load->min_time_ms >= 4 && load->max_time_ms < 1000,
+                "Loader latency measured in milliseconds");
+    free(stats);
+    
+    TEST_ASSERT(cache_reset_stats(cache) == SUCCESS, "Stats reset");
+    cache_get_operation_stats(cache, &stats, &count);
+    TEST_ASSERT(count == 0, "Reset clears operation stats");
+    free(stats);
+    
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++) {
+        pthread_create(&threads[i], NULL, op_stats_worker, cache);
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    cache_get(cache, "key0", NULL, NULL);
+    cache_get_operation_stats(cache, &stats, &count);
+    get = find_op_stats(stats, count, "get");
+    TEST_ASSERT(get && get->count == 401, "Histograms of exited threads merged");
+    free(stats);
+    
+    TEST_ASSERT(cache_set_operation_timing(cache, false) == SUCCESS, "Timing switched off");
+    cache_get(cache, "key0", NULL, NULL);
+    cache_get_operation_stats(cache, &stats, &count);
+    get = find_op_stats(stats, count, "get");
+    TEST_ASSERT(get && get->count == 401, "Disabled timing records nothing");
+    free(stats);
+    
+    cache_set_operation_timing(cache, true);
+    cache_get(cache, "key0", NULL, NULL);
+    cache_get_operation_stats(cache, &stats, &count);
+    get = find_op_stats(stats, count, "get");
+    TEST_ASSERT(get && get->count == 402, "Timing switched back on");
+    free(stats);
+    
+    cache_instance_destroy(cache);
+}
+
+// =============================================================================
+// Redis Backend
+// =============================================================================
+
+// Loopback RESP servers (tools/resp_server) the Redis and cluster tests run
+// against. RESP_SERVER in the environment overrides the binary.
+static pid_t resp_server_pid = -1;
+static int resp_server_port = 0;
+
+static void stop_resp_server(pid_t pid) {
+    if (pid > 0) {
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+    }
+}
+
+// Returns the server's pid, or -1 if it didn't come up
+static pid_t start_resp_server(int* port) {
+    const char* path = getenv("RESP_SERVER");
+    if (!path) {
+        path = "./build/resp_server";
+    }
+    
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        execl(path, path, "-p", "0", (char*)NULL);
+        _exit(127);
+    }
+    close(fds[1]);
+    
+    // The server prints its port once it is accepting connections
+    *port = 0;
+    FILE* out = fdopen(fds[0], "r");
+    if (!out || pid < 0 || fscanf(out, "port %d", port) != 1) {
+        *port = 0;
+    }
+    if (out) {
+        fclose(out);
+    } else {
+        close(fds[0]);
+    }
+    if (*port == 0) {
+        stop_resp_server(pid);
+        return -1;
+    }
+    return pid;
+}
+
+static cache_instance_t* create_redis_cache(uint64_t default_ttl_ms) {
+    cache_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.type = CACHE_TYPE_REDIS;
+    config.default_ttl_ms = default_ttl_ms;
+    snprintf(config.redis_host, sizeof(config.redis_host), "127.0.0.1");
+    config.redis_port = resp_server_port;
+    config.redis_db = 1;
+    return cache_instance_create(&config);
+}
+
+void test_redis_basic_operations(void) {
+    printf("\n=== Test: Redis Basic Operations ===\n");
+    
+    cache_instance_t* cache = create_redis_cache(0);
+    TEST_ASSERT(cache_set(cache, "key", "v", 1) == ERROR_IO, "Operations fail before connecting");
+    TEST_ASSERT(cache_instance_connect(cache) == SUCCESS, "Connected to loopback server");
+    cache_invalidate_all(cache);
+    
+    // Binary-safe values, including bytes that look like protocol framing
+    const char binary[] = "a\r\n$3\r\n\0b";
+    void* value = NULL;
+    size_t size = 0;
+    TEST_ASSERT(cache_set(cache, "bin", binary, sizeof(binary)) == SUCCESS, "Set binary value");
+    TEST_ASSERT(cache_get(cache, "bin", &value, &size) == SUCCESS &&
+                size == sizeof(binary) && memcmp(value, binary, size) == 0, "Binary value round-trips");
+    safe_free(&value);
+    TEST_ASSERT(cache_get(cache, "missing", &value, &size) == ERROR_NOT_FOUND && value == NULL,
+                "Missing key reported");
+    TEST_ASSERT(cache_exists(cache, "bin") && !cache_exists(cache, "missing"), "Exists");
+    
+    int64_t counter = 0;
+    TEST_ASSERT(cache_increment(cache, "counter", 5, &counter) == SUCCESS && counter == 5, "INCRBY creates counter");
+    TEST_ASSERT(cache_decrement(cache, "counter", 7, &counter) == SUCCESS && counter == -2, "Decrement");
+    TEST_ASSERT(cache_increment(cache, "bin", 1, &counter) == ERROR_INVALID_PARAM, "Increment of non-number rejected");
+    
+    TEST_ASSERT(cache_append(cache, "log", "ab", 2) == SUCCESS && cache_append(cache, "log", "cd", 2) == SUCCESS,
+                "Append");
+    TEST_ASSERT(cache_get(cache, "log", &value, &size) == SUCCESS && size == 4 && memcmp(value, "abcd", 4) == 0,
+                "Appended value");
+    safe_free(&value);
+    
+    // Values larger than the connection buffers
+    size_t large_size = 200000;
+    char* large = safe_malloc(large_size);
+    for (size_t i = 0; i < large_size; i++) {
+        large[i] = (char)('a' + i % 26);
+    }
+    TEST_ASSERT(cache_set(cache, "large", large, large_size) == SUCCESS &&
+                cache_get(cache, "large", &value, &size) == SUCCESS &&
+                size == large_size && memcmp(value, large, large_size) == 0, "Large value round-trips");
+    safe_free(&value);
+    safe_free((void**)&large);
+    
+    size_t count = 0;
+    TEST_ASSERT(cache_get_size(cache, &count) == SUCCESS && count == 4, "DBSIZE");
+    TEST_ASSERT(cache_delete(cache, "bin") == SUCCESS && cache_delete(cache, "bin") == ERROR_NOT_FOUND, "Delete");
+    TEST_ASSERT(cache_invalidate_all(cache) == SUCCESS && cache_get_size(cache, &count) == SUCCESS && count == 0,
+                "FLUSHDB");
+    
+    cache_instance_disconnect(cache);
+    TEST_ASSERT(!cache_exists(cache, "log") && cache_get(cache, "log", &value, &size) == ERROR_IO,
+                "Operations fail after disconnecting");
+    cache_instance_destroy(cache);
+}
+
+void test_redis_batch_and_ttl(void) {
+    printf("\n=== Test: Redis Batch Operations and TTL ===\n");
+    
+    cache_instance_t* cache = create_redis_cache(0);
+    cache_instance_connect(cache);
+    cache_invalidate_all(cache);
+    
+    const char* keys[] = {"k0", "k1", "k2", "k3"};
+    void* values[] = {"zero", "one", "", "three"};
+    size_t sizes[] = {4, 3, 0, 5};
+    TEST_ASSERT(cache_mset(cache, keys, values, sizes, 4) == SUCCESS, "MSET");
+    
+    const char* lookup[] = {"k0", NULL, "nope", "k3", "k2"};
+    void** got = NULL;
+    size_t* got_sizes = NULL;
+    TEST_ASSERT(cache_mget(cache, lookup, 5, &got, &got_sizes) == SUCCESS, "MGET");
+    TEST_ASSERT(got[0] && got_sizes[0] == 4 && memcmp(got[0], "zero", 4) == 0 &&
+                got[3] && got_sizes[3] == 5 && memcmp(got[3], "three", 5) == 0, "MGET values in caller order");
+    TEST_ASSERT(got[1] == NULL && got[2] == NULL && got_sizes[2] == 0, "NULL and missing keys come back empty");
+    TEST_ASSERT(got[4] != NULL && got_sizes[4] == 0, "Empty value distinct from a miss");
+    for (size_t i = 0; i < 5; i++) {
+        safe_free(&got[i]);
+    }
+    safe_free((void**)&got);
+    safe_free((void**)&got_sizes);
+    
+    uint64_t ttl = 1;
+    TEST_ASSERT(cache_get_ttl(cache, "k0", &ttl) == SUCCESS && ttl == 0, "MSET keys have no TTL");
+    TEST_ASSERT(cache_set_ttl(cache, "k0", 60000) == SUCCESS &&
+                cache_get_ttl(cache, "k0", &ttl) == SUCCESS && ttl > 59000 && ttl <= 60000, "PEXPIRE and PTTL");
+    TEST_ASSERT(cache_persist(cache, "k0") == SUCCESS &&
+                cache_get_ttl(cache, "k0", &ttl) == SUCCESS && ttl == 0, "Persist");
+    TEST_ASSERT(cache_persist(cache, "nope") == ERROR_NOT_FOUND && cache_set_ttl(cache, "nope", 100) == ERROR_NOT_FOUND &&
+                cache_get_ttl(cache, "nope", &ttl) == ERROR_NOT_FOUND, "TTL ops on missing key");
+    
+    TEST_ASSERT(cache_set_with_ttl(cache, "short", "x", 1, 50) == SUCCESS && cache_exists(cache, "short"),
+                "Set with TTL");
+    sleep_ms(80);
+    TEST_ASSERT(!cache_exists(cache, "short"), "Key expired on server");
+    
+    TEST_ASSERT(cache_mdelete(cache, keys, 4) == SUCCESS && !cache_exists(cache, "k3"), "Multi-key DEL");
+    cache_instance_destroy(cache);
+    
+    // With a default TTL, batch sets are pipelined SET ... PX
+    cache = create_redis_cache(30000);
+    cache_instance_connect(cache);
+    TEST_ASSERT(cache_mset(cache, keys, values, sizes, 4) == SUCCESS, "Pipelined MSET with default TTL");
+    TEST_ASSERT(cache_get_ttl(cache, "k3", &ttl) == SUCCESS && ttl > 29000 && ttl <= 30000, "Default TTL applied");
+    TEST_ASSERT(cache_set(cache, "k4", "four", 4) == SUCCESS &&
+                cache_get_ttl(cache, "k4", &ttl) == SUCCESS && ttl > 29000, "Set applies default TTL");
+    cache_invalidate_all(cache);
+    cache_instance_destroy(cache);
+}
+
+typedef struct {
+    cache_instance_t* cache;
+    int id;
+    int errors;
+} redis_worker_t;
+
+static void* redis_worker(void* arg) {
+    redis_worker_t* worker = arg;
+    char key[32];
+    char value[32];
+    for (int i = 0; i < 200; i++) {
+        int64_t counter;
+        if (cache_increment(worker->cache, "shared", 1, &counter) != SUCCESS) {
+            worker->errors++;
+        }
+        
+        snprintf(key, sizeof(key), "w%d:%d", worker->id, i % 10);
+        int length = snprintf(value, sizeof(value), "%d-%d", worker->id, i);
+        void* got = NULL;
+        size_t size = 0;
+        if (cache_set(worker->cache, key, value, (size_t)length) != SUCCESS ||
+            cache_get(worker->cache, key, &got, &size) != SUCCESS ||
+            size != (size_t)length || memcmp(got, value, size) != 0) {
+            worker->errors++;
+        }
+        safe_free(&got);
+    }
+    return NULL;
+}
+
+void test_redis_connection_pool(void) {
+    printf("\n=== Test: Redis Connection Pool ===\n");
+    
+    cache_instance_t* cache = create_redis_cache(0);
+    cache_instance_connect(cache);
+    cache_invalidate_all(cache);
+    
+    // More threads than pooled connections
+    pthread_t threads[8];
+    redis_worker_t workers[8];
+    for (int i = 0; i < 8; i++) {
+        workers[i] = (redis_worker_t){ cache, i, 0 };
+        pthread_create(&threads[i], NULL, redis_worker, &workers[i]);
+    }
+    int errors = 0;
+    for (int i = 0; i < 8; i++) {
+        pthread_join(threads[i], NULL);
+        errors += workers[i].errors;
+    }
+    
+    int64_t counter = 0;
+    TEST_ASSERT(errors == 0, "Concurrent callers see their own replies");
+    TEST_ASSERT(cache_increment(cache, "shared", 0, &counter) == SUCCESS && counter == 1600,
+                "Every increment applied once");
+    
+    cache_invalidate_all(cache);
+    cache_instance_destroy(cache);
+}
+
+// =============================================================================
+// Distributed Cluster
+// =============================================================================
+
+#define CLUSTER_NODES 5
+#define CLUSTER_KEYS 2000
+
+static pid_t cluster_pids[CLUSTER_NODES];
+static int cluster_ports[CLUSTER_NODES];
+
+static bool start_cluster_servers(void) {
+    bool started = true;
+    for (int i = 0; i < CLUSTER_NODES; i++) {
+        cluster_pids[i] = start_resp_server(&cluster_ports[i]);
+        started = started && cluster_pids[i] > 0;
+    }
+    TEST_ASSERT(started, "Cluster node servers started");
+    return started;
+}
+
+static void stop_cluster_servers(void) {
+    for (int i = 0; i < CLUSTER_NODES; i++) {
+        stop_resp_server(cluster_pids[i]);
+        cluster_pids[i] = -1;
+    }
+}
+
+// Cluster over the first node_count servers, after flushing them
+static cache_cluster_t* create_cluster(size_t replication_factor, bool read_from_replicas, int node_count) {
+    replication_config_t config = { 0 };
+    config.replication_factor = replication_factor;
+    config.enable_read_from_replicas = read_from_replicas;
+    cache_cluster_t* cluster = cache_cluster_create(&config);
+    
+    for (int i = 0; i < node_count; i++) {
+        cache_cluster_add_node(cluster, "127.0.0.1", cluster_ports[i]);
+        resp_server_port = cluster_ports[i];
+        cache_instance_t* node = create_redis_cache(0);
+        cache_instance_connect(node);
+        cache_invalidate_all(node);
+        cache_instance_destroy(node);
+    }
+    return cluster;
+}
+
+// Which keys each server holds, read directly rather than through the cluster
+static void count_keys_per_node(int node_count, size_t* counts) {
+    for (int i = 0; i < node_count; i++) {
+        resp_server_port = cluster_ports[i];
+        cache_instance_t* node = create_redis_cache(0);
+        cache_instance_connect(node);
+        cache_get_size(node, &counts[i]);
+        cache_instance_destroy(node);
+    }
+}
+
+static int count_readable(cache_cluster_t* cluster, int key_count) {
+    char key[32];
+    int found = 0;
+    for (int i = 0; i < key_count; i++) {
+        snprintf(key, sizeof(key), "item:%d", i);
+        void* value = NULL;
+        size_t size = 0;
+        if (cache_cluster_get(cluster, key, &value, &size) == SUCCESS &&
+            size == strlen(key) && memcmp(value, key, size) == 0) {
+            found++;
+        }
+        safe_free(&value);
+    }
+    return found;
+}
+
+static int write_keys(cache_cluster_t* cluster, int key_count) {
+    char key[32];
+    int failed = 0;
+    for (int i = 0; i < key_count; i++) {
+        snprintf(key, sizeof(key), "item:%d", i);
+        if (cache_cluster_set(cluster, key, key, strlen(key)) != SUCCESS) {
+            failed++;
+        }
+    }
+    return failed;
+}
+
+void test_cluster_membership(void) {
+    printf("\n=== Test: Cluster Membership ===\n");
+    
+    cache_cluster_t* cluster = create_cluster(2, false, 3);
+    cache_node_info_t* nodes = NULL;
+    size_t count = 0;
+    TEST_ASSERT(cache_cluster_get_nodes(cluster, &nodes, &count) == SUCCESS && count == 3, "Three nodes joined");
+    
+    char expected[64];
+    snprintf(expected, sizeof(expected), "127.0.0.1:%d", cluster_ports[1]);
+    bool listed = false;
+    for (size_t i = 0; i < count; i++) {
+        listed = listed || (strcmp(nodes[i].node_id, expected) == 0 && nodes[i].port == cluster_ports[1]);
+    }
+    TEST_ASSERT(listed, "Node ids are host:port");
+    safe_free((void**)&nodes);
+    
+    TEST_ASSERT(cache_cluster_add_node(cluster, "127.0.0.1", cluster_ports[0]) == ERROR_ALREADY_EXISTS,
+                "Duplicate node rejected");
+    TEST_ASSERT(cache_cluster_remove_node(cluster, "127.0.0.1:1") == ERROR_NOT_FOUND, "Unknown node id");
+    
+    // A port nobody listens on: grab one, then let it go
+    int closed_port;
+    pid_t pid = start_resp_server(&closed_port);
+    stop_resp_server(pid);
+    TEST_ASSERT(cache_cluster_add_node(cluster, "127.0.0.1", closed_port) == ERROR_IO, "Unreachable node not added");
+    
+    TEST_ASSERT(cache_cluster_remove_node(cluster, expected) == SUCCESS &&
+                cache_cluster_get_nodes(cluster, &nodes, &count) == SUCCESS && count == 2, "Node removed");
+    safe_free((void**)&nodes);
+    cache_cluster_destroy(cluster);
+    
+    // An empty cluster owns nothing
+    replication_config_t config = { 0 };
+    cluster = cache_cluster_create(&config);
+    void* value = NULL;
+    TEST_ASSERT(cache_cluster_set(cluster, "k", "v", 1) == ERROR_NOT_FOUND &&
+                cache_cluster_get(cluster, "k", &value, NULL) == ERROR_NOT_FOUND, "Empty cluster");
+    cache_cluster_destroy(cluster);
+}
+
+void test_cluster_replication(void) {
+    printf("\n=== Test: Cluster Replication ===\n");
+    
+    cache_cluster_t* cluster = create_cluster(2, true, 4);
+    TEST_ASSERT(write_keys(cluster, CLUSTER_KEYS) == 0, "Writes fanned out to replicas");
+    
+    size_t counts[CLUSTER_NODES] = { 0 };
+    count_keys_per_node(4, counts);
+    size_t total = 0;
+    size_t least = SIZE_MAX;
+    size_t most = 0;
+    for (int i = 0; i < 4; i++) {
+        total += counts[i];
+        least = counts[i] < least ? counts[i] : least;
+        most = counts[i] > most ? counts[i] : most;
+    }
+    printf("  keys per node: %zu..%zu\n", least, most);
+    TEST_ASSERT(total == 2 * CLUSTER_KEYS, "Every key stored on exactly two nodes");
+    TEST_ASSERT(least > total / 4 * 7 / 10 && most < total / 4 * 13 / 10, "Virtual nodes balance the load");
+    
+    TEST_ASSERT(count_readable(cluster, CLUSTER_KEYS) == CLUSTER_KEYS, "Reads spread over replicas see every key");
+    
+    TEST_ASSERT(cache_cluster_delete(cluster, "item:7") == SUCCESS &&
+                cache_cluster_delete(cluster, "item:7") == ERROR_NOT_FOUND, "Delete");
+    count_keys_per_node(4, counts);
+    TEST_ASSERT(counts[0] + counts[1] + counts[2] + counts[3] == 2 * CLUSTER_KEYS - 2, "Delete reached both replicas");
+    
+    cache_cluster_destroy(cluster);
+}
+
+void test_cluster_rebalance(void) {
+    printf("\n=== Test: Cluster Rebalance ===\n");
+    
+    cache_cluster_t* cluster = create_cluster(1, false, 4);
+    write_keys(cluster, CLUSTER_KEYS);
+    
+    // A fifth node should take about a fifth of the keys and nothing else
+    int before = count_readable(cluster, CLUSTER_KEYS);
+    cache_cluster_add_node(cluster, "127.0.0.1", cluster_ports[4]);
+    int after_add = count_readable(cluster, CLUSTER_KEYS);
+    printf("  keys still on their owner after adding a node: %d/%d\n", after_add, CLUSTER_KEYS);
+    TEST_ASSERT(before == CLUSTER_KEYS, "All keys readable");
+    TEST_ASSERT(after_add > CLUSTER_KEYS * 7 / 10 && after_add < CLUSTER_KEYS * 9 / 10,
+                "Adding a node moves only its share of keys");
+    
+    // Removing it again hands its arcs back to their old owners
+    char node_id[64];
+    snprintf(node_id, sizeof(node_id), "127.0.0.1:%d", cluster_ports[4]);
+    cache_cluster_remove_node(cluster, node_id);
+    TEST_ASSERT(count_readable(cluster, CLUSTER_KEYS) == CLUSTER_KEYS, "Removing it restores the old placement");
+    
+    cache_cluster_destroy(cluster);
+}
+
+void test_cluster_node_failure(void) {
+    printf("\n=== Test: Cluster Node Failure ===\n");
+    
+    cache_cluster_t* cluster = create_cluster(2, false, 4);
+    write_keys(cluster, CLUSTER_KEYS);
+    
+    // With two replicas, every key survives one node going away
+    stop_resp_server(cluster_pids[3]);
+    cluster_pids[3] = -1;
+    TEST_ASSERT(count_readable(cluster, CLUSTER_KEYS) == CLUSTER_KEYS, "Reads fail over to the other replica");
+    int failed = write_keys(cluster, CLUSTER_KEYS);
+    TEST_ASSERT(failed > 0 && failed < CLUSTER_KEYS, "Writes touching the dead node report failure");
+    
+    char node_id[64];
+    snprintf(node_id, sizeof(node_id), "127.0.0.1:%d", cluster_ports[3]);
+    TEST_ASSERT(cache_cluster_remove_node(cluster, node_id) == SUCCESS && write_keys(cluster, CLUSTER_KEYS) == 0,
+                "Writes succeed once the node is removed");
+    
+    cache_cluster_destroy(cluster);
+}
+
+// =============================================================================
+// Main Test Runner
+// =============================================================================
+
+int main(void) {
+    printf("========================================\n");
+    printf("Cache Strategies Tests\n");
+    printf("========================================\n");
+    
+    // Basic Operations
+    test_cache_set_get();
+    test_cache_eviction();
+    test_cache_ttl();
+    test_cache_atomic_and_batch();
+    test_cache_compression();
+    test_cache_compression_codec();
+    
+    // Invalidation
+    test_cache_tag_invalidation();
+    test_cache_tag_eviction();
+    test_cache_pattern_invalidation();
+    test_cache_pattern_trie_consistency();
+    
+    // Stampede Prevention
+    test_cache_single_flight();
+    test_cache_single_flight_error();
+    test_cache_single_flight_timeout();
+    test_cache_key_lock();
+    test_cache_probabilistic_refresh();
+    test_cache_precompute_refresh();
+    
+    // Write-Behind
+    test_write_behind_coalescing();
+    test_write_behind_triggers();
+    test_write_behind_retry();
+    test_write_behind_backpressure();
+    
+    // Cache Warming
+    test_cache_warmup();
+    test_cache_warmup_popular();
+    test_cache_warmup_throttling();
+    
+    // Near Cache
+    test_near_cache_basic();
+    test_near_cache_invalidation();
+    test_near_cache_threads();
+    
+    // Operation Stats
+    test_cache_operation_stats();
+    
+    // Redis Backend
+    resp_server_pid = start_resp_server(&resp_server_port);
+    TEST_ASSERT(resp_server_pid > 0, "Loopback RESP server started");
+    if (resp_server_pid > 0) {
+        test_redis_basic_operations();
+        test_redis_batch_and_ttl();
+        test_redis_connection_pool();
+        stop_resp_server(resp_server_pid);
+    }
+    
+    // Distributed Cluster
+    if (start_cluster_servers()) {
+        test_cluster_membership();
+        test_cluster_replication();
+        test_cluster_rebalance();
+        test_cluster_node_failure();
+    }
+    stop_cluster_servers();
+    
+    // Summary
+    printf("\n========================================\n");
+    printf("Test Results:\n");
+    printf("  Passed: %d\n", tests_passed);
+    printf("  Failed: %d\n", tests_failed);
+    printf("  Total:  %d\n", tests_passed + tests_failed);
+    printf("========================================\n");
+    
+    return tests_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,442 @@
+#define _POSIX_C_SOURCE 200809L
+#include "concurrency.h"
+#include "common.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+
+// Test counter
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+static void sleep_ms(uint64_t ms) {
+    struct timespec ts = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static thread_pool_t* create_pool(thread_pool_type_t type, size_t min_threads, size_t max_threads) {
+    thread_pool_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.type = type;
+    config.min_threads = min_threads;
+    config.max_threads = max_threads;
+    config.enable_priority_queue = true;
+    return thread_pool_create(&config);
+}
+
+static void count_task(void* arg) {
+    __atomic_add_fetch((int*)arg, 1, __ATOMIC_RELAXED);
+}
+
+static void slow_task(void* arg) {
+    sleep_ms(20);
+    __atomic_add_fetch((int*)arg, 1, __ATOMIC_RELAXED);
+}
+
+// Blocks a worker until the gate opens
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool open;
+    int entered;
+} gate_t;
+
+static void gate_init(gate_t* gate) {
+    pthread_mutex_init(&gate->lock, NULL);
+    pthread_cond_init(&gate->cond, NULL);
+    gate->open = false;
+    gate->entered = 0;
+}
+
+static void gate_open(gate_t* gate) {
+    pthread_mutex_lock(&gate->lock);
+    gate->open = true;
+    pthread_cond_broadcast(&gate->cond);
+    pthread_mutex_unlock(&gate->lock);
+}
+
+static void gate_wait_entered(gate_t* gate, int count) {
+    pthread_mutex_lock(&gate->lock);
+    while (gate->entered < count) {
+        pthread_mutex_unlock(&gate->lock);
+        sleep_ms(1);
+        pthread_mutex_lock(&gate->lock);
+    }
+    pthread_mutex_unlock(&gate->lock);
+}
+
+static void gate_task(void* arg) {
+    gate_t* gate = (gate_t*)arg;
+    pthread_mutex_lock(&gate->lock);
+    gate->entered++;
+    while (!gate->open) {
+        pthread_cond_wait(&gate->cond, &gate->lock);
+    }
+    pthread_mutex_unlock(&gate->lock);
+}
+
+// Records the order tasks ran in
+typedef struct {
+    pthread_mutex_t lock;
+    int order[8];
+    int count;
+} order_log_t;
+
+typedef struct {
+    order_log_t* log;
+    int id;
+} order_arg_t;
+
+static void order_task(void* arg) {
+    order_arg_t* entry = (order_arg_t*)arg;
+    pthread_mutex_lock(&entry->log->lock);
+    entry->log->order[entry->log->count++] = entry->id;
+    pthread_mutex_unlock(&entry->log->lock);
+}
+
+// =============================================================================
+// Thread Pool Tests
+// =============================================================================
+
+void test_thread_pool_basic(void) {
+    printf("\n=== Test: Thread Pool Basic ===\n");
+    
+    thread_pool_t* pool = create_pool(THREAD_POOL_FIXED, 0, 4);
+    TEST_ASSERT(pool != NULL, "Pool created");
+    TEST_ASSERT(thread_pool_start(pool) == SUCCESS, "Pool started");
+    TEST_ASSERT(thread_pool_start(pool) == ERROR_INVALID_PARAM, "Second start rejected");
+    
+    int counter = 0;
+    task_t* task = thread_pool_submit(pool, count_task, &counter);
+    TEST_ASSERT(task != NULL, "Task submitted");
+    TEST_ASSERT(thread_pool_wait_for_task(task) == SUCCESS, "Wait for task succeeds");
+    TEST_ASSERT(task->state == TASK_STATE_COMPLETED, "Task marked completed");
+    TEST_ASSERT(counter == 1, "Task ran once");
+    TEST_ASSERT(strlen(task->id) > 0, "Task has an id");
+    thread_pool_task_release(task);
+    
+    for (int i = 0; i < 1000; i++) {
+        thread_pool_task_release(thread_pool_submit(pool, count_task, &counter));
+    }
+    TEST_ASSERT(thread_pool_wait_all(pool) == SUCCESS, "Wait all succeeds");
+    TEST_ASSERT(counter == 1001, "Every task ran");
+    
+    thread_pool_stats_t stats;
+    TEST_ASSERT(thread_pool_get_stats(pool, &stats) == SUCCESS, "Stats retrieved");
+    TEST_ASSERT(stats.total_threads == 4, "Four workers");
+    TEST_ASSERT(stats.completed_tasks == 1001, "Completed tasks counted");
+    TEST_ASSERT(stats.queued_tasks == 0, "Queue drained");
+    
+    TEST_ASSERT(thread_pool_submit(NULL, count_task, &counter) == NULL, "Submit to NULL pool rejected");
+    TEST_ASSERT(thread_pool_submit(pool, NULL, NULL) == NULL, "NULL function rejected");
+    thread_pool_destroy(pool);
+}
+
+void test_thread_pool_parallelism(void) {
+    printf("\n=== Test: Thread Pool Parallelism ===\n");
+    
+    thread_pool_t* pool = create_pool(THREAD_POOL_FIXED, 0, 4);
+    thread_pool_start(pool);
+    
+    // Four tasks that only finish together: each waits at the gate until all
+    // four are inside, so this completes only if they overlap
+    gate_t gate;
+    gate_init(&gate);
+    for (int i = 0; i < 4; i++) {
+        thread_pool_task_release(thread_pool_submit(pool, gate_task, &gate));
+    }
+    gate_wait_entered(&gate, 4);
+    thread_pool_stats_t stats;
+    thread_pool_get_stats(pool, &stats);
+    TEST_ASSERT(stats.active_threads == 4, "Tasks ran in parallel");
+    gate_open(&gate);
+    
+    int counter = 0;
+    for (int i = 0; i < 8; i++) {
+        thread_pool_task_release(thread_pool_submit(pool, slow_task, &counter));
+    }
+    thread_pool_wait_all(pool);
+    TEST_ASSERT(counter == 8, "All slow tasks ran");
+    
+    thread_pool_destroy(pool);
+}
+
+void test_thread_pool_priority(void) {
+    printf("\n=== Test: Thread Pool Priority ===\n");
+    
+    thread_pool_t* pool = create_pool(THREAD_POOL_FIXED, 0, 1);
+    thread_pool_start(pool);
+    
+    // Hold the only worker so the rest queue up
+    gate_t gate;
+    gate_init(&gate);
+    task_t* blocker = thread_pool_submit(pool, gate_task, &gate);
+    gate_wait_entered(&gate, 1);
+    
+    order_log_t log;
+    memset(&log, 0, sizeof(log));
+    pthread_mutex_init(&log.lock, NULL);
+    order_arg_t args[4] = { {&log, 0}, {&log, 1}, {&log, 2}, {&log, 3} };
+    task_priority_t priorities[4] = { TASK_PRIORITY_LOW, TASK_PRIORITY_NORMAL,
+                                      TASK_PRIORITY_CRITICAL, TASK_PRIORITY_HIGH };
+    for (int i = 0; i < 4; i++) {
+        thread_pool_task_release(thread_pool_submit_with_priority(pool, order_task, &args[i], priorities[i]));
+    }
+    
+    gate_open(&gate);
+    thread_pool_wait_all(pool);
+    thread_pool_task_release(blocker);
+    
+    TEST_ASSERT(log.count == 4, "All prioritised tasks ran");
+    TEST_ASSERT(log.order[0] == 2 && log.order[1] == 3 && log.order[2] == 1 && log.order[3] == 0,
+                "Tasks ran highest priority first");
+    
+    thread_pool_destroy(pool);
+}
+
+void test_thread_pool_cancel_and_queue_limit(void) {
+    printf("\n=== Test: Thread Pool Cancel and Queue Limit ===\n");
+    
+    thread_pool_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.type = THREAD_POOL_FIXED;
+    config.max_threads = 1;
+    config.queue_size = 2;
+    thread_pool_t* pool = thread_pool_create(&config);
+    thread_pool_start(pool);
+    
+    gate_t gate;
+    gate_init(&gate);
+    task_t* blocker = thread_pool_submit(pool, gate_task, &gate);
+    gate_wait_entered(&gate, 1);
+    
+    int counter = 0;
+    task_t* first = thread_pool_submit(pool, count_task, &counter);
+    task_t* second = thread_pool_submit(pool, count_task, &counter);
+    task_t* third = thread_pool_submit(pool, count_task, &counter);
+    TEST_ASSERT(first && second, "Tasks queued up to the limit");
+    TEST_ASSERT(third == NULL, "Task beyond queue_size rejected");
+    
+    TEST_ASSERT(thread_pool_cancel_task(pool, first) == SUCCESS, "Pending task cancelled");
+    TEST_ASSERT(first->state == TASK_STATE_CANCELLED, "Cancelled state recorded");
+    TEST_ASSERT(thread_pool_wait_for_task(first) == ERROR_NOT_FOUND, "Waiting on a cancelled task reports it never ran");
+    TEST_ASSERT(thread_pool_cancel_task(pool, blocker) == ERROR_NOT_FOUND, "Running task can't be cancelled");
+    
+    gate_open(&gate);
+    thread_pool_wait_all(pool);
+    TEST_ASSERT(counter == 1, "Only the uncancelled task ran");
+    TEST_ASSERT(thread_pool_cancel_task(pool, second) == ERROR_NOT_FOUND, "Completed task can't be cancelled");
+    
+    thread_pool_stats_t stats;
+    thread_pool_get_stats(pool, &stats);
+    TEST_ASSERT(stats.rejected_tasks == 1, "Rejection counted");
+    
+    thread_pool_task_release(blocker);
+    thread_pool_task_release(first);
+    thread_pool_task_release(second);
+    thread_pool_destroy(pool);
+}
+
+void test_thread_pool_shutdown(void) {
+    printf("\n=== Test: Thread Pool Shutdown ===\n");
+    
+    // Draining shutdown runs everything queued
+    thread_pool_t* pool = create_pool(THREAD_POOL_FIXED, 0, 2);
+    thread_pool_start(pool);
+    int counter = 0;
+    for (int i = 0; i < 10; i++) {
+        thread_pool_task_release(thread_pool_submit(pool, slow_task, &counter));
+    }
+    TEST_ASSERT(thread_pool_shutdown(pool, true) == SUCCESS, "Draining shutdown succeeds");
+    TEST_ASSERT(counter == 10, "Queued tasks ran before shutdown");
+    TEST_ASSERT(thread_pool_submit(pool, count_task, &counter) == NULL, "Submit after shutdown rejected");
+    thread_pool_destroy(pool);
+    
+    // Immediate shutdown cancels what hasn't started
+    pool = create_pool(THREAD_POOL_FIXED, 0, 1);
+    thread_pool_start(pool);
+    gate_t gate;
+    gate_init(&gate);
+    thread_pool_task_release(thread_pool_submit(pool, gate_task, &gate));
+    gate_wait_entered(&gate, 1);
+    
+    counter = 0;
+    task_t* pending = thread_pool_submit(pool, count_task, &counter);
+    gate_open(&gate);
+    thread_pool_shutdown(pool, false);
+    TEST_ASSERT(pending->state == TASK_STATE_CANCELLED || pending->state == TASK_STATE_COMPLETED,
+                "Pending task settled by shutdown");
+    TEST_ASSERT(counter == (pending->state == TASK_STATE_COMPLETED ? 1 : 0), "Cancelled task never ran");
+    thread_pool_task_release(pending);
+    thread_pool_destroy(pool);
+    
+    // Destroying a pool that was never started frees its queue
+    pool = create_pool(THREAD_POOL_FIXED, 0, 2);
+    counter = 0;
+    task_t* queued = thread_pool_submit(pool, count_task, &counter);
+    thread_pool_destroy(pool);
+    TEST_ASSERT(queued->state == TASK_STATE_CANCELLED && counter == 0,
+                "Unstarted pool destroyed with queued tasks");
+    thread_pool_task_release(queued);
+}
+
+void test_thread_pool_resize(void) {
+    printf("\n=== Test: Thread Pool Resize ===\n");
+    
+    thread_pool_t* pool = create_pool(THREAD_POOL_FIXED, 0, 2);
+    thread_pool_start(pool);
+    
+    thread_pool_stats_t stats;
+    TEST_ASSERT(thread_pool_resize(pool, 6) == SUCCESS, "Pool grown");
+    thread_pool_get_stats(pool, &stats);
+    TEST_ASSERT(stats.total_threads == 6, "Six workers after growing");
+    
+    TEST_ASSERT(thread_pool_resize(pool, 1) == SUCCESS, "Pool shrunk");
+    thread_pool_get_stats(pool, &stats);
+    TEST_ASSERT(stats.total_threads == 1, "One worker after shrinking");
+    
+    int counter = 0;
+    for (int i = 0; i < 100; i++) {
+        thread_pool_task_release(thread_pool_submit(pool, count_task, &counter));
+    }
+    thread_pool_wait_all(pool);
+    TEST_ASSERT(counter == 100, "Shrunk pool still runs tasks");
+    TEST_ASSERT(thread_pool_resize(pool, 0) == ERROR_INVALID_PARAM, "Zero size rejected");
+    
+    thread_pool_destroy(pool);
+}
+
+#define RESIZERS 4
+
+typedef struct {
+    thread_pool_t* pool;
+    size_t sizes[2];
+    int failures;
+} resizer_t;
+
+static void* resizer_main(void* arg) {
+    resizer_t* resizer = (resizer_t*)arg;
+    for (int i = 0; i < 50; i++) {
+        if (thread_pool_resize(resizer->pool, resizer->sizes[i % 2]) != SUCCESS) {
+            resizer->failures++;
+        }
+    }
+    return NULL;
+}
+
+static void* shutdown_main(void* arg) {
+    thread_pool_shutdown((thread_pool_t*)arg, true);
+    return NULL;
+}
+
+void test_thread_pool_concurrent_resize(void) {
+    printf("\n=== Test: Thread Pool Concurrent Resize ===\n");
+    
+    // Shrinks and grows from several threads while a cached pool spawns
+    // workers for a stream of tasks
+    thread_pool_t* pool = create_pool(THREAD_POOL_CACHED, 1, 8);
+    thread_pool_start(pool);
+    
+    resizer_t resizers[RESIZERS];
+    pthread_t threads[RESIZERS];
+    for (int i = 0; i < RESIZERS; i++) {
+        resizers[i] = (resizer_t){ pool, { (size_t)(i + 1), (size_t)(8 - i) }, 0 };
+        pthread_create(&threads[i], NULL, resizer_main, &resizers[i]);
+    }
+    int counter = 0;
+    for (int i = 0; i < 2000; i++) {
+        thread_pool_task_release(thread_pool_submit(pool, count_task, &counter));
+    }
+    int failures = 0;
+    for (int i = 0; i < RESIZERS; i++) {
+        pthread_join(threads[i], NULL);
+        failures += resizers[i].failures;
+    }
+    thread_pool_wait_all(pool);
+    
+    thread_pool_stats_t stats;
+    thread_pool_get_stats(pool, &stats);
+    TEST_ASSERT(failures == 0 && counter == 2000, "Concurrent resizes all succeed and tasks all run");
+    TEST_ASSERT(stats.total_threads >= 1 && stats.total_threads <= 8, "Worker count within bounds");
+    
+    // A shutdown racing resizes waits for them, and later resizes are refused
+    pthread_t stopper;
+    resizers[0].failures = 0;
+    pthread_create(&threads[0], NULL, resizer_main, &resizers[0]);
+    pthread_create(&stopper, NULL, shutdown_main, pool);
+    pthread_join(stopper, NULL);
+    pthread_join(threads[0], NULL);
+    thread_pool_get_stats(pool, &stats);
+    TEST_ASSERT(stats.total_threads == 0, "Shutdown joined every worker");
+    TEST_ASSERT(thread_pool_resize(pool, 2) == ERROR_INVALID_PARAM, "Resize after shutdown refused");
+    
+    thread_pool_destroy(pool);
+}
+
+void test_thread_pool_cached(void) {
+    printf("\n=== Test: Cached Thread Pool ===\n");
+    
+    thread_pool_t* pool = create_pool(THREAD_POOL_CACHED, 1, 4);
+    thread_pool_start(pool);
+    
+    thread_pool_stats_t stats;
+    thread_pool_get_stats(pool, &stats);
+    TEST_ASSERT(stats.total_threads == 1, "Cached pool starts with min_threads");
+    
+    gate_t gate;
+    gate_init(&gate);
+    for (int i = 0; i < 6; i++) {
+        thread_pool_task_release(thread_pool_submit(pool, gate_task, &gate));
+    }
+    gate_wait_entered(&gate, 4);
+    thread_pool_get_stats(pool, &stats);
+    TEST_ASSERT(stats.total_threads == 4, "Cached pool grew to max_threads under load");
+    TEST_ASSERT(stats.active_threads == 4, "All workers busy");
+    
+    gate_open(&gate);
+    thread_pool_wait_all(pool);
+    thread_pool_get_stats(pool, &stats);
+    TEST_ASSERT(stats.completed_tasks == 6, "All blocked tasks completed");
+    TEST_ASSERT(stats.thread_utilization > 0.0 && stats.thread_utilization <= 1.0, "Utilization in range");
+    
+    thread_pool_destroy(pool);
+}
+
+int main(void) {
+    printf("========================================\n");
+    printf("Concurrency Tests\n");
+    printf("========================================\n");
+    
+    // Thread Pool
+    test_thread_pool_basic();
+    test_thread_pool_parallelism();
+    test_thread_pool_priority();
+    test_thread_pool_cancel_and_queue_limit();
+    test_thread_pool_shutdown();
+    test_thread_pool_resize();
+    test_thread_pool_concurrent_resize();
+    test_thread_pool_cached();
+    
+    // Summary
+    printf("\n========================================\n");
+    printf("Test Results:\n");
+    printf("  Passed: %d\n", tests_passed);
+    printf("  Failed: %d\n", tests_failed);
+    printf("  Total:  %d\n", tests_passed + tests_failed);
+    printf("========================================\n");
+    
+    return tests_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,1126 @@
+#define _POSIX_C_SOURCE 200809L
+#include "database.h"
+#include "common.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <signal.h>
+
+// A fresh data directory logs to its first WAL segment until a snapshot
+#define FIRST_WAL_SEGMENT "wal-000001.log"
+
+// Test counter
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+// Fresh data directory under /tmp
+static char* make_data_dir(void) {
+    char* dir = safe_strdup("/tmp/test_database_XXXXXX");
+    if (!mkdtemp(dir)) {
+        safe_free((void**)&dir);
+    }
+    return dir;
+}
+
+static void remove_data_dir(char* dir) {
+    DIR* handle = opendir(dir);
+    if (handle) {
+        struct dirent* entry;
+        while ((entry = readdir(handle)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+                continue;
+            }
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+        closedir(handle);
+    }
+    rmdir(dir);
+    free(dir);
+}
+
+static database_t* open_database(const char* dir, const database_config_t* config) {
+    database_t* db = database_create_with_config(dir, config);
+    if (db && database_open(db) != SUCCESS) {
+        database_destroy(db);
+        return NULL;
+    }
+    return db;
+}
+
+static bool value_is(database_t* db, const char* key, const char* expected) {
+    void* value = NULL;
+    size_t size = 0;
+    bool matches = database_get(db, key, &value, &size) == SUCCESS &&
+                   size == strlen(expected) + 1 && strcmp(value, expected) == 0;
+    free(value);
+    return matches;
+}
+
+// =============================================================================
+// Basic Operations
+// =============================================================================
+
+void test_database_basic_operations(void) {
+    printf("\n=== Test: Database Basic Operations ===\n");
+    
+    char* dir = make_data_dir();
+    database_t* db = open_database(dir, NULL);
+    TEST_ASSERT(db != NULL, "Database opened");
+    
+    TEST_ASSERT(database_put(db, "user:1", "alice", 6) == SUCCESS, "Put succeeds");
+    TEST_ASSERT(value_is(db, "user:1", "alice"), "Get returns the stored value");
+    TEST_ASSERT(database_put(db, "user:1", "bob", 4) == SUCCESS && value_is(db, "user:1", "bob"),
+                "Put overwrites");
+    TEST_ASSERT(database_exists(db, "user:1"), "Exists finds the key");
+    TEST_ASSERT(database_delete(db, "user:1") == SUCCESS, "Delete succeeds");
+    TEST_ASSERT(!database_exists(db, "user:1"), "Deleted key is gone");
+    TEST_ASSERT(database_get(db, "user:1", NULL, NULL) == ERROR_NOT_FOUND, "Get of a deleted key fails");
+    TEST_ASSERT(database_put(db, "empty", "x", 0) == ERROR_INVALID_PARAM, "Empty values rejected");
+    
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+// =============================================================================
+// Group Commit
+// =============================================================================
+
+#define WRITER_THREADS 8
+#define WRITES_PER_THREAD 50
+
+typedef struct {
+    database_t* db;
+    int id;
+    int failures;
+} writer_t;
+
+static void* writer_main(void* arg) {
+    writer_t* writer = (writer_t*)arg;
+    for (int i = 0; i < WRITES_PER_THREAD; i++) {
+        char key[32];
+        char value[32];
+        snprintf(key, sizeof(key), "w%d:%d", writer->id, i);
+        snprintf(value, sizeof(value), "value%d", i);
+        if (database_put(writer->db, key, value, strlen(value) + 1) != SUCCESS) {
+            writer->failures++;
+        }
+    }
+    return NULL;
+}
+
+void test_database_group_commit(void) {
+    printf("\n=== Test: Database Group Commit ===\n");
+    
+    char* dir = make_data_dir();
+    database_t* db = open_database(dir, NULL);
+    
+    pthread_t threads[WRITER_THREADS];
+    writer_t writers[WRITER_THREADS];
+    for (int i = 0; i < WRITER_THREADS; i++) {
+        writers[i] = (writer_t){ db, i, 0 };
+        pthread_create(&threads[i], NULL, writer_main, &writers[i]);
+    }
+    int failures = 0;
+    for (int i = 0; i < WRITER_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        failures += writers[i].failures;
+    }
+    TEST_ASSERT(failures == 0, "Concurrent puts succeed");
+    
+    database_stats_t stats;
+    database_get_stats(db, &stats);
+    TEST_ASSERT(stats.wal_records == WRITER_THREADS * WRITES_PER_THREAD, "Every put logged");
+    TEST_ASSERT(stats.wal_syncs < stats.wal_records, "Concurrent writers share syncs");
+    
+    // A put has returned only once its record is on disk, so a second handle
+    // opened now (as after a crash) replays every key
+    database_t* recovered = open_database(dir, NULL);
+    bool all_present = true;
+    for (int t = 0; t < WRITER_THREADS; t++) {
+        for (int i = 0; i < WRITES_PER_THREAD; i++) {
+            char key[32];
+            char value[32];
+            snprintf(key, sizeof(key), "w%d:%d", t, i);
+            snprintf(value, sizeof(value), "value%d", i);
+            all_present = all_present && value_is(recovered, key, value);
+        }
+    }
+    TEST_ASSERT(all_present, "Acknowledged puts recovered from the WAL");
+    
+    database_delete(db, "w0:0");
+    database_t* after_delete = open_database(dir, NULL);
+    TEST_ASSERT(after_delete && !database_exists(after_delete, "w0:0") && database_exists(after_delete, "w0:1"),
+                "Acknowledged delete recovered from the WAL");
+    
+    database_destroy(after_delete);
+    database_destroy(recovered);
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+void test_database_group_commit_config(void) {
+    printf("\n=== Test: Database Group Commit Configuration ===\n");
+    
+    char* dir = make_data_dir();
+    database_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.wal_batch_delay_us = 50000;
+    database_t* db = open_database(dir, &config);
+    
+    uint64_t start = now_ms();
+    database_put(db, "slow", "v", 2);
+    TEST_ASSERT(now_ms() - start >= 45, "Commit waits out the batch delay");
+    database_destroy(db);
+    
+    // A record larger than the batch limit closes its batch at once
+    config.wal_batch_max_bytes = 16;
+    db = open_database(dir, &config);
+    start = now_ms();
+    database_put(db, "fast", "v", 2);
+    TEST_ASSERT(now_ms() - start < 45, "Full batch synced without the delay");
+    
+    database_stats_t stats;
+    database_get_stats(db, &stats);
+    TEST_ASSERT(stats.wal_records == 1 && stats.wal_syncs == 1, "One record, one sync");
+    
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+// =============================================================================
+// WAL Recovery
+// =============================================================================
+
+static off_t wal_file_size(const char* dir) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/" FIRST_WAL_SEGMENT, dir);
+    struct stat st;
+    return stat(path, &st) == 0 ? st.st_size : -1;
+}
+
+// Overwrite or append raw bytes, as a crash or bad sector would
+static void wal_write_raw(const char* dir, off_t offset, const void* data, size_t size) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/" FIRST_WAL_SEGMENT, dir);
+    int fd = open(path, O_WRONLY);
+    if (fd >= 0) {
+        if (pwrite(fd, data, size, offset) != (ssize_t)size) {
+            perror("pwrite");
+        }
+        close(fd);
+    }
+}
+
+void test_database_torn_write_recovery(void) {
+    printf("\n=== Test: Database Torn Write Recovery ===\n");
+    
+    char* dir = make_data_dir();
+    database_t* db = open_database(dir, NULL);
+    char value[1000];
+    memset(value, 'x', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+    database_put(db, "a", value, sizeof(value));
+    database_put(db, "b", value, sizeof(value));
+    database_put(db, "c", value, sizeof(value));
+    off_t size = wal_file_size(dir);
+    
+    // Half of a record: a frame promising more bytes than follow it
+    char torn[20];
+    memset(torn, 0, sizeof(torn));
+    torn[0] = 100;
+    wal_write_raw(dir, size, torn, sizeof(torn));
+    
+    database_t* recovered = open_database(dir, NULL);
+    database_stats_t stats;
+    database_get_stats(recovered, &stats);
+    TEST_ASSERT(recovered && value_is(recovered, "a", value) && value_is(recovered, "c", value),
+                "Complete records replayed");
+    TEST_ASSERT(stats.wal_truncated_bytes == sizeof(torn), "Torn tail counted");
+    TEST_ASSERT(wal_file_size(dir) == size, "WAL truncated at the last valid record");
+    
+    // A flipped byte inside the second record ends replay before it
+    char flipped = 'y';
+    wal_write_raw(dir, size / 2, &flipped, 1);
+    database_t* corrupt = open_database(dir, NULL);
+    TEST_ASSERT(corrupt && value_is(corrupt, "a", value), "Records before the corruption replayed");
+    TEST_ASSERT(corrupt && !database_exists(corrupt, "b") && !database_exists(corrupt, "c"),
+                "Corrupt record and everything after it dropped");
+    TEST_ASSERT(wal_file_size(dir) < size / 2, "WAL cut before the corrupt record");
+    
+    // New records follow the last valid one
+    database_put(corrupt, "d", "new", 4);
+    database_t* reopened = open_database(dir, NULL);
+    TEST_ASSERT(reopened && value_is(reopened, "a", value) && value_is(reopened, "d", "new"),
+                "Records written after recovery replayed");
+    database_get_stats(reopened, &stats);
+    TEST_ASSERT(stats.wal_truncated_bytes == 0, "Clean WAL needs no truncation");
+    
+    database_destroy(reopened);
+    database_destroy(corrupt);
+    database_destroy(recovered);
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+void test_database_wal_failure(void) {
+    printf("\n=== Test: Database WAL Failure ===\n");
+    
+    char* dir = make_data_dir();
+    database_t* db = open_database(dir, NULL);
+    database_put(db, "before", "ok", 3);
+    
+    // Cap file sizes just past the WAL so the next batch cannot be written
+    struct rlimit saved;
+    getrlimit(RLIMIT_FSIZE, &saved);
+    struct rlimit capped = saved;
+    capped.rlim_cur = (rlim_t)wal_file_size(dir) + 16;
+    signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &capped);
+    
+    char value[1000];
+    memset(value, 'x', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+    int failed = database_put(db, "big", value, sizeof(value));
+    int put_after = database_put(db, "after", "no", 3);
+    int delete_after = database_delete(db, "before");
+    database_write_batch_t* batch = database_write_batch_create();
+    database_write_batch_put(batch, "batched", "no", 3);
+    int batch_after = database_write_batch(db, batch);
+    database_write_batch_destroy(batch);
+    
+    setrlimit(RLIMIT_FSIZE, &saved);
+    
+    TEST_ASSERT(failed == ERROR_IO, "Write in the failed batch reports ERROR_IO");
+    TEST_ASSERT(put_after == ERROR_IO && !database_exists(db, "after"),
+                "Later puts refused before they are applied");
+    TEST_ASSERT(delete_after == ERROR_IO && value_is(db, "before", "ok"),
+                "Later deletes refused before they are applied");
+    TEST_ASSERT(batch_after == ERROR_IO && !database_exists(db, "batched"),
+                "Later batches refused before they are applied");
+    
+    // Closing cannot snapshot over the failed WAL, so only synced writes remain
+    database_destroy(db);
+    database_t* reopened = open_database(dir, NULL);
+    TEST_ASSERT(reopened && value_is(reopened, "before", "ok") && !database_exists(reopened, "big"),
+                "Only synced writes survive a restart");
+    
+    database_destroy(reopened);
+    remove_data_dir(dir);
+}
+
+void test_database_write_batch(void) {
+    printf("\n=== Test: Database Write Batches ===\n");
+    
+    char* dir = make_data_dir();
+    database_t* db = open_database(dir, NULL);
+    database_put(db, "keep", "old", 4);
+    database_put(db, "gone", "old", 4);
+    
+    database_write_batch_t* batch = database_write_batch_create();
+    for (int i = 0; i < 1000; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "batch%04d", i);
+        database_write_batch_put(batch, key, "v", 2);
+    }
+    database_write_batch_put(batch, "keep", "new", 4);
+    database_write_batch_delete(batch, "gone");
+    database_write_batch_delete(batch, "never");
+    TEST_ASSERT(database_write_batch_count(batch) == 1003, "Batch counts its operations");
+    TEST_ASSERT(database_write_batch_put(batch, "k", NULL, 0) == ERROR_INVALID_PARAM, "Batch rejects empty values");
+    
+    database_stats_t before;
+    database_stats_t after;
+    database_get_stats(db, &before);
+    TEST_ASSERT(database_write_batch(db, batch) == SUCCESS, "Batch applied");
+    database_get_stats(db, &after);
+    TEST_ASSERT(after.wal_records == before.wal_records + 1, "Batch logged as one WAL record");
+    TEST_ASSERT(value_is(db, "batch0999", "v") && value_is(db, "keep", "new") && !database_exists(db, "gone"),
+                "Batch puts and deletes visible");
+    
+    // Transactions commit through the same record, so they are durable too
+    transaction_t* txn = database_begin_transaction(db, ISOLATION_READ_COMMITTED);
+    transaction_put(txn, "txn", "put", 4);
+    transaction_delete(txn, "batch0000");
+    TEST_ASSERT(transaction_get(txn, "batch0000", NULL, NULL) == ERROR_NOT_FOUND, "Transaction sees its own delete");
+    TEST_ASSERT(transaction_commit(txn) == SUCCESS && !database_exists(db, "batch0000"), "Transaction delete committed");
+    
+    database_t* recovered = open_database(dir, NULL);
+    TEST_ASSERT(recovered && value_is(recovered, "batch0500", "v") && value_is(recovered, "keep", "new") &&
+                !database_exists(recovered, "gone") && value_is(recovered, "txn", "put") &&
+                !database_exists(recovered, "batch0000"), "Batch and transaction replayed from the WAL");
+    
+    // A batch torn anywhere is dropped whole
+    off_t size = wal_file_size(dir);
+    database_write_batch_clear(batch);
+    for (int i = 0; i < 1000; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "torn%04d", i);
+        database_write_batch_put(batch, key, "v", 2);
+    }
+    database_write_batch(db, batch);
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/" FIRST_WAL_SEGMENT, dir);
+    TEST_ASSERT(truncate(path, size + (wal_file_size(dir) - size) / 2) == 0, "WAL torn inside the batch");
+    database_t* torn = open_database(dir, NULL);
+    TEST_ASSERT(torn && !database_exists(torn, "torn0000") && !database_exists(torn, "torn0999") &&
+                value_is(torn, "txn", "put"), "Torn batch replayed not at all");
+    
+    database_write_batch_destroy(batch);
+    database_destroy(torn);
+    database_destroy(recovered);
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+// =============================================================================
+// Snapshots
+// =============================================================================
+
+static bool data_file_exists(const char* dir, const char* name) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    struct stat st;
+    return stat(path, &st) == 0;
+}
+
+void test_database_snapshot_restart(void) {
+    printf("\n=== Test: Database Snapshot Restart ===\n");
+    
+    char* dir = make_data_dir();
+    database_t* db = open_database(dir, NULL);
+    for (int i = 0; i < 200; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%d", i);
+        database_put(db, key, "old", 4);
+    }
+    for (int i = 0; i < 50; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%d", i);
+        database_delete(db, key);
+    }
+    database_put(db, "key50", "new", 4);
+    
+    database_stats_t stats;
+    TEST_ASSERT(database_checkpoint(db) == SUCCESS, "Checkpoint succeeds");
+    database_get_stats(db, &stats);
+    TEST_ASSERT(stats.snapshots == 1 && stats.wal_size == 0, "Snapshot written and WAL restarted");
+    TEST_ASSERT(data_file_exists(dir, "snapshot.db") && !data_file_exists(dir, FIRST_WAL_SEGMENT),
+                "Covered WAL segment removed");
+    
+    // Snapshot plus the WAL written after it, as after a crash
+    database_put(db, "tail", "after", 6);
+    database_t* recovered = open_database(dir, NULL);
+    database_get_stats(recovered, &stats);
+    TEST_ASSERT(recovered && stats.num_keys == 151, "Snapshot and WAL tail replayed");
+    TEST_ASSERT(recovered && !database_exists(recovered, "key0") && value_is(recovered, "key50", "new") &&
+                value_is(recovered, "key199", "old") && value_is(recovered, "tail", "after"),
+                "Recovered values match");
+    database_destroy(recovered);
+    database_destroy(db);
+    
+    // A clean close leaves a snapshot and nothing to replay
+    db = open_database(dir, NULL);
+    database_get_stats(db, &stats);
+    TEST_ASSERT(stats.num_keys == 151 && stats.wal_size == 0, "Closed database reopens from its snapshot");
+    
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+void test_database_background_snapshot(void) {
+    printf("\n=== Test: Database Background Snapshots ===\n");
+    
+    char* dir = make_data_dir();
+    database_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.snapshot_wal_bytes = 2048;
+    database_t* db = open_database(dir, &config);
+    
+    // Snapshots start and run while the writers keep going
+    pthread_t threads[WRITER_THREADS];
+    writer_t writers[WRITER_THREADS];
+    for (int i = 0; i < WRITER_THREADS; i++) {
+        writers[i] = (writer_t){ db, i, 0 };
+        pthread_create(&threads[i], NULL, writer_main, &writers[i]);
+    }
+    int failures = 0;
+    for (int i = 0; i < WRITER_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        failures += writers[i].failures;
+    }
+    TEST_ASSERT(failures == 0, "Puts succeed during snapshots");
+    
+    database_stats_t stats;
+    database_get_stats(db, &stats);
+    uint64_t start = now_ms();
+    while (stats.snapshots == 0 && now_ms() - start < 5000) {
+        database_get_stats(db, &stats);
+    }
+    TEST_ASSERT(stats.snapshots >= 1, "WAL growth triggered a snapshot");
+    TEST_ASSERT(stats.wal_size < stats.wal_records * 40, "Snapshots bound the WAL");
+    
+    database_t* recovered = open_database(dir, NULL);
+    bool all_present = true;
+    for (int t = 0; t < WRITER_THREADS; t++) {
+        for (int i = 0; i < WRITES_PER_THREAD; i++) {
+            char key[32];
+            char value[32];
+            snprintf(key, sizeof(key), "w%d:%d", t, i);
+            snprintf(value, sizeof(value), "value%d", i);
+            all_present = all_present && value_is(recovered, key, value);
+        }
+    }
+    TEST_ASSERT(all_present, "Fuzzy snapshot plus WAL recovers every put");
+    
+    database_destroy(recovered);
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+// =============================================================================
+// LSM Engine
+// =============================================================================
+
+// Small memtables and levels so a few thousand keys reach several levels
+static database_config_t lsm_config(void) {
+    database_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.engine = DATABASE_ENGINE_LSM;
+    config.memtable_bytes = 16 * 1024;
+    config.sstable_block_size = 512;
+    config.level0_compaction_trigger = 2;
+    config.level1_max_bytes = 32 * 1024;
+    return config;
+}
+
+static void lsm_put_range(database_t* db, int first, int last, const char* prefix) {
+    for (int i = first; i < last; i++) {
+        char key[32];
+        char value[32];
+        snprintf(key, sizeof(key), "key%05d", i);
+        snprintf(value, sizeof(value), "%s%d", prefix, i);
+        database_put(db, key, value, strlen(value) + 1);
+    }
+}
+
+// Keys below deleted were deleted, the rest hold prefix values
+static bool lsm_range_matches(database_t* db, int deleted, int last, const char* prefix) {
+    bool matches = true;
+    for (int i = 0; i < last && matches; i++) {
+        char key[32];
+        char value[32];
+        snprintf(key, sizeof(key), "key%05d", i);
+        snprintf(value, sizeof(value), "%s%d", prefix, i);
+        matches = i < deleted ? !database_exists(db, key) : value_is(db, key, value);
+    }
+    return matches;
+}
+
+void test_database_lsm_basic(void) {
+    printf("\n=== Test: Database LSM Basic Operations ===\n");
+    
+    char* dir = make_data_dir();
+    database_config_t config = lsm_config();
+    database_t* db = open_database(dir, &config);
+    TEST_ASSERT(db != NULL, "LSM database opened");
+    
+    TEST_ASSERT(database_put(db, "user:1", "alice", 6) == SUCCESS && value_is(db, "user:1", "alice"),
+                "Put and get from the memtable");
+    TEST_ASSERT(database_delete(db, "user:1") == SUCCESS && !database_exists(db, "user:1"),
+                "Delete hides the key");
+    TEST_ASSERT(database_delete(db, "user:1") == ERROR_NOT_FOUND, "Deleting a missing key fails");
+    
+    // Enough to fill several memtables
+    lsm_put_range(db, 0, 2000, "v");
+    database_stats_t stats;
+    database_get_stats(db, &stats);
+    TEST_ASSERT(stats.memtable_flushes > 0 && stats.sstable_count > 0, "Full memtables flushed to tables");
+    
+    for (int i = 0; i < 100; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%05d", i);
+        database_delete(db, key);
+    }
+    TEST_ASSERT(lsm_range_matches(db, 100, 2000, "v"), "Reads merge memtable and tables");
+    TEST_ASSERT(database_delete(db, "key00000") == ERROR_NOT_FOUND, "Tombstone hides the flushed key");
+    
+    transaction_t* txn = database_begin_transaction(db, ISOLATION_READ_COMMITTED);
+    transaction_put(txn, "key00000", "txn", 4);
+    transaction_put(txn, "key01999", "txn", 4);
+    TEST_ASSERT(transaction_commit(txn) == SUCCESS && value_is(db, "key00000", "txn") &&
+                value_is(db, "key01999", "txn"), "Transaction commits to the LSM engine");
+    
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+void test_database_lsm_compaction(void) {
+    printf("\n=== Test: Database LSM Compaction ===\n");
+    
+    char* dir = make_data_dir();
+    database_config_t config = lsm_config();
+    database_t* db = open_database(dir, &config);
+    
+    // Rewrite every key a few times so the levels hold stale versions
+    lsm_put_range(db, 0, 3000, "a");
+    lsm_put_range(db, 0, 3000, "b");
+    lsm_put_range(db, 1000, 3000, "c");
+    for (int i = 0; i < 500; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%05d", i);
+        database_delete(db, key);
+    }
+    
+    database_stats_t stats;
+    database_get_stats(db, &stats);
+    uint64_t start = now_ms();
+    while (stats.compactions == 0 && now_ms() - start < 5000) {
+        database_get_stats(db, &stats);
+    }
+    TEST_ASSERT(stats.compactions > 0, "Level 0 compacted in the background");
+    TEST_ASSERT(stats.num_keys > 2500, "Stale versions counted before a full compaction");
+    
+    TEST_ASSERT(database_compact(db) == SUCCESS, "Full compaction succeeds");
+    database_get_stats(db, &stats);
+    TEST_ASSERT(stats.num_keys == 2500, "Overwritten versions and tombstones dropped");
+    
+    bool matches = true;
+    for (int i = 0; i < 3000 && matches; i++) {
+        char key[32];
+        char value[32];
+        snprintf(key, sizeof(key), "key%05d", i);
+        snprintf(value, sizeof(value), "%s%d", i < 1000 ? "b" : "c", i);
+        matches = i < 500 ? !database_exists(db, key) : value_is(db, key, value);
+    }
+    TEST_ASSERT(matches, "Newest versions survive compaction");
+    
+    database_destroy(db);
+    
+    // The manifest lists the compacted tables
+    db = open_database(dir, &config);
+    database_get_stats(db, &stats);
+    TEST_ASSERT(db && stats.num_keys == 2500 && value_is(db, "key00999", "b999") &&
+                value_is(db, "key02999", "c2999") && !database_exists(db, "key00000"),
+                "Compacted tables reopen");
+    
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+void test_database_lsm_recovery(void) {
+    printf("\n=== Test: Database LSM Recovery ===\n");
+    
+    // No background compaction while a second handle opens the directory
+    char* dir = make_data_dir();
+    database_config_t config = lsm_config();
+    config.level0_compaction_trigger = 100;
+    database_t* db = open_database(dir, &config);
+    
+    lsm_put_range(db, 0, 1000, "v");
+    TEST_ASSERT(database_checkpoint(db) == SUCCESS, "Checkpoint flushes the memtable");
+    database_stats_t stats;
+    database_get_stats(db, &stats);
+    TEST_ASSERT(stats.wal_size == 0, "Flushed WAL segments removed");
+    
+    // Tables plus the WAL written after them, as after a crash
+    database_delete(db, "key00000");
+    database_put(db, "tail", "after", 6);
+    database_t* recovered = open_database(dir, &config);
+    TEST_ASSERT(recovered && lsm_range_matches(recovered, 1, 1000, "v") && value_is(recovered, "tail", "after"),
+                "Tables and WAL tail recovered");
+    database_destroy(recovered);
+    database_destroy(db);
+    
+    // Concurrent writers racing flushes and compactions
+    config.level0_compaction_trigger = 2;
+    db = open_database(dir, &config);
+    pthread_t threads[WRITER_THREADS];
+    writer_t writers[WRITER_THREADS];
+    for (int i = 0; i < WRITER_THREADS; i++) {
+        writers[i] = (writer_t){ db, i, 0 };
+        pthread_create(&threads[i], NULL, writer_main, &writers[i]);
+    }
+    lsm_put_range(db, 1000, 3000, "v");
+    int failures = 0;
+    for (int i = 0; i < WRITER_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        failures += writers[i].failures;
+    }
+    TEST_ASSERT(failures == 0, "Puts succeed during flushes");
+    database_destroy(db);
+    
+    db = open_database(dir, &config);
+    bool all_present = lsm_range_matches(db, 1, 3000, "v");
+    for (int t = 0; t < WRITER_THREADS; t++) {
+        for (int i = 0; i < WRITES_PER_THREAD; i++) {
+            char key[32];
+            char value[32];
+            snprintf(key, sizeof(key), "w%d:%d", t, i);
+            snprintf(value, sizeof(value), "value%d", i);
+            all_present = all_present && value_is(db, key, value);
+        }
+    }
+    TEST_ASSERT(all_present, "Every put found after reopening");
+    database_get_stats(db, &stats);
+    TEST_ASSERT(stats.wal_size == 0 && stats.sstable_count > 0, "Clean close leaves only tables");
+    
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+static int lsm_count_present(database_t* db, int last, const char* suffix) {
+    int present = 0;
+    for (int i = 0; i < last; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%05d%s", i, suffix);
+        present += database_exists(db, key);
+    }
+    return present;
+}
+
+void test_database_lsm_filters_and_cache(void) {
+    printf("\n=== Test: Database LSM Bloom Filters and Block Cache ===\n");
+    
+    char* dir = make_data_dir();
+    database_config_t config = lsm_config();
+    config.block_cache_bytes = 64 * 1024;
+    database_t* db = open_database(dir, &config);
+    lsm_put_range(db, 0, 3000, "v");
+    database_compact(db);
+    
+    // Absent keys that sort between present ones, so every level's range
+    // holds them and only the filters keep the lookups off disk
+    database_stats_t stats;
+    TEST_ASSERT(lsm_count_present(db, 3000, "x") == 0, "Absent keys not found");
+    database_get_stats(db, &stats);
+    TEST_ASSERT(stats.bloom_negatives + stats.bloom_false_positives >= 2990, "Filters consulted for absent keys");
+    TEST_ASSERT(stats.bloom_false_positive_rate < 0.05, "False positive rate near 1% at 10 bits per key");
+    
+    uint64_t misses = stats.block_cache_misses;
+    TEST_ASSERT(lsm_count_present(db, 3000, "") == 3000, "Present keys pass their filters");
+    TEST_ASSERT(lsm_count_present(db, 300, "") == 300, "Hot keys read again");
+    database_get_stats(db, &stats);
+    TEST_ASSERT(stats.block_cache_hits > 0 && stats.block_cache_misses > misses, "Block cache hits and misses counted");
+    TEST_ASSERT(stats.block_cache_usage > 0 && stats.block_cache_usage <= config.block_cache_bytes,
+                "Block cache stays within its budget");
+    TEST_ASSERT(stats.block_cache_hit_rate > 0.5, "Repeated reads served from the cache");
+    database_destroy(db);
+    remove_data_dir(dir);
+    
+    // Without filters every lookup in range reads a block
+    dir = make_data_dir();
+    config.bloom_bits_per_key = -1;
+    db = open_database(dir, &config);
+    lsm_put_range(db, 0, 3000, "v");
+    database_compact(db);
+    lsm_count_present(db, 3000, "x");
+    database_get_stats(db, &stats);
+    TEST_ASSERT(stats.bloom_negatives == 0 && stats.bloom_false_positives == 0 &&
+                stats.block_cache_hits + stats.block_cache_misses >= 2990, "Tables without filters read blocks");
+    
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+// =============================================================================
+// Transactions
+// =============================================================================
+
+#define COUNTER_INCREMENTS 100
+#define SNAPSHOT_READERS 4
+#define SNAPSHOT_KEYS 1200         // Twice this outgrows the table's first 1024 buckets
+
+static bool txn_value_is(transaction_t* txn, const char* key, const char* expected) {
+    void* value = NULL;
+    size_t size = 0;
+    bool matches = transaction_get(txn, key, &value, &size) == SUCCESS &&
+                   size == strlen(expected) + 1 && strcmp(value, expected) == 0;
+    free(value);
+    return matches;
+}
+
+// Snapshot reads on one engine: the snapshot keeps its view while other
+// commits overwrite, delete and add keys
+static void check_snapshot_reads(database_config_t* config, const char* label) {
+    char* dir = make_data_dir();
+    database_t* db = open_database(dir, config);
+    database_put(db, "a", "old", 4);
+    database_put(db, "b", "old", 4);
+    if (config && config->engine == DATABASE_ENGINE_LSM) {
+        database_checkpoint(db);  // The snapshot's versions come from a table
+    }
+    
+    transaction_t* snapshot = database_begin_transaction(db, ISOLATION_REPEATABLE_READ);
+    transaction_t* latest = database_begin_transaction(db, ISOLATION_READ_COMMITTED);
+    database_put(db, "a", "new", 4);
+    database_delete(db, "b");
+    database_put(db, "c", "new", 4);
+    
+    char message[96];
+    snprintf(message, sizeof(message), "Snapshot keeps overwritten and deleted values (%s)", label);
+    TEST_ASSERT(txn_value_is(snapshot, "a", "old") && txn_value_is(snapshot, "b", "old") &&
+                transaction_get(snapshot, "c", NULL, NULL) == ERROR_NOT_FOUND, message);
+    snprintf(message, sizeof(message), "Read committed sees the newest data (%s)", label);
+    TEST_ASSERT(txn_value_is(latest, "a", "new") && transaction_get(latest, "b", NULL, NULL) == ERROR_NOT_FOUND &&
+                value_is(db, "c", "new"), message);
+    transaction_rollback(latest);
+    
+    snprintf(message, sizeof(message), "Write-write conflict rolls back the commit (%s)", label);
+    transaction_put(snapshot, "a", "mine", 5);
+    TEST_ASSERT(transaction_commit(snapshot) == ERROR_CONFLICT && value_is(db, "a", "new"), message);
+    
+    database_stats_t stats;
+    database_get_stats(db, &stats);
+    uint64_t start = now_ms();
+    while (stats.mvcc_versions > 0 && now_ms() - start < 5000) {
+        database_get_stats(db, &stats);
+    }
+    snprintf(message, sizeof(message), "Versions collected once the snapshot ends (%s)", label);
+    TEST_ASSERT(stats.txn_conflicts == 1 && stats.mvcc_versions == 0, message);
+    
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+typedef struct {
+    transaction_t* snapshot;
+    int mismatches;
+} snapshot_reader_t;
+
+// Reread every key through a snapshot taken before the writer started: the
+// first half keep their old values and the second half stay missing
+static void* snapshot_reader_main(void* arg) {
+    snapshot_reader_t* reader = (snapshot_reader_t*)arg;
+    for (int round = 0; round < 4; round++) {
+        for (int i = 0; i < SNAPSHOT_KEYS * 2; i++) {
+            char key[32];
+            char value[32];
+            snprintf(key, sizeof(key), "key%05d", i);
+            snprintf(value, sizeof(value), "old%d", i);
+            bool matches = i < SNAPSHOT_KEYS ? txn_value_is(reader->snapshot, key, value)
+                                             : transaction_get(reader->snapshot, key, NULL, NULL) == ERROR_NOT_FOUND;
+            if (!matches) {
+                reader->mismatches++;
+            }
+        }
+    }
+    return NULL;
+}
+
+// Overwrite and add keys, then delete every other one
+static void* snapshot_writer_main(void* arg) {
+    database_t* db = (database_t*)arg;
+    lsm_put_range(db, 0, SNAPSHOT_KEYS * 2, "new");
+    for (int i = 0; i < SNAPSHOT_KEYS * 2; i += 2) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%05d", i);
+        database_delete(db, key);
+    }
+    return NULL;
+}
+
+// Snapshot reads racing commits, table resizes and, with the LSM engine,
+// flushes and compactions
+static void check_concurrent_snapshot_reads(database_config_t* config, const char* label) {
+    char* dir = make_data_dir();
+    database_t* db = open_database(dir, config);
+    lsm_put_range(db, 0, SNAPSHOT_KEYS, "old");
+    
+    pthread_t threads[SNAPSHOT_READERS + 1];
+    snapshot_reader_t readers[SNAPSHOT_READERS];
+    for (int i = 0; i < SNAPSHOT_READERS; i++) {
+        readers[i] = (snapshot_reader_t){ database_begin_transaction(db, ISOLATION_REPEATABLE_READ), 0 };
+        pthread_create(&threads[i], NULL, snapshot_reader_main, &readers[i]);
+    }
+    pthread_create(&threads[SNAPSHOT_READERS], NULL, snapshot_writer_main, db);
+    int mismatches = 0;
+    for (int i = 0; i <= SNAPSHOT_READERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    for (int i = 0; i < SNAPSHOT_READERS; i++) {
+        mismatches += readers[i].mismatches;
+        transaction_rollback(readers[i].snapshot);
+    }
+    
+    char message[96];
+    snprintf(message, sizeof(message), "Snapshots read unchanged data beside the writer (%s)", label);
+    TEST_ASSERT(mismatches == 0, message);
+    snprintf(message, sizeof(message), "Writer's changes all visible afterwards (%s)", label);
+    TEST_ASSERT(!database_exists(db, "key00000") && value_is(db, "key00001", "new1") &&
+                value_is(db, "key02399", "new2399"), message);
+    
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+typedef struct {
+    database_t* db;
+    int conflicts;
+} incrementer_t;
+
+// Read-modify-write of a shared counter, retried on conflict
+static void* incrementer_main(void* arg) {
+    incrementer_t* incrementer = (incrementer_t*)arg;
+    for (int i = 0; i < COUNTER_INCREMENTS; i++) {
+        int status;
+        do {
+            transaction_t* txn = database_begin_transaction(incrementer->db, ISOLATION_REPEATABLE_READ);
+            int* value = NULL;
+            transaction_get(txn, "counter", (void**)&value, NULL);
+            int next = *value + 1;
+            free(value);
+            transaction_put(txn, "counter", &next, sizeof(next));
+            status = transaction_commit(txn);
+            if (status == ERROR_CONFLICT) {
+                incrementer->conflicts++;
+            }
+        } while (status == ERROR_CONFLICT);
+    }
+    return NULL;
+}
+
+void test_database_snapshot_isolation(void) {
+    printf("\n=== Test: Database Snapshot Isolation ===\n");
+    
+    check_snapshot_reads(NULL, "hash");
+    database_config_t config = lsm_config();
+    check_snapshot_reads(&config, "lsm");
+    check_concurrent_snapshot_reads(NULL, "hash");
+    check_concurrent_snapshot_reads(&config, "lsm");
+    
+    char* dir = make_data_dir();
+    database_t* db = open_database(dir, NULL);
+    
+    // A transaction's writes become visible to snapshots all at once
+    transaction_t* snapshot = database_begin_transaction(db, ISOLATION_REPEATABLE_READ);
+    transaction_t* writer = database_begin_transaction(db, ISOLATION_REPEATABLE_READ);
+    transaction_put(writer, "x", "1", 2);
+    transaction_put(writer, "y", "1", 2);
+    TEST_ASSERT(transaction_commit(writer) == SUCCESS, "Transaction without conflicts commits");
+    TEST_ASSERT(transaction_get(snapshot, "x", NULL, NULL) == ERROR_NOT_FOUND &&
+                transaction_get(snapshot, "y", NULL, NULL) == ERROR_NOT_FOUND, "Earlier snapshot sees none of it");
+    transaction_rollback(snapshot);
+    
+    // Write skew: each reads the key the other writes. Snapshot isolation
+    // lets both commit; serializable refuses the second.
+    transaction_t* first = database_begin_transaction(db, ISOLATION_REPEATABLE_READ);
+    transaction_t* second = database_begin_transaction(db, ISOLATION_REPEATABLE_READ);
+    transaction_get(first, "x", NULL, NULL);
+    transaction_get(second, "y", NULL, NULL);
+    transaction_put(first, "y", "2", 2);
+    transaction_put(second, "x", "2", 2);
+    TEST_ASSERT(transaction_commit(first) == SUCCESS && transaction_commit(second) == SUCCESS,
+                "Repeatable read allows write skew");
+    first = database_begin_transaction(db, ISOLATION_SERIALIZABLE);
+    second = database_begin_transaction(db, ISOLATION_SERIALIZABLE);
+    transaction_get(first, "x", NULL, NULL);
+    transaction_get(second, "y", NULL, NULL);
+    transaction_put(first, "y", "3", 2);
+    transaction_put(second, "x", "3", 2);
+    TEST_ASSERT(transaction_commit(first) == SUCCESS && transaction_commit(second) == ERROR_CONFLICT &&
+                value_is(db, "x", "2"), "Serializable refuses write skew");
+    
+    // No increment is lost between concurrent read-modify-write transactions
+    int zero = 0;
+    database_put(db, "counter", &zero, sizeof(zero));
+    pthread_t threads[WRITER_THREADS];
+    incrementer_t incrementers[WRITER_THREADS];
+    for (int i = 0; i < WRITER_THREADS; i++) {
+        incrementers[i] = (incrementer_t){ db, 0 };
+        pthread_create(&threads[i], NULL, incrementer_main, &incrementers[i]);
+    }
+    for (int i = 0; i < WRITER_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    int* counter = NULL;
+    database_get(db, "counter", (void**)&counter, NULL);
+    TEST_ASSERT(counter && *counter == WRITER_THREADS * COUNTER_INCREMENTS, "Concurrent increments all counted");
+    free(counter);
+    
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+// =============================================================================
+// Indexes and Range Scans
+// =============================================================================
+
+// Scan [start, end) and check it yields key%05d for every i in [first, last)
+// with i % skip != 0, in order
+static bool scan_yields(database_t* db, const char* start, const char* end, int first, int last, int skip) {
+    database_iterator_t* it = database_scan(db, start, end);
+    bool matches = it != NULL;
+    int i = first;
+    while (matches && database_iterator_next(it)) {
+        while (skip > 0 && i < last && i % skip == 0) {
+            i++;
+        }
+        char key[32];
+        snprintf(key, sizeof(key), "key%05d", i++);
+        matches = strcmp(database_iterator_key(it), key) == 0;
+    }
+    while (skip > 0 && i < last && i % skip == 0) {
+        i++;
+    }
+    matches = matches && i == last && database_iterator_status(it) == SUCCESS;
+    database_iterator_close(it);
+    return matches;
+}
+
+void test_database_btree_index(void) {
+    printf("\n=== Test: Database B-Tree Index and Scans ===\n");
+    
+    char* dir = make_data_dir();
+    database_t* db = open_database(dir, NULL);
+    lsm_put_range(db, 0, 3000, "v");
+    
+    TEST_ASSERT(scan_yields(db, "key00100", "key00200", 100, 200, 0), "Scan without an index walks and sorts");
+    TEST_ASSERT(database_create_index(db, "primary", INDEX_BTREE) == SUCCESS, "B-tree index created");
+    TEST_ASSERT(database_create_index(db, "primary", INDEX_HASH) == ERROR_ALREADY_EXISTS,
+                "Duplicate index name rejected");
+    TEST_ASSERT(scan_yields(db, NULL, NULL, 0, 3000, 0), "Full scan returns every key in order");
+    TEST_ASSERT(scan_yields(db, "key01000", "key01500", 1000, 1500, 0), "Scan stops at the end bound");
+    TEST_ASSERT(scan_yields(db, "key00999x", "key01001", 1000, 1001, 0), "Start bound between keys");
+    TEST_ASSERT(scan_yields(db, "key09000", NULL, 0, 0, 0), "Empty range yields nothing");
+    
+    // Writes after the bulk load keep the tree in step
+    for (int i = 0; i < 3000; i += 3) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%05d", i);
+        database_delete(db, key);
+    }
+    lsm_put_range(db, 3000, 6000, "v");
+    lsm_put_range(db, 1, 2, "w");
+    TEST_ASSERT(scan_yields(db, NULL, "key03000", 0, 3000, 3), "Deletes leave the index");
+    TEST_ASSERT(scan_yields(db, "key03000", NULL, 3000, 6000, 0), "Inserts split leaves in order");
+    
+    database_iterator_t* it = database_scan(db, "key00001", NULL);
+    void* value = NULL;
+    size_t size = 0;
+    TEST_ASSERT(database_iterator_next(it) && database_iterator_value(it, &value, &size) == SUCCESS &&
+                strcmp((char*)value, "w1") == 0, "Iterator reads the current value");
+    safe_free(&value);
+    database_iterator_close(it);
+    
+    // Reopening rebuilds the tree from the snapshot and WAL
+    database_destroy(db);
+    db = open_database(dir, NULL);
+    TEST_ASSERT(scan_yields(db, NULL, "key03000", 0, 3000, 3), "Reopened table scans without an index");
+    TEST_ASSERT(database_create_index(db, "primary", INDEX_BTREE) == SUCCESS &&
+                scan_yields(db, "key03000", NULL, 3000, 6000, 0), "Index rebuilt over the recovered table");
+    
+    // Enough inserts to split inner nodes too
+    transaction_t* txn = database_begin_transaction(db, ISOLATION_READ_COMMITTED);
+    for (int i = 6000; i < 60000; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%05d", i);
+        transaction_put(txn, key, "t", 2);
+    }
+    transaction_commit(txn);
+    TEST_ASSERT(scan_yields(db, "key03000", NULL, 3000, 60000, 0), "Inner nodes split in order");
+    TEST_ASSERT(database_drop_index(db, "primary") == SUCCESS &&
+                database_drop_index(db, "primary") == ERROR_NOT_FOUND, "Index dropped once");
+    
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+void test_database_lsm_scan(void) {
+    printf("\n=== Test: Database LSM Range Scans ===\n");
+    
+    char* dir = make_data_dir();
+    database_config_t config = lsm_config();
+    database_t* db = open_database(dir, &config);
+    
+    // Versions spread over the memtable and several levels
+    lsm_put_range(db, 0, 3000, "v");
+    database_compact(db);
+    lsm_put_range(db, 1000, 2000, "w");
+    for (int i = 0; i < 3000; i += 3) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%05d", i);
+        database_delete(db, key);
+    }
+    
+    TEST_ASSERT(database_create_index(db, "primary", INDEX_BTREE) == SUCCESS, "LSM index registered");
+    TEST_ASSERT(scan_yields(db, NULL, NULL, 0, 3000, 3), "Merged scan skips tombstones and duplicates");
+    TEST_ASSERT(scan_yields(db, "key01234", "key02345", 1234, 2345, 3), "Merged scan honours both bounds");
+    
+    database_destroy(db);
+    remove_data_dir(dir);
+}
+
+// =============================================================================
+// Main Test Runner
+// =============================================================================
+
+int main(void) {
+    printf("========================================\n");
+    printf("Database Tests\n");
+    printf("========================================\n");
+    
+    // Basic Operations
+    test_database_basic_operations();
+    
+    // Group Commit
+    test_database_group_commit();
+    test_database_group_commit_config();
+    
+    // WAL Recovery
+    test_database_torn_write_recovery();
+    test_database_wal_failure();
+    test_database_write_batch();
+    
+    // Snapshots
+    test_database_snapshot_restart();
+    test_database_background_snapshot();
+    
+    // LSM Engine
+    test_database_lsm_basic();
+    test_database_lsm_compaction();
+    test_database_lsm_recovery();
+    test_database_lsm_filters_and_cache();
+    
+    // Transactions
+    test_database_snapshot_isolation();
+    
+    // Indexes and Range Scans
+    test_database_btree_index();
+    test_database_lsm_scan();
+    
+    // Summary
+    printf("\n========================================\n");
+    printf("Test Results:\n");
+    printf("  Passed: %d\n", tests_passed);
+    printf("  Failed: %d\n", tests_failed);
+    printf("  Total:  %d\n", tests_passed + tests_failed);
+    printf("========================================\n");
+    
+    return tests_failed == 0 ? 0 : 1;
+}
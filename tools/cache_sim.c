@@ -0,0 +1,495 @@
+#define _POSIX_C_SOURCE 200809L
+#include "cache.h"
+#include "common.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Trace-replay simulator for cache_t eviction policies.
+//
+// Trace formats:
+//   binary - a flat array of native-endian uint64_t key ids, no header
+//   csv    - one access per line; the key is the first field (up to ',').
+//            Empty lines and lines starting with '#' are skipped.
+//
+// Every (policy, size) pair is an independent configuration. Worker threads
+// claim configurations from a shared counter and each streams the mmapped
+// trace on its own, so the trace is parsed in place and never copied into
+// memory. Output is one CSV row per configuration; the rows for one policy
+// form its miss-ratio curve.
+
+#define SIM_MAX_KEY 256
+#define SIM_MAX_CONFIGS 1024
+#define SIM_DEFAULT_SIZES "1000,2000,5000,10000,20000,50000,100000"
+#define SIM_DEFAULT_POLICIES "lru,lfu,tinylfu,sieve"
+
+// Synthetic trace defaults
+#define GEN_DEFAULT_EVENTS 10000000
+#define GEN_DEFAULT_KEYS 1000000
+#define GEN_DEFAULT_SKEW 0.9
+
+typedef enum {
+    TRACE_BINARY,
+    TRACE_CSV
+} trace_format_t;
+
+typedef struct {
+    const uint8_t* data;
+    size_t length;
+    trace_format_t format;
+} trace_t;
+
+typedef struct {
+    eviction_policy_t policy;
+    size_t size;
+    uint64_t accesses;
+    uint64_t misses;
+    double seconds;
+} sim_config_t;
+
+typedef struct {
+    const trace_t* trace;
+    sim_config_t* configs;
+    size_t config_count;
+    size_t next_config;   // Claimed atomically by workers
+    bool verbose;
+} sim_job_t;
+
+static const struct {
+    const char* name;
+    eviction_policy_t policy;
+} policy_names[] = {
+    { "lru", EVICTION_LRU },
+    { "lfu", EVICTION_LFU },
+    { "tinylfu", EVICTION_TINYLFU },
+    { "sieve", EVICTION_SIEVE }
+};
+
+static const char* policy_name(eviction_policy_t policy) {
+    for (size_t i = 0; i < sizeof(policy_names) / sizeof(policy_names[0]); i++) {
+        if (policy_names[i].policy == policy) return policy_names[i].name;
+    }
+    return "?";
+}
+
+static int parse_policy(const char* name, eviction_policy_t* policy) {
+    for (size_t i = 0; i < sizeof(policy_names) / sizeof(policy_names[0]); i++) {
+        if (strcmp(policy_names[i].name, name) == 0) {
+            *policy = policy_names[i].policy;
+            return SUCCESS;
+        }
+    }
+    return ERROR_INVALID_PARAM;
+}
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// =============================================================================
+// Trace Reader
+// =============================================================================
+
+static int trace_open(const char* path, trace_format_t format, trace_t* trace) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return ERROR_NOT_FOUND;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return ERROR_IO;
+    }
+    
+    size_t length = (size_t)st.st_size;
+    if (format == TRACE_BINARY && length % sizeof(uint64_t) != 0) {
+        close(fd);
+        return ERROR_IO;
+    }
+    
+    void* data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return ERROR_IO;
+    }
+    posix_madvise(data, length, POSIX_MADV_SEQUENTIAL);
+    
+    trace->data = data;
+    trace->length = length;
+    trace->format = format;
+    return SUCCESS;
+}
+
+static void trace_close(trace_t* trace) {
+    munmap((void*)trace->data, trace->length);
+}
+
+// Streaming cursor over a mapped trace. Yields NUL-terminated keys in `key`.
+typedef struct {
+    const trace_t* trace;
+    size_t offset;
+    char key[SIM_MAX_KEY];
+} trace_cursor_t;
+
+// Two hex digits per byte value, filled in once by main()
+static char hex_pairs[256][2];
+
+static void init_hex_pairs(void) {
+    static const char hex[] = "0123456789abcdef";
+    for (int b = 0; b < 256; b++) {
+        hex_pairs[b][0] = hex[b >> 4];
+        hex_pairs[b][1] = hex[b & 0xF];
+    }
+}
+
+// Binary ids become "k" + 16 hex digits, a byte at a time. Short keys would be
+// cheaper still but hash less evenly, which skews W-TinyLFU's sketch.
+static void encode_key_id(uint64_t id, char* key) {
+    key[0] = 'k';
+    for (int i = 0; i < 8; i++) {
+        memcpy(key + 1 + 2 * i, hex_pairs[(id >> (56 - 8 * i)) & 0xFF], 2);
+    }
+    key[17] = '\0';
+}
+
+static bool trace_next(trace_cursor_t* cursor) {
+    const trace_t* trace = cursor->trace;
+    
+    if (trace->format == TRACE_BINARY) {
+        if (cursor->offset >= trace->length) return false;
+        uint64_t id;
+        memcpy(&id, trace->data + cursor->offset, sizeof(id));
+        cursor->offset += sizeof(id);
+        encode_key_id(id, cursor->key);
+        return true;
+    }
+    
+    while (cursor->offset < trace->length) {
+        const char* line = (const char*)trace->data + cursor->offset;
+        size_t remaining = trace->length - cursor->offset;
+        const char* end = memchr(line, '\n', remaining);
+        size_t line_length = end ? (size_t)(end - line) : remaining;
+        cursor->offset += line_length + (end ? 1 : 0);
+        
+        size_t key_length = 0;
+        while (key_length < line_length && line[key_length] != ',' &&
+               line[key_length] != '\r') {
+            key_length++;
+        }
+        if (key_length == 0 || line[0] == '#') continue;
+        if (key_length >= SIM_MAX_KEY) key_length = SIM_MAX_KEY - 1;
+        
+        memcpy(cursor->key, line, key_length);
+        cursor->key[key_length] = '\0';
+        return true;
+    }
+    
+    return false;
+}
+
+// =============================================================================
+// Replay
+// =============================================================================
+
+// Demand-fill replay: every miss is followed by a put of the missing key.
+// Each cache is private to its worker, so the write lock is never contended.
+static void replay(const trace_t* trace, sim_config_t* config) {
+    cache_t* cache = cache_create(config->size, config->policy);
+    trace_cursor_t cursor = { .trace = trace, .offset = 0 };
+    uint64_t start = get_time_ns();
+    
+    while (trace_next(&cursor)) {
+        cache_replay_access(cache, cursor.key);
+    }
+    
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    config->accesses = stats.hits + stats.misses;
+    config->misses = stats.misses;
+    config->seconds = (get_time_ns() - start) / 1e9;
+    
+    cache_destroy(cache);
+}
+
+static void* sim_worker(void* arg) {
+    sim_job_t* job = (sim_job_t*)arg;
+    
+    for (;;) {
+        size_t index = __atomic_fetch_add(&job->next_config, 1, __ATOMIC_RELAXED);
+        if (index >= job->config_count) break;
+        
+        sim_config_t* config = &job->configs[index];
+        replay(job->trace, config);
+        
+        if (job->verbose) {
+            fprintf(stderr, "%s size=%zu: %.2fs, %.1f M accesses/s\n",
+                    policy_name(config->policy), config->size, config->seconds,
+                    config->accesses / config->seconds / 1e6);
+        }
+    }
+    
+    return NULL;
+}
+
+// =============================================================================
+// Synthetic Traces
+// =============================================================================
+
+static uint64_t rng_state = 0x2545F4914F6CDD1DULL;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Writes a binary Zipf trace using an inverted CDF table
+static int generate_trace(const char* path, size_t events, size_t keys, double skew) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return ERROR_IO;
+    }
+    
+    double* cdf = safe_malloc(keys * sizeof(double));
+    double sum = 0.0;
+    for (size_t i = 0; i < keys; i++) {
+        sum += 1.0 / pow((double)(i + 1), skew);
+        cdf[i] = sum;
+    }
+    for (size_t i = 0; i < keys; i++) {
+        cdf[i] /= sum;
+    }
+    
+    uint64_t buffer[4096];
+    size_t buffered = 0;
+    int result = SUCCESS;
+    
+    for (size_t e = 0; e < events; e++) {
+        double u = (double)(next_random() >> 11) / (double)(1ULL << 53);
+        size_t lo = 0;
+        size_t hi = keys - 1;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (cdf[mid] < u) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        
+        buffer[buffered++] = lo;
+        if (buffered == sizeof(buffer) / sizeof(buffer[0]) || e + 1 == events) {
+            if (fwrite(buffer, sizeof(uint64_t), buffered, file) != buffered) {
+                result = ERROR_IO;
+                break;
+            }
+            buffered = 0;
+        }
+    }
+    
+    safe_free((void**)&cdf);
+    if (fclose(file) != 0) {
+        result = ERROR_IO;
+    }
+    return result;
+}
+
+// =============================================================================
+// Command Line
+// =============================================================================
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options] <trace>\n"
+            "       %s -g <out.bin> [-n events] [-k keys] [-z skew]\n"
+            "\n"
+            "Replay options:\n"
+            "  -f binary|csv   Trace format (default: csv for *.csv, else binary)\n"
+            "  -p list         Policies: lru,lfu,tinylfu,sieve (default: all)\n"
+            "  -s list         Cache sizes in entries (default: %s)\n"
+            "  -t threads      Worker threads (default: online CPUs)\n"
+            "  -o file         Write the CSV result to file (default: stdout)\n"
+            "  -v              Per-configuration progress on stderr\n"
+            "\n"
+            "Generator options:\n"
+            "  -g file         Write a synthetic Zipf trace in binary format\n"
+            "  -n events       Trace length (default: %d)\n"
+            "  -k keys         Key space (default: %d)\n"
+            "  -z skew         Zipf exponent (default: %.1f)\n",
+            program, program, SIM_DEFAULT_SIZES,
+            GEN_DEFAULT_EVENTS, GEN_DEFAULT_KEYS, GEN_DEFAULT_SKEW);
+}
+
+static size_t parse_list(char* list, char** items, size_t max_items) {
+    size_t count = 0;
+    char* saveptr = NULL;
+    for (char* item = strtok_r(list, ",", &saveptr); item && count < max_items;
+         item = strtok_r(NULL, ",", &saveptr)) {
+        items[count++] = item;
+    }
+    return count;
+}
+
+int main(int argc, char** argv) {
+    const char* policies_arg = SIM_DEFAULT_POLICIES;
+    const char* sizes_arg = SIM_DEFAULT_SIZES;
+    const char* format_arg = NULL;
+    const char* output_path = NULL;
+    const char* generate_path = NULL;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t gen_events = GEN_DEFAULT_EVENTS;
+    size_t gen_keys = GEN_DEFAULT_KEYS;
+    double gen_skew = GEN_DEFAULT_SKEW;
+    bool verbose = false;
+    
+    int opt;
+    while ((opt = getopt(argc, argv, "f:p:s:t:o:vg:n:k:z:h")) != -1) {
+        switch (opt) {
+            case 'f': format_arg = optarg; break;
+            case 'p': policies_arg = optarg; break;
+            case 's': sizes_arg = optarg; break;
+            case 't': threads = strtol(optarg, NULL, 10); break;
+            case 'o': output_path = optarg; break;
+            case 'v': verbose = true; break;
+            case 'g': generate_path = optarg; break;
+            case 'n': gen_events = strtoull(optarg, NULL, 10); break;
+            case 'k': gen_keys = strtoull(optarg, NULL, 10); break;
+            case 'z': gen_skew = strtod(optarg, NULL); break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    
+    if (generate_path) {
+        if (gen_events == 0 || gen_keys == 0) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (generate_trace(generate_path, gen_events, gen_keys, gen_skew) != SUCCESS) {
+            fprintf(stderr, "Failed to write %s\n", generate_path);
+            return 1;
+        }
+        return 0;
+    }
+    
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char* trace_path = argv[optind];
+    
+    trace_format_t format = TRACE_BINARY;
+    if (format_arg) {
+        if (strcmp(format_arg, "csv") == 0) {
+            format = TRACE_CSV;
+        } else if (strcmp(format_arg, "binary") != 0) {
+            usage(argv[0]);
+            return 1;
+        }
+    } else {
+        size_t length = strlen(trace_path);
+        if (length >= 4 && strcmp(trace_path + length - 4, ".csv") == 0) {
+            format = TRACE_CSV;
+        }
+    }
+    
+    // Expand the policy x size grid
+    char* policy_list = safe_strdup(policies_arg);
+    char* size_list = safe_strdup(sizes_arg);
+    char* policy_items[16];
+    char* size_items[SIM_MAX_CONFIGS];
+    size_t policy_count = parse_list(policy_list, policy_items, 16);
+    size_t size_count = parse_list(size_list, size_items, SIM_MAX_CONFIGS);
+    
+    sim_config_t* configs = safe_calloc(policy_count * size_count + 1, sizeof(sim_config_t));
+    size_t config_count = 0;
+    int status = 0;
+    
+    for (size_t p = 0; p < policy_count && status == 0; p++) {
+        eviction_policy_t policy;
+        if (parse_policy(policy_items[p], &policy) != SUCCESS) {
+            fprintf(stderr, "Unknown policy: %s\n", policy_items[p]);
+            status = 1;
+            break;
+        }
+        for (size_t s = 0; s < size_count; s++) {
+            size_t size = strtoull(size_items[s], NULL, 10);
+            if (size == 0) {
+                fprintf(stderr, "Invalid cache size: %s\n", size_items[s]);
+                status = 1;
+                break;
+            }
+            configs[config_count++] = (sim_config_t){ .policy = policy, .size = size };
+        }
+    }
+    
+    trace_t trace;
+    if (status == 0 && config_count == 0) {
+        usage(argv[0]);
+        status = 1;
+    }
+    if (status == 0 && trace_open(trace_path, format, &trace) != SUCCESS) {
+        fprintf(stderr, "Cannot read trace %s\n", trace_path);
+        status = 1;
+    }
+    
+    if (status == 0) {
+        init_hex_pairs();
+        sim_job_t job = {
+            .trace = &trace,
+            .configs = configs,
+            .config_count = config_count,
+            .next_config = 0,
+            .verbose = verbose
+        };
+        
+        if (threads < 1) threads = 1;
+        if ((size_t)threads > config_count) threads = (long)config_count;
+        
+        // The calling thread is worker 0
+        pthread_t* tids = safe_calloc((size_t)threads, sizeof(pthread_t));
+        long spawned = 1;
+        while (spawned < threads &&
+               pthread_create(&tids[spawned], NULL, sim_worker, &job) == 0) {
+            spawned++;
+        }
+        sim_worker(&job);
+        for (long t = 1; t < spawned; t++) {
+            pthread_join(tids[t], NULL);
+        }
+        safe_free((void**)&tids);
+        trace_close(&trace);
+        
+        FILE* out = output_path ? fopen(output_path, "w") : stdout;
+        if (!out) {
+            fprintf(stderr, "Cannot write %s\n", output_path);
+            status = 1;
+        } else {
+            fprintf(out, "policy,cache_size,accesses,misses,miss_ratio\n");
+            for (size_t i = 0; i < config_count; i++) {
+                const sim_config_t* config = &configs[i];
+                fprintf(out, "%s,%zu,%llu,%llu,%.6f\n",
+                        policy_name(config->policy), config->size,
+                        (unsigned long long)config->accesses,
+                        (unsigned long long)config->misses,
+                        config->accesses ? (double)config->misses / config->accesses : 0.0);
+            }
+            if (out != stdout) fclose(out);
+        }
+    }
+    
+    safe_free((void**)&configs);
+    safe_free((void**)&policy_list);
+    safe_free((void**)&size_list);
+    return status;
+}
@@ -0,0 +1,670 @@
+#define _POSIX_C_SOURCE 200809L
+#include "cache.h"
+#include "common.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+// Minimal RESP2 server backed by cache_t, for exercising the Redis client in
+// cache_strategies offline. Single-threaded poll() loop: every complete
+// command in a client's input buffer is executed in order and the replies are
+// written back together, so pipelined requests cost one read and one write.
+//
+// Values are stored in cache_t as an 8-byte absolute expiry (ms, 0 = none)
+// followed by the payload, which lets PTTL report what cache_t enforces.
+//
+// Supported: PING ECHO QUIT SELECT AUTH COMMAND GET SET [EX s|PX ms] MGET MSET
+// DEL EXISTS INCR DECR INCRBY DECRBY APPEND EXPIRE PEXPIRE TTL PTTL PERSIST
+// DBSIZE FLUSHDB FLUSHALL
+
+#define SERVER_DEFAULT_ENTRIES 1000000
+#define SERVER_MAX_CLIENTS 1024
+#define SERVER_READ_CHUNK 16384
+
+typedef struct {
+    int fd;
+    char* in;
+    size_t in_len;
+    size_t in_cap;
+    char* out;
+    size_t out_len;
+    size_t out_cap;
+    size_t out_sent;
+    const char** argv;      // Point into `in`
+    size_t* arglen;
+    size_t arg_cap;
+    bool closing;
+} client_t;
+
+typedef struct {
+    cache_t* cache;
+    client_t clients[SERVER_MAX_CLIENTS];
+    struct pollfd fds[SERVER_MAX_CLIENTS + 1];
+    size_t client_count;
+} server_t;
+
+static volatile sig_atomic_t running = 1;
+
+static void handle_signal(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+// =============================================================================
+// Reply Encoding
+// =============================================================================
+
+static void out_reserve(client_t* client, size_t extra) {
+    if (client->out_len + extra > client->out_cap) {
+        size_t capacity = client->out_cap > 0 ? client->out_cap : SERVER_READ_CHUNK;
+        while (capacity < client->out_len + extra) {
+            capacity *= 2;
+        }
+        client->out = safe_realloc(client->out, capacity);
+        client->out_cap = capacity;
+    }
+}
+
+static void reply_raw(client_t* client, const char* data, size_t length) {
+    out_reserve(client, length);
+    memcpy(client->out + client->out_len, data, length);
+    client->out_len += length;
+}
+
+static void reply_line(client_t* client, char type, const char* text) {
+    size_t length = strlen(text);
+    out_reserve(client, length + 3);
+    client->out[client->out_len] = type;
+    memcpy(client->out + client->out_len + 1, text, length);
+    memcpy(client->out + client->out_len + 1 + length, "\r\n", 2);
+    client->out_len += length + 3;
+}
+
+static void reply_status(client_t* client, const char* status) {
+    reply_line(client, '+', status);
+}
+
+static void reply_error(client_t* client, const char* message) {
+    reply_line(client, '-', message);
+}
+
+static void reply_integer(client_t* client, long long value) {
+    out_reserve(client, 24);
+    client->out_len += (size_t)sprintf(client->out + client->out_len, ":%lld\r\n", value);
+}
+
+static void reply_header(client_t* client, char type, long long count) {
+    out_reserve(client, 24);
+    client->out_len += (size_t)sprintf(client->out + client->out_len, "%c%lld\r\n", type, count);
+}
+
+static void reply_bulk(client_t* client, const void* data, size_t length) {
+    reply_header(client, '$', (long long)length);
+    out_reserve(client, length + 2);
+    memcpy(client->out + client->out_len, data, length);
+    memcpy(client->out + client->out_len + length, "\r\n", 2);
+    client->out_len += length + 2;
+}
+
+static void reply_nil(client_t* client) {
+    reply_raw(client, "$-1\r\n", 5);
+}
+
+// =============================================================================
+// Storage
+// =============================================================================
+
+#define HEADER_SIZE sizeof(uint64_t)
+
+// Fetch a live value; *data points into the returned buffer past the header
+static void* store_get(cache_t* cache, const char* key, const char** data, size_t* length,
+                       uint64_t* expires_at) {
+    void* stored = NULL;
+    size_t stored_size = 0;
+    if (cache_get(cache, key, &stored, &stored_size) != SUCCESS || stored_size < HEADER_SIZE) {
+        free(stored);
+        return NULL;
+    }
+    
+    uint64_t expiry;
+    memcpy(&expiry, stored, HEADER_SIZE);
+    if (expiry != 0 && expiry <= get_timestamp_ms()) {
+        free(stored);
+        cache_delete(cache, key);
+        return NULL;
+    }
+    
+    *data = (const char*)stored + HEADER_SIZE;
+    *length = stored_size - HEADER_SIZE;
+    if (expires_at) {
+        *expires_at = expiry;
+    }
+    return stored;
+}
+
+static int store_put(cache_t* cache, const char* key, const void* data, size_t length, uint64_t ttl_ms) {
+    uint8_t* stored = safe_malloc(HEADER_SIZE + length);
+    uint64_t expiry = ttl_ms > 0 ? get_timestamp_ms() + ttl_ms : 0;
+    memcpy(stored, &expiry, HEADER_SIZE);
+    memcpy(stored + HEADER_SIZE, data, length);
+    
+    int result = ttl_ms > 0 ? cache_put_with_ttl(cache, key, stored, HEADER_SIZE + length, ttl_ms)
+                            : cache_put(cache, key, stored, HEADER_SIZE + length);
+    free(stored);
+    return result;
+}
+
+static bool parse_integer(const char* text, size_t length, long long* value) {
+    if (length == 0 || length > 20) {
+        return false;
+    }
+    char digits[24];
+    memcpy(digits, text, length);
+    digits[length] = '\0';
+    
+    char* end = NULL;
+    errno = 0;
+    *value = strtoll(digits, &end, 10);
+    return errno == 0 && *end == '\0';
+}
+
+// =============================================================================
+// Commands
+// =============================================================================
+
+static bool arg_is(const client_t* client, size_t index, const char* name) {
+    return strlen(name) == client->arglen[index] && strncasecmp(client->argv[index], name, client->arglen[index]) == 0;
+}
+
+static void cmd_set(server_t* server, client_t* client, size_t argc) {
+    uint64_t ttl_ms = 0;
+    for (size_t i = 3; i < argc; i += 2) {
+        long long amount;
+        if (i + 1 >= argc || !parse_integer(client->argv[i + 1], client->arglen[i + 1], &amount) || amount <= 0) {
+            reply_error(client, "ERR syntax error");
+            return;
+        }
+        if (arg_is(client, i, "EX")) {
+            ttl_ms = (uint64_t)amount * 1000;
+        } else if (arg_is(client, i, "PX")) {
+            ttl_ms = (uint64_t)amount;
+        } else {
+            reply_error(client, "ERR syntax error");
+            return;
+        }
+    }
+    
+    if (store_put(server->cache, client->argv[1], client->argv[2], client->arglen[2], ttl_ms) != SUCCESS) {
+        reply_error(client, "ERR out of memory");
+        return;
+    }
+    reply_status(client, "OK");
+}
+
+static void cmd_incrby(server_t* server, client_t* client, long long delta) {
+    const char* key = client->argv[1];
+    const char* data = NULL;
+    size_t length = 0;
+    uint64_t expires_at = 0;
+    long long current = 0;
+    
+    void* stored = store_get(server->cache, key, &data, &length, &expires_at);
+    if (stored && !parse_integer(data, length, &current)) {
+        free(stored);
+        reply_error(client, "ERR value is not an integer or out of range");
+        return;
+    }
+    free(stored);
+    
+    if ((delta > 0 && current > INT64_MAX - delta) || (delta < 0 && current < INT64_MIN - delta)) {
+        reply_error(client, "ERR increment or decrement would overflow");
+        return;
+    }
+    current += delta;
+    
+    // Keep the remaining TTL
+    uint64_t now = get_timestamp_ms();
+    uint64_t ttl_ms = expires_at > now ? expires_at - now : 0;
+    char digits[24];
+    int digits_length = snprintf(digits, sizeof(digits), "%lld", current);
+    store_put(server->cache, key, digits, (size_t)digits_length, ttl_ms);
+    reply_integer(client, current);
+}
+
+static void cmd_append(server_t* server, client_t* client) {
+    const char* key = client->argv[1];
+    const char* data = "";
+    size_t length = 0;
+    uint64_t expires_at = 0;
+    void* stored = store_get(server->cache, key, &data, &length, &expires_at);
+    
+    size_t total = length + client->arglen[2];
+    char* joined = safe_malloc(total > 0 ? total : 1);
+    memcpy(joined, data, length);
+    memcpy(joined + length, client->argv[2], client->arglen[2]);
+    free(stored);
+    
+    uint64_t now = get_timestamp_ms();
+    store_put(server->cache, key, joined, total, expires_at > now ? expires_at - now : 0);
+    free(joined);
+    reply_integer(client, (long long)total);
+}
+
+// Rewrite the value with a new TTL (0 = persist). Returns false if the key is missing.
+static bool store_retime(cache_t* cache, const char* key, uint64_t ttl_ms, bool only_if_expiring) {
+    const char* data = NULL;
+    size_t length = 0;
+    uint64_t expires_at = 0;
+    void* stored = store_get(cache, key, &data, &length, &expires_at);
+    if (!stored) {
+        return false;
+    }
+    
+    bool changed = !only_if_expiring || expires_at != 0;
+    if (changed) {
+        store_put(cache, key, data, length, ttl_ms);
+    }
+    free(stored);
+    return changed;
+}
+
+static void cmd_ttl(server_t* server, client_t* client, bool millis) {
+    const char* data = NULL;
+    size_t length = 0;
+    uint64_t expires_at = 0;
+    void* stored = store_get(server->cache, client->argv[1], &data, &length, &expires_at);
+    if (!stored) {
+        reply_integer(client, -2);
+        return;
+    }
+    free(stored);
+    
+    if (expires_at == 0) {
+        reply_integer(client, -1);
+        return;
+    }
+    // The key may have expired since store_get checked it
+    uint64_t now = get_timestamp_ms();
+    if (expires_at <= now) {
+        reply_integer(client, -2);
+        return;
+    }
+    uint64_t remaining = expires_at - now;
+    reply_integer(client, (long long)(millis ? remaining : (remaining + 999) / 1000));
+}
+
+static void execute(server_t* server, client_t* client, size_t argc) {
+    cache_t* cache = server->cache;
+    
+    if (arg_is(client, 0, "PING")) {
+        if (argc > 1) {
+            reply_bulk(client, client->argv[1], client->arglen[1]);
+        } else {
+            reply_status(client, "PONG");
+        }
+    } else if (arg_is(client, 0, "ECHO") && argc == 2) {
+        reply_bulk(client, client->argv[1], client->arglen[1]);
+    } else if (arg_is(client, 0, "QUIT")) {
+        reply_status(client, "OK");
+        client->closing = true;
+    } else if (arg_is(client, 0, "SELECT") || arg_is(client, 0, "AUTH")) {
+        reply_status(client, "OK");
+    } else if (arg_is(client, 0, "COMMAND")) {
+        reply_header(client, '*', 0);
+    } else if (arg_is(client, 0, "GET") && argc == 2) {
+        const char* data = NULL;
+        size_t length = 0;
+        void* stored = store_get(cache, client->argv[1], &data, &length, NULL);
+        if (stored) {
+            reply_bulk(client, data, length);
+            free(stored);
+        } else {
+            reply_nil(client);
+        }
+    } else if (arg_is(client, 0, "SET") && argc >= 3) {
+        cmd_set(server, client, argc);
+    } else if (arg_is(client, 0, "MGET") && argc >= 2) {
+        reply_header(client, '*', (long long)(argc - 1));
+        for (size_t i = 1; i < argc; i++) {
+            const char* data = NULL;
+            size_t length = 0;
+            void* stored = store_get(cache, client->argv[i], &data, &length, NULL);
+            if (stored) {
+                reply_bulk(client, data, length);
+                free(stored);
+            } else {
+                reply_nil(client);
+            }
+        }
+    } else if (arg_is(client, 0, "MSET") && argc >= 3 && argc % 2 == 1) {
+        for (size_t i = 1; i < argc; i += 2) {
+            store_put(cache, client->argv[i], client->argv[i + 1], client->arglen[i + 1], 0);
+        }
+        reply_status(client, "OK");
+    } else if ((arg_is(client, 0, "DEL") || arg_is(client, 0, "EXISTS")) && argc >= 2) {
+        bool remove = arg_is(client, 0, "DEL");
+        long long count = 0;
+        for (size_t i = 1; i < argc; i++) {
+            const char* data = NULL;
+            size_t length = 0;
+            void* stored = store_get(cache, client->argv[i], &data, &length, NULL);
+            if (stored) {
+                count++;
+                free(stored);
+                if (remove) {
+                    cache_delete(cache, client->argv[i]);
+                }
+            }
+        }
+        reply_integer(client, count);
+    } else if ((arg_is(client, 0, "INCR") || arg_is(client, 0, "DECR")) && argc == 2) {
+        cmd_incrby(server, client, arg_is(client, 0, "INCR") ? 1 : -1);
+    } else if ((arg_is(client, 0, "INCRBY") || arg_is(client, 0, "DECRBY")) && argc == 3) {
+        long long delta;
+        if (!parse_integer(client->argv[2], client->arglen[2], &delta) || delta == INT64_MIN) {
+            reply_error(client, "ERR value is not an integer or out of range");
+        } else {
+            cmd_incrby(server, client, arg_is(client, 0, "INCRBY") ? delta : -delta);
+        }
+    } else if (arg_is(client, 0, "APPEND") && argc == 3) {
+        cmd_append(server, client);
+    } else if ((arg_is(client, 0, "EXPIRE") || arg_is(client, 0, "PEXPIRE")) && argc == 3) {
+        long long amount;
+        if (!parse_integer(client->argv[2], client->arglen[2], &amount)) {
+            reply_error(client, "ERR value is not an integer or out of range");
+        } else if (amount <= 0) {
+            // Already expired
+            long long removed = cache_exists(cache, client->argv[1]) ? 1 : 0;
+            cache_delete(cache, client->argv[1]);
+            reply_integer(client, removed);
+        } else {
+            uint64_t ttl_ms = (uint64_t)amount * (arg_is(client, 0, "EXPIRE") ? 1000 : 1);
+            reply_integer(client, store_retime(cache, client->argv[1], ttl_ms, false) ? 1 : 0);
+        }
+    } else if ((arg_is(client, 0, "TTL") || arg_is(client, 0, "PTTL")) && argc == 2) {
+        cmd_ttl(server, client, arg_is(client, 0, "PTTL"));
+    } else if (arg_is(client, 0, "PERSIST") && argc == 2) {
+        reply_integer(client, store_retime(cache, client->argv[1], 0, true) ? 1 : 0);
+    } else if (arg_is(client, 0, "DBSIZE")) {
+        cache_stats_t stats;
+        cache_get_stats(cache, &stats);
+        reply_integer(client, (long long)stats.size);
+    } else if (arg_is(client, 0, "FLUSHDB") || arg_is(client, 0, "FLUSHALL")) {
+        cache_clear(cache);
+        reply_status(client, "OK");
+    } else {
+        reply_error(client, "ERR unknown command or wrong number of arguments");
+    }
+}
+
+// =============================================================================
+// Request Parsing
+// =============================================================================
+
+// Parse "<prefix><integer>\r\n" at p. Returns the position after the line,
+// NULL if incomplete, or `end + 1` on a protocol error.
+static const char* parse_line_integer(const char* p, const char* end, char prefix, long long* value) {
+    if (p >= end) return NULL;
+    if (*p != prefix) return end + 1;
+    const char* cr = memchr(p, '\r', (size_t)(end - p));
+    if (!cr || cr + 1 >= end) return NULL;
+    if (cr[1] != '\n' || !parse_integer(p + 1, (size_t)(cr - p - 1), value)) return end + 1;
+    return cr + 2;
+}
+
+// Parse one multibulk command at the start of the input. Arguments are left
+// in place; the '\r' after each one is overwritten with '\0' so keys can be
+// passed to cache_t without copying. Returns bytes consumed, 0 if incomplete,
+// or -1 on a protocol error.
+static long parse_command(client_t* client, size_t offset, size_t* argc) {
+    char* start = client->in + offset;
+    const char* end = client->in + client->in_len;
+    long long count;
+    
+    const char* p = parse_line_integer(start, end, '*', &count);
+    if (!p) return 0;
+    if (p > end || count <= 0 || count > 1024 * 1024) return -1;
+    
+    if ((size_t)count > client->arg_cap) {
+        client->arg_cap = (size_t)count;
+        client->argv = safe_realloc(client->argv, client->arg_cap * sizeof(char*));
+        client->arglen = safe_realloc(client->arglen, client->arg_cap * sizeof(size_t));
+    }
+    
+    for (long long i = 0; i < count; i++) {
+        long long length;
+        p = parse_line_integer(p, end, '$', &length);
+        if (!p) return 0;
+        if (p > end || length < 0) return -1;
+        if ((size_t)(end - p) < (size_t)length + 2) return 0;
+        if (p[length] != '\r' || p[length + 1] != '\n') return -1;
+        
+        client->argv[i] = p;
+        client->arglen[i] = (size_t)length;
+        p += length + 2;
+    }
+    
+    for (long long i = 0; i < count; i++) {
+        ((char*)client->argv[i])[client->arglen[i]] = '\0';
+    }
+    *argc = (size_t)count;
+    return (long)(p - start);
+}
+
+// =============================================================================
+// Event Loop
+// =============================================================================
+
+static void client_reset(client_t* client) {
+    safe_free((void**)&client->in);
+    safe_free((void**)&client->out);
+    safe_free((void**)&client->argv);
+    safe_free((void**)&client->arglen);
+    memset(client, 0, sizeof(*client));
+    client->fd = -1;
+}
+
+// Returns false when the connection should be closed
+static bool client_read(server_t* server, client_t* client) {
+    if (client->in_cap - client->in_len < SERVER_READ_CHUNK) {
+        client->in_cap = client->in_cap > 0 ? client->in_cap * 2 : SERVER_READ_CHUNK * 2;
+        client->in = safe_realloc(client->in, client->in_cap);
+    }
+    
+    ssize_t received = recv(client->fd, client->in + client->in_len, client->in_cap - client->in_len, 0);
+    if (received <= 0) {
+        return received < 0 && (errno == EAGAIN || errno == EINTR);
+    }
+    client->in_len += (size_t)received;
+    
+    size_t offset = 0;
+    while (offset < client->in_len && !client->closing) {
+        size_t argc = 0;
+        long consumed = parse_command(client, offset, &argc);
+        if (consumed < 0) {
+            reply_error(client, "ERR Protocol error");
+            client->closing = true;
+            break;
+        }
+        if (consumed == 0) {
+            break;
+        }
+        execute(server, client, argc);
+        offset += (size_t)consumed;
+    }
+    
+    memmove(client->in, client->in + offset, client->in_len - offset);
+    client->in_len -= offset;
+    return true;
+}
+
+static bool client_write(client_t* client) {
+    while (client->out_sent < client->out_len) {
+        ssize_t sent = send(client->fd, client->out + client->out_sent, client->out_len - client->out_sent, MSG_NOSIGNAL);
+        if (sent < 0) {
+            return errno == EAGAIN || errno == EINTR;
+        }
+        client->out_sent += (size_t)sent;
+    }
+    client->out_len = 0;
+    client->out_sent = 0;
+    return !client->closing;
+}
+
+static int listen_on(uint16_t port, uint16_t* bound_port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    socklen_t addr_len = sizeof(addr);
+    
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 128) != 0 ||
+        getsockname(fd, (struct sockaddr*)&addr, &addr_len) != 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    *bound_port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static void serve(server_t* server, int listen_fd) {
+    for (size_t i = 0; i < SERVER_MAX_CLIENTS; i++) {
+        server->clients[i].fd = -1;
+    }
+    
+    while (running) {
+        // Slot 0 is the listener; the rest mirror the client table
+        server->fds[0] = (struct pollfd){ listen_fd, POLLIN, 0 };
+        for (size_t i = 0; i < SERVER_MAX_CLIENTS; i++) {
+            client_t* client = &server->clients[i];
+            short events = client->out_len > client->out_sent ? POLLOUT : POLLIN;
+            server->fds[i + 1] = (struct pollfd){ client->fd, events, 0 };
+        }
+        
+        if (poll(server->fds, SERVER_MAX_CLIENTS + 1, 200) <= 0) {
+            continue;
+        }
+        
+        if (server->fds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(listen_fd, NULL, NULL)) >= 0) {
+                size_t slot = 0;
+                while (slot < SERVER_MAX_CLIENTS && server->clients[slot].fd >= 0) slot++;
+                if (slot == SERVER_MAX_CLIENTS) {
+                    close(fd);
+                    continue;
+                }
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                server->clients[slot].fd = fd;
+                server->client_count++;
+            }
+        }
+        
+        for (size_t i = 0; i < SERVER_MAX_CLIENTS; i++) {
+            client_t* client = &server->clients[i];
+            short revents = server->fds[i + 1].revents;
+            if (client->fd < 0 || revents == 0) {
+                continue;
+            }
+            
+            bool open = !(revents & (POLLERR | POLLNVAL));
+            if (open && (revents & (POLLIN | POLLHUP))) {
+                open = client_read(server, client);
+            }
+            if (open && client->out_len > 0) {
+                open = client_write(client);
+            }
+            if (!open) {
+                close(client->fd);
+                client_reset(client);
+                server->client_count--;
+            }
+        }
+    }
+    
+    for (size_t i = 0; i < SERVER_MAX_CLIENTS; i++) {
+        if (server->clients[i].fd >= 0) {
+            close(server->clients[i].fd);
+            client_reset(&server->clients[i]);
+        }
+    }
+}
+
+// =============================================================================
+// Command Line
+// =============================================================================
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [-p port] [-s max_entries]\n"
+            "\n"
+            "  -p port         TCP port on 127.0.0.1 (default: 6379, 0 = any free port)\n"
+            "  -s entries      cache_t capacity (default: %d)\n"
+            "\n"
+            "Prints \"port <n>\" on stdout once it accepts connections.\n",
+            program, SERVER_DEFAULT_ENTRIES);
+}
+
+int main(int argc, char** argv) {
+    long port = 6379;
+    size_t max_entries = SERVER_DEFAULT_ENTRIES;
+    
+    int opt;
+    while ((opt = getopt(argc, argv, "p:s:h")) != -1) {
+        switch (opt) {
+            case 'p': port = strtol(optarg, NULL, 10); break;
+            case 's': max_entries = strtoull(optarg, NULL, 10); break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (port < 0 || port > 65535 || max_entries == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    
+    uint16_t bound_port = 0;
+    int listen_fd = listen_on((uint16_t)port, &bound_port);
+    if (listen_fd < 0) {
+        fprintf(stderr, "Cannot listen on port %ld: %s\n", port, strerror(errno));
+        return 1;
+    }
+    
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    
+    server_t* server = safe_calloc(1, sizeof(server_t));
+    server->cache = cache_create(max_entries, EVICTION_LRU);
+    
+    printf("port %u\n", bound_port);
+    fflush(stdout);
+    
+    serve(server, listen_fd);
+    
+    close(listen_fd);
+    cache_destroy(server->cache);
+    free(server);
+    return 0;
+}